@@ -0,0 +1,713 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+#include <algorithm>
+#include <chrono>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#elif defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+#include "Utils.hpp"
+#include "my_math.h"
+
+//? Asynchronous whole-file reads. On Linux one service thread owns an io_uring: files are opened on it,
+//? split into chunks and the chunks of the most urgent requests go into the submission queue, many per
+//? io_uring_enter. Elsewhere, or when the kernel refuses io_uring (old kernel, seccomp), a few threads
+//? read with fread instead. Data lands in a caller owned IoArena, page aligned so it can be copied
+//? straight into mapped upload buffers. Completion runs a callback on the I/O thread, or fulfils a future.
+//? Cancelling a queued request drops it; cancelling one in flight stops its remaining chunks.
+
+namespace lib
+{
+	enum class IoPriority : u32
+	{
+		high,   // something on screen is waiting for it
+		normal,
+		low,    // prefetch
+		count
+	};
+
+	enum class IoStatus : u32
+	{
+		done,
+		failed,
+		cancelled,
+	};
+
+	enum class IoBackend : u32
+	{
+		uring,
+		threads,
+	};
+
+	inline const char* io_backend_name(IoBackend backend)
+	{
+		return backend == IoBackend::uring ? "io_uring" : "threads";
+	}
+
+	//? Bump allocator in blocks of at least block_size, all allocations page aligned. Thread safe; memory
+	//? stays valid until reset() or destroy(), which the owner calls once nothing reads it anymore.
+	struct IoArena
+	{
+		static constexpr size_t alignment = 4096;
+
+		struct Block
+		{
+			u8* base;
+			size_t size;
+			size_t used;
+		};
+
+		size_t block_size = 0;
+		std::vector<Block> blocks;
+		std::mutex mutex;
+
+		void init(size_t min_block_size = 64ull << 20)
+		{
+			block_size = (min_block_size + alignment - 1) & ~(alignment - 1);
+		}
+
+		void destroy()
+		{
+			for (Block& b : blocks)
+				free_aligned(b.base);
+			blocks.clear();
+		}
+
+		u8* alloc(size_t size)
+		{
+			size = (size + alignment - 1) & ~(alignment - 1);
+			std::lock_guard<std::mutex> lock(mutex);
+			for (Block& b : blocks)
+			{
+				if (b.size - b.used >= size)
+				{
+					u8* p = b.base + b.used;
+					b.used += size;
+					return p;
+				}
+			}
+			const size_t bytes = max(block_size, size);
+			u8* base = alloc_aligned(bytes);
+			if (!base)
+				return nullptr;
+			blocks.push_back({ base, bytes, size });
+			return base;
+		}
+
+		//? Keeps the blocks for the next batch
+		void reset()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (Block& b : blocks)
+				b.used = 0;
+		}
+
+		size_t capacity() const
+		{
+			size_t total = 0;
+			for (const Block& b : blocks)
+				total += b.size;
+			return total;
+		}
+
+	private:
+		static u8* alloc_aligned(size_t size)
+		{
+#if defined(_MSC_VER)
+			return (u8*)_aligned_malloc(size, alignment);
+#else
+			return (u8*)aligned_alloc(alignment, size);
+#endif
+		}
+
+		static void free_aligned(u8* p)
+		{
+#if defined(_MSC_VER)
+			_aligned_free(p);
+#else
+			free(p);
+#endif
+		}
+	};
+
+	struct IoResult
+	{
+		u32 id;
+		IoStatus status;
+		s32 error;        // errno for failed
+		const u8* data;   // in the request's arena, null unless done
+		u64 size;
+		f64 ms;           // from read() to completion
+	};
+
+	using IoCallback = std::function<void(const IoResult&)>;
+
+	struct AssetIoStats
+	{
+		u64 requests = 0;
+		u64 done = 0;
+		u64 failed = 0;
+		u64 cancelled = 0;
+		u64 bytes = 0;
+		u64 chunks = 0;
+		u64 enters = 0; // io_uring_enter calls, chunks / enters is the batching
+	};
+
+	struct AssetIO
+	{
+		IoBackend backend = IoBackend::threads;
+		u32 queue_depth = 64;       // chunks in flight with io_uring
+		u32 chunk_size = 1u << 20;
+		AssetIoStats stats;
+
+		//? Falls back to threads when io_uring isn't available, backend says which one runs
+		void init(IoBackend preferred = IoBackend::uring, u32 thread_count = 4, u32 depth = 64, u32 chunk_bytes = 1u << 20)
+		{
+			queue_depth = max(depth, 1u);
+			chunk_size = max(chunk_bytes, (u32)IoArena::alignment);
+			quit = false;
+			backend = IoBackend::threads;
+#if defined(__linux__)
+			if (preferred == IoBackend::uring && ring.init(queue_depth))
+			{
+				backend = IoBackend::uring;
+				chunks.resize(ring.entries);
+				for (u32 i = 0; i < ring.entries; ++i)
+					free_chunks.push_back(ring.entries - 1 - i);
+				workers.emplace_back([this] { uring_loop(); });
+				return;
+			}
+#endif
+			for (u32 i = 0; i < max(thread_count, 1u); ++i)
+				workers.emplace_back([this] { thread_loop(); });
+		}
+
+		//? Cancels whatever is still queued, waits for reads in flight
+		void destroy()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				quit = true;
+			}
+			wake.notify_all();
+			for (std::thread& worker : workers)
+				worker.join();
+			workers.clear();
+#if defined(__linux__)
+			if (backend == IoBackend::uring)
+				ring.destroy();
+#endif
+		}
+
+		//? Reads the whole file into arena; done runs on an I/O thread and must not block for long
+		u32 read(const char* path, IoArena& arena, IoPriority priority, IoCallback done)
+		{
+			u32 id;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				id = next_id++;
+				Request& r = requests[id];
+				r.id = id;
+				r.path = path;
+				r.arena = &arena;
+				r.priority = priority;
+				r.done = static_cast<IoCallback&&>(done);
+				r.start = std::chrono::steady_clock::now();
+				queued[(u32)priority].push_back(&r);
+				++stats.requests;
+			}
+			wake.notify_one();
+			return id;
+		}
+
+		std::future<IoResult> read(const char* path, IoArena& arena, IoPriority priority = IoPriority::normal)
+		{
+			auto promise = std::make_shared<std::promise<IoResult>>();
+			std::future<IoResult> future = promise->get_future();
+			read(path, arena, priority, [promise](const IoResult& result) { promise->set_value(result); });
+			return future;
+		}
+
+		//? False when the request already finished
+		b32 cancel(u32 id)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = requests.find(id);
+			if (it == requests.end())
+				return false;
+			it->second.cancelled.store(true, std::memory_order_relaxed);
+			wake.notify_all();
+			return true;
+		}
+
+		//? Blocks until every request so far has completed
+		void wait_idle()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			idle.wait(lock, [this] { return requests.empty(); });
+		}
+
+		void print_summary() const
+		{
+			if (!stats.requests)
+				return;
+			printf("asset io (%s): %llu requests, %llu done, %llu failed, %llu cancelled, %.1f MiB in %llu chunks",
+				io_backend_name(backend), (unsigned long long)stats.requests, (unsigned long long)stats.done,
+				(unsigned long long)stats.failed, (unsigned long long)stats.cancelled, stats.bytes / (1024.0 * 1024.0),
+				(unsigned long long)stats.chunks);
+			if (stats.enters)
+				printf(", %.1f chunks per io_uring_enter", (f64)stats.chunks / (f64)stats.enters);
+			printf("\n");
+		}
+
+	private:
+		struct Request
+		{
+			u32 id;
+			std::string path;
+			IoArena* arena;
+			IoPriority priority;
+			IoCallback done;
+			std::chrono::steady_clock::time_point start;
+			std::atomic<b32> cancelled{ false };
+
+			// I/O thread only
+#if defined(__linux__)
+			s32 fd = -1;
+#else
+			FILE* file = nullptr;
+#endif
+			u8* data = nullptr;
+			u64 size = 0;
+			u64 next = 0;      // first byte not submitted yet
+			u64 read = 0;      // bytes completed
+			u32 in_flight = 0;
+			s32 error = 0;
+			b32 opened = false;
+		};
+
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable idle;
+		std::unordered_map<u32, Request> requests; // node based, Request pointers stay valid
+		std::deque<Request*> queued[(u32)IoPriority::count];
+		std::vector<std::thread> workers;
+		u32 next_id = 1;
+		b32 quit = false;
+
+		//? Highest priority first, with the lock held
+		Request* pop_queued()
+		{
+			for (std::deque<Request*>& q : queued)
+			{
+				if (!q.empty())
+				{
+					Request* r = q.front();
+					q.pop_front();
+					return r;
+				}
+			}
+			return nullptr;
+		}
+
+		b32 has_queued() const
+		{
+			for (const std::deque<Request*>& q : queued)
+			{
+				if (!q.empty())
+					return true;
+			}
+			return false;
+		}
+
+		void finish(Request& r)
+		{
+#if defined(__linux__)
+			if (r.fd >= 0)
+				close(r.fd);
+#else
+			if (r.file)
+				fclose(r.file);
+#endif
+			IoResult result{ r.id, IoStatus::done, r.error, r.data, r.size,
+				std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - r.start).count() };
+			if (r.error)
+				result.status = IoStatus::failed;
+			else if (r.cancelled.load(std::memory_order_relaxed) && !(r.opened && r.read == r.size))
+				result.status = IoStatus::cancelled;
+			if (result.status != IoStatus::done)
+				result.data = nullptr;
+			if (r.done)
+				r.done(result);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			stats.done += result.status == IoStatus::done ? 1 : 0;
+			stats.failed += result.status == IoStatus::failed ? 1 : 0;
+			stats.cancelled += result.status == IoStatus::cancelled ? 1 : 0;
+			stats.bytes += r.read;
+			requests.erase(r.id);
+			if (requests.empty())
+				idle.notify_all();
+		}
+
+		//? Size and destination, false when the file can't be read (error is set)
+		b32 open_request(Request& r)
+		{
+			r.opened = true;
+#if defined(__linux__)
+			r.fd = open(r.path.c_str(), O_RDONLY | O_CLOEXEC);
+			struct stat st;
+			if (r.fd < 0 || fstat(r.fd, &st) != 0)
+			{
+				r.error = errno ? errno : EIO;
+				return false;
+			}
+			r.size = (u64)st.st_size;
+#else
+			r.file = fopen(r.path.c_str(), "rb");
+			if (!r.file)
+			{
+				r.error = errno ? errno : EIO;
+				return false;
+			}
+			_fseeki64(r.file, 0, SEEK_END);
+			r.size = (u64)_ftelli64(r.file);
+			_fseeki64(r.file, 0, SEEK_SET);
+#endif
+			r.data = r.size ? r.arena->alloc(r.size) : nullptr;
+			if (r.size && !r.data)
+			{
+				r.error = ENOMEM;
+				return false;
+			}
+			return true;
+		}
+
+		//? Fallback: each thread reads one file at a time, checking for cancellation between chunks
+		void thread_loop()
+		{
+			for (;;)
+			{
+				Request* r = nullptr;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					wake.wait(lock, [this] { return quit || has_queued(); });
+					r = pop_queued();
+					if (!r)
+						return;
+					if (quit)
+						r->cancelled.store(true, std::memory_order_relaxed); // destroy() doesn't wait for queued work
+				}
+
+				u64 chunk_count = 0;
+				if (!r->cancelled.load(std::memory_order_relaxed) && open_request(*r))
+				{
+					while (r->read < r->size && !r->cancelled.load(std::memory_order_relaxed))
+					{
+						const size_t want = (size_t)min<u64>(chunk_size, r->size - r->read);
+#if defined(__linux__)
+						const ssize_t got = pread(r->fd, r->data + r->read, want, (off_t)r->read);
+#else
+						const s64 got = (s64)fread(r->data + r->read, 1, want, r->file);
+#endif
+						++chunk_count;
+						if (got <= 0)
+						{
+							r->error = got < 0 ? errno : EIO;
+							break;
+						}
+						r->read += (u64)got;
+					}
+				}
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					stats.chunks += chunk_count;
+				}
+				finish(*r);
+			}
+		}
+
+#if defined(__linux__)
+		//? Just the parts of io_uring we use: one ring, mmapped queues, raw syscalls (no liburing)
+		struct Uring
+		{
+			s32 fd = -1;
+			u32 entries = 0;
+			u32 sq_tail = 0; // local, published on submit
+			u32 to_submit = 0;
+			u32* sq_head_ptr = nullptr;
+			u32* sq_tail_ptr = nullptr;
+			u32* sq_mask_ptr = nullptr;
+			u32* sq_array = nullptr;
+			io_uring_sqe* sqes = nullptr;
+			u32* cq_head_ptr = nullptr;
+			u32* cq_tail_ptr = nullptr;
+			u32* cq_mask_ptr = nullptr;
+			io_uring_cqe* cqes = nullptr;
+			void* sq_ring = nullptr;
+			void* cq_ring = nullptr;
+			size_t sq_ring_size = 0;
+			size_t cq_ring_size = 0;
+			size_t sqes_size = 0;
+
+			b32 init(u32 depth)
+			{
+				io_uring_params params;
+				memset(&params, 0, sizeof(params));
+				fd = (s32)syscall(__NR_io_uring_setup, depth, &params);
+				if (fd < 0)
+					return false;
+
+				entries = params.sq_entries;
+				sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+				cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+				const b32 single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+				if (single)
+					sq_ring_size = cq_ring_size = max(sq_ring_size, cq_ring_size);
+
+				sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+				cq_ring = single ? sq_ring : mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+				sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+				sqes = (io_uring_sqe*)mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+				if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED)
+				{
+					close(fd);
+					fd = -1;
+					return false;
+				}
+
+				u8* sq = (u8*)sq_ring;
+				sq_head_ptr = (u32*)(sq + params.sq_off.head);
+				sq_tail_ptr = (u32*)(sq + params.sq_off.tail);
+				sq_mask_ptr = (u32*)(sq + params.sq_off.ring_mask);
+				sq_array = (u32*)(sq + params.sq_off.array);
+				sq_tail = *sq_tail_ptr;
+				u8* cq = (u8*)cq_ring;
+				cq_head_ptr = (u32*)(cq + params.cq_off.head);
+				cq_tail_ptr = (u32*)(cq + params.cq_off.tail);
+				cq_mask_ptr = (u32*)(cq + params.cq_off.ring_mask);
+				cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+				return true;
+			}
+
+			void destroy()
+			{
+				munmap(sqes, sqes_size);
+				if (cq_ring != sq_ring)
+					munmap(cq_ring, cq_ring_size);
+				munmap(sq_ring, sq_ring_size);
+				close(fd);
+				fd = -1;
+			}
+
+			void prep_read(s32 file, u8* dst, u32 length, u64 offset, u64 user_data)
+			{
+				const u32 index = sq_tail & *sq_mask_ptr;
+				io_uring_sqe& sqe = sqes[index];
+				memset(&sqe, 0, sizeof(sqe));
+				sqe.opcode = IORING_OP_READ;
+				sqe.fd = file;
+				sqe.addr = (u64)(uintptr_t)dst;
+				sqe.len = length;
+				sqe.off = offset;
+				sqe.user_data = user_data;
+				sq_array[index] = index;
+				++sq_tail;
+				++to_submit;
+			}
+
+			//? Publishes the prepared entries and waits for at least wait_for completions
+			s32 enter(u32 wait_for)
+			{
+				std::atomic_ref<u32>(*sq_tail_ptr).store(sq_tail, std::memory_order_release);
+				const u32 count = to_submit;
+				to_submit = 0;
+				for (;;)
+				{
+					const s32 ret = (s32)syscall(__NR_io_uring_enter, fd, count, wait_for, wait_for ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+					if (ret >= 0 || errno != EINTR)
+						return ret;
+				}
+			}
+
+			template <typename F>
+			void reap(F&& f)
+			{
+				u32 head = *cq_head_ptr;
+				const u32 tail = std::atomic_ref<u32>(*cq_tail_ptr).load(std::memory_order_acquire);
+				for (; head != tail; ++head)
+					f(cqes[head & *cq_mask_ptr]);
+				std::atomic_ref<u32>(*cq_head_ptr).store(head, std::memory_order_release);
+			}
+		};
+
+		struct Chunk
+		{
+			Request* request;
+			u8* dst;
+			u64 offset;
+			u32 length;
+		};
+
+		static constexpr u32 max_active = 32; // open files, a high priority request is always let in
+
+		Uring ring;
+		std::vector<Chunk> chunks;
+		std::vector<u32> free_chunks;
+		std::vector<Chunk> retries; // short reads, resubmitted before new chunks
+
+		void uring_loop()
+		{
+			std::vector<Request*> active;
+			u32 in_flight = 0;
+			for (;;)
+			{
+				b32 quitting = false; // quit read under the lock, destroy() writes it under the lock
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					if (!in_flight && active.empty())
+						wake.wait(lock, [this] { return quit || has_queued(); });
+					quitting = quit;
+					if (quitting)
+					{
+						// queued requests are dropped, active ones stop after what's in flight
+						while (Request* r = pop_queued())
+						{
+							r->cancelled.store(true, std::memory_order_relaxed);
+							active.push_back(r);
+						}
+						for (Request* r : active)
+							r->cancelled.store(true, std::memory_order_relaxed);
+					}
+					while (!queued[(u32)IoPriority::high].empty() || active.size() < max_active)
+					{
+						Request* r = pop_queued();
+						if (!r)
+							break;
+						active.push_back(r);
+					}
+				}
+				std::stable_sort(active.begin(), active.end(), [](const Request* a, const Request* b) { return a->priority < b->priority; });
+
+				// fill the submission queue, retries first, then the most urgent requests in order
+				while (!retries.empty() && !free_chunks.empty())
+				{
+					--retries.back().request->in_flight; // was kept in flight while waiting here
+					submit_chunk(retries.back());
+					retries.pop_back();
+					++in_flight;
+				}
+				for (u32 i = 0; i < (u32)active.size();)
+				{
+					Request& r = *active[i];
+					if (!r.opened && !r.cancelled.load(std::memory_order_relaxed))
+						open_request(r);
+					const b32 stop = r.error || r.cancelled.load(std::memory_order_relaxed);
+					while (!stop && r.next < r.size && !free_chunks.empty())
+					{
+						const u32 length = (u32)min<u64>(chunk_size, r.size - r.next);
+						submit_chunk({ &r, r.data + r.next, r.next, length });
+						r.next += length;
+						++in_flight;
+					}
+					if (!r.in_flight && (stop || r.read == r.size))
+					{
+						finish(r);
+						active.erase(active.begin() + i);
+						continue;
+					}
+					++i;
+				}
+
+				if (!in_flight)
+				{
+					if (quitting && active.empty())
+						return;
+					continue;
+				}
+
+				const u32 submitted = ring.to_submit;
+				if (ring.enter(1) < 0)
+				{
+					// the ring is broken, fail everything in flight rather than hang
+					const s32 error = errno;
+					for (Request* r : active)
+					{
+						r->error = error;
+						r->in_flight = 0;
+					}
+					free_chunks.clear();
+					retries.clear();
+					for (u32 c = 0; c < (u32)chunks.size(); ++c)
+						free_chunks.push_back(c);
+					in_flight = 0;
+					continue;
+				}
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					++stats.enters;
+					stats.chunks += submitted;
+				}
+
+				ring.reap([&](const io_uring_cqe& cqe)
+					{
+						const u32 index = (u32)cqe.user_data;
+						const Chunk chunk = chunks[index];
+						free_chunks.push_back(index);
+						--in_flight;
+						Request& r = *chunk.request;
+						--r.in_flight;
+						if (cqe.res < 0)
+						{
+							r.error = -cqe.res;
+						}
+						else if (cqe.res == 0)
+						{
+							r.error = EIO; // the file got shorter
+						}
+						else
+						{
+							r.read += (u64)cqe.res;
+							if ((u32)cqe.res < chunk.length)
+							{
+								++r.in_flight;
+								retries.push_back({ &r, chunk.dst + cqe.res, chunk.offset + cqe.res, chunk.length - (u32)cqe.res });
+							}
+						}
+					});
+			}
+		}
+
+		void submit_chunk(const Chunk& chunk)
+		{
+			const u32 index = free_chunks.back();
+			free_chunks.pop_back();
+			chunks[index] = chunk;
+			++chunk.request->in_flight;
+			ring.prep_read(chunk.request->fd, chunk.dst, chunk.length, chunk.offset, index);
+		}
+#endif
+	};
+}
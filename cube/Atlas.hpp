@@ -0,0 +1,270 @@
+#pragma once
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include "Utils.hpp"
+#include "my_math.h"
+#include "JobSystem.hpp"
+#include "Texture.hpp"
+
+//? Texture atlas for many small textures: one texture, one bind, and draws no longer split by material.
+//? Tiles are packed with a skyline packer on a grid of align x align cells, align = 2^(mip_levels - 1),
+//? so every slot starts and ends on a texel boundary of every kept mip. Mips are box filtered, which then
+//? never mixes two slots. Each slot has a gutter of align / 2 texels filled by wrapping the tile, enough
+//? for bilinear at the last level and for shaders that wrap with fract().
+
+namespace lib
+{
+	//? Skyline bottom-left: the top edge of everything placed is a list of segments, a rect goes where
+	//? its bottom ends up lowest, then leftmost
+	struct SkylinePacker
+	{
+		struct Segment
+		{
+			s32 x;
+			s32 y;
+			s32 width;
+		};
+
+		s32 width = 0;
+		s32 height = 0;
+		std::vector<Segment> skyline;
+
+		void init(s32 w, s32 h)
+		{
+			width = w;
+			height = h;
+			skyline.assign(1, { 0, 0, w });
+		}
+
+		b32 insert(s32 w, s32 h, s32& out_x, s32& out_y)
+		{
+			s32 best = -1, best_y = height, best_x = width;
+			for (u32 i = 0; i < (u32)skyline.size(); ++i)
+			{
+				const s32 y = fit(i, w, h);
+				if (y >= 0 && (y < best_y || (y == best_y && skyline[i].x < best_x)))
+				{
+					best = (s32)i;
+					best_y = y;
+					best_x = skyline[i].x;
+				}
+			}
+			if (best < 0)
+				return false;
+
+			out_x = best_x;
+			out_y = best_y;
+
+			// the new segment covers [x, x + w), whatever it overlaps is cut or removed
+			skyline.insert(skyline.begin() + best, { best_x, best_y + h, w });
+			for (u32 i = (u32)best + 1; i < (u32)skyline.size();)
+			{
+				Segment& s = skyline[i];
+				const s32 end = best_x + w;
+				if (s.x >= end)
+					break;
+				const s32 cut = min(end - s.x, s.width);
+				s.x += cut;
+				s.width -= cut;
+				if (s.width > 0)
+					break;
+				skyline.erase(skyline.begin() + i);
+			}
+			// neighbours at the same height become one segment
+			for (u32 i = 0; i + 1 < (u32)skyline.size();)
+			{
+				if (skyline[i].y == skyline[i + 1].y)
+				{
+					skyline[i].width += skyline[i + 1].width;
+					skyline.erase(skyline.begin() + i + 1);
+				}
+				else
+				{
+					++i;
+				}
+			}
+			return true;
+		}
+
+	private:
+		//? Height the rect would sit at starting on segment index, -1 when it doesn't fit there
+		s32 fit(u32 index, s32 w, s32 h) const
+		{
+			const s32 x = skyline[index].x;
+			if (x + w > width)
+				return -1;
+			s32 y = 0, left = w;
+			for (u32 i = index; left > 0; ++i)
+			{
+				if (i == skyline.size())
+					return -1;
+				y = max(y, skyline[i].y);
+				if (y + h > height)
+					return -1;
+				left -= skyline[i].width;
+			}
+			return y;
+		}
+	};
+
+	//? Inner tile in texels of level 0, without the gutter
+	struct AtlasRect
+	{
+		s32 x;
+		s32 y;
+		s32 width;
+		s32 height;
+	};
+
+	struct AtlasStats
+	{
+		u32 tiles = 0;
+		u64 tile_texels = 0; // inner tiles
+		u64 slot_texels = 0; // with gutters and alignment
+		f64 pack_ms = 0.0;
+		f64 mip_ms = 0.0;
+	};
+
+	struct Atlas
+	{
+		s32 align = 1;
+		s32 padding = 0;
+		std::vector<AtlasRect> rects; // same order as the images given to build()
+		MipChain chain;
+		AtlasStats stats;
+
+		//? offset xy, scale zw of tile i in texture coordinates
+		Vec4 uv_rect(u32 i) const
+		{
+			const AtlasRect& r = rects[i];
+			const f32 w = (f32)chain.width, h = (f32)chain.height;
+			return { r.x / w, r.y / h, r.width / w, r.height / h };
+		}
+
+		//? Packs and fills level 0, then builds mip_levels levels. Power of two pages grow one side at a time
+		//? until everything fits, false past 16k; the height is then cut to what is used.
+		b32 build(const std::vector<Image>& images, u32 mip_levels, JobSystem* jobs = nullptr)
+		{
+			PROFILE_SCOPE("build atlas");
+			mip_levels = clamp(mip_levels, 1u, 8u);
+			align = 1 << (mip_levels - 1);
+			padding = max(1, align / 2);
+			stats = {};
+			stats.tiles = (u32)images.size();
+
+			auto start = std::chrono::steady_clock::now();
+			// slots in cells of align texels
+			std::vector<s32> slot_w(images.size()), slot_h(images.size());
+			std::vector<u32> order(images.size());
+			u64 cells = 0;
+			for (u32 i = 0; i < (u32)images.size(); ++i)
+			{
+				slot_w[i] = (images[i].width + 2 * padding + align - 1) / align;
+				slot_h[i] = (images[i].height + 2 * padding + align - 1) / align;
+				cells += (u64)slot_w[i] * slot_h[i];
+				stats.tile_texels += (u64)images[i].width * images[i].height;
+				stats.slot_texels += (u64)slot_w[i] * slot_h[i] * align * align;
+				order[i] = i;
+			}
+			std::sort(order.begin(), order.end(), [&](u32 a, u32 b) { return slot_h[a] != slot_h[b] ? slot_h[a] > slot_h[b] : slot_w[a] > slot_w[b]; });
+
+			s32 page_w = 1, page_h = 1;
+			while ((u64)page_w * page_h < cells || page_w * align < 64)
+			{
+				if (page_w <= page_h)
+					page_w *= 2;
+				else
+					page_h *= 2;
+			}
+
+			std::vector<s32> cell_x(images.size()), cell_y(images.size());
+			SkylinePacker packer;
+			for (;;)
+			{
+				packer.init(page_w, page_h);
+				b32 packed = true;
+				for (u32 i : order)
+				{
+					if (!packer.insert(slot_w[i], slot_h[i], cell_x[i], cell_y[i]))
+					{
+						packed = false;
+						break;
+					}
+				}
+				if (packed)
+					break;
+				if (page_w <= page_h)
+					page_w *= 2;
+				else
+					page_h *= 2;
+				if ((s64)max(page_w, page_h) * align > 16384)
+					return false;
+			}
+
+			// the skyline rarely reaches the top of the page, cut it there; still a multiple of align, so
+			// every kept level keeps whole texels per slot
+			s32 top = 1;
+			for (const SkylinePacker::Segment& s : packer.skyline)
+				top = max(top, s.y);
+			page_h = top;
+			stats.pack_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			Image page;
+			page.width = page_w * align;
+			page.height = page_h * align;
+			page.pixels.assign((size_t)page.width * page.height * 4, 0);
+			rects.resize(images.size());
+			for (u32 i = 0; i < (u32)images.size(); ++i)
+			{
+				const Image& image = images[i];
+				const s32 x0 = cell_x[i] * align, y0 = cell_y[i] * align;
+				rects[i] = { x0 + padding, y0 + padding, image.width, image.height };
+				// whole slot, the tile repeats into its gutter
+				for (s32 y = y0; y < y0 + slot_h[i] * align; ++y)
+				{
+					const s32 sy = ((y - y0 - padding) % image.height + image.height) % image.height;
+					const u8* src = image.pixels.data() + (size_t)sy * image.width * 4;
+					u8* dst = page.pixels.data() + ((size_t)y * page.width) * 4;
+					for (s32 x = x0; x < x0 + slot_w[i] * align; ++x)
+					{
+						const s32 sx = ((x - x0 - padding) % image.width + image.width) % image.width;
+						memcpy(dst + x * 4, src + sx * 4, 4);
+					}
+				}
+			}
+
+			start = std::chrono::steady_clock::now();
+			build_mips(page, chain, MipFilter::box, jobs);
+			// levels past the alignment would average neighbouring slots
+			const u32 levels = min(mip_levels, (u32)chain.levels.size());
+			const MipLevel last = chain.levels[levels - 1];
+			chain.levels.resize(levels);
+			chain.pixels.resize(last.offset + (size_t)last.width * last.height * 4);
+			stats.mip_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+			return true;
+		}
+
+		//? Inner tiles over the page, and slots (tile + gutter + alignment) over the page
+		f64 efficiency() const
+		{
+			return chain.width ? (f64)stats.tile_texels / ((f64)chain.width * chain.height) : 0.0;
+		}
+
+		f64 slot_efficiency() const
+		{
+			return chain.width ? (f64)stats.slot_texels / ((f64)chain.width * chain.height) : 0.0;
+		}
+
+		void print_summary() const
+		{
+			printf("atlas: %u tiles in %dx%d, %zu levels (align %d, gutter %d), %.1f%% tiles, %.1f%% slots, pack %.2f ms, mips %.2f ms\n",
+				stats.tiles, chain.width, chain.height, chain.levels.size(), align, padding, efficiency() * 100.0, slot_efficiency() * 100.0,
+				stats.pack_ms, stats.mip_ms);
+		}
+	};
+}
@@ -0,0 +1,969 @@
+#pragma once
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Utils.hpp"
+#include "my_math.h"
+#include "JobSystem.hpp"
+#include "Texture.hpp"
+
+//? Block compression: BC1 (RGB + 1 bit alpha, 4 bpp), BC3 (BC1 color + BC4 alpha, 8 bpp) and BC7 (8 bpp,
+//? mode 6 only: one RGBA subset, 7 bit endpoints with p-bits, 4 bit indices). Endpoints start at the
+//? block's principal axis and get a least squares refit. Index selection is the hot loop, it tests four
+//? pixels per __m128 against every palette entry. Blocks are independent, rows of blocks are spread over
+//? the job system. BcQuality::best adds refits and a hill climb over the quantized endpoints, that's what
+//? the offline tool writes and what the bench uses as reference.
+//? Blocks are fit to the sRGB8 values, the sRGB formats decode the block first and convert after.
+//? .ctex files are a header and the blocks of every level, ready for glCompressedTexSubImage2D.
+
+namespace lib
+{
+	enum class BcFormat : u32
+	{
+		bc1,
+		bc3,
+		bc7,
+	};
+
+	enum class BcQuality : u32
+	{
+		fast,
+		best,
+	};
+
+	inline u32 bc_block_bytes(BcFormat format)
+	{
+		return format == BcFormat::bc1 ? 8 : 16;
+	}
+
+	inline const char* bc_format_name(BcFormat format)
+	{
+		switch (format)
+		{
+		case BcFormat::bc1: return "bc1";
+		case BcFormat::bc3: return "bc3";
+		case BcFormat::bc7: return "bc7";
+		}
+		return "?";
+	}
+
+	inline b32 parse_bc_format(const char* name, BcFormat& format)
+	{
+		for (BcFormat f : { BcFormat::bc1, BcFormat::bc3, BcFormat::bc7 })
+		{
+			if (strcmp(name, bc_format_name(f)) == 0)
+			{
+				format = f;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//? Same level layout as MipChain, offsets point into blocks
+	struct CompressedTexture
+	{
+		BcFormat format = BcFormat::bc1;
+		s32 width = 0;
+		s32 height = 0;
+		std::vector<MipLevel> levels;
+		std::vector<u8> blocks;
+
+		const u8* level_blocks(u32 level) const
+		{
+			return blocks.data() + levels[level].offset;
+		}
+
+		size_t level_size(u32 level) const
+		{
+			return (size_t)((levels[level].width + 3) / 4) * ((levels[level].height + 3) / 4) * bc_block_bytes(format);
+		}
+	};
+
+	namespace bc
+	{
+		//? 4x4 pixels, channel major so four pixels of a channel are one aligned load
+		struct Block
+		{
+			alignas(16) f32 c[4][16];
+		};
+
+		//? Pixels outside the image repeat the last row/column
+		inline void load_block(const u8* pixels, s32 width, s32 height, s32 bx, s32 by, Block& block)
+		{
+			for (s32 i = 0; i < 16; ++i)
+			{
+				const s32 x = min(bx * 4 + (i & 3), width - 1);
+				const s32 y = min(by * 4 + (i >> 2), height - 1);
+				const u8* p = pixels + ((size_t)y * width + x) * 4;
+				for (u32 c = 0; c < 4; ++c)
+					block.c[c][i] = p[c];
+			}
+		}
+
+		//? Nearest palette entry per pixel, returns the summed weighted squared error. Channels with weight 0
+		//? are ignored. The scalar path accumulates in the same order, both give the same indices and error.
+		inline f32 fit_indices(const Block& block, const f32 (*palette)[4], u32 size, const f32 weights[4], u8 indices[16], b32 simd)
+		{
+			alignas(16) f32 lanes[4] = {};
+			if (simd)
+			{
+				__m128 total = _mm_setzero_ps();
+				for (u32 i = 0; i < 16; i += 4)
+				{
+					__m128 best = _mm_set1_ps(1e30f);
+					__m128 best_index = _mm_setzero_ps();
+					for (u32 e = 0; e < size; ++e)
+					{
+						__m128 d = _mm_setzero_ps();
+						for (u32 c = 0; c < 4; ++c)
+						{
+							if (weights[c] == 0.0f)
+								continue;
+							const __m128 diff = _mm_sub_ps(_mm_load_ps(&block.c[c][i]), _mm_set1_ps(palette[e][c]));
+							d = _mm_add_ps(d, _mm_mul_ps(_mm_mul_ps(diff, diff), _mm_set1_ps(weights[c])));
+						}
+						const __m128 closer = _mm_cmplt_ps(d, best);
+						best = _mm_min_ps(d, best);
+						best_index = _mm_blendv_ps(best_index, _mm_set1_ps((f32)e), closer);
+					}
+					total = _mm_add_ps(total, best);
+					alignas(16) s32 index[4];
+					_mm_store_si128((__m128i*)index, _mm_cvttps_epi32(best_index));
+					for (u32 k = 0; k < 4; ++k)
+						indices[i + k] = (u8)index[k];
+				}
+				_mm_store_ps(lanes, total);
+			}
+			else
+			{
+				for (u32 i = 0; i < 16; ++i)
+				{
+					f32 best = 1e30f;
+					u8 best_index = 0;
+					for (u32 e = 0; e < size; ++e)
+					{
+						f32 d = 0.0f;
+						for (u32 c = 0; c < 4; ++c)
+						{
+							if (weights[c] == 0.0f)
+								continue;
+							const f32 diff = block.c[c][i] - palette[e][c];
+							d = d + diff * diff * weights[c];
+						}
+						if (d < best)
+						{
+							best = d;
+							best_index = (u8)e;
+						}
+					}
+					lanes[i & 3] += best;
+					indices[i] = best_index;
+				}
+			}
+			return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+		}
+
+		//? Mean and dominant direction of the first channels (3 or 4), power iteration on the covariance
+		inline void principal_axis(const Block& block, u32 channels, f32 mean[4], f32 axis[4])
+		{
+			f32 lo[4] = { 255.0f, 255.0f, 255.0f, 255.0f }, hi[4] = {};
+			for (u32 c = 0; c < 4; ++c)
+			{
+				mean[c] = 0.0f;
+				axis[c] = 0.0f;
+				if (c >= channels)
+					continue;
+				for (u32 i = 0; i < 16; ++i)
+				{
+					mean[c] += block.c[c][i];
+					lo[c] = min(lo[c], block.c[c][i]);
+					hi[c] = max(hi[c], block.c[c][i]);
+				}
+				mean[c] *= 1.0f / 16.0f;
+				axis[c] = hi[c] - lo[c];
+			}
+
+			f32 cov[4][4] = {};
+			for (u32 i = 0; i < 16; ++i)
+			{
+				for (u32 a = 0; a < channels; ++a)
+					for (u32 b = 0; b < channels; ++b)
+						cov[a][b] += (block.c[a][i] - mean[a]) * (block.c[b][i] - mean[b]);
+			}
+
+			for (u32 iteration = 0; iteration < 8; ++iteration)
+			{
+				f32 v[4] = {};
+				f32 length = 0.0f;
+				for (u32 a = 0; a < channels; ++a)
+				{
+					for (u32 b = 0; b < channels; ++b)
+						v[a] += cov[a][b] * axis[b];
+					length += v[a] * v[a];
+				}
+				if (length < 1e-12f)
+					break;
+				const f32 scale = 1.0f / sqrtf(length);
+				for (u32 a = 0; a < channels; ++a)
+					axis[a] = v[a] * scale;
+			}
+		}
+
+		//? Endpoints at the extremes of the block's projection on the axis
+		inline void axis_endpoints(const Block& block, u32 channels, f32 e0[4], f32 e1[4])
+		{
+			f32 mean[4], axis[4];
+			principal_axis(block, channels, mean, axis);
+			f32 t_min = 0.0f, t_max = 0.0f;
+			for (u32 i = 0; i < 16; ++i)
+			{
+				f32 t = 0.0f;
+				for (u32 c = 0; c < channels; ++c)
+					t += (block.c[c][i] - mean[c]) * axis[c];
+				t_min = min(t_min, t);
+				t_max = max(t_max, t);
+			}
+			for (u32 c = 0; c < 4; ++c)
+			{
+				e0[c] = clamp(mean[c] + axis[c] * t_max, 0.0f, 255.0f);
+				e1[c] = clamp(mean[c] + axis[c] * t_min, 0.0f, 255.0f);
+			}
+		}
+
+		//? Best endpoints for fixed interpolation weights t (pixels with t < 0 don't count), per channel
+		//? the 2x2 normal equations of sum |(1 - t) e0 + t e1 - p|^2
+		inline b32 least_squares(const Block& block, const f32 t[16], u32 channels, f32 e0[4], f32 e1[4])
+		{
+			f32 aa = 0.0f, ab = 0.0f, bb = 0.0f;
+			f32 ap[4] = {}, bp[4] = {};
+			for (u32 i = 0; i < 16; ++i)
+			{
+				if (t[i] < 0.0f)
+					continue;
+				const f32 a = 1.0f - t[i], b = t[i];
+				aa += a * a;
+				ab += a * b;
+				bb += b * b;
+				for (u32 c = 0; c < channels; ++c)
+				{
+					ap[c] += a * block.c[c][i];
+					bp[c] += b * block.c[c][i];
+				}
+			}
+			const f32 det = aa * bb - ab * ab;
+			if (fabsf(det) < 1e-6f)
+				return false;
+			for (u32 c = 0; c < channels; ++c)
+			{
+				e0[c] = clamp((bb * ap[c] - ab * bp[c]) / det, 0.0f, 255.0f);
+				e1[c] = clamp((aa * bp[c] - ab * ap[c]) / det, 0.0f, 255.0f);
+			}
+			return true;
+		}
+
+		//? Moves one quantized endpoint value by one step at a time while the error goes down. eval may
+		//? reorder its argument, what it leaves there is what gets kept.
+		template <typename Eval>
+		inline f32 hill_climb(s32* q, const s32* limit, u32 count, f32 error, Eval&& eval)
+		{
+			for (u32 round = 0; round < 16; ++round)
+			{
+				b32 improved = false;
+				for (u32 i = 0; i < count; ++i)
+				{
+					for (s32 step : { -1, 1 })
+					{
+						s32 candidate[16];
+						memcpy(candidate, q, count * sizeof(s32));
+						candidate[i] += step;
+						if (candidate[i] < 0 || candidate[i] > limit[i])
+							continue;
+						const f32 e = eval(candidate);
+						if (e < error)
+						{
+							error = e;
+							memcpy(q, candidate, count * sizeof(s32));
+							improved = true;
+						}
+					}
+				}
+				if (!improved)
+					break;
+			}
+			return error;
+		}
+
+		struct BitWriter
+		{
+			u8* out;
+			u32 bit = 0;
+
+			void put(u32 value, u32 count)
+			{
+				for (u32 i = 0; i < count; ++i, ++bit)
+					out[bit >> 3] |= (u8)(((value >> i) & 1) << (bit & 7));
+			}
+		};
+
+		struct BitReader
+		{
+			const u8* in;
+			u32 bit = 0;
+
+			u32 get(u32 count)
+			{
+				u32 value = 0;
+				for (u32 i = 0; i < count; ++i, ++bit)
+					value |= (u32)((in[bit >> 3] >> (bit & 7)) & 1) << i;
+				return value;
+			}
+		};
+
+		// BC1 ---------------------------------------------------------------------------------------------
+
+		inline s32 expand5(s32 q) { return (q << 3) | (q >> 2); }
+		inline s32 expand6(s32 q) { return (q << 2) | (q >> 4); }
+		inline u16 pack565(const s32* q) { return (u16)((q[0] << 11) | (q[1] << 5) | q[2]); }
+
+		//? q is r0 g0 b0 r1 g1 b1 in 5:6:5, reordered so the decoder picks the intended mode: c0 > c1 gives
+		//? four colors, c0 <= c1 three and transparent black at index 3
+		inline f32 bc1_evaluate(const Block& block, s32 q[6], b32 three_color, u16 transparent, b32 simd, u8 indices[16])
+		{
+			const u16 c0 = pack565(q), c1 = pack565(q + 3);
+			if (three_color ? c0 > c1 : c0 < c1)
+			{
+				for (u32 i = 0; i < 3; ++i)
+				{
+					const s32 t = q[i];
+					q[i] = q[i + 3];
+					q[i + 3] = t;
+				}
+			}
+
+			const s32 a[3] = { expand5(q[0]), expand6(q[1]), expand5(q[2]) };
+			const s32 b[3] = { expand5(q[3]), expand6(q[4]), expand5(q[5]) };
+			f32 palette[4][4] = {};
+			for (u32 c = 0; c < 3; ++c)
+			{
+				palette[0][c] = (f32)a[c];
+				palette[1][c] = (f32)b[c];
+				palette[2][c] = three_color ? (f32)((a[c] + b[c]) / 2) : (f32)((2 * a[c] + b[c]) / 3);
+				palette[3][c] = (f32)((a[c] + 2 * b[c]) / 3);
+			}
+			const f32 weights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+			const f32 error = fit_indices(block, palette, three_color ? 3 : 4, weights, indices, simd);
+			for (u32 i = 0; i < 16; ++i)
+			{
+				if (TestBit(transparent, i))
+					indices[i] = 3;
+			}
+			return error;
+		}
+
+		inline void bc1_quantize(const f32 e0[4], const f32 e1[4], s32 q[6])
+		{
+			const f32 scale[3] = { 31.0f / 255.0f, 63.0f / 255.0f, 31.0f / 255.0f };
+			for (u32 c = 0; c < 3; ++c)
+			{
+				q[c] = (s32)(e0[c] * scale[c] + 0.5f);
+				q[c + 3] = (s32)(e1[c] * scale[c] + 0.5f);
+			}
+		}
+
+		//? punch_alpha: pixels under 128 alpha become transparent black (three color mode), BC3 passes false
+		inline void encode_bc1(const Block& source, b32 punch_alpha, BcQuality quality, b32 simd, u8 out[8])
+		{
+			memset(out, 0, 8);
+			Block block = source;
+			u16 transparent = 0;
+			if (punch_alpha)
+			{
+				f32 mean[3] = {};
+				u32 opaque = 0;
+				for (u32 i = 0; i < 16; ++i)
+				{
+					if (block.c[3][i] < 128.0f)
+					{
+						transparent |= (u16)(1u << i);
+						continue;
+					}
+					for (u32 c = 0; c < 3; ++c)
+						mean[c] += block.c[c][i];
+					++opaque;
+				}
+				if (!opaque)
+				{
+					out[4] = out[5] = out[6] = out[7] = 0xff; // c0 == c1 == 0, every index 3
+					return;
+				}
+				// transparent pixels get the opaque mean so they neither pull the axis nor count as error
+				for (u32 i = 0; i < 16; ++i)
+				{
+					if (TestBit(transparent, i))
+						for (u32 c = 0; c < 3; ++c)
+							block.c[c][i] = mean[c] / opaque;
+				}
+			}
+			const b32 three_color = transparent != 0;
+
+			f32 e0[4], e1[4];
+			axis_endpoints(block, 3, e0, e1);
+			s32 q[6];
+			bc1_quantize(e0, e1, q);
+			u8 indices[16];
+			f32 error = bc1_evaluate(block, q, three_color, transparent, simd, indices);
+
+			const u32 refits = quality == BcQuality::best ? 4 : 1;
+			for (u32 r = 0; r < refits; ++r)
+			{
+				const f32 four[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+				const f32 three[4] = { 0.0f, 1.0f, 0.5f, -1.0f };
+				f32 t[16];
+				for (u32 i = 0; i < 16; ++i)
+					t[i] = three_color ? three[indices[i]] : four[indices[i]];
+				if (!least_squares(block, t, 3, e0, e1))
+					break;
+
+				s32 candidate[6];
+				bc1_quantize(e0, e1, candidate);
+				u8 candidate_indices[16];
+				const f32 e = bc1_evaluate(block, candidate, three_color, transparent, simd, candidate_indices);
+				if (e >= error)
+					break;
+				error = e;
+				memcpy(q, candidate, sizeof(q));
+				memcpy(indices, candidate_indices, sizeof(indices));
+			}
+
+			if (quality == BcQuality::best)
+			{
+				const s32 limit[6] = { 31, 63, 31, 31, 63, 31 };
+				u8 scratch[16];
+				hill_climb(q, limit, 6, error, [&](s32* c) { return bc1_evaluate(block, c, three_color, transparent, simd, scratch); });
+				bc1_evaluate(block, q, three_color, transparent, simd, indices);
+			}
+
+			const u16 c0 = pack565(q), c1 = pack565(q + 3);
+			out[0] = (u8)c0;
+			out[1] = (u8)(c0 >> 8);
+			out[2] = (u8)c1;
+			out[3] = (u8)(c1 >> 8);
+			BitWriter w{ out + 4 };
+			for (u32 i = 0; i < 16; ++i)
+				w.put(indices[i], 2);
+		}
+
+		//? four_colors: BC3 color blocks ignore the endpoint order
+		inline void decode_bc1(const u8* in, u8 rgba[64], b32 four_colors)
+		{
+			const u16 c0 = (u16)(in[0] | (in[1] << 8)), c1 = (u16)(in[2] | (in[3] << 8));
+			const s32 a[3] = { expand5(c0 >> 11), expand6((c0 >> 5) & 63), expand5(c0 & 31) };
+			const s32 b[3] = { expand5(c1 >> 11), expand6((c1 >> 5) & 63), expand5(c1 & 31) };
+			const b32 four = four_colors || c0 > c1;
+			u8 palette[4][4];
+			for (u32 c = 0; c < 3; ++c)
+			{
+				palette[0][c] = (u8)a[c];
+				palette[1][c] = (u8)b[c];
+				palette[2][c] = (u8)(four ? (2 * a[c] + b[c]) / 3 : (a[c] + b[c]) / 2);
+				palette[3][c] = (u8)(four ? (a[c] + 2 * b[c]) / 3 : 0);
+			}
+			palette[0][3] = palette[1][3] = palette[2][3] = 255;
+			palette[3][3] = four ? 255 : 0;
+
+			BitReader r{ in + 4 };
+			for (u32 i = 0; i < 16; ++i)
+				memcpy(rgba + i * 4, palette[r.get(2)], 4);
+		}
+
+		// BC4, alpha of BC3 ---------------------------------------------------------------------------------
+
+		//? a0 > a1 interpolates six values between them, otherwise four plus 0 and 255
+		inline void bc4_palette(s32 a0, s32 a1, f32 palette[8][4])
+		{
+			memset(palette, 0, sizeof(f32) * 8 * 4);
+			palette[0][3] = (f32)a0;
+			palette[1][3] = (f32)a1;
+			if (a0 > a1)
+			{
+				for (s32 i = 1; i < 7; ++i)
+					palette[i + 1][3] = (f32)(((7 - i) * a0 + i * a1) / 7);
+			}
+			else
+			{
+				for (s32 i = 1; i < 5; ++i)
+					palette[i + 1][3] = (f32)(((5 - i) * a0 + i * a1) / 5);
+				palette[6][3] = 0.0f;
+				palette[7][3] = 255.0f;
+			}
+		}
+
+		inline void encode_bc4_alpha(const Block& block, BcQuality quality, b32 simd, u8 out[8])
+		{
+			memset(out, 0, 8);
+			f32 lo = 255.0f, hi = 0.0f;
+			for (u32 i = 0; i < 16; ++i)
+			{
+				lo = min(lo, block.c[3][i]);
+				hi = max(hi, block.c[3][i]);
+			}
+
+			s32 q[2] = { (s32)hi, (s32)lo };
+			u8 indices[16] = {};
+			if (q[0] != q[1])
+			{
+				const f32 weights[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+				f32 palette[8][4];
+				auto eval = [&](s32* a, u8* idx)
+					{
+						bc4_palette(a[0], a[1], palette);
+						return fit_indices(block, palette, 8, weights, idx, simd);
+					};
+				const f32 error = eval(q, indices);
+				if (quality == BcQuality::best)
+				{
+					const s32 limit[2] = { 255, 255 };
+					u8 scratch[16];
+					hill_climb(q, limit, 2, error, [&](s32* a) { return eval(a, scratch); });
+					eval(q, indices);
+				}
+			}
+
+			out[0] = (u8)q[0];
+			out[1] = (u8)q[1];
+			BitWriter w{ out + 2 };
+			for (u32 i = 0; i < 16; ++i)
+				w.put(indices[i], 3);
+		}
+
+		inline void decode_bc4_alpha(const u8* in, u8 rgba[64])
+		{
+			f32 palette[8][4];
+			bc4_palette(in[0], in[1], palette);
+			BitReader r{ in + 2 };
+			for (u32 i = 0; i < 16; ++i)
+				rgba[i * 4 + 3] = (u8)palette[r.get(3)][3];
+		}
+
+		// BC7 mode 6 ----------------------------------------------------------------------------------------
+
+		constexpr s32 bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		//? q: r0 g0 b0 a0 r1 g1 b1 a1 in 7 bits, then the two p-bits, endpoint channel = q << 1 | p
+		inline f32 bc7_evaluate(const Block& block, const s32 q[10], b32 simd, u8 indices[16])
+		{
+			f32 palette[16][4];
+			for (u32 c = 0; c < 4; ++c)
+			{
+				const s32 a = (q[c] << 1) | q[8], b = (q[c + 4] << 1) | q[9];
+				for (u32 i = 0; i < 16; ++i)
+					palette[i][c] = (f32)(((64 - bc7_weights[i]) * a + bc7_weights[i] * b + 32) >> 6);
+			}
+			const f32 weights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+			return fit_indices(block, palette, 16, weights, indices, simd);
+		}
+
+		//? Per endpoint the p-bit that rounds its four channels best
+		inline void bc7_quantize(const f32 e0[4], const f32 e1[4], s32 q[10])
+		{
+			const f32* e[2] = { e0, e1 };
+			for (u32 k = 0; k < 2; ++k)
+			{
+				f32 best = 1e30f;
+				for (s32 p = 0; p < 2; ++p)
+				{
+					s32 candidate[4];
+					f32 error = 0.0f;
+					for (u32 c = 0; c < 4; ++c)
+					{
+						candidate[c] = clamp((s32)((e[k][c] - p) * 0.5f + 0.5f), 0, 127);
+						const f32 d = e[k][c] - (f32)((candidate[c] << 1) | p);
+						error += d * d;
+					}
+					if (error < best)
+					{
+						best = error;
+						memcpy(q + k * 4, candidate, sizeof(candidate));
+						q[8 + k] = p;
+					}
+				}
+			}
+		}
+
+		inline void encode_bc7(const Block& block, BcQuality quality, b32 simd, u8 out[16])
+		{
+			f32 e0[4], e1[4];
+			axis_endpoints(block, 4, e0, e1);
+			s32 q[10];
+			bc7_quantize(e0, e1, q);
+			u8 indices[16];
+			f32 error = bc7_evaluate(block, q, simd, indices);
+
+			const u32 refits = quality == BcQuality::best ? 4 : 1;
+			for (u32 r = 0; r < refits; ++r)
+			{
+				f32 t[16];
+				for (u32 i = 0; i < 16; ++i)
+					t[i] = bc7_weights[indices[i]] / 64.0f;
+				if (!least_squares(block, t, 4, e0, e1))
+					break;
+
+				s32 candidate[10];
+				bc7_quantize(e0, e1, candidate);
+				u8 candidate_indices[16];
+				const f32 e = bc7_evaluate(block, candidate, simd, candidate_indices);
+				if (e >= error)
+					break;
+				error = e;
+				memcpy(q, candidate, sizeof(q));
+				memcpy(indices, candidate_indices, sizeof(indices));
+			}
+
+			if (quality == BcQuality::best)
+			{
+				const s32 limit[10] = { 127, 127, 127, 127, 127, 127, 127, 127, 1, 1 };
+				u8 scratch[16];
+				hill_climb(q, limit, 10, error, [&](s32* c) { return bc7_evaluate(block, c, simd, scratch); });
+				bc7_evaluate(block, q, simd, indices);
+			}
+
+			// the first index is stored without its top bit, swapping the endpoints mirrors the palette
+			if (indices[0] & 8)
+			{
+				for (u32 c = 0; c < 4; ++c)
+				{
+					const s32 t = q[c];
+					q[c] = q[c + 4];
+					q[c + 4] = t;
+				}
+				const s32 p = q[8];
+				q[8] = q[9];
+				q[9] = p;
+				for (u32 i = 0; i < 16; ++i)
+					indices[i] = (u8)(15 - indices[i]);
+			}
+
+			memset(out, 0, 16);
+			BitWriter w{ out };
+			w.put(1u << 6, 7); // mode 6
+			for (u32 c = 0; c < 4; ++c)
+			{
+				w.put((u32)q[c], 7);
+				w.put((u32)q[c + 4], 7);
+			}
+			w.put((u32)q[8], 1);
+			w.put((u32)q[9], 1);
+			w.put(indices[0], 3);
+			for (u32 i = 1; i < 16; ++i)
+				w.put(indices[i], 4);
+		}
+
+		//! Mode 6 only, the one encode_bc7 writes. Other modes decode to magenta.
+		inline void decode_bc7(const u8* in, u8 rgba[64])
+		{
+			if ((in[0] & 0x7f) != (1u << 6))
+			{
+				for (u32 i = 0; i < 16; ++i)
+				{
+					rgba[i * 4 + 0] = 255;
+					rgba[i * 4 + 1] = 0;
+					rgba[i * 4 + 2] = 255;
+					rgba[i * 4 + 3] = 255;
+				}
+				return;
+			}
+
+			BitReader r{ in, 7 };
+			s32 q[10];
+			for (u32 c = 0; c < 4; ++c)
+			{
+				q[c] = (s32)r.get(7);
+				q[c + 4] = (s32)r.get(7);
+			}
+			q[8] = (s32)r.get(1);
+			q[9] = (s32)r.get(1);
+			for (u32 i = 0; i < 16; ++i)
+			{
+				const s32 w = bc7_weights[r.get(i ? 4 : 3)];
+				for (u32 c = 0; c < 4; ++c)
+				{
+					const s32 a = (q[c] << 1) | q[8], b = (q[c + 4] << 1) | q[9];
+					rgba[i * 4 + c] = (u8)(((64 - w) * a + w * b + 32) >> 6);
+				}
+			}
+		}
+
+		inline void encode_block(BcFormat format, const Block& block, BcQuality quality, b32 simd, u8* out)
+		{
+			switch (format)
+			{
+			case BcFormat::bc1:
+				encode_bc1(block, true, quality, simd, out);
+				break;
+			case BcFormat::bc3:
+				encode_bc4_alpha(block, quality, simd, out);
+				encode_bc1(block, false, quality, simd, out + 8);
+				break;
+			case BcFormat::bc7:
+				encode_bc7(block, quality, simd, out);
+				break;
+			}
+		}
+
+		inline void decode_block(BcFormat format, const u8* in, u8 rgba[64])
+		{
+			switch (format)
+			{
+			case BcFormat::bc1:
+				decode_bc1(in, rgba, false);
+				break;
+			case BcFormat::bc3:
+				decode_bc1(in + 8, rgba, true);
+				decode_bc4_alpha(in, rgba);
+				break;
+			case BcFormat::bc7:
+				decode_bc7(in, rgba);
+				break;
+			}
+		}
+	}
+
+	//? Every level of the chain, block rows in parallel when there's a job system.
+	//? simd = false runs the scalar index search, output is identical.
+	inline void compress(const MipChain& chain, BcFormat format, CompressedTexture& out, JobSystem* jobs = nullptr,
+		BcQuality quality = BcQuality::fast, b32 simd = true)
+	{
+		PROFILE_SCOPE("compress texture");
+		out.format = format;
+		out.width = chain.width;
+		out.height = chain.height;
+		out.levels.resize(chain.levels.size());
+		size_t total = 0;
+		for (u32 level = 0; level < (u32)chain.levels.size(); ++level)
+		{
+			out.levels[level] = { chain.levels[level].width, chain.levels[level].height, total };
+			total += out.level_size(level);
+		}
+		out.blocks.resize(total);
+
+		const u32 block_bytes = bc_block_bytes(format);
+		for (u32 level = 0; level < (u32)chain.levels.size(); ++level)
+		{
+			const s32 width = chain.levels[level].width, height = chain.levels[level].height;
+			const s32 blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+			const u8* pixels = chain.level_pixels(level);
+			u8* dst = out.blocks.data() + out.levels[level].offset;
+			auto encode_rows = [=](u32 first, u32 last)
+				{
+					bc::Block block;
+					for (s32 by = (s32)first; by < (s32)last; ++by)
+					{
+						for (s32 bx = 0; bx < blocks_x; ++bx)
+						{
+							bc::load_block(pixels, width, height, bx, by, block);
+							bc::encode_block(format, block, quality, simd, dst + ((size_t)by * blocks_x + bx) * block_bytes);
+						}
+					}
+				};
+			if (jobs)
+				jobs->parallel_for((u32)blocks_y, max(1u, 64u / (u32)blocks_x), encode_rows);
+			else
+				encode_rows(0, (u32)blocks_y);
+		}
+	}
+
+	//? Back to RGBA8, for the PSNR check and for drivers without the format
+	inline void decompress(const CompressedTexture& texture, MipChain& chain)
+	{
+		chain.width = texture.width;
+		chain.height = texture.height;
+		chain.levels.resize(texture.levels.size());
+		size_t total = 0;
+		for (u32 level = 0; level < (u32)texture.levels.size(); ++level)
+		{
+			chain.levels[level] = { texture.levels[level].width, texture.levels[level].height, total };
+			total += (size_t)texture.levels[level].width * texture.levels[level].height * 4;
+		}
+		chain.pixels.resize(total);
+
+		const u32 block_bytes = bc_block_bytes(texture.format);
+		for (u32 level = 0; level < (u32)texture.levels.size(); ++level)
+		{
+			const s32 width = texture.levels[level].width, height = texture.levels[level].height;
+			const s32 blocks_x = (width + 3) / 4;
+			const u8* blocks = texture.level_blocks(level);
+			u8* pixels = chain.pixels.data() + chain.levels[level].offset;
+			for (s32 by = 0; by < (height + 3) / 4; ++by)
+			{
+				for (s32 bx = 0; bx < blocks_x; ++bx)
+				{
+					u8 rgba[64];
+					bc::decode_block(texture.format, blocks + ((size_t)by * blocks_x + bx) * block_bytes, rgba);
+					for (s32 i = 0; i < 16; ++i)
+					{
+						const s32 x = bx * 4 + (i & 3), y = by * 4 + (i >> 2);
+						if (x < width && y < height)
+							memcpy(pixels + ((size_t)y * width + x) * 4, rgba + i * 4, 4);
+					}
+				}
+			}
+		}
+	}
+
+	constexpr u32 ctex_magic = 0x58455443; // "CTEX"
+	constexpr u32 ctex_version = 1;
+
+	struct CtexHeader
+	{
+		u32 magic;
+		u32 version;
+		u32 format;
+		s32 width;
+		s32 height;
+		u32 levels;
+	};
+
+	inline b32 write_ctex(const char* path, const CompressedTexture& texture)
+	{
+		FILE* file = fopen(path, "wb");
+		if (!file)
+			return false;
+
+		const CtexHeader header = { ctex_magic, ctex_version, (u32)texture.format, texture.width, texture.height, (u32)texture.levels.size() };
+		b32 ok = fwrite(&header, sizeof(header), 1, file) == 1;
+		ok = ok && fwrite(texture.blocks.data(), 1, texture.blocks.size(), file) == texture.blocks.size();
+		fclose(file);
+		return ok;
+	}
+
+	//? Level sizes follow from the header, they're not stored
+	inline b32 parse_ctex(const u8* data, size_t size, CompressedTexture& texture)
+	{
+		CtexHeader header;
+		if (size < sizeof(header))
+			return false;
+		memcpy(&header, data, sizeof(header));
+		if (header.magic != ctex_magic || header.version != ctex_version || header.format > (u32)BcFormat::bc7 ||
+			header.width <= 0 || header.height <= 0 || header.levels == 0 || header.levels > 32)
+			return false;
+
+		texture.format = (BcFormat)header.format;
+		texture.width = header.width;
+		texture.height = header.height;
+		texture.levels.resize(header.levels);
+		size_t total = 0;
+		s32 w = header.width, h = header.height;
+		for (u32 level = 0; level < header.levels; ++level)
+		{
+			texture.levels[level] = { w, h, total };
+			total += texture.level_size(level);
+			w = max(1, w / 2);
+			h = max(1, h / 2);
+		}
+		if (size - sizeof(header) < total)
+			return false;
+		texture.blocks.assign(data + sizeof(header), data + sizeof(header) + total);
+		return true;
+	}
+
+	inline b32 read_ctex(const char* path, CompressedTexture& texture)
+	{
+		FILE* file = fopen(path, "rb");
+		if (!file)
+			return false;
+
+		std::vector<u8> data;
+		fseek(file, 0, SEEK_END);
+		const long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		if (size > 0)
+		{
+			data.resize((size_t)size);
+			if (fread(data.data(), 1, data.size(), file) != data.size())
+				data.clear();
+		}
+		fclose(file);
+		return parse_ctex(data.data(), data.size(), texture);
+	}
+
+	inline b32 has_gl_extension(const char* name)
+	{
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; ++i)
+		{
+			const GLubyte* extension = glGetStringi(GL_EXTENSIONS, (GLuint)i);
+			if (extension && strcmp((const char*)extension, name) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	// EXT_texture_compression_s3tc with EXT_texture_sRGB, the glad here is generated without extensions
+	constexpr GLenum gl_compressed_srgb_alpha_s3tc_dxt1 = 0x8C4D;
+	constexpr GLenum gl_compressed_srgb_alpha_s3tc_dxt5 = 0x8C4F;
+
+	inline GLenum bc_gl_format(BcFormat format)
+	{
+		switch (format)
+		{
+		case BcFormat::bc1: return gl_compressed_srgb_alpha_s3tc_dxt1;
+		case BcFormat::bc3: return gl_compressed_srgb_alpha_s3tc_dxt5;
+		case BcFormat::bc7: return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+		}
+		return 0;
+	}
+
+	//? BPTC is core in 4.2, S3TC is an extension everywhere (universal on desktop)
+	inline b32 bc_format_supported(BcFormat format)
+	{
+		if (format == BcFormat::bc7)
+			return GLAD_GL_VERSION_4_2 || has_gl_extension("GL_ARB_texture_compression_bptc");
+		return has_gl_extension("GL_EXT_texture_compression_s3tc") &&
+			(has_gl_extension("GL_EXT_texture_sRGB") || has_gl_extension("GL_EXT_texture_compression_s3tc_srgb"));
+	}
+
+	//? Blocks as they are when the driver takes the format, otherwise decompressed and uploaded as RGBA8
+	inline GLuint upload_compressed(const CompressedTexture& texture)
+	{
+		if (!bc_format_supported(texture.format))
+		{
+			MipChain chain;
+			decompress(texture, chain);
+			return upload_texture(chain);
+		}
+
+		GLuint name = 0;
+		glGenTextures(1, &name);
+		glBindTexture(GL_TEXTURE_2D, name);
+		const GLenum format = bc_gl_format(texture.format);
+		const GLsizei levels = (GLsizei)texture.levels.size();
+		if (GLAD_GL_VERSION_4_2)
+		{
+			glTexStorage2D(GL_TEXTURE_2D, levels, format, texture.width, texture.height);
+			for (GLsizei level = 0; level < levels; ++level)
+			{
+				const MipLevel& l = texture.levels[level];
+				glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, l.width, l.height, format, (GLsizei)texture.level_size(level),
+					texture.level_blocks(level));
+			}
+		}
+		else
+		{
+			for (GLsizei level = 0; level < levels; ++level)
+			{
+				const MipLevel& l = texture.levels[level];
+				glCompressedTexImage2D(GL_TEXTURE_2D, level, format, l.width, l.height, 0, (GLsizei)texture.level_size(level),
+					texture.level_blocks(level));
+			}
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+		}
+		set_texture_sampling();
+		return name;
+	}
+}
@@ -0,0 +1,373 @@
+#pragma once
+#include <vector>
+#include <thread>
+
+#include "Utils.hpp"
+#include "my_math.h"
+#include "JobSystem.hpp"
+
+//? Clipping and triangle setup for a CPU rasterizer. Triangles come in clip space, indexed, and leave as
+//? screen space triangles in a bin. The clip volume is -w <= x, y <= w and 0 <= z <= w: create_perspective
+//? puts the near plane at z = 0 and the far plane at z = w. clip_triangles() takes four triangles per
+//? iteration, a vertex component of all four in one __m128, and computes outcodes for the six planes at
+//? once: triangles with every vertex outside one plane are rejected, triangles with no vertex outside any
+//? are accepted and set up four at a time, and only the rest, the ones straddling a plane, go through
+//? Sutherland-Hodgman one at a time. The sides are tested against a guard band guard_band times the
+//? viewport instead of the viewport itself: a triangle poking out of the screen but not out of the band is
+//? accepted as is and left to the rasterizer's scissor, so only the near and far planes and triangles
+//? reaching far off screen are clipped. clip_triangles_scalar() is the same stage a triangle at a time,
+//? the reference for it and the benchmark's baseline.
+//! Triangles are counter-clockwise in the bin, x right and y up from the bottom left pixel corner; back
+//! faces (clockwise on screen) are dropped unless cull_back is off, then they are flipped. Vertices can be
+//! outside the viewport, up to the guard band, a rasterizer must clamp its bounds to the viewport.
+
+namespace lib
+{
+	struct ClipVertex
+	{
+		f32 x, y, z, w; // clip space
+		f32 r, g, b, a;
+	};
+
+	struct RasterVertex
+	{
+		f32 x, y;       // pixels
+		f32 z;          // 0 at the near plane, 1 at the far plane
+		f32 inv_w;      // 1 / w, interpolates linearly on screen
+		f32 r, g, b, a; // divided by w, so they do too
+	};
+
+	struct ClipViewport
+	{
+		f32 width;
+		f32 height;
+		b32 cull_back = true;
+		f32 guard_band = 4.0f; // side planes for clipping, in viewports from the center; 1 clips at the edges
+	};
+
+	struct ClipStats
+	{
+		u64 triangles = 0;
+		u64 accepted = 0; // inside the near and far planes and the guard band
+		u64 rejected = 0; // outside one plane of the view volume
+		u64 clipped = 0;  // straddling, went through Sutherland-Hodgman
+		u64 culled = 0;   // back facing or without area after setup
+		u64 emitted = 0;  // triangles in the bin, a clipped one can become several
+
+		void add(const ClipStats& o)
+		{
+			triangles += o.triangles;
+			accepted += o.accepted;
+			rejected += o.rejected;
+			clipped += o.clipped;
+			culled += o.culled;
+			emitted += o.emitted;
+		}
+	};
+
+	struct ClipBin
+	{
+		std::vector<RasterVertex> vertices; // three per triangle
+		ClipStats stats;
+
+		void clear()
+		{
+			vertices.clear();
+			stats = {};
+		}
+	};
+
+	// outcode bits, one per clip plane
+	inline constexpr u32 clip_left = 1;
+	inline constexpr u32 clip_right = 2;
+	inline constexpr u32 clip_bottom = 4;
+	inline constexpr u32 clip_top = 8;
+	inline constexpr u32 clip_near = 16;
+	inline constexpr u32 clip_far = 32;
+
+	inline constexpr u8 clip_lane_count[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+	//? Planes v is outside of, the sides moved out to guard times the viewport
+	inline u32 clip_outcode(const ClipVertex& v, f32 guard = 1.0f)
+	{
+		const f32 side = v.w * guard;
+		return (v.x < -side ? clip_left : 0u) | (v.x > side ? clip_right : 0u) | (v.y < -side ? clip_bottom : 0u) |
+			(v.y > side ? clip_top : 0u) | (v.z < 0.0f ? clip_near : 0u) | (v.z > v.w ? clip_far : 0u);
+	}
+
+	inline f32 clip_distance(const ClipVertex& v, const f32* plane)
+	{
+		return v.x * plane[0] + v.y * plane[1] + v.z * plane[2] + v.w * plane[3];
+	}
+
+	inline RasterVertex clip_to_screen(const ClipVertex& v, const ClipViewport& viewport)
+	{
+		const f32 inv_w = 1.0f / v.w;
+		return { (v.x * inv_w + 1.0f) * (viewport.width * 0.5f), (v.y * inv_w + 1.0f) * (viewport.height * 0.5f), v.z * inv_w, inv_w,
+			v.r * inv_w, v.g * inv_w, v.b * inv_w, v.a * inv_w };
+	}
+
+	//? Divide, viewport and facing of a triangle inside the volume
+	inline void setup_triangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, const ClipViewport& viewport, ClipBin& bin)
+	{
+		const RasterVertex sa = clip_to_screen(a, viewport), sb = clip_to_screen(b, viewport), sc = clip_to_screen(c, viewport);
+		const f32 area = (sb.x - sa.x) * (sc.y - sa.y) - (sc.x - sa.x) * (sb.y - sa.y);
+		if (area == 0.0f || (area < 0.0f && viewport.cull_back))
+		{
+			++bin.stats.culled;
+			return;
+		}
+		bin.vertices.push_back(sa);
+		bin.vertices.push_back(area > 0.0f ? sb : sc);
+		bin.vertices.push_back(area > 0.0f ? sc : sb);
+		++bin.stats.emitted;
+	}
+
+	//? Sutherland-Hodgman against the planes in the mask, the polygon left over fanned into triangles.
+	//? Each plane adds at most one vertex, so a triangle grows to nine.
+	inline void clip_triangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, u32 planes, const ClipViewport& viewport,
+		ClipBin& bin)
+	{
+		// x, y, z, w factors of the planes in outcode bit order, a dot product with them is positive inside
+		const f32 g = viewport.guard_band;
+		const f32 clip_planes[6][4] = {
+			{ 1.0f, 0.0f, 0.0f, g }, { -1.0f, 0.0f, 0.0f, g }, // left, right
+			{ 0.0f, 1.0f, 0.0f, g }, { 0.0f, -1.0f, 0.0f, g }, // bottom, top
+			{ 0.0f, 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, -1.0f, 1.0f }, // near, far
+		};
+		ClipVertex polygons[2][9]; // not zeroed, that alone costs as much as clipping against one plane
+		polygons[0][0] = a;
+		polygons[0][1] = b;
+		polygons[0][2] = c;
+		u32 count = 3;
+		u32 in = 0;
+		for (u32 p = 0; p < 6 && count >= 3; ++p)
+		{
+			if (!(planes & (1u << p)))
+				continue;
+			const f32* plane = clip_planes[p];
+			const ClipVertex* src = polygons[in];
+			ClipVertex* dst = polygons[in ^ 1];
+			u32 out = 0;
+			f32 d = clip_distance(src[count - 1], plane);
+			for (u32 i = 0, prev = count - 1; i < count; prev = i++)
+			{
+				const f32 d_prev = d;
+				d = clip_distance(src[i], plane);
+				if ((d_prev >= 0.0f) != (d >= 0.0f))
+				{
+					// interpolated from the inside vertex, so the same edge gives the same point both ways
+					const b32 forward = d_prev >= 0.0f;
+					const ClipVertex& from = forward ? src[prev] : src[i];
+					const ClipVertex& to = forward ? src[i] : src[prev];
+					const f32 t = forward ? d_prev / (d_prev - d) : d / (d - d_prev);
+					dst[out++] = { from.x + (to.x - from.x) * t, from.y + (to.y - from.y) * t, from.z + (to.z - from.z) * t,
+						from.w + (to.w - from.w) * t, from.r + (to.r - from.r) * t, from.g + (to.g - from.g) * t,
+						from.b + (to.b - from.b) * t, from.a + (to.a - from.a) * t };
+				}
+				if (d >= 0.0f)
+					dst[out++] = src[i];
+			}
+			count = out;
+			in ^= 1;
+		}
+		for (u32 i = 1; i + 1 < count; ++i)
+			setup_triangle(polygons[in][0], polygons[in][i], polygons[in][i + 1], viewport, bin);
+	}
+
+	//? Reference, one triangle at a time: triangles [first, first + count) of indices
+	inline void clip_triangles_scalar(const ClipVertex* vertices, const u32* indices, u32 first, u32 count, const ClipViewport& viewport,
+		ClipBin& bin)
+	{
+		bin.vertices.reserve(bin.vertices.size() + (size_t)count * 3);
+		for (u32 t = first; t < first + count; ++t)
+		{
+			const ClipVertex& a = vertices[indices[t * 3 + 0]];
+			const ClipVertex& b = vertices[indices[t * 3 + 1]];
+			const ClipVertex& c = vertices[indices[t * 3 + 2]];
+			const u32 guard = clip_outcode(a, viewport.guard_band) | clip_outcode(b, viewport.guard_band) | clip_outcode(c, viewport.guard_band);
+			++bin.stats.triangles;
+			if (clip_outcode(a) & clip_outcode(b) & clip_outcode(c))
+			{
+				++bin.stats.rejected;
+			}
+			else if (!guard)
+			{
+				++bin.stats.accepted;
+				setup_triangle(a, b, c, viewport, bin);
+			}
+			else
+			{
+				++bin.stats.clipped;
+				clip_triangle(a, b, c, guard, viewport, bin);
+			}
+		}
+	}
+
+	//? Four triangles per iteration, see the top of the file; the last count % 4 go through the scalar path
+	inline void clip_triangles(const ClipVertex* vertices, const u32* indices, u32 first, u32 count, const ClipViewport& viewport,
+		ClipBin& bin)
+	{
+		bin.vertices.reserve(bin.vertices.size() + (size_t)count * 3);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 guard = _mm_set1_ps(viewport.guard_band);
+		const __m128 half_width = _mm_set1_ps(viewport.width * 0.5f);
+		const __m128 half_height = _mm_set1_ps(viewport.height * 0.5f);
+		const u32 end = first + count;
+		u32 t = first;
+		for (; t + 4 <= end; t += 4)
+		{
+			const u32* tri = indices + (size_t)t * 3;
+
+			// x, y, z, w of vertex k of the four triangles
+			__m128 x[3], y[3], z[3], w[3];
+			for (u32 k = 0; k < 3; ++k)
+			{
+				__m128 p0 = _mm_loadu_ps(&vertices[tri[0 + k]].x);
+				__m128 p1 = _mm_loadu_ps(&vertices[tri[3 + k]].x);
+				__m128 p2 = _mm_loadu_ps(&vertices[tri[6 + k]].x);
+				__m128 p3 = _mm_loadu_ps(&vertices[tri[9 + k]].x);
+				_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+				x[k] = p0;
+				y[k] = p1;
+				z[k] = p2;
+				w[k] = p3;
+			}
+
+			// all three outside a plane of the view volume rejects, any outside a plane of the guard band
+			// means the triangle needs clipping
+			__m128 all_out = zero, any_out = zero;
+			auto reject = [&](__m128 o0, __m128 o1, __m128 o2)
+			{
+				all_out = _mm_or_ps(all_out, _mm_and_ps(_mm_and_ps(o0, o1), o2));
+			};
+			auto clip = [&](__m128 o0, __m128 o1, __m128 o2)
+			{
+				any_out = _mm_or_ps(any_out, _mm_or_ps(_mm_or_ps(o0, o1), o2));
+			};
+			__m128 neg_w[3], side[3], neg_side[3];
+			for (u32 k = 0; k < 3; ++k)
+			{
+				neg_w[k] = _mm_sub_ps(zero, w[k]);
+				side[k] = _mm_mul_ps(w[k], guard);
+				neg_side[k] = _mm_sub_ps(zero, side[k]);
+			}
+			reject(_mm_cmplt_ps(x[0], neg_w[0]), _mm_cmplt_ps(x[1], neg_w[1]), _mm_cmplt_ps(x[2], neg_w[2]));
+			reject(_mm_cmpgt_ps(x[0], w[0]), _mm_cmpgt_ps(x[1], w[1]), _mm_cmpgt_ps(x[2], w[2]));
+			reject(_mm_cmplt_ps(y[0], neg_w[0]), _mm_cmplt_ps(y[1], neg_w[1]), _mm_cmplt_ps(y[2], neg_w[2]));
+			reject(_mm_cmpgt_ps(y[0], w[0]), _mm_cmpgt_ps(y[1], w[1]), _mm_cmpgt_ps(y[2], w[2]));
+			clip(_mm_cmplt_ps(x[0], neg_side[0]), _mm_cmplt_ps(x[1], neg_side[1]), _mm_cmplt_ps(x[2], neg_side[2]));
+			clip(_mm_cmpgt_ps(x[0], side[0]), _mm_cmpgt_ps(x[1], side[1]), _mm_cmpgt_ps(x[2], side[2]));
+			clip(_mm_cmplt_ps(y[0], neg_side[0]), _mm_cmplt_ps(y[1], neg_side[1]), _mm_cmplt_ps(y[2], neg_side[2]));
+			clip(_mm_cmpgt_ps(y[0], side[0]), _mm_cmpgt_ps(y[1], side[1]), _mm_cmpgt_ps(y[2], side[2]));
+			const __m128 near0 = _mm_cmplt_ps(z[0], zero), near1 = _mm_cmplt_ps(z[1], zero), near2 = _mm_cmplt_ps(z[2], zero);
+			const __m128 far0 = _mm_cmpgt_ps(z[0], w[0]), far1 = _mm_cmpgt_ps(z[1], w[1]), far2 = _mm_cmpgt_ps(z[2], w[2]);
+			reject(near0, near1, near2);
+			clip(near0, near1, near2);
+			reject(far0, far1, far2);
+			clip(far0, far1, far2);
+			const u32 rejected = (u32)_mm_movemask_ps(all_out);
+			const u32 outside = (u32)_mm_movemask_ps(any_out);
+			const u32 accepted = ~(outside | rejected) & 15;
+			const u32 straddling = outside & ~rejected;
+			bin.stats.triangles += 4;
+			bin.stats.rejected += clip_lane_count[rejected];
+			bin.stats.accepted += clip_lane_count[accepted];
+			bin.stats.clipped += clip_lane_count[straddling];
+
+			// setup of all four lanes when any is accepted, only the accepted ones are read
+			alignas(16) f32 sx[3][4], sy[3][4], sz[3][4], iw[3][4], area[4];
+			if (accepted)
+			{
+				__m128 px[3], py[3];
+				for (u32 k = 0; k < 3; ++k)
+				{
+					// rejected and straddling lanes may divide by zero, their results are never read
+					const __m128 inv_w = _mm_div_ps(one, w[k]);
+					px[k] = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(x[k], inv_w), one), half_width);
+					py[k] = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(y[k], inv_w), one), half_height);
+					_mm_store_ps(sx[k], px[k]);
+					_mm_store_ps(sy[k], py[k]);
+					_mm_store_ps(sz[k], _mm_mul_ps(z[k], inv_w));
+					_mm_store_ps(iw[k], inv_w);
+				}
+				_mm_store_ps(area, _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(px[1], px[0]), _mm_sub_ps(py[2], py[0])),
+					_mm_mul_ps(_mm_sub_ps(px[2], px[0]), _mm_sub_ps(py[1], py[0]))));
+			}
+
+			// lanes in order, so the bin keeps the order triangles were submitted in
+			for (u32 lane = 0; lane < 4; ++lane)
+			{
+				const u32 bit = 1u << lane;
+				if (straddling & bit)
+				{
+					const ClipVertex& a = vertices[tri[lane * 3 + 0]];
+					const ClipVertex& b = vertices[tri[lane * 3 + 1]];
+					const ClipVertex& c = vertices[tri[lane * 3 + 2]];
+					const f32 g = viewport.guard_band;
+					clip_triangle(a, b, c, clip_outcode(a, g) | clip_outcode(b, g) | clip_outcode(c, g), viewport, bin);
+					continue;
+				}
+				if (!(accepted & bit))
+					continue;
+				if (area[lane] == 0.0f || (area[lane] < 0.0f && viewport.cull_back))
+				{
+					++bin.stats.culled;
+					continue;
+				}
+				const b32 flip = area[lane] < 0.0f;
+				for (u32 k = 0; k < 3; ++k)
+				{
+					const u32 from = flip && k ? 3 - k : k;
+					const ClipVertex& v = vertices[tri[lane * 3 + from]];
+					const f32 inv_w = iw[from][lane];
+					bin.vertices.push_back({ sx[from][lane], sy[from][lane], sz[from][lane], inv_w, v.r * inv_w, v.g * inv_w, v.b * inv_w,
+						v.a * inv_w });
+				}
+				++bin.stats.emitted;
+			}
+		}
+		clip_triangles_scalar(vertices, indices, t, end - t, viewport, bin);
+	}
+
+	//? Triangles split over the job system in fixed chunks, each chunk fills its own bin: no locks, nothing
+	//? shared between threads, and the bins come out in triangle order, the order a rasterizer needs.
+	struct ClipStage
+	{
+		static constexpr u32 chunk_triangles = 16384;
+
+		std::vector<ClipBin> bins; // bin_count of them are this run's, the rest keep their memory
+		u32 bin_count = 0;
+		b32 simd = true;
+
+		void run(JobSystem& jobs, const ClipVertex* vertices, const u32* indices, u32 triangle_count, const ClipViewport& viewport)
+		{
+			bin_count = (triangle_count + chunk_triangles - 1) / chunk_triangles;
+			if (bins.size() < bin_count)
+				bins.resize(bin_count);
+			jobs.parallel_for(bin_count, 1, [&](u32 first, u32 last)
+				{
+					for (u32 c = first; c < last; ++c)
+					{
+						ClipBin& bin = bins[c];
+						bin.clear();
+						const u32 begin = c * chunk_triangles;
+						const u32 count = min(chunk_triangles, triangle_count - begin);
+						if (simd)
+							clip_triangles(vertices, indices, begin, count, viewport, bin);
+						else
+							clip_triangles_scalar(vertices, indices, begin, count, viewport, bin);
+					}
+				});
+		}
+
+		ClipStats stats() const
+		{
+			ClipStats total;
+			for (u32 c = 0; c < bin_count; ++c)
+				total.add(bins[c].stats);
+			return total;
+		}
+	};
+}
@@ -0,0 +1,278 @@
+#pragma once
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+#include "Utils.hpp"
+#include "my_math.h"
+#include "JobSystem.hpp"
+#include "Scene.hpp"
+
+//? Clustered forward lighting, CPU side. The view frustum (same fov/aspect/near/far as create_perspective)
+//? is split into grid_x * grid_y screen tiles and grid_z slices that grow exponentially with distance. Every
+//? frame the lights are moved to view space and each slice tests them against the AABBs of its clusters,
+//? four clusters per SSE compare, slices running in parallel on the job system. The result is the compact
+//? layout the fragment shader reads: per cluster (offset, count) into one list of light indices.
+//? Clusters take at most max_lights_per_cluster lights, the rest is counted as overflow and not lit.
+
+namespace lib
+{
+	struct PointLight
+	{
+		Vec3 pos;   // world space at time 0
+		f32 radius; // attenuation reaches zero here
+		Vec3 color;
+		f32 speed;  // orbit around the y axis, radians per second
+	};
+
+	//? Two RGBA32F texels in the light buffer
+	struct GpuLight
+	{
+		Vec3 pos; // view space
+		f32 radius;
+		Vec3 color;
+		f32 pad;
+	};
+
+	struct ClusterStats
+	{
+		u64 frames = 0;
+		f64 bin_ms = 0.0;
+		f64 max_bin_ms = 0.0;
+		u64 references = 0; // light indices written
+		u64 overflow = 0;   // light/cluster pairs dropped because the cluster was full
+		u32 max_per_cluster = 0;
+	};
+
+	struct ClusteredLights
+	{
+		static constexpr u32 grid_x = 16;
+		static constexpr u32 grid_y = 9;
+		static constexpr u32 grid_z = 24;
+		static constexpr u32 slice_clusters = grid_x * grid_y;
+		static constexpr u32 cluster_count = slice_clusters * grid_z;
+		static constexpr u32 max_lights_per_cluster = 256;
+		static_assert(slice_clusters % 4 == 0, "clusters of a slice are tested four at a time");
+
+		std::vector<PointLight> lights;
+		f32 fov = 0.0f;
+		f32 aspect = 0.0f;
+		f32 near_plane = 0.0f;
+		f32 far_plane = 0.0f;
+
+		// filled by bin(), ready to upload
+		std::vector<GpuLight> gpu_lights;
+		std::vector<u32> cluster_ranges; // offset, count
+		std::vector<u16> light_indices;
+		ClusterStats stats;
+
+		//? Lights scattered through a sphere of the scene's size, radius scaled so the count doesn't change
+		//? how much of the scene is lit, only how many lights overlap
+		void generate(u32 count, f32 scene_radius, u64 seed)
+		{
+			SceneRng rng{ seed ^ 0x6c69676874ull };
+			lights.resize(min(count, 65535u)); // indices are u16
+			const f32 reach = scene_radius * 1.2f;
+			const f32 radius = scene_radius * 2.0f / cbrtf((f32)max(count, 1u));
+			for (PointLight& light : lights)
+			{
+				light.pos = rng.unit_vector() * reach * cbrtf(rng.uniform(0.0f, 1.0f));
+				light.radius = radius * rng.uniform(0.75f, 1.25f);
+				light.color = Vec3{ rng.uniform(0.2f, 1.0f), rng.uniform(0.2f, 1.0f), rng.uniform(0.2f, 1.0f) } * 1.5f;
+				light.speed = rng.uniform(-0.5f, 0.5f);
+			}
+		}
+
+		//? Rebuilds cluster bounds when the projection changed, cheap to call every frame
+		void set_projection(f32 fov_y, f32 aspect_ratio, f32 near_z, f32 far_z)
+		{
+			if (fov_y == fov && aspect_ratio == aspect && near_z == near_plane && far_z == far_plane)
+				return;
+
+			fov = fov_y;
+			aspect = aspect_ratio;
+			near_plane = near_z;
+			far_plane = far_z;
+
+			for (std::vector<f32>* v : { &min_x, &max_x, &min_y, &max_y, &min_z, &max_z })
+				v->resize(cluster_count);
+			slice_near.resize(grid_z);
+			slice_far.resize(grid_z);
+
+			const f32 tan_y = tanf(fov * 0.5f);
+			const f32 tan_x = tan_y * aspect;
+			for (u32 z = 0; z < grid_z; ++z)
+			{
+				const f32 d0 = slice_depth(z);
+				const f32 d1 = slice_depth(z + 1);
+				slice_near[z] = d0;
+				slice_far[z] = d1;
+				for (u32 y = 0; y < grid_y; ++y)
+				{
+					const f32 y0 = (-1.0f + 2.0f * y / grid_y) * tan_y;
+					const f32 y1 = (-1.0f + 2.0f * (y + 1) / grid_y) * tan_y;
+					for (u32 x = 0; x < grid_x; ++x)
+					{
+						const f32 x0 = (-1.0f + 2.0f * x / grid_x) * tan_x;
+						const f32 x1 = (-1.0f + 2.0f * (x + 1) / grid_x) * tan_x;
+						const u32 c = (z * grid_y + y) * grid_x + x;
+						min_x[c] = min(x0 * d0, x0 * d1);
+						max_x[c] = max(x1 * d0, x1 * d1);
+						min_y[c] = min(y0 * d0, y0 * d1);
+						max_y[c] = max(y1 * d0, y1 * d1);
+						min_z[c] = -d1; // view space looks down -z
+						max_z[c] = -d0;
+					}
+				}
+			}
+		}
+
+		//? View distance where slice z begins, slice grid_z begins at the far plane
+		f32 slice_depth(u32 z) const
+		{
+			return near_plane * powf(far_plane / near_plane, (f32)z / (f32)grid_z);
+		}
+
+		//? Shader side: slice = log(distance) * z_scale + z_bias
+		f32 z_scale() const
+		{
+			return (f32)grid_z / logf(far_plane / near_plane);
+		}
+
+		f32 z_bias() const
+		{
+			return -(f32)grid_z * logf(near_plane) / logf(far_plane / near_plane);
+		}
+
+		//? Where an orbiting light is at time
+		static Vec3 world_pos(const PointLight& light, f32 time)
+		{
+			const f32 angle = light.speed * time;
+			const f32 c = cosf(angle), s = sinf(angle);
+			return { light.pos.x * c + light.pos.z * s, light.pos.y, light.pos.z * c - light.pos.x * s };
+		}
+
+		void bin(const Mat4& view, f32 time, JobSystem& jobs)
+		{
+			PROFILE_SCOPE("bin lights");
+			const auto start = std::chrono::steady_clock::now();
+
+			const u32 count = (u32)lights.size();
+			gpu_lights.resize(count);
+			for (u32 i = 0; i < count; ++i)
+			{
+				const PointLight& light = lights[i];
+				const Vec3 p = world_pos(light, time);
+				const Vec4 v = view * Vec4{ p.x, p.y, p.z, 1.0f };
+				GpuLight& out = gpu_lights[i];
+				out.pos = v.xyz;
+				out.radius = light.radius;
+				out.color = light.color;
+				out.pad = 0.0f;
+			}
+
+			cluster_counts.resize(cluster_count);
+			slice_lists.resize((size_t)cluster_count * max_lights_per_cluster);
+			slice_overflow.assign(grid_z, 0);
+			jobs.parallel_for(grid_z, 1, [this](u32 first, u32 last)
+				{
+					for (u32 z = first; z < last; ++z)
+						bin_slice(z);
+				});
+
+			// compact, clusters keep their order so the shader indexes ranges directly
+			cluster_ranges.resize(cluster_count * 2);
+			light_indices.clear();
+			u32 max_count = 0;
+			for (u32 c = 0; c < cluster_count; ++c)
+			{
+				const u32 n = cluster_counts[c];
+				cluster_ranges[c * 2 + 0] = (u32)light_indices.size();
+				cluster_ranges[c * 2 + 1] = n;
+				const u16* list = &slice_lists[(size_t)c * max_lights_per_cluster];
+				light_indices.insert(light_indices.end(), list, list + n);
+				max_count = max(max_count, n);
+			}
+			// texture buffers can't be empty
+			if (light_indices.empty())
+				light_indices.push_back(0);
+
+			const f64 ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+			++stats.frames;
+			stats.bin_ms += ms;
+			stats.max_bin_ms = max(stats.max_bin_ms, ms);
+			stats.references += light_indices.size();
+			for (u32 overflow : slice_overflow)
+				stats.overflow += overflow;
+			stats.max_per_cluster = max(stats.max_per_cluster, max_count);
+		}
+
+		void print_summary() const
+		{
+			if (!stats.frames)
+				return;
+
+			const f64 n = (f64)stats.frames;
+			printf("lights: %zu in %ux%ux%u clusters, bin avg %.3f ms max %.3f ms, %.1f lights per cluster avg, max %u, %llu overflowed\n",
+				lights.size(), grid_x, grid_y, grid_z, stats.bin_ms / n, stats.max_bin_ms, stats.references / n / cluster_count,
+				stats.max_per_cluster, (unsigned long long)stats.overflow);
+		}
+
+	private:
+		// cluster bounds in view space, structure of arrays in cluster order
+		std::vector<f32> min_x, max_x, min_y, max_y, min_z, max_z;
+		std::vector<f32> slice_near, slice_far; // view distances
+		std::vector<u32> cluster_counts;
+		std::vector<u16> slice_lists; // max_lights_per_cluster slots per cluster
+		std::vector<u32> slice_overflow;
+
+		void bin_slice(u32 z)
+		{
+			const u32 base = z * slice_clusters;
+			u32* counts = &cluster_counts[base];
+			u16* lists = &slice_lists[(size_t)base * max_lights_per_cluster];
+			memset(counts, 0, slice_clusters * sizeof(u32));
+			u32 overflow = 0;
+
+			const f32 d0 = slice_near[z], d1 = slice_far[z];
+			const __m128 zero = _mm_setzero_ps();
+			for (u32 i = 0; i < (u32)gpu_lights.size(); ++i)
+			{
+				const GpuLight& light = gpu_lights[i];
+				if (-light.pos.z + light.radius < d0 || -light.pos.z - light.radius > d1)
+					continue;
+
+				const __m128 cx = _mm_set1_ps(light.pos.x);
+				const __m128 cy = _mm_set1_ps(light.pos.y);
+				const __m128 cz = _mm_set1_ps(light.pos.z);
+				const __m128 r2 = _mm_set1_ps(light.radius * light.radius);
+				for (u32 c = 0; c < slice_clusters; c += 4)
+				{
+					// squared distance from the sphere center to the box, per axis max(min - p, p - max, 0)
+					const u32 at = base + c;
+					const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&min_x[at]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&max_x[at]))), zero);
+					const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&min_y[at]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&max_y[at]))), zero);
+					const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&min_z[at]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&max_z[at]))), zero);
+					const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+					const s32 mask = _mm_movemask_ps(_mm_cmple_ps(d2, r2));
+					if (!mask)
+						continue;
+
+					for (u32 bit = 0; bit < 4; ++bit)
+					{
+						if (!TestBit(mask, bit))
+							continue;
+						u32& n = counts[c + bit];
+						if (n < max_lights_per_cluster)
+							lists[(size_t)(c + bit) * max_lights_per_cluster + n++] = (u16)i;
+						else
+							++overflow;
+					}
+				}
+			}
+			slice_overflow[z] = overflow;
+		}
+	};
+}
@@ -0,0 +1,342 @@
+#pragma once
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+#include <glad/glad.h>
+
+#include "Utils.hpp"
+#include "my_math.h"
+#include "Metrics.hpp"
+
+//? Immediate mode debug drawing: lines, points, boxes, spheres and frusta in world space, from any thread.
+//? Every thread appends to its own arenas, no locks after its first call, and flush() puts all of them in
+//? one stream buffer and draws each primitive type once per depth mode: depth tested into the scene, then
+//? overlay over it. Arenas keep their memory between frames, a frame with as many vertices as the one
+//? before allocates nothing.
+//! flush() reads every arena, all threads must be done appending for the frame when it runs
+
+namespace lib
+{
+	enum class DebugDepth : u32
+	{
+		tested,
+		overlay,
+	};
+
+	struct DebugVertex
+	{
+		Vec3 pos;
+		u32 color; // RGBA8
+	};
+
+	inline constexpr u32 debug_color(u32 r, u32 g, u32 b, u32 a = 255)
+	{
+		return r | (g << 8) | (b << 16) | (a << 24);
+	}
+
+	inline u32 debug_color(Vec3 c, f32 a = 1.0f)
+	{
+		auto byte = [](f32 v) { return (u32)(clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f); };
+		return debug_color(byte(c.x), byte(c.y), byte(c.z), byte(a));
+	}
+
+	struct DebugDrawStats
+	{
+		u64 frames = 0;
+		u64 lines = 0;      // summed over frames
+		u64 points = 0;
+		u64 max_lines = 0;  // in one frame
+		u32 arenas = 0;     // threads that have drawn
+		f64 flush_ms = 0.0; // CPU, summed
+		f64 max_flush_ms = 0.0;
+	};
+
+	struct DebugDraw
+	{
+		static constexpr u32 sphere_segments = 24; // per circle, three circles
+
+		b32 enabled = false;
+		f32 point_size = 5.0f; // pixels
+		DebugDrawStats stats;
+
+		//? program takes DebugVertex at locations 0 and 1 and has uniforms ViewProj (mat4) and PointSize
+		void init(GLuint debug_program)
+		{
+			program = debug_program;
+			view_proj_location = glGetUniformLocation(program, "ViewProj");
+			point_size_location = glGetUniformLocation(program, "PointSize");
+			id = next_id().fetch_add(1, std::memory_order_relaxed) + 1;
+			for (u32 i = 0; i < sphere_segments; ++i)
+			{
+				const f32 angle = 6.28318530718f * (f32)i / (f32)sphere_segments;
+				circle[i] = { cosf(angle), sinf(angle) };
+			}
+
+			glGenVertexArrays(1, &vertex_array);
+			glBindVertexArray(vertex_array);
+			glGenBuffers(1, &vertex_buffer);
+			glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(DebugVertex), (void*)offsetof(DebugVertex, pos));
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(DebugVertex), (void*)offsetof(DebugVertex, color));
+			glBindVertexArray(0);
+		}
+
+		void destroy()
+		{
+			glDeleteBuffers(1, &vertex_buffer);
+			glDeleteVertexArrays(1, &vertex_array);
+			std::lock_guard<std::mutex> lock(mutex);
+			for (Arena* a : arenas)
+				delete a;
+			arenas.clear();
+			id = 0; // threads still pointing at the old arenas register again
+		}
+
+		void line(Vec3 a, Vec3 b, u32 color, DebugDepth depth = DebugDepth::tested)
+		{
+			if (DebugVertex* v = append(List::lines, depth, 2))
+			{
+				v[0] = { a, color };
+				v[1] = { b, color };
+			}
+		}
+
+		void point(Vec3 p, u32 color, DebugDepth depth = DebugDepth::tested)
+		{
+			if (DebugVertex* v = append(List::points, depth, 1))
+				v[0] = { p, color };
+		}
+
+		void aabb(Vec3 bounds_min, Vec3 bounds_max, u32 color, DebugDepth depth = DebugDepth::tested)
+		{
+			Vec3 corners[8];
+			for (u32 i = 0; i < 8; ++i)
+				corners[i] = { i & 1 ? bounds_max.x : bounds_min.x, i & 2 ? bounds_max.y : bounds_min.y, i & 4 ? bounds_max.z : bounds_min.z };
+			box(corners, color, depth);
+		}
+
+		//? Local bounds of an object with world transform, as the box it is in world space
+		void obb(const Mat4& world, Vec3 bounds_min, Vec3 bounds_max, u32 color, DebugDepth depth = DebugDepth::tested)
+		{
+			// one corner through the matrix, the others are edges along its columns away
+			const Vec3 origin = (world * Vec4{ bounds_min.x, bounds_min.y, bounds_min.z, 1.0f }).xyz;
+			const Vec3 edge[3] = { world.vecs[0].xyz * (bounds_max.x - bounds_min.x), world.vecs[1].xyz * (bounds_max.y - bounds_min.y),
+				world.vecs[2].xyz * (bounds_max.z - bounds_min.z) };
+			Vec3 corners[8];
+			corners[0] = origin;
+			for (u32 axis = 0, count = 1; axis < 3; ++axis, count *= 2)
+			{
+				for (u32 i = 0; i < count; ++i)
+					corners[count + i] = corners[i] + edge[axis];
+			}
+			box(corners, color, depth);
+		}
+
+		//? Three great circles
+		void sphere(Vec3 center, f32 radius, u32 color, DebugDepth depth = DebugDepth::tested)
+		{
+			DebugVertex* v = append(List::lines, depth, 3 * 2 * sphere_segments);
+			if (!v)
+				return;
+			for (u32 i = 0; i < sphere_segments; ++i)
+			{
+				const Vec2& a = circle[i];
+				const Vec2& b = circle[(i + 1) % sphere_segments];
+				*v++ = { center + Vec3{ a.x * radius, a.y * radius, 0.0f }, color };
+				*v++ = { center + Vec3{ b.x * radius, b.y * radius, 0.0f }, color };
+				*v++ = { center + Vec3{ a.x * radius, 0.0f, a.y * radius }, color };
+				*v++ = { center + Vec3{ b.x * radius, 0.0f, b.y * radius }, color };
+				*v++ = { center + Vec3{ 0.0f, a.x * radius, a.y * radius }, color };
+				*v++ = { center + Vec3{ 0.0f, b.x * radius, b.y * radius }, color };
+			}
+		}
+
+		//? The volume a camera with view_proj sees, corners from the inverse of it
+		void frustum(const Mat4& view_proj, u32 color, DebugDepth depth = DebugDepth::tested)
+		{
+			const Mat4 to_world = inverse(view_proj);
+			Vec3 corners[8];
+			for (u32 i = 0; i < 8; ++i)
+			{
+				const Vec4 p = to_world * Vec4{ i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f };
+				corners[i] = p.xyz / p.w;
+			}
+			box(corners, color, depth);
+		}
+
+		//? x, y and z of transform in red, green and blue
+		void axes(const Mat4& transform, f32 size, DebugDepth depth = DebugDepth::overlay)
+		{
+			const Vec3 origin = transform.vecs[3].xyz;
+			for (u32 axis = 0; axis < 3; ++axis)
+				line(origin, origin + size * transform.vecs[axis].xyz, debug_color(axis == 0 ? 255 : 0, axis == 1 ? 255 : 0, axis == 2 ? 255 : 0), depth);
+		}
+
+		//? Render thread, with the scene's framebuffer, viewport and depth buffer bound; empties the arenas.
+		//? Leaves depth test on and blending off.
+		void flush(const Mat4& view_proj)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			u32 counts[list_count] = {};
+			std::lock_guard<std::mutex> lock(mutex);
+			u64 total = 0;
+			for (const Arena* a : arenas)
+			{
+				for (u32 l = 0; l < list_count; ++l)
+					counts[l] += a->size[l];
+			}
+			for (u32 l = 0; l < list_count; ++l)
+				total += counts[l];
+			stats.arenas = (u32)arenas.size();
+			if (total)
+			{
+				// lists back to back in the buffer, each arena's run of a list copied as it is
+				glBindVertexArray(vertex_array);
+				glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+				glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(total * sizeof(DebugVertex)), nullptr, GL_STREAM_DRAW);
+				u64 offset = 0;
+				for (u32 l = 0; l < list_count; ++l)
+				{
+					for (Arena* a : arenas)
+					{
+						if (!a->size[l])
+							continue;
+						glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(offset * sizeof(DebugVertex)), (GLsizeiptr)(a->size[l] * sizeof(DebugVertex)),
+							a->vertices[l].data());
+						offset += a->size[l];
+						a->size[l] = 0;
+					}
+				}
+
+				glUseProgram(program);
+				glUniformMatrix4fv(view_proj_location, 1, GL_FALSE, (const GLfloat*)&view_proj);
+				glUniform1f(point_size_location, point_size);
+				glEnable(GL_PROGRAM_POINT_SIZE);
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				GLint first = 0;
+				for (u32 l = 0; l < list_count; ++l)
+				{
+					if (l == list(List::lines, DebugDepth::overlay))
+						glDisable(GL_DEPTH_TEST);
+					if (counts[l])
+						glDrawArrays(l / 2 == (u32)List::lines ? GL_LINES : GL_POINTS, first, (GLsizei)counts[l]);
+					first += (GLint)counts[l];
+				}
+				glEnable(GL_DEPTH_TEST);
+				glDisable(GL_BLEND);
+				glDisable(GL_PROGRAM_POINT_SIZE);
+				glBindVertexArray(0);
+			}
+
+			const u64 lines = (counts[list(List::lines, DebugDepth::tested)] + counts[list(List::lines, DebugDepth::overlay)]) / 2;
+			const f64 ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+			++stats.frames;
+			stats.lines += lines;
+			stats.points += counts[list(List::points, DebugDepth::tested)] + counts[list(List::points, DebugDepth::overlay)];
+			stats.max_lines = max(stats.max_lines, lines);
+			stats.flush_ms += ms;
+			stats.max_flush_ms = max(stats.max_flush_ms, ms);
+		}
+
+		void print_summary() const
+		{
+			if (!stats.frames)
+				return;
+			printf("debug draw: %llu frames, %.0f lines and %.0f points per frame (max %llu lines), %u thread arenas, flush %.3f ms avg, %.3f ms max\n",
+				(unsigned long long)stats.frames, (f64)stats.lines / stats.frames, (f64)stats.points / stats.frames,
+				(unsigned long long)stats.max_lines, stats.arenas, stats.flush_ms / stats.frames, stats.max_flush_ms);
+		}
+
+	private:
+		// draw order: everything depth tested, then the overlay
+		enum class List : u32
+		{
+			lines,
+			points,
+		};
+		static constexpr u32 list_count = 4;
+
+		static constexpr u32 list(List primitive, DebugDepth depth)
+		{
+			return (u32)depth * 2 + (u32)primitive;
+		}
+
+		struct Arena
+		{
+			std::vector<DebugVertex> vertices[list_count]; // capacity, only grows
+			u32 size[list_count] = {};
+		};
+
+		struct Local
+		{
+			u32 owner; // id of the DebugDraw the arena belongs to
+			Arena* arena;
+		};
+
+		GLuint program = 0;
+		GLuint vertex_array = 0;
+		GLuint vertex_buffer = 0;
+		GLint view_proj_location = -1;
+		GLint point_size_location = -1;
+		u32 id = 0;
+		Vec2 circle[sphere_segments];
+		std::mutex mutex;            // arenas, taken by a thread's first call and by flush()
+		std::vector<Arena*> arenas;
+
+		static std::atomic<u32>& next_id()
+		{
+			static std::atomic<u32> ids{ 0 };
+			return ids;
+		}
+
+		static Local& local()
+		{
+			thread_local Local l = { 0, nullptr };
+			return l;
+		}
+
+		//? Room for count vertices in this thread's arena, null while disabled
+		DebugVertex* append(List primitive, DebugDepth depth, u32 count)
+		{
+			if (!enabled || !id)
+				return nullptr;
+			Local& l = local();
+			if (l.owner != id)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				l.arena = arenas.emplace_back(new Arena);
+				l.owner = id;
+			}
+			const u32 index = list(primitive, depth);
+			Arena& a = *l.arena;
+			std::vector<DebugVertex>& v = a.vertices[index];
+			if (a.size[index] + count > v.size())
+				v.resize(max<size_t>(v.size() * 2, max<size_t>(a.size[index] + count, 4096)));
+			DebugVertex* out = v.data() + a.size[index];
+			a.size[index] += count;
+			return out;
+		}
+
+		void box(const Vec3 corners[8], u32 color, DebugDepth depth)
+		{
+			// corner bits are x, y, z; an edge joins corners one bit apart
+			static constexpr u8 edges[12][2] = { { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 }, { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },
+				{ 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 } };
+			DebugVertex* v = append(List::lines, depth, 24);
+			if (!v)
+				return;
+			for (const auto& e : edges)
+			{
+				*v++ = { corners[e[0]], color };
+				*v++ = { corners[e[1]], color };
+			}
+		}
+	};
+}
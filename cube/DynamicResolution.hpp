@@ -0,0 +1,211 @@
+#pragma once
+#include <stdio.h>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Utils.hpp"
+#include "my_math.h"
+#include "GpuTimer.hpp"
+#include "GpuMemory.hpp"
+
+namespace lib
+{
+	struct DynResSample
+	{
+		u32 frame;
+		f32 scale;
+		f32 gpu_ms;
+	};
+
+	//? Scene is rendered into an offscreen target at `scale` of the window framebuffer and then upscaled with
+	//? a linear blit. Target is allocated once at max_scale and only the viewport shrinks, so changing scale
+	//? never reallocates anything. Scale is driven by measured GPU time against target_ms.
+	struct DynamicResolution
+	{
+		f32 target_ms = 16.0f;
+		f32 min_scale = 0.5f;
+		f32 max_scale = 1.0f;
+		f32 scale = 1.0f;
+		b32 enabled = true;
+
+		//? Controller tuning, pixel cost grows with scale^2 so we step by sqrt of the time ratio
+		f32 smoothing = 0.1f;       // EMA factor applied to GPU time
+		f32 headroom = 0.9f;        // aim a bit below the budget so spikes don't immediately miss it
+		f32 step_quantum = 1.0f / 64.0f;
+		u32 cooldown_frames = 8;    // frames between scale changes, gives timer latency time to settle
+
+		GLuint fbo = 0;
+		GLuint color = 0;
+		GLuint depth = 0;
+		s32 alloc_width = 0;
+		s32 alloc_height = 0;
+		s32 render_width = 0;
+		s32 render_height = 0;
+
+		GpuTimer timer;
+		f32 smoothed_ms = 0.0f;
+		u32 frame = 0;
+		u32 last_change = 0;
+		std::vector<DynResSample> log;
+
+		void init()
+		{
+			glGenFramebuffers(1, &fbo);
+			timer.init();
+		}
+
+		void destroy()
+		{
+			timer.flush();
+			timer.destroy();
+			glDeleteTextures(1, &color);
+			glDeleteRenderbuffers(1, &depth);
+			glDeleteFramebuffers(1, &fbo);
+		}
+
+		//? Call at frame start, binds offscreen target (or default framebuffer when disabled) and sets viewport
+		void begin_frame(s32 width, s32 height)
+		{
+			timer.begin();
+
+			if (!enabled)
+			{
+				render_width = width;
+				render_height = height;
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+				glViewport(0, 0, width, height);
+				glScissor(0, 0, width, height);
+				return;
+			}
+
+			//? A minimized window reports 0x0, keep the old target instead of building an incomplete FBO
+			const s32 wanted_width = max(1, (s32)(width * max_scale));
+			const s32 wanted_height = max(1, (s32)(height * max_scale));
+			const b32 minimized = width <= 0 || height <= 0;
+			if ((!minimized || alloc_width == 0) && (wanted_width != alloc_width || wanted_height != alloc_height))
+				allocate(wanted_width, wanted_height);
+
+			render_width = max(1, (s32)(width * scale));
+			render_height = max(1, (s32)(height * scale));
+
+			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+			glViewport(0, 0, render_width, render_height);
+			glScissor(0, 0, render_width, render_height);
+		}
+
+		//? Clears only the region used this frame
+		void clear(GLbitfield mask)
+		{
+			glEnable(GL_SCISSOR_TEST);
+			glClear(mask);
+			glDisable(GL_SCISSOR_TEST);
+		}
+
+		//? Upscales to the default framebuffer and feeds the controller with the latest resolved GPU time
+		void end_frame(s32 width, s32 height)
+		{
+			if (enabled)
+			{
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+				glBlitFramebuffer(0, 0, render_width, render_height, 0, 0, width, height,
+					GL_COLOR_BUFFER_BIT, GL_LINEAR);
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			}
+
+			timer.end();
+			update_controller();
+			++frame;
+		}
+
+		void write_log(const char* path) const
+		{
+			FILE* file = fopen(path, "w");
+			if (!file)
+				return;
+
+			fprintf(file, "frame,scale,gpu_ms\n");
+			for (const DynResSample& s : log)
+				fprintf(file, "%u,%.4f,%.4f\n", s.frame, s.scale, s.gpu_ms);
+			fclose(file);
+		}
+
+		void print_summary() const
+		{
+			if (log.empty())
+				return;
+
+			f64 scale_sum = 0.0, ms_sum = 0.0;
+			f32 scale_lo = max_scale, scale_hi = min_scale, ms_hi = 0.0f;
+			for (const DynResSample& s : log)
+			{
+				scale_sum += s.scale;
+				ms_sum += s.gpu_ms;
+				scale_lo = min(scale_lo, s.scale);
+				scale_hi = max(scale_hi, s.scale);
+				ms_hi = max(ms_hi, s.gpu_ms);
+			}
+
+			const f64 count = (f64)log.size();
+			printf("dynres: %zu frames, target %.2f ms, scale avg %.3f [%.3f, %.3f], gpu avg %.3f ms max %.3f ms\n",
+				log.size(), target_ms, scale_sum / count, scale_lo, scale_hi, ms_sum / count, ms_hi);
+		}
+
+	private:
+		void allocate(s32 width, s32 height)
+		{
+			GpuCategoryScope scope(GpuCategory::render_target);
+			glDeleteTextures(1, &color);
+			glDeleteRenderbuffers(1, &depth);
+
+			glGenTextures(1, &color);
+			glBindTexture(GL_TEXTURE_2D, color);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+			glBindTexture(GL_TEXTURE_2D, 0);
+
+			glGenRenderbuffers(1, &depth);
+			glBindRenderbuffer(GL_RENDERBUFFER, depth);
+			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+			glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+			SoftAssert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+			alloc_width = width;
+			alloc_height = height;
+		}
+
+		void update_controller()
+		{
+			const f32 ms = timer.last_ms;
+			if (ms <= 0.0f) // timer ring not filled yet
+				return;
+
+			smoothed_ms = smoothed_ms == 0.0f ? ms : lerp(smoothed_ms, ms, smoothing);
+			log.push_back({ frame, enabled ? scale : 1.0f, ms });
+
+			if (!enabled || frame - last_change < cooldown_frames)
+				return;
+
+			const f32 goal = target_ms * headroom;
+			f32 wanted = scale * sqrt(goal / smoothed_ms);
+			wanted = clamp(wanted, min_scale, max_scale);
+			wanted = (f32)round(wanted / step_quantum) * step_quantum;
+
+			//? Hysteresis: grow only when comfortably under budget, shrink as soon as we are over it
+			const b32 over = smoothed_ms > target_ms;
+			const b32 under = smoothed_ms < goal * 0.9f;
+			if ((over && wanted < scale) || (under && wanted > scale))
+			{
+				scale = wanted;
+				last_change = frame;
+			}
+		}
+	};
+}
@@ -0,0 +1,336 @@
+#pragma once
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <chrono>
+
+#include <glad/glad.h>
+
+#include "Utils.hpp"
+
+namespace lib
+{
+	//? Pixels are RGBA8, bottom-up rows as returned by glReadPixels. Only valid inside the sink call.
+	struct CapturedFrame
+	{
+		u32 index;
+		s32 width;
+		s32 height;
+		const u8* pixels;
+	};
+
+	using CaptureSink = std::function<void(const CapturedFrame&)>;
+
+	enum class CaptureMode : u32
+	{
+		off,
+		async, // readback into PBO ring, mapped a few frames later, sink runs on worker
+		sync,  // glReadPixels to client memory, baseline for measuring overhead
+		count
+	};
+
+	inline const char* capture_mode_name(CaptureMode mode)
+	{
+		constexpr const char* names[] = { "off", "async", "sync" };
+		return names[(u32)mode];
+	}
+
+	struct CaptureStats
+	{
+		u64 frames = 0;
+		u64 dropped = 0;
+		f64 render_thread_ms = 0.0; // time spent inside capture() on the render thread
+		f64 max_ms = 0.0;
+	};
+
+	struct FrameCapture
+	{
+		static constexpr u32 ring_size = 4;
+
+		enum class SlotState : u32 { free, reading, mapped };
+
+		struct Slot
+		{
+			GLuint pbo;
+			GLsync fence;
+			SlotState state;
+			std::atomic<b32> done; // set by worker when it's finished with mapped memory
+			const u8* mapped;
+			u32 index;
+			s32 width;
+			s32 height;
+			size_t capacity;
+		};
+
+		CaptureMode mode = CaptureMode::off;
+		CaptureStats stats[(u32)CaptureMode::count];
+
+		Slot slots[ring_size];
+		u32 next_slot = 0;
+		u32 frame = 0;
+
+		CaptureSink sink;
+
+		struct SyncFrame
+		{
+			CapturedFrame header;
+			std::vector<u8> pixels;
+		};
+
+		std::thread worker;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::deque<u32> queue; // slot indices, or sync_item for frames waiting in sync_frames
+		std::deque<SyncFrame> sync_frames;
+		static constexpr u32 sync_item = ~0u;
+		static constexpr u32 max_sync_frames = ring_size; // queued for the worker, more are dropped
+		b32 quit = false;
+
+		void init(CaptureSink capture_sink)
+		{
+			sink = static_cast<CaptureSink&&>(capture_sink);
+			for (Slot& slot : slots)
+			{
+				glGenBuffers(1, &slot.pbo);
+				slot.fence = 0;
+				slot.mapped = nullptr;
+				slot.state = SlotState::free;
+				slot.done = false;
+				slot.capacity = 0;
+			}
+			quit = false;
+			worker = std::thread([this] { worker_loop(); });
+		}
+
+		void destroy()
+		{
+			// drain everything already read back, then stop the worker
+			for (Slot& slot : slots)
+			{
+				if (slot.state == SlotState::reading)
+				{
+					glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+					hand_to_worker(slot);
+				}
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				quit = true;
+			}
+			wake.notify_one();
+			worker.join();
+
+			for (Slot& slot : slots)
+			{
+				if (slot.state == SlotState::mapped)
+				{
+					glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+					glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+				}
+				glDeleteBuffers(1, &slot.pbo);
+			}
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		}
+
+		void cycle_mode()
+		{
+			mode = (CaptureMode)(((u32)mode + 1) % (u32)CaptureMode::count);
+			printf("capture: %s\n", capture_mode_name(mode));
+		}
+
+		//? Call after the frame is finished in the default framebuffer, before swap
+		void capture(s32 width, s32 height)
+		{
+			PROFILE_SCOPE("capture");
+			const auto start = std::chrono::steady_clock::now();
+
+			if (mode == CaptureMode::async)
+			{
+				capture_async(width, height);
+			}
+			else if (mode == CaptureMode::sync)
+			{
+				capture_sync(width, height);
+			}
+			else
+			{
+				// still retire slots left over from a previous async run
+				retire_slots();
+				return;
+			}
+
+			const f64 ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+			CaptureStats& s = stats[(u32)mode];
+			s.render_thread_ms += ms;
+			s.max_ms = ms > s.max_ms ? ms : s.max_ms;
+			++frame;
+		}
+
+		void print_stats() const
+		{
+			for (u32 i = 1; i < (u32)CaptureMode::count; ++i)
+			{
+				const CaptureStats& s = stats[i];
+				if (!s.frames && !s.dropped)
+					continue;
+
+				printf("capture %-5s: %llu frames, %llu dropped, render thread avg %.3f ms max %.3f ms\n",
+					capture_mode_name((CaptureMode)i), (unsigned long long)s.frames, (unsigned long long)s.dropped,
+					s.frames ? s.render_thread_ms / (f64)s.frames : 0.0, s.max_ms);
+			}
+		}
+
+	private:
+		void capture_async(s32 width, s32 height)
+		{
+			retire_slots();
+
+			Slot& slot = slots[next_slot];
+			if (slot.state != SlotState::free)
+			{
+				// worker or GPU is more than ring_size frames behind, skipping beats stalling the frame
+				++stats[(u32)CaptureMode::async].dropped;
+				return;
+			}
+
+			const size_t size = (size_t)width * height * 4;
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+			if (slot.capacity != size)
+			{
+				glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+				slot.capacity = size;
+			}
+
+			glReadBuffer(GL_BACK);
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+			slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			slot.state = SlotState::reading;
+			slot.index = frame;
+			slot.width = width;
+			slot.height = height;
+			next_slot = (next_slot + 1) % ring_size;
+			++stats[(u32)CaptureMode::async].frames;
+		}
+
+		void capture_sync(s32 width, s32 height)
+		{
+			retire_slots();
+
+			{
+				// a slow sink would otherwise have the queue hold every frame since it fell behind
+				std::lock_guard<std::mutex> lock(mutex);
+				if (sync_frames.size() >= max_sync_frames)
+				{
+					++stats[(u32)CaptureMode::sync].dropped;
+					return;
+				}
+			}
+
+			SyncFrame sync{ { frame, width, height, nullptr }, {} };
+			sync.pixels.resize((size_t)width * height * 4);
+			glReadBuffer(GL_BACK);
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, sync.pixels.data());
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				sync_frames.push_back(static_cast<SyncFrame&&>(sync));
+				queue.push_back(sync_item);
+			}
+			wake.notify_one();
+			++stats[(u32)CaptureMode::sync].frames;
+		}
+
+		//? Maps slots whose fence signaled and unmaps slots the worker is finished with, never waits
+		void retire_slots()
+		{
+			for (Slot& slot : slots)
+			{
+				if (slot.state == SlotState::mapped && slot.done.load(std::memory_order_acquire))
+				{
+					glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+					glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+					glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+					slot.state = SlotState::free;
+				}
+				else if (slot.state == SlotState::reading)
+				{
+					const GLenum status = glClientWaitSync(slot.fence, 0, 0);
+					if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+						hand_to_worker(slot);
+				}
+			}
+		}
+
+		void hand_to_worker(Slot& slot)
+		{
+			glDeleteSync(slot.fence);
+			slot.fence = 0;
+
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+			void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.capacity, GL_MAP_READ_BIT);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+			if (!mapped)
+			{
+				slot.state = SlotState::free;
+				return;
+			}
+
+			slot.mapped = (const u8*)mapped;
+			slot.state = SlotState::mapped;
+			slot.done.store(false, std::memory_order_relaxed);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				queue.push_back((u32)(&slot - slots));
+			}
+			wake.notify_one();
+		}
+
+		void worker_loop()
+		{
+			for (;;)
+			{
+				u32 item = 0;
+				SyncFrame sync{};
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					wake.wait(lock, [this] { return quit || !queue.empty(); });
+					if (queue.empty())
+						return;
+
+					item = queue.front();
+					queue.pop_front();
+					if (item == sync_item)
+					{
+						sync = static_cast<SyncFrame&&>(sync_frames.front());
+						sync_frames.pop_front();
+					}
+				}
+
+				if (item == sync_item)
+				{
+					sync.header.pixels = sync.pixels.data();
+					if (sink)
+						sink(sync.header);
+					continue;
+				}
+
+				// mapped pointer stays valid until done is set, only the render thread touches GL
+				Slot& slot = slots[item];
+				if (sink)
+					sink({ slot.index, slot.width, slot.height, slot.mapped });
+				slot.done.store(true, std::memory_order_release);
+			}
+		}
+	};
+}
@@ -0,0 +1,374 @@
+#pragma once
+#include <tuple>
+#include <atomic>
+#include <unordered_map>
+#include <type_traits>
+
+#include <glad/glad.h>
+
+#include "Utils.hpp"
+#include "Metrics.hpp"
+#include "GpuMemory.hpp"
+
+//? Counting layer between the renderer and GL. install_counters() wraps the loaded driver functions,
+//? install_mock() wraps stubs that do nothing, so CPU-side cost of the render loop can be measured on any
+//? machine without a context (build with CUBE_MOCK_GL). Both fill lib::metrics the same way, and report
+//? allocations to lib::gpu_memory.
+//? Functions not listed here are neither counted nor mocked, in mock mode they stay null.
+
+#define GLBACKEND_FUNCTIONS(X) \
+	X(Enable, state) X(Disable, state) X(FrontFace, state) X(CullFace, state) X(Viewport, state) X(Scissor, state) X(BlendFunc, state) \
+	X(DepthFunc, state) X(DepthMask, state) X(ColorMask, state) \
+	X(Clear, other) X(GetIntegerv, other) X(GetString, other) X(GetStringi, other) \
+	X(GenBuffers, other) X(DeleteBuffers, other) X(BindBuffer, state) X(BindBufferBase, state) \
+	X(BufferData, upload) X(BufferSubData, upload) X(MapBufferRange, other) X(UnmapBuffer, other) \
+	X(CreateShader, other) X(DeleteShader, other) X(ShaderSource, other) X(CompileShader, other) \
+	X(CreateProgram, other) X(DeleteProgram, other) X(AttachShader, other) X(LinkProgram, other) X(UseProgram, state) \
+	X(GetUniformLocation, other) X(GetAttribLocation, other) X(GetUniformBlockIndex, other) X(UniformBlockBinding, state) \
+	X(UniformMatrix4fv, uniform) X(Uniform1f, uniform) X(Uniform1i, uniform) X(Uniform4fv, uniform) \
+	X(GenVertexArrays, other) X(DeleteVertexArrays, other) X(BindVertexArray, state) \
+	X(EnableVertexAttribArray, state) X(VertexAttribPointer, state) X(VertexAttribDivisor, state) \
+	X(DrawArrays, draw) X(DrawElements, draw) X(DrawElementsBaseVertex, draw) X(DrawElementsInstancedBaseVertex, draw) \
+	X(GenFramebuffers, other) X(DeleteFramebuffers, other) X(BindFramebuffer, state) X(BlitFramebuffer, other) \
+	X(FramebufferTexture2D, state) X(FramebufferRenderbuffer, state) X(CheckFramebufferStatus, other) \
+	X(GenTextures, other) X(DeleteTextures, other) X(BindTexture, state) X(TexImage2D, upload) X(TexParameteri, state) \
+	X(ActiveTexture, state) X(TexBuffer, state) X(TexStorage2D, other) X(TexSubImage2D, upload) \
+	X(CompressedTexImage2D, upload) X(CompressedTexSubImage2D, upload) \
+	X(GenRenderbuffers, other) X(DeleteRenderbuffers, other) X(BindRenderbuffer, state) X(RenderbufferStorage, other) \
+	X(GenQueries, other) X(DeleteQueries, other) X(QueryCounter, other) X(GetQueryObjectui64v, other) \
+	X(ReadBuffer, state) X(PixelStorei, state) X(ReadPixels, readback) \
+	X(FenceSync, other) X(ClientWaitSync, other) X(DeleteSync, other) X(Flush, other) \
+	X(CopyBufferSubData, other)
+
+namespace lib::glbackend
+{
+	enum class CallKind : u32
+	{
+		other,
+		state,
+		uniform,
+		upload,
+		draw,
+		readback,
+	};
+
+	inline size_t image_bytes(GLsizei width, GLsizei height, GLenum format, GLenum type)
+	{
+		const u32 components = format == GL_RED ? 1 : format == GL_RG ? 2 : format == GL_RGB ? 3 : 4;
+		const u32 size = type == GL_FLOAT ? 4 : type == GL_HALF_FLOAT ? 2 : 1;
+		return (size_t)width * height * components * size;
+	}
+
+	constexpr b32 is_slot(const void* a, const void* b)
+	{
+		return a == b;
+	}
+
+	//? With a pixel unpack buffer bound, texture uploads read from it and their pointer is an offset; the
+	//? bytes were already counted when the buffer was filled. Binding state is per context, so per thread.
+	inline thread_local b32 unpack_buffer_bound = false;
+
+	//? lib::metrics belongs to the render thread; threads with their own context (GlUploader) turn this off
+	//? and their calls go straight through, but for memory tracking
+	inline thread_local b32 counting = true;
+
+	//? What is bound where, so an allocation call can be pinned on an object without asking GL. Per context,
+	//? so per thread. The element buffer binding is vertex array state, it is remembered per vertex array.
+	struct Bindings
+	{
+		GLuint buffers[8];   // buffer_slot()
+		GLuint textures[32]; // GL_TEXTURE_2D per unit
+		u32 unit;
+		GLuint renderbuffer;
+		GLuint vertex_array;
+		std::unordered_map<GLuint, GLuint> element_buffers;
+	};
+
+	inline thread_local Bindings bindings{};
+
+	inline s32 buffer_slot(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_ARRAY_BUFFER: return 0;
+		case GL_ELEMENT_ARRAY_BUFFER: return 1;
+		case GL_UNIFORM_BUFFER: return 2;
+		case GL_TEXTURE_BUFFER: return 3;
+		case GL_COPY_READ_BUFFER: return 4;
+		case GL_COPY_WRITE_BUFFER: return 5;
+		case GL_PIXEL_PACK_BUFFER: return 6;
+		case GL_PIXEL_UNPACK_BUFFER: return 7;
+		default: return -1;
+		}
+	}
+
+	template <auto* Slot, CallKind Kind, typename F = std::remove_pointer_t<decltype(Slot)>>
+	struct Hook;
+
+	template <auto* Slot, CallKind Kind, typename R, typename... Args>
+	struct Hook<Slot, Kind, R(APIENTRY*)(Args...)>
+	{
+		static inline R(APIENTRY* next)(Args...) = nullptr;
+
+		static R APIENTRY call(Args... args)
+		{
+			if constexpr (tracks_memory())
+				track_memory(std::forward_as_tuple(args...));
+			if (!counting)
+				return next(args...);
+
+			FrameMetrics& m = metrics.current;
+			++m.gl_calls;
+
+			if constexpr (Kind == CallKind::state)
+				++m.state_changes;
+			if constexpr (is_slot(Slot, &glad_glBindBuffer))
+			{
+				if (std::get<0>(std::forward_as_tuple(args...)) == GL_PIXEL_UNPACK_BUFFER)
+					unpack_buffer_bound = std::get<1>(std::forward_as_tuple(args...)) != 0;
+			}
+			if constexpr (Kind == CallKind::uniform)
+				++m.uniform_updates;
+			if constexpr (Kind == CallKind::upload || Kind == CallKind::draw || Kind == CallKind::readback)
+				count_payload(m, std::forward_as_tuple(args...));
+
+			return next(args...);
+		}
+
+	private:
+		static constexpr b32 tracks_memory()
+		{
+			return is_slot(Slot, &glad_glBindBuffer) || is_slot(Slot, &glad_glBindVertexArray) || is_slot(Slot, &glad_glActiveTexture) ||
+				is_slot(Slot, &glad_glBindTexture) || is_slot(Slot, &glad_glBindRenderbuffer) || is_slot(Slot, &glad_glBufferData) ||
+				is_slot(Slot, &glad_glTexImage2D) || is_slot(Slot, &glad_glTexStorage2D) || is_slot(Slot, &glad_glCompressedTexImage2D) ||
+				is_slot(Slot, &glad_glRenderbufferStorage) || is_slot(Slot, &glad_glDeleteBuffers) || is_slot(Slot, &glad_glDeleteTextures) ||
+				is_slot(Slot, &glad_glDeleteRenderbuffers);
+		}
+
+		template <typename Tuple>
+		static void track_memory(const Tuple& a)
+		{
+			using Object = GpuMemoryTracker::Kind;
+			Bindings& b = bindings;
+			if constexpr (is_slot(Slot, &glad_glBindBuffer))
+			{
+				const s32 slot = buffer_slot(std::get<0>(a));
+				if (slot >= 0)
+					b.buffers[slot] = std::get<1>(a);
+				if (std::get<0>(a) == GL_ELEMENT_ARRAY_BUFFER)
+					b.element_buffers[b.vertex_array] = std::get<1>(a);
+			}
+			else if constexpr (is_slot(Slot, &glad_glBindVertexArray))
+			{
+				b.vertex_array = std::get<0>(a);
+				auto it = b.element_buffers.find(b.vertex_array);
+				b.buffers[1] = it != b.element_buffers.end() ? it->second : 0;
+			}
+			else if constexpr (is_slot(Slot, &glad_glActiveTexture))
+			{
+				b.unit = min<u32>(std::get<0>(a) - GL_TEXTURE0, 31);
+			}
+			else if constexpr (is_slot(Slot, &glad_glBindTexture))
+			{
+				if (std::get<0>(a) == GL_TEXTURE_2D)
+					b.textures[b.unit] = std::get<1>(a);
+			}
+			else if constexpr (is_slot(Slot, &glad_glBindRenderbuffer))
+			{
+				b.renderbuffer = std::get<1>(a);
+			}
+			else if constexpr (is_slot(Slot, &glad_glBufferData))
+			{
+				const s32 slot = buffer_slot(std::get<0>(a));
+				if (slot >= 0)
+					gpu_memory.set(Object::buffer, b.buffers[slot], gpu_buffer_category(std::get<0>(a)), (u64)std::get<1>(a));
+			}
+			else if constexpr (is_slot(Slot, &glad_glTexImage2D))
+			{
+				if (std::get<0>(a) == GL_TEXTURE_2D)
+					gpu_memory.set_level(b.textures[b.unit], (u32)std::get<1>(a), gpu_texture_category(GpuCategory::texture),
+						gpu_texture_bytes((GLenum)std::get<2>(a), std::get<3>(a), std::get<4>(a)));
+			}
+			else if constexpr (is_slot(Slot, &glad_glTexStorage2D))
+			{
+				if (std::get<0>(a) != GL_TEXTURE_2D)
+					return;
+				s32 w = std::get<3>(a), h = std::get<4>(a);
+				for (GLsizei level = 0; level < std::get<1>(a); ++level)
+				{
+					gpu_memory.set_level(b.textures[b.unit], (u32)level, gpu_texture_category(GpuCategory::texture),
+						gpu_texture_bytes(std::get<2>(a), w, h));
+					w = max(w / 2, 1);
+					h = max(h / 2, 1);
+				}
+			}
+			else if constexpr (is_slot(Slot, &glad_glCompressedTexImage2D))
+			{
+				if (std::get<0>(a) == GL_TEXTURE_2D)
+					gpu_memory.set_level(b.textures[b.unit], (u32)std::get<1>(a), gpu_texture_category(GpuCategory::texture),
+						(u64)std::get<6>(a));
+			}
+			else if constexpr (is_slot(Slot, &glad_glRenderbufferStorage))
+			{
+				gpu_memory.set(Object::renderbuffer, b.renderbuffer, gpu_texture_category(GpuCategory::render_target),
+					gpu_texture_bytes(std::get<1>(a), std::get<2>(a), std::get<3>(a)));
+			}
+			else if constexpr (is_slot(Slot, &glad_glDeleteBuffers) || is_slot(Slot, &glad_glDeleteTextures) ||
+				is_slot(Slot, &glad_glDeleteRenderbuffers))
+			{
+				const Object kind = is_slot(Slot, &glad_glDeleteBuffers) ? Object::buffer : is_slot(Slot, &glad_glDeleteTextures) ? Object::texture : Object::renderbuffer;
+				for (GLsizei i = 0; i < std::get<0>(a); ++i)
+					gpu_memory.release(kind, std::get<1>(a)[i]);
+			}
+		}
+
+		template <typename Tuple>
+		static void count_payload(FrameMetrics& m, const Tuple& a)
+		{
+			if constexpr (is_slot(Slot, &glad_glBufferData))
+			{
+				if (std::get<2>(a))
+					m.bytes_uploaded += (u64)std::get<1>(a);
+			}
+			else if constexpr (is_slot(Slot, &glad_glBufferSubData))
+			{
+				m.bytes_uploaded += (u64)std::get<2>(a);
+			}
+			else if constexpr (is_slot(Slot, &glad_glTexImage2D))
+			{
+				if (std::get<8>(a) && !unpack_buffer_bound)
+					m.bytes_uploaded += image_bytes(std::get<3>(a), std::get<4>(a), std::get<6>(a), std::get<7>(a));
+			}
+			else if constexpr (is_slot(Slot, &glad_glTexSubImage2D))
+			{
+				if (std::get<8>(a) && !unpack_buffer_bound)
+					m.bytes_uploaded += image_bytes(std::get<4>(a), std::get<5>(a), std::get<6>(a), std::get<7>(a));
+			}
+			else if constexpr (is_slot(Slot, &glad_glCompressedTexImage2D))
+			{
+				if (std::get<7>(a) && !unpack_buffer_bound)
+					m.bytes_uploaded += (u64)std::get<6>(a);
+			}
+			else if constexpr (is_slot(Slot, &glad_glCompressedTexSubImage2D))
+			{
+				if (std::get<8>(a) && !unpack_buffer_bound)
+					m.bytes_uploaded += (u64)std::get<7>(a);
+			}
+			else if constexpr (is_slot(Slot, &glad_glDrawArrays))
+			{
+				++m.draw_calls;
+				if (std::get<0>(a) == GL_TRIANGLES)
+					m.triangles += (u64)std::get<2>(a) / 3;
+			}
+			else if constexpr (is_slot(Slot, &glad_glDrawElements) || is_slot(Slot, &glad_glDrawElementsBaseVertex))
+			{
+				++m.draw_calls;
+				m.triangles += (u64)std::get<1>(a) / 3;
+			}
+			else if constexpr (is_slot(Slot, &glad_glDrawElementsInstancedBaseVertex))
+			{
+				++m.draw_calls;
+				m.triangles += (u64)std::get<1>(a) / 3 * (u64)std::get<4>(a);
+			}
+			else if constexpr (is_slot(Slot, &glad_glReadPixels))
+			{
+				m.bytes_read += image_bytes(std::get<2>(a), std::get<3>(a), std::get<4>(a), std::get<5>(a));
+			}
+		}
+	};
+
+	template <typename F>
+	struct MockStub;
+
+	//? Default mock does nothing and returns zero
+	template <typename R, typename... Args>
+	struct MockStub<R(APIENTRY*)(Args...)>
+	{
+		static R APIENTRY call(Args...)
+		{
+			if constexpr (!std::is_void_v<R>)
+				return R{};
+		}
+	};
+
+	inline std::atomic<GLuint> mock_next_name{ 1 }; // names are made on upload threads too
+	inline u8 mock_map_scratch[16];
+
+	static void APIENTRY mock_gen(GLsizei n, GLuint* names)
+	{
+		for (GLsizei i = 0; i < n; ++i)
+			names[i] = mock_next_name.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	static GLuint APIENTRY mock_create_shader(GLenum) { return mock_next_name.fetch_add(1, std::memory_order_relaxed); }
+	static GLuint APIENTRY mock_create_program() { return mock_next_name.fetch_add(1, std::memory_order_relaxed); }
+	static GLenum APIENTRY mock_check_framebuffer(GLenum) { return GL_FRAMEBUFFER_COMPLETE; }
+	static GLenum APIENTRY mock_client_wait(GLsync, GLbitfield, GLuint64) { return GL_ALREADY_SIGNALED; }
+	static GLsync APIENTRY mock_fence(GLenum, GLbitfield) { return (GLsync)&mock_next_name; }
+	static const GLubyte* APIENTRY mock_get_string(GLenum) { return (const GLubyte*)"mock"; }
+
+	static void APIENTRY mock_get_integer(GLenum pname, GLint* data)
+	{
+		*data = pname == GL_UNPACK_ALIGNMENT || pname == GL_PACK_ALIGNMENT ? 4 : 0;
+	}
+
+	//? Stable small location per name so uniforms set by name keep hitting the same slot
+	static GLint APIENTRY mock_location(GLuint, const GLchar* name)
+	{
+		u32 hash = 2166136261u;
+		for (const GLchar* c = name; *c; ++c)
+			hash = (hash ^ (u8)*c) * 16777619u;
+		return (GLint)(hash % 16);
+	}
+
+	static GLuint APIENTRY mock_block_index(GLuint program, const GLchar* name)
+	{
+		return (GLuint)mock_location(program, name);
+	}
+
+	//? Nobody reads mapped readback memory in mock runs, capture is off, but don't hand out null either
+	static void* APIENTRY mock_map(GLenum, GLintptr, GLsizeiptr, GLbitfield) { return mock_map_scratch; }
+	static GLboolean APIENTRY mock_unmap(GLenum) { return GL_TRUE; }
+
+	inline b32 counters_installed = false;
+
+	//? Call right after gladLoadGLLoader, wraps the driver functions with counters
+	inline void install_counters()
+	{
+#define GLBACKEND_INSTALL(name, kind) \
+		Hook<&glad_gl##name, CallKind::kind>::next = glad_gl##name; \
+		glad_gl##name = Hook<&glad_gl##name, CallKind::kind>::call;
+		GLBACKEND_FUNCTIONS(GLBACKEND_INSTALL)
+#undef GLBACKEND_INSTALL
+		counters_installed = true;
+	}
+
+	//? Replaces GL loading entirely, counters wrap stubs instead of the driver
+	inline void install_mock()
+	{
+#define GLBACKEND_MOCK(name, kind) glad_gl##name = MockStub<decltype(glad_gl##name)>::call;
+		GLBACKEND_FUNCTIONS(GLBACKEND_MOCK)
+#undef GLBACKEND_MOCK
+
+		glad_glGenBuffers = mock_gen;
+		glad_glGenVertexArrays = mock_gen;
+		glad_glGenFramebuffers = mock_gen;
+		glad_glGenTextures = mock_gen;
+		glad_glGenRenderbuffers = mock_gen;
+		glad_glGenQueries = mock_gen;
+		glad_glCreateShader = mock_create_shader;
+		glad_glCreateProgram = mock_create_program;
+		glad_glCheckFramebufferStatus = mock_check_framebuffer;
+		glad_glClientWaitSync = mock_client_wait;
+		glad_glFenceSync = mock_fence;
+		glad_glGetString = mock_get_string;
+		glad_glGetIntegerv = mock_get_integer;
+		glad_glGetUniformLocation = mock_location;
+		glad_glGetAttribLocation = mock_location;
+		glad_glGetUniformBlockIndex = mock_block_index;
+		glad_glMapBufferRange = mock_map;
+		glad_glUnmapBuffer = mock_unmap;
+
+		install_counters();
+	}
+}
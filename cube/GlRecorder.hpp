@@ -0,0 +1,1160 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+#include <glad/glad.h>
+
+#include "Utils.hpp"
+
+//? Records GL calls by swapping glad's function pointers for wrappers that serialize the call (with any
+//? client memory it reads) and forward to the driver. Only functions listed in GLREC_FUNCTIONS are
+//? recorded, anything else goes straight to the driver unseen, so new GL calls in the render path
+//? need an entry here (and a case in the replayer) to show up in recordings.
+//?
+//? File layout: header, then a stream of [u16 op][payload]. Everything before frame_begin is setup
+//? (replayed once), the range between frame_begin and frame_end is the frame (replayed N times).
+//? Buffers re-uploaded every frame would make the setup grow with the target frame, so before it an
+//? upload is dropped once glBufferData respecifies (or glDeleteBuffers frees) its buffer, unless
+//? something copied out of the buffer in between. A dropped glBufferData keeps its call without the
+//? data, so setup draws that read the buffer still find a data store of the right size.
+//? Object names and uniform locations are recorded as the driver returned them and remapped on replay.
+
+#define GLREC_FUNCTIONS(X) \
+	X(Enable) X(Disable) X(FrontFace) X(CullFace) X(Viewport) X(Scissor) X(Clear) X(BlendFunc) \
+	X(DepthFunc) X(DepthMask) X(ColorMask) \
+	X(GenBuffers) X(DeleteBuffers) X(BindBuffer) X(BufferData) X(BufferSubData) X(CopyBufferSubData) X(BindBufferBase) \
+	X(CreateShader) X(DeleteShader) X(ShaderSource) X(CompileShader) \
+	X(CreateProgram) X(DeleteProgram) X(AttachShader) X(LinkProgram) X(UseProgram) \
+	X(GetUniformLocation) X(GetAttribLocation) X(GetUniformBlockIndex) X(UniformBlockBinding) \
+	X(UniformMatrix4fv) X(Uniform1f) X(Uniform1i) X(Uniform4fv) \
+	X(GenVertexArrays) X(DeleteVertexArrays) X(BindVertexArray) X(EnableVertexAttribArray) X(VertexAttribPointer) \
+	X(VertexAttribDivisor) X(DrawArrays) X(DrawElements) X(DrawElementsBaseVertex) X(DrawElementsInstancedBaseVertex) \
+	X(GenFramebuffers) X(DeleteFramebuffers) X(BindFramebuffer) X(BlitFramebuffer) \
+	X(FramebufferTexture2D) X(FramebufferRenderbuffer) X(CheckFramebufferStatus) \
+	X(GenTextures) X(DeleteTextures) X(BindTexture) X(TexImage2D) X(TexParameteri) X(ActiveTexture) X(TexBuffer) \
+	X(TexStorage2D) X(TexSubImage2D) X(CompressedTexImage2D) X(CompressedTexSubImage2D) \
+	X(GenRenderbuffers) X(DeleteRenderbuffers) X(BindRenderbuffer) X(RenderbufferStorage) \
+	X(GenQueries) X(DeleteQueries) X(QueryCounter) X(GetQueryObjectui64v)
+
+namespace lib::glrec
+{
+	constexpr u32 file_magic = 0x43524c47; // "GLRC"
+	constexpr u32 file_version = 9;
+
+	enum class Op : u16
+	{
+		frame_begin,
+		frame_end,
+#define GLREC_OP(name) name,
+		GLREC_FUNCTIONS(GLREC_OP)
+#undef GLREC_OP
+		count
+	};
+
+	struct FileHeader
+	{
+		u32 magic;
+		u32 version;
+		s32 width;
+		s32 height;
+	};
+
+	struct Recorder
+	{
+		std::vector<u8> bytes;
+		b32 installed = false;
+		u32 frame = 0;
+		u32 target_frame = 0;
+		const char* path = nullptr;
+		FileHeader header{};
+		GLuint unpack_buffer = 0; // texture uploads read from it when bound
+
+		struct Range
+		{
+			size_t begin, end;
+			b32 data_store = false; // a glBufferData, begin is its has-data flag
+		};
+		std::unordered_map<GLuint, std::vector<Range>> uploads; // per buffer, since it was last respecified
+		std::vector<Range> dead;                                // uploads to cut out at the end of the frame
+
+		inline b32 before_target() const
+		{
+			return frame < target_frame;
+		}
+
+		//? Uploads to buffer so far are overwritten or freed, the next compact() removes them
+		inline void kill_uploads(GLuint buffer)
+		{
+			auto it = uploads.find(buffer);
+			if (it == uploads.end())
+				return;
+			for (const Range& range : it->second)
+			{
+				if (range.data_store)
+				{
+					bytes[range.begin] = 0; // the call stays, its data goes
+					dead.push_back({ range.begin + 1, range.end });
+				}
+				else
+				{
+					dead.push_back(range);
+				}
+			}
+			uploads.erase(it);
+		}
+
+		//? Called when buffer's contents are read into something that outlives the frame, they must stay
+		inline void keep_uploads(GLuint buffer)
+		{
+			uploads.erase(buffer);
+		}
+
+		//? Removes dead uploads from the stream in one pass and moves the tracked ranges after them down
+		void compact()
+		{
+			if (dead.empty())
+				return;
+
+			std::sort(dead.begin(), dead.end(), [](const Range& a, const Range& b) { return a.begin < b.begin; });
+			std::vector<size_t> removed_before(dead.size() + 1, 0); // bytes cut before dead[i]
+			size_t write = dead[0].begin;
+			for (size_t i = 0; i < dead.size(); ++i)
+			{
+				const size_t next = i + 1 < dead.size() ? dead[i + 1].begin : bytes.size();
+				memmove(bytes.data() + write, bytes.data() + dead[i].end, next - dead[i].end);
+				write += next - dead[i].end;
+				removed_before[i + 1] = removed_before[i] + (dead[i].end - dead[i].begin);
+			}
+			bytes.resize(write);
+
+			for (auto& [buffer, ranges] : uploads)
+			{
+				for (Range& range : ranges)
+				{
+					const size_t i = (size_t)(std::upper_bound(dead.begin(), dead.end(), range.begin,
+						[](size_t at, const Range& d) { return at < d.begin; }) - dead.begin());
+					range.begin -= removed_before[i];
+					range.end -= removed_before[i];
+				}
+			}
+			dead.clear();
+		}
+
+		template <typename T>
+		inline void put(T value)
+		{
+			const size_t at = bytes.size();
+			bytes.resize(at + sizeof(T));
+			memcpy(bytes.data() + at, &value, sizeof(T));
+		}
+
+		inline void put_bytes(const void* data, size_t size)
+		{
+			put<u64>(size);
+			const u8* p = (const u8*)data;
+			bytes.insert(bytes.end(), p, p + size);
+		}
+
+		inline void put_string(const char* str, s64 length = -1)
+		{
+			put_bytes(str, length < 0 ? strlen(str) : (size_t)length);
+		}
+
+		inline void op(Op o)
+		{
+			put<u16>((u16)o);
+		}
+
+		//? 0 no data, 1 client memory follows, 2 an offset into the bound unpack buffer follows
+		inline void put_pixels(const void* pixels, size_t size)
+		{
+			if (unpack_buffer)
+			{
+				keep_uploads(unpack_buffer);
+				put<u8>(2);
+				put((s64)(uintptr_t)pixels);
+				return;
+			}
+			put<u8>(pixels != nullptr);
+			if (pixels)
+				put_bytes(pixels, size);
+		}
+	};
+
+	inline Recorder recorder;
+
+#define GLREC_REAL(name) inline decltype(glad_gl##name) real_##name = nullptr;
+	GLREC_FUNCTIONS(GLREC_REAL)
+#undef GLREC_REAL
+
+	inline size_t pixel_bytes(GLsizei width, GLsizei height, GLenum format, GLenum type)
+	{
+		u32 components = 4;
+		switch (format)
+		{
+		case GL_RED: case GL_DEPTH_COMPONENT: components = 1; break;
+		case GL_RG: components = 2; break;
+		case GL_RGB: case GL_BGR: components = 3; break;
+		}
+
+		u32 size = 1;
+		switch (type)
+		{
+		case GL_HALF_FLOAT: case GL_UNSIGNED_SHORT: size = 2; break;
+		case GL_FLOAT: case GL_UNSIGNED_INT: size = 4; break;
+		}
+
+		GLint alignment = 4;
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+		const size_t row = ((size_t)width * components * size + alignment - 1) & ~((size_t)alignment - 1);
+		return row * height;
+	}
+
+	inline GLuint bound_buffer(GLenum target)
+	{
+		GLenum binding = 0;
+		switch (target)
+		{
+		case GL_ARRAY_BUFFER: binding = GL_ARRAY_BUFFER_BINDING; break;
+		case GL_ELEMENT_ARRAY_BUFFER: binding = GL_ELEMENT_ARRAY_BUFFER_BINDING; break;
+		case GL_UNIFORM_BUFFER: binding = GL_UNIFORM_BUFFER_BINDING; break;
+		case GL_TEXTURE_BUFFER: binding = GL_TEXTURE_BUFFER_BINDING; break;
+		case GL_COPY_READ_BUFFER: binding = GL_COPY_READ_BUFFER_BINDING; break;
+		case GL_COPY_WRITE_BUFFER: binding = GL_COPY_WRITE_BUFFER_BINDING; break;
+		case GL_PIXEL_PACK_BUFFER: binding = GL_PIXEL_PACK_BUFFER_BINDING; break;
+		case GL_PIXEL_UNPACK_BUFFER: binding = GL_PIXEL_UNPACK_BUFFER_BINDING; break;
+		default: return 0;
+		}
+		GLint name = 0;
+		glGetIntegerv(binding, &name);
+		return (GLuint)name;
+	}
+
+	// wrappers, one per recorded function
+	static void APIENTRY rec_Enable(GLenum cap) { recorder.op(Op::Enable); recorder.put(cap); real_Enable(cap); }
+	static void APIENTRY rec_Disable(GLenum cap) { recorder.op(Op::Disable); recorder.put(cap); real_Disable(cap); }
+	static void APIENTRY rec_FrontFace(GLenum mode) { recorder.op(Op::FrontFace); recorder.put(mode); real_FrontFace(mode); }
+	static void APIENTRY rec_CullFace(GLenum mode) { recorder.op(Op::CullFace); recorder.put(mode); real_CullFace(mode); }
+	static void APIENTRY rec_Clear(GLbitfield mask) { recorder.op(Op::Clear); recorder.put(mask); real_Clear(mask); }
+	static void APIENTRY rec_DepthFunc(GLenum func) { recorder.op(Op::DepthFunc); recorder.put(func); real_DepthFunc(func); }
+	static void APIENTRY rec_DepthMask(GLboolean flag) { recorder.op(Op::DepthMask); recorder.put(flag); real_DepthMask(flag); }
+
+	static void APIENTRY rec_BlendFunc(GLenum src, GLenum dst) { recorder.op(Op::BlendFunc); recorder.put(src); recorder.put(dst); real_BlendFunc(src, dst); }
+
+	static void APIENTRY rec_ColorMask(GLboolean r, GLboolean g, GLboolean b, GLboolean a)
+	{
+		recorder.op(Op::ColorMask); recorder.put(r); recorder.put(g); recorder.put(b); recorder.put(a);
+		real_ColorMask(r, g, b, a);
+	}
+
+	static void APIENTRY rec_Viewport(GLint x, GLint y, GLsizei w, GLsizei h)
+	{
+		recorder.op(Op::Viewport); recorder.put(x); recorder.put(y); recorder.put(w); recorder.put(h);
+		real_Viewport(x, y, w, h);
+	}
+
+	static void APIENTRY rec_Scissor(GLint x, GLint y, GLsizei w, GLsizei h)
+	{
+		recorder.op(Op::Scissor); recorder.put(x); recorder.put(y); recorder.put(w); recorder.put(h);
+		real_Scissor(x, y, w, h);
+	}
+
+	//? Gen* and Delete* all share a shape, names written after the driver filled them
+	inline void record_gen(Op o, GLsizei n, const GLuint* names)
+	{
+		recorder.op(o);
+		recorder.put(n);
+		for (GLsizei i = 0; i < n; ++i)
+			recorder.put(names[i]);
+	}
+
+	static void APIENTRY rec_GenBuffers(GLsizei n, GLuint* names) { real_GenBuffers(n, names); record_gen(Op::GenBuffers, n, names); }
+	static void APIENTRY rec_DeleteBuffers(GLsizei n, const GLuint* names)
+	{
+		if (recorder.before_target())
+			for (GLsizei i = 0; i < n; ++i)
+				recorder.kill_uploads(names[i]);
+		record_gen(Op::DeleteBuffers, n, names);
+		real_DeleteBuffers(n, names);
+	}
+
+	static void APIENTRY rec_GenVertexArrays(GLsizei n, GLuint* names) { real_GenVertexArrays(n, names); record_gen(Op::GenVertexArrays, n, names); }
+	static void APIENTRY rec_DeleteVertexArrays(GLsizei n, const GLuint* names) { record_gen(Op::DeleteVertexArrays, n, names); real_DeleteVertexArrays(n, names); }
+	static void APIENTRY rec_GenFramebuffers(GLsizei n, GLuint* names) { real_GenFramebuffers(n, names); record_gen(Op::GenFramebuffers, n, names); }
+	static void APIENTRY rec_DeleteFramebuffers(GLsizei n, const GLuint* names) { record_gen(Op::DeleteFramebuffers, n, names); real_DeleteFramebuffers(n, names); }
+	static void APIENTRY rec_GenTextures(GLsizei n, GLuint* names) { real_GenTextures(n, names); record_gen(Op::GenTextures, n, names); }
+	static void APIENTRY rec_DeleteTextures(GLsizei n, const GLuint* names) { record_gen(Op::DeleteTextures, n, names); real_DeleteTextures(n, names); }
+	static void APIENTRY rec_GenRenderbuffers(GLsizei n, GLuint* names) { real_GenRenderbuffers(n, names); record_gen(Op::GenRenderbuffers, n, names); }
+	static void APIENTRY rec_DeleteRenderbuffers(GLsizei n, const GLuint* names) { record_gen(Op::DeleteRenderbuffers, n, names); real_DeleteRenderbuffers(n, names); }
+	static void APIENTRY rec_GenQueries(GLsizei n, GLuint* names) { real_GenQueries(n, names); record_gen(Op::GenQueries, n, names); }
+	static void APIENTRY rec_DeleteQueries(GLsizei n, const GLuint* names) { record_gen(Op::DeleteQueries, n, names); real_DeleteQueries(n, names); }
+
+	static void APIENTRY rec_BindBuffer(GLenum target, GLuint buffer)
+	{
+		recorder.op(Op::BindBuffer); recorder.put(target); recorder.put(buffer);
+		if (target == GL_PIXEL_UNPACK_BUFFER)
+			recorder.unpack_buffer = buffer;
+		real_BindBuffer(target, buffer);
+	}
+
+	static void APIENTRY rec_BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+	{
+		const GLuint buffer = recorder.before_target() ? bound_buffer(target) : 0;
+		if (buffer)
+			recorder.kill_uploads(buffer);
+
+		recorder.op(Op::BufferData);
+		recorder.put(target); recorder.put((s64)size); recorder.put(usage);
+		const size_t flag_at = recorder.bytes.size();
+		recorder.put<u8>(data != nullptr);
+		if (data)
+			recorder.put_bytes(data, (size_t)size);
+		if (buffer && data)
+			recorder.uploads[buffer].push_back({ flag_at, recorder.bytes.size(), true });
+		real_BufferData(target, size, data, usage);
+	}
+
+	static void APIENTRY rec_BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+	{
+		const GLuint buffer = recorder.before_target() ? bound_buffer(target) : 0;
+		const size_t at = recorder.bytes.size();
+		recorder.op(Op::BufferSubData);
+		recorder.put(target); recorder.put((s64)offset);
+		recorder.put_bytes(data, (size_t)size);
+		if (buffer)
+			recorder.uploads[buffer].push_back({ at, recorder.bytes.size() });
+		real_BufferSubData(target, offset, size, data);
+	}
+
+	static void APIENTRY rec_CopyBufferSubData(GLenum read_target, GLenum write_target, GLintptr read_offset, GLintptr write_offset, GLsizeiptr size)
+	{
+		if (recorder.before_target())
+			recorder.keep_uploads(bound_buffer(read_target));
+		recorder.op(Op::CopyBufferSubData);
+		recorder.put(read_target); recorder.put(write_target); recorder.put((s64)read_offset); recorder.put((s64)write_offset); recorder.put((s64)size);
+		real_CopyBufferSubData(read_target, write_target, read_offset, write_offset, size);
+	}
+
+	static void APIENTRY rec_BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+	{
+		recorder.op(Op::BindBufferBase); recorder.put(target); recorder.put(index); recorder.put(buffer);
+		real_BindBufferBase(target, index, buffer);
+	}
+
+	static GLuint APIENTRY rec_CreateShader(GLenum type)
+	{
+		const GLuint name = real_CreateShader(type);
+		recorder.op(Op::CreateShader); recorder.put(type); recorder.put(name);
+		return name;
+	}
+
+	static void APIENTRY rec_DeleteShader(GLuint shader) { recorder.op(Op::DeleteShader); recorder.put(shader); real_DeleteShader(shader); }
+
+	static void APIENTRY rec_ShaderSource(GLuint shader, GLsizei count, const GLchar* const* strings, const GLint* lengths)
+	{
+		recorder.op(Op::ShaderSource); recorder.put(shader); recorder.put(count);
+		for (GLsizei i = 0; i < count; ++i)
+			recorder.put_string(strings[i], lengths && lengths[i] >= 0 ? lengths[i] : -1);
+		real_ShaderSource(shader, count, strings, lengths);
+	}
+
+	static void APIENTRY rec_CompileShader(GLuint shader) { recorder.op(Op::CompileShader); recorder.put(shader); real_CompileShader(shader); }
+
+	static GLuint APIENTRY rec_CreateProgram()
+	{
+		const GLuint name = real_CreateProgram();
+		recorder.op(Op::CreateProgram); recorder.put(name);
+		return name;
+	}
+
+	static void APIENTRY rec_DeleteProgram(GLuint program) { recorder.op(Op::DeleteProgram); recorder.put(program); real_DeleteProgram(program); }
+	static void APIENTRY rec_AttachShader(GLuint program, GLuint shader) { recorder.op(Op::AttachShader); recorder.put(program); recorder.put(shader); real_AttachShader(program, shader); }
+	static void APIENTRY rec_LinkProgram(GLuint program) { recorder.op(Op::LinkProgram); recorder.put(program); real_LinkProgram(program); }
+	static void APIENTRY rec_UseProgram(GLuint program) { recorder.op(Op::UseProgram); recorder.put(program); real_UseProgram(program); }
+
+	static GLint APIENTRY rec_GetUniformLocation(GLuint program, const GLchar* name)
+	{
+		const GLint location = real_GetUniformLocation(program, name);
+		recorder.op(Op::GetUniformLocation); recorder.put(program); recorder.put_string(name); recorder.put(location);
+		return location;
+	}
+
+	static GLint APIENTRY rec_GetAttribLocation(GLuint program, const GLchar* name)
+	{
+		const GLint location = real_GetAttribLocation(program, name);
+		recorder.op(Op::GetAttribLocation); recorder.put(program); recorder.put_string(name); recorder.put(location);
+		return location;
+	}
+
+	static GLuint APIENTRY rec_GetUniformBlockIndex(GLuint program, const GLchar* name)
+	{
+		const GLuint index = real_GetUniformBlockIndex(program, name);
+		recorder.op(Op::GetUniformBlockIndex); recorder.put(program); recorder.put_string(name); recorder.put(index);
+		return index;
+	}
+
+	static void APIENTRY rec_UniformBlockBinding(GLuint program, GLuint index, GLuint binding)
+	{
+		recorder.op(Op::UniformBlockBinding); recorder.put(program); recorder.put(index); recorder.put(binding);
+		real_UniformBlockBinding(program, index, binding);
+	}
+
+	static void APIENTRY rec_UniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+	{
+		recorder.op(Op::UniformMatrix4fv); recorder.put(location); recorder.put(count); recorder.put(transpose);
+		recorder.put_bytes(value, (size_t)count * 16 * sizeof(GLfloat));
+		real_UniformMatrix4fv(location, count, transpose, value);
+	}
+
+	static void APIENTRY rec_Uniform1f(GLint location, GLfloat v) { recorder.op(Op::Uniform1f); recorder.put(location); recorder.put(v); real_Uniform1f(location, v); }
+	static void APIENTRY rec_Uniform1i(GLint location, GLint v) { recorder.op(Op::Uniform1i); recorder.put(location); recorder.put(v); real_Uniform1i(location, v); }
+
+	static void APIENTRY rec_Uniform4fv(GLint location, GLsizei count, const GLfloat* value)
+	{
+		recorder.op(Op::Uniform4fv); recorder.put(location); recorder.put(count);
+		recorder.put_bytes(value, (size_t)count * 4 * sizeof(GLfloat));
+		real_Uniform4fv(location, count, value);
+	}
+
+	static void APIENTRY rec_BindVertexArray(GLuint vao) { recorder.op(Op::BindVertexArray); recorder.put(vao); real_BindVertexArray(vao); }
+	static void APIENTRY rec_EnableVertexAttribArray(GLuint index) { recorder.op(Op::EnableVertexAttribArray); recorder.put(index); real_EnableVertexAttribArray(index); }
+
+	//? Pointer arguments are buffer offsets here, client-side arrays are not a thing in core profile
+	static void APIENTRY rec_VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer)
+	{
+		recorder.op(Op::VertexAttribPointer);
+		recorder.put(index); recorder.put(size); recorder.put(type); recorder.put(normalized); recorder.put(stride); recorder.put((u64)pointer);
+		real_VertexAttribPointer(index, size, type, normalized, stride, pointer);
+	}
+
+	static void APIENTRY rec_DrawArrays(GLenum mode, GLint first, GLsizei count)
+	{
+		recorder.op(Op::DrawArrays); recorder.put(mode); recorder.put(first); recorder.put(count);
+		real_DrawArrays(mode, first, count);
+	}
+
+	static void APIENTRY rec_DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+	{
+		recorder.op(Op::DrawElements); recorder.put(mode); recorder.put(count); recorder.put(type); recorder.put((u64)indices);
+		real_DrawElements(mode, count, type, indices);
+	}
+
+	static void APIENTRY rec_VertexAttribDivisor(GLuint index, GLuint divisor) { recorder.op(Op::VertexAttribDivisor); recorder.put(index); recorder.put(divisor); real_VertexAttribDivisor(index, divisor); }
+
+	static void APIENTRY rec_DrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint base_vertex)
+	{
+		recorder.op(Op::DrawElementsBaseVertex); recorder.put(mode); recorder.put(count); recorder.put(type); recorder.put((u64)indices); recorder.put(base_vertex);
+		real_DrawElementsBaseVertex(mode, count, type, indices, base_vertex);
+	}
+
+	static void APIENTRY rec_DrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances, GLint base_vertex)
+	{
+		recorder.op(Op::DrawElementsInstancedBaseVertex); recorder.put(mode); recorder.put(count); recorder.put(type); recorder.put((u64)indices);
+		recorder.put(instances); recorder.put(base_vertex);
+		real_DrawElementsInstancedBaseVertex(mode, count, type, indices, instances, base_vertex);
+	}
+
+	static void APIENTRY rec_BindFramebuffer(GLenum target, GLuint fbo) { recorder.op(Op::BindFramebuffer); recorder.put(target); recorder.put(fbo); real_BindFramebuffer(target, fbo); }
+
+	static void APIENTRY rec_BlitFramebuffer(GLint sx0, GLint sy0, GLint sx1, GLint sy1, GLint dx0, GLint dy0, GLint dx1, GLint dy1, GLbitfield mask, GLenum filter)
+	{
+		recorder.op(Op::BlitFramebuffer);
+		recorder.put(sx0); recorder.put(sy0); recorder.put(sx1); recorder.put(sy1);
+		recorder.put(dx0); recorder.put(dy0); recorder.put(dx1); recorder.put(dy1);
+		recorder.put(mask); recorder.put(filter);
+		real_BlitFramebuffer(sx0, sy0, sx1, sy1, dx0, dy0, dx1, dy1, mask, filter);
+	}
+
+	static void APIENTRY rec_FramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level)
+	{
+		recorder.op(Op::FramebufferTexture2D);
+		recorder.put(target); recorder.put(attachment); recorder.put(textarget); recorder.put(texture); recorder.put(level);
+		real_FramebufferTexture2D(target, attachment, textarget, texture, level);
+	}
+
+	static void APIENTRY rec_FramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum rbtarget, GLuint rb)
+	{
+		recorder.op(Op::FramebufferRenderbuffer);
+		recorder.put(target); recorder.put(attachment); recorder.put(rbtarget); recorder.put(rb);
+		real_FramebufferRenderbuffer(target, attachment, rbtarget, rb);
+	}
+
+	static GLenum APIENTRY rec_CheckFramebufferStatus(GLenum target)
+	{
+		recorder.op(Op::CheckFramebufferStatus); recorder.put(target);
+		return real_CheckFramebufferStatus(target);
+	}
+
+	static void APIENTRY rec_BindTexture(GLenum target, GLuint texture) { recorder.op(Op::BindTexture); recorder.put(target); recorder.put(texture); real_BindTexture(target, texture); }
+
+	static void APIENTRY rec_TexImage2D(GLenum target, GLint level, GLint internal_format, GLsizei w, GLsizei h, GLint border, GLenum format, GLenum type, const void* pixels)
+	{
+		recorder.op(Op::TexImage2D);
+		recorder.put(target); recorder.put(level); recorder.put(internal_format); recorder.put(w); recorder.put(h);
+		recorder.put(border); recorder.put(format); recorder.put(type);
+		recorder.put_pixels(pixels, pixel_bytes(w, h, format, type));
+		real_TexImage2D(target, level, internal_format, w, h, border, format, type, pixels);
+	}
+
+	static void APIENTRY rec_TexParameteri(GLenum target, GLenum pname, GLint param)
+	{
+		recorder.op(Op::TexParameteri); recorder.put(target); recorder.put(pname); recorder.put(param);
+		real_TexParameteri(target, pname, param);
+	}
+
+	static void APIENTRY rec_ActiveTexture(GLenum unit) { recorder.op(Op::ActiveTexture); recorder.put(unit); real_ActiveTexture(unit); }
+
+	static void APIENTRY rec_TexBuffer(GLenum target, GLenum internal_format, GLuint buffer)
+	{
+		recorder.op(Op::TexBuffer); recorder.put(target); recorder.put(internal_format); recorder.put(buffer);
+		real_TexBuffer(target, internal_format, buffer);
+	}
+
+	static void APIENTRY rec_TexStorage2D(GLenum target, GLsizei levels, GLenum internal_format, GLsizei w, GLsizei h)
+	{
+		recorder.op(Op::TexStorage2D); recorder.put(target); recorder.put(levels); recorder.put(internal_format); recorder.put(w); recorder.put(h);
+		real_TexStorage2D(target, levels, internal_format, w, h);
+	}
+
+	static void APIENTRY rec_TexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei w, GLsizei h, GLenum format, GLenum type, const void* pixels)
+	{
+		recorder.op(Op::TexSubImage2D);
+		recorder.put(target); recorder.put(level); recorder.put(x); recorder.put(y); recorder.put(w); recorder.put(h);
+		recorder.put(format); recorder.put(type);
+		recorder.put_pixels(pixels, pixel_bytes(w, h, format, type));
+		real_TexSubImage2D(target, level, x, y, w, h, format, type, pixels);
+	}
+
+	static void APIENTRY rec_CompressedTexImage2D(GLenum target, GLint level, GLenum internal_format, GLsizei w, GLsizei h, GLint border,
+		GLsizei image_size, const void* data)
+	{
+		recorder.op(Op::CompressedTexImage2D);
+		recorder.put(target); recorder.put(level); recorder.put(internal_format); recorder.put(w); recorder.put(h); recorder.put(border);
+		recorder.put(image_size); recorder.put_pixels(data, (size_t)image_size);
+		real_CompressedTexImage2D(target, level, internal_format, w, h, border, image_size, data);
+	}
+
+	static void APIENTRY rec_CompressedTexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei w, GLsizei h, GLenum format,
+		GLsizei image_size, const void* data)
+	{
+		recorder.op(Op::CompressedTexSubImage2D);
+		recorder.put(target); recorder.put(level); recorder.put(x); recorder.put(y); recorder.put(w); recorder.put(h); recorder.put(format);
+		recorder.put(image_size); recorder.put_pixels(data, (size_t)image_size);
+		real_CompressedTexSubImage2D(target, level, x, y, w, h, format, image_size, data);
+	}
+
+	static void APIENTRY rec_BindRenderbuffer(GLenum target, GLuint rb) { recorder.op(Op::BindRenderbuffer); recorder.put(target); recorder.put(rb); real_BindRenderbuffer(target, rb); }
+
+	static void APIENTRY rec_RenderbufferStorage(GLenum target, GLenum internal_format, GLsizei w, GLsizei h)
+	{
+		recorder.op(Op::RenderbufferStorage); recorder.put(target); recorder.put(internal_format); recorder.put(w); recorder.put(h);
+		real_RenderbufferStorage(target, internal_format, w, h);
+	}
+
+	static void APIENTRY rec_QueryCounter(GLuint id, GLenum target) { recorder.op(Op::QueryCounter); recorder.put(id); recorder.put(target); real_QueryCounter(id, target); }
+
+	static void APIENTRY rec_GetQueryObjectui64v(GLuint id, GLenum pname, GLuint64* params)
+	{
+		recorder.op(Op::GetQueryObjectui64v); recorder.put(id); recorder.put(pname);
+		real_GetQueryObjectui64v(id, pname, params);
+	}
+
+	inline void uninstall()
+	{
+		if (!recorder.installed)
+			return;
+
+#define GLREC_UNINSTALL(name) glad_gl##name = real_##name;
+		GLREC_FUNCTIONS(GLREC_UNINSTALL)
+#undef GLREC_UNINSTALL
+		recorder.installed = false;
+	}
+
+	//? Call right after loading GL, everything from here to the target frame (less dead uploads) becomes the setup section
+	inline void install(const char* path, u32 target_frame, s32 width, s32 height)
+	{
+#define GLREC_INSTALL(name) real_##name = glad_gl##name; glad_gl##name = rec_##name;
+		GLREC_FUNCTIONS(GLREC_INSTALL)
+#undef GLREC_INSTALL
+
+		recorder.installed = true;
+		recorder.path = path;
+		recorder.target_frame = target_frame;
+		recorder.frame = 0;
+		recorder.header = { file_magic, file_version, width, height };
+		recorder.bytes.reserve(MiB(4));
+		recorder.uploads.clear();
+		recorder.dead.clear();
+	}
+
+	inline void begin_frame()
+	{
+		if (recorder.installed && recorder.frame == recorder.target_frame)
+			recorder.op(Op::frame_begin);
+	}
+
+	//? Writes the file and unhooks once the target frame is done
+	inline void end_frame()
+	{
+		if (!recorder.installed)
+			return;
+
+		if (recorder.frame++ != recorder.target_frame)
+		{
+			recorder.compact();
+			return;
+		}
+
+		recorder.op(Op::frame_end);
+		uninstall();
+
+		FILE* file = fopen(recorder.path, "wb");
+		if (!file)
+		{
+			fprintf(stderr, "glrec: can't open %s\n", recorder.path);
+			return;
+		}
+		fwrite(&recorder.header, sizeof(recorder.header), 1, file);
+		fwrite(recorder.bytes.data(), 1, recorder.bytes.size(), file);
+		fclose(file);
+		printf("glrec: frame %u written to %s (%.1f KiB)\n", recorder.target_frame, recorder.path, recorder.bytes.size() / 1024.0);
+
+		recorder.bytes.clear();
+		recorder.bytes.shrink_to_fit();
+		recorder.uploads.clear();
+	}
+
+	//? Plays a recording back. Data pointers point straight into the loaded file, nothing is copied per call,
+	//? so replaying measures driver submission cost and not our own serialization.
+	struct Replayer
+	{
+		FileHeader header{};
+		std::vector<u8> bytes;
+		size_t setup_end = 0;  // offset of frame_begin
+		size_t frame_begin = 0;
+		size_t frame_end = 0;
+
+		std::unordered_map<GLuint, GLuint> buffers, vertex_arrays, framebuffers, textures, renderbuffers, queries, shaders, programs;
+		std::unordered_map<u64, GLint> uniform_locations; // (recorded program << 32 | recorded location)
+		std::unordered_map<u64, GLuint> block_indices;
+		GLuint current_program = 0; // recorded name
+
+		b32 load(const char* path)
+		{
+			FILE* file = fopen(path, "rb");
+			if (!file)
+				return false;
+
+			fseek(file, 0, SEEK_END);
+			const long size = ftell(file);
+			fseek(file, 0, SEEK_SET);
+
+			if (size < (long)sizeof(FileHeader) || fread(&header, sizeof(header), 1, file) != 1 ||
+				header.magic != file_magic || header.version != file_version)
+			{
+				fclose(file);
+				return false;
+			}
+
+			bytes.resize(size - sizeof(FileHeader));
+			const b32 ok = fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+			fclose(file);
+			return ok && index_frame();
+		}
+
+		void play_setup()
+		{
+			play(0, setup_end);
+		}
+
+		void play_frame()
+		{
+			play(frame_begin, frame_end);
+		}
+
+		size_t frame_bytes() const
+		{
+			return frame_end - frame_begin;
+		}
+
+	private:
+		struct Reader
+		{
+			const u8* p;
+
+			template <typename T>
+			inline T get()
+			{
+				T v;
+				memcpy(&v, p, sizeof(T));
+				p += sizeof(T);
+				return v;
+			}
+
+			inline const u8* get_bytes(u64* size)
+			{
+				*size = get<u64>();
+				const u8* data = p;
+				p += *size;
+				return data;
+			}
+
+			//? Counterpart of Recorder::put_pixels, offsets come back as the pointer GL expects
+			inline const u8* get_pixels(u64* size)
+			{
+				const u8 kind = get<u8>();
+				if (kind == 2)
+					return (const u8*)(uintptr_t)get<s64>();
+				return kind ? get_bytes(size) : nullptr;
+			}
+		};
+
+		//? Walks the stream once to find the frame range, also validates every op is known
+		b32 index_frame()
+		{
+			const u8* start = bytes.data();
+			const u8* end = start + bytes.size();
+			b32 found_begin = false;
+			Reader r{ start };
+			while (r.p < end)
+			{
+				const Op o = (Op)r.get<u16>();
+				if (o == Op::frame_begin)
+				{
+					setup_end = (size_t)(r.p - start) - sizeof(u16);
+					frame_begin = (size_t)(r.p - start);
+					found_begin = true;
+				}
+				else if (o == Op::frame_end)
+				{
+					frame_end = (size_t)(r.p - start) - sizeof(u16);
+					return found_begin;
+				}
+				else if (!execute(o, r, false))
+				{
+					return false;
+				}
+			}
+			return false;
+		}
+
+		void play(size_t begin, size_t end)
+		{
+			Reader r{ bytes.data() + begin };
+			const u8* stop = bytes.data() + end;
+			while (r.p < stop)
+				execute((Op)r.get<u16>(), r, true);
+		}
+
+		static GLuint map_name(std::unordered_map<GLuint, GLuint>& map, GLuint name)
+		{
+			if (name == 0)
+				return 0;
+			auto it = map.find(name);
+			return it != map.end() ? it->second : 0;
+		}
+
+		void replay_gen(Reader& r, b32 run, std::unordered_map<GLuint, GLuint>& map, decltype(glad_glGenBuffers) gen)
+		{
+			const GLsizei n = r.get<GLsizei>();
+			for (GLsizei i = 0; i < n; ++i)
+			{
+				const GLuint recorded = r.get<GLuint>();
+				if (run)
+				{
+					GLuint name = 0;
+					gen(1, &name);
+					map[recorded] = name;
+				}
+			}
+		}
+
+		void replay_delete(Reader& r, b32 run, std::unordered_map<GLuint, GLuint>& map, decltype(glad_glDeleteBuffers) del)
+		{
+			const GLsizei n = r.get<GLsizei>();
+			for (GLsizei i = 0; i < n; ++i)
+			{
+				const GLuint recorded = r.get<GLuint>();
+				if (run)
+				{
+					const GLuint name = map_name(map, recorded);
+					del(1, &name);
+					map.erase(recorded);
+				}
+			}
+		}
+
+		GLint map_location(GLint location)
+		{
+			if (location < 0)
+				return location;
+			auto it = uniform_locations.find((u64)current_program << 32 | (u32)location);
+			return it != uniform_locations.end() ? it->second : -1;
+		}
+
+		//? run == false only advances the reader, used when indexing
+		b32 execute(Op o, Reader& r, b32 run)
+		{
+			u64 size = 0;
+			switch (o)
+			{
+			case Op::Enable: { const GLenum cap = r.get<GLenum>(); if (run) glEnable(cap); } break;
+			case Op::Disable: { const GLenum cap = r.get<GLenum>(); if (run) glDisable(cap); } break;
+			case Op::FrontFace: { const GLenum m = r.get<GLenum>(); if (run) glFrontFace(m); } break;
+			case Op::CullFace: { const GLenum m = r.get<GLenum>(); if (run) glCullFace(m); } break;
+			case Op::Clear: { const GLbitfield m = r.get<GLbitfield>(); if (run) glClear(m); } break;
+			case Op::DepthFunc: { const GLenum f = r.get<GLenum>(); if (run) glDepthFunc(f); } break;
+			case Op::DepthMask: { const GLboolean f = r.get<GLboolean>(); if (run) glDepthMask(f); } break;
+			case Op::BlendFunc:
+			{
+				const GLenum src = r.get<GLenum>(), dst = r.get<GLenum>();
+				if (run) glBlendFunc(src, dst);
+			} break;
+			case Op::ColorMask:
+			{
+				const GLboolean cr = r.get<GLboolean>(), cg = r.get<GLboolean>(), cb = r.get<GLboolean>(), ca = r.get<GLboolean>();
+				if (run) glColorMask(cr, cg, cb, ca);
+			} break;
+			case Op::Viewport:
+			case Op::Scissor:
+			{
+				const GLint x = r.get<GLint>(), y = r.get<GLint>();
+				const GLsizei w = r.get<GLsizei>(), h = r.get<GLsizei>();
+				if (run)
+					(o == Op::Viewport ? glViewport : glScissor)(x, y, w, h);
+			} break;
+
+			case Op::GenBuffers: replay_gen(r, run, buffers, glGenBuffers); break;
+			case Op::DeleteBuffers: replay_delete(r, run, buffers, glDeleteBuffers); break;
+			case Op::GenVertexArrays: replay_gen(r, run, vertex_arrays, glGenVertexArrays); break;
+			case Op::DeleteVertexArrays: replay_delete(r, run, vertex_arrays, glDeleteVertexArrays); break;
+			case Op::GenFramebuffers: replay_gen(r, run, framebuffers, glGenFramebuffers); break;
+			case Op::DeleteFramebuffers: replay_delete(r, run, framebuffers, glDeleteFramebuffers); break;
+			case Op::GenTextures: replay_gen(r, run, textures, glGenTextures); break;
+			case Op::DeleteTextures: replay_delete(r, run, textures, glDeleteTextures); break;
+			case Op::GenRenderbuffers: replay_gen(r, run, renderbuffers, glGenRenderbuffers); break;
+			case Op::DeleteRenderbuffers: replay_delete(r, run, renderbuffers, glDeleteRenderbuffers); break;
+			case Op::GenQueries: replay_gen(r, run, queries, glGenQueries); break;
+			case Op::DeleteQueries: replay_delete(r, run, queries, glDeleteQueries); break;
+
+			case Op::BindBuffer:
+			{
+				const GLenum target = r.get<GLenum>();
+				const GLuint buffer = r.get<GLuint>();
+				if (run) glBindBuffer(target, map_name(buffers, buffer));
+			} break;
+			case Op::BufferData:
+			{
+				const GLenum target = r.get<GLenum>();
+				const s64 data_size = r.get<s64>();
+				const GLenum usage = r.get<GLenum>();
+				const u8* data = r.get<u8>() ? r.get_bytes(&size) : nullptr;
+				if (run) glBufferData(target, (GLsizeiptr)data_size, data, usage);
+			} break;
+			case Op::BufferSubData:
+			{
+				const GLenum target = r.get<GLenum>();
+				const s64 offset = r.get<s64>();
+				const u8* data = r.get_bytes(&size);
+				if (run) glBufferSubData(target, (GLintptr)offset, (GLsizeiptr)size, data);
+			} break;
+			case Op::CopyBufferSubData:
+			{
+				const GLenum read_target = r.get<GLenum>(), write_target = r.get<GLenum>();
+				const s64 read_offset = r.get<s64>(), write_offset = r.get<s64>(), copy_size = r.get<s64>();
+				if (run) glCopyBufferSubData(read_target, write_target, (GLintptr)read_offset, (GLintptr)write_offset, (GLsizeiptr)copy_size);
+			} break;
+			case Op::BindBufferBase:
+			{
+				const GLenum target = r.get<GLenum>();
+				const GLuint index = r.get<GLuint>(), buffer = r.get<GLuint>();
+				if (run) glBindBufferBase(target, index, map_name(buffers, buffer));
+			} break;
+
+			case Op::CreateShader:
+			{
+				const GLenum type = r.get<GLenum>();
+				const GLuint recorded = r.get<GLuint>();
+				if (run) shaders[recorded] = glCreateShader(type);
+			} break;
+			case Op::DeleteShader: { const GLuint s = r.get<GLuint>(); if (run) glDeleteShader(map_name(shaders, s)); } break;
+			case Op::ShaderSource:
+			{
+				const GLuint shader = r.get<GLuint>();
+				const GLsizei count = r.get<GLsizei>();
+				std::vector<const GLchar*> strings(count);
+				std::vector<GLint> lengths(count);
+				for (GLsizei i = 0; i < count; ++i)
+				{
+					strings[i] = (const GLchar*)r.get_bytes(&size);
+					lengths[i] = (GLint)size;
+				}
+				if (run) glShaderSource(map_name(shaders, shader), count, strings.data(), lengths.data());
+			} break;
+			case Op::CompileShader: { const GLuint s = r.get<GLuint>(); if (run) glCompileShader(map_name(shaders, s)); } break;
+			case Op::CreateProgram: { const GLuint recorded = r.get<GLuint>(); if (run) programs[recorded] = glCreateProgram(); } break;
+			case Op::DeleteProgram: { const GLuint p = r.get<GLuint>(); if (run) glDeleteProgram(map_name(programs, p)); } break;
+			case Op::AttachShader:
+			{
+				const GLuint p = r.get<GLuint>(), s = r.get<GLuint>();
+				if (run) glAttachShader(map_name(programs, p), map_name(shaders, s));
+			} break;
+			case Op::LinkProgram: { const GLuint p = r.get<GLuint>(); if (run) glLinkProgram(map_name(programs, p)); } break;
+			case Op::UseProgram:
+			{
+				const GLuint p = r.get<GLuint>();
+				if (run)
+				{
+					current_program = p;
+					glUseProgram(map_name(programs, p));
+				}
+			} break;
+
+			case Op::GetUniformLocation:
+			case Op::GetAttribLocation:
+			{
+				const GLuint p = r.get<GLuint>();
+				const u8* name = r.get_bytes(&size);
+				const GLint recorded = r.get<GLint>();
+				if (run && recorded >= 0)
+				{
+					const std::string str((const char*)name, size);
+					if (o == Op::GetUniformLocation)
+						uniform_locations[(u64)p << 32 | (u32)recorded] = glGetUniformLocation(map_name(programs, p), str.c_str());
+					else
+						glGetAttribLocation(map_name(programs, p), str.c_str()); // attribute indices are baked into the VAO setup calls
+				}
+			} break;
+			case Op::GetUniformBlockIndex:
+			{
+				const GLuint p = r.get<GLuint>();
+				const u8* name = r.get_bytes(&size);
+				const GLuint recorded = r.get<GLuint>();
+				if (run)
+				{
+					const std::string str((const char*)name, size);
+					block_indices[(u64)p << 32 | recorded] = glGetUniformBlockIndex(map_name(programs, p), str.c_str());
+				}
+			} break;
+			case Op::UniformBlockBinding:
+			{
+				const GLuint p = r.get<GLuint>(), index = r.get<GLuint>(), binding = r.get<GLuint>();
+				if (run)
+				{
+					auto it = block_indices.find((u64)p << 32 | index);
+					glUniformBlockBinding(map_name(programs, p), it != block_indices.end() ? it->second : index, binding);
+				}
+			} break;
+			case Op::UniformMatrix4fv:
+			{
+				const GLint location = r.get<GLint>();
+				const GLsizei count = r.get<GLsizei>();
+				const GLboolean transpose = r.get<GLboolean>();
+				const GLfloat* value = (const GLfloat*)r.get_bytes(&size);
+				if (run) glUniformMatrix4fv(map_location(location), count, transpose, value);
+			} break;
+			case Op::Uniform1f:
+			{
+				const GLint location = r.get<GLint>();
+				const GLfloat v = r.get<GLfloat>();
+				if (run) glUniform1f(map_location(location), v);
+			} break;
+			case Op::Uniform1i:
+			{
+				const GLint location = r.get<GLint>();
+				const GLint v = r.get<GLint>();
+				if (run) glUniform1i(map_location(location), v);
+			} break;
+			case Op::Uniform4fv:
+			{
+				const GLint location = r.get<GLint>();
+				const GLsizei count = r.get<GLsizei>();
+				const GLfloat* value = (const GLfloat*)r.get_bytes(&size);
+				if (run) glUniform4fv(map_location(location), count, value);
+			} break;
+
+			case Op::BindVertexArray: { const GLuint v = r.get<GLuint>(); if (run) glBindVertexArray(map_name(vertex_arrays, v)); } break;
+			case Op::EnableVertexAttribArray: { const GLuint i = r.get<GLuint>(); if (run) glEnableVertexAttribArray(i); } break;
+			case Op::VertexAttribPointer:
+			{
+				const GLuint index = r.get<GLuint>();
+				const GLint components = r.get<GLint>();
+				const GLenum type = r.get<GLenum>();
+				const GLboolean normalized = r.get<GLboolean>();
+				const GLsizei stride = r.get<GLsizei>();
+				const u64 offset = r.get<u64>();
+				if (run) glVertexAttribPointer(index, components, type, normalized, stride, (const void*)offset);
+			} break;
+			case Op::DrawArrays:
+			{
+				const GLenum mode = r.get<GLenum>();
+				const GLint first = r.get<GLint>();
+				const GLsizei count = r.get<GLsizei>();
+				if (run) glDrawArrays(mode, first, count);
+			} break;
+			case Op::DrawElements:
+			{
+				const GLenum mode = r.get<GLenum>();
+				const GLsizei count = r.get<GLsizei>();
+				const GLenum type = r.get<GLenum>();
+				const u64 offset = r.get<u64>();
+				if (run) glDrawElements(mode, count, type, (const void*)offset);
+			} break;
+			case Op::VertexAttribDivisor:
+			{
+				const GLuint index = r.get<GLuint>(), divisor = r.get<GLuint>();
+				if (run) glVertexAttribDivisor(index, divisor);
+			} break;
+			case Op::DrawElementsBaseVertex:
+			case Op::DrawElementsInstancedBaseVertex:
+			{
+				const GLenum mode = r.get<GLenum>();
+				const GLsizei count = r.get<GLsizei>();
+				const GLenum type = r.get<GLenum>();
+				const u64 offset = r.get<u64>();
+				const GLsizei instances = o == Op::DrawElementsInstancedBaseVertex ? r.get<GLsizei>() : 1;
+				const GLint base_vertex = r.get<GLint>();
+				if (run)
+				{
+					if (o == Op::DrawElementsBaseVertex)
+						glDrawElementsBaseVertex(mode, count, type, (const void*)offset, base_vertex);
+					else
+						glDrawElementsInstancedBaseVertex(mode, count, type, (const void*)offset, instances, base_vertex);
+				}
+			} break;
+
+			case Op::BindFramebuffer:
+			{
+				const GLenum target = r.get<GLenum>();
+				const GLuint fbo = r.get<GLuint>();
+				if (run) glBindFramebuffer(target, map_name(framebuffers, fbo));
+			} break;
+			case Op::BlitFramebuffer:
+			{
+				GLint c[8];
+				for (GLint& v : c)
+					v = r.get<GLint>();
+				const GLbitfield mask = r.get<GLbitfield>();
+				const GLenum filter = r.get<GLenum>();
+				if (run) glBlitFramebuffer(c[0], c[1], c[2], c[3], c[4], c[5], c[6], c[7], mask, filter);
+			} break;
+			case Op::FramebufferTexture2D:
+			{
+				const GLenum target = r.get<GLenum>(), attachment = r.get<GLenum>(), textarget = r.get<GLenum>();
+				const GLuint texture = r.get<GLuint>();
+				const GLint level = r.get<GLint>();
+				if (run) glFramebufferTexture2D(target, attachment, textarget, map_name(textures, texture), level);
+			} break;
+			case Op::FramebufferRenderbuffer:
+			{
+				const GLenum target = r.get<GLenum>(), attachment = r.get<GLenum>(), rbtarget = r.get<GLenum>();
+				const GLuint rb = r.get<GLuint>();
+				if (run) glFramebufferRenderbuffer(target, attachment, rbtarget, map_name(renderbuffers, rb));
+			} break;
+			case Op::CheckFramebufferStatus: { const GLenum target = r.get<GLenum>(); if (run) glCheckFramebufferStatus(target); } break;
+
+			case Op::BindTexture:
+			{
+				const GLenum target = r.get<GLenum>();
+				const GLuint texture = r.get<GLuint>();
+				if (run) glBindTexture(target, map_name(textures, texture));
+			} break;
+			case Op::TexImage2D:
+			{
+				const GLenum target = r.get<GLenum>();
+				const GLint level = r.get<GLint>(), internal_format = r.get<GLint>();
+				const GLsizei w = r.get<GLsizei>(), h = r.get<GLsizei>();
+				const GLint border = r.get<GLint>();
+				const GLenum format = r.get<GLenum>(), type = r.get<GLenum>();
+				const u8* pixels = r.get_pixels(&size);
+				if (run) glTexImage2D(target, level, internal_format, w, h, border, format, type, pixels);
+			} break;
+			case Op::TexParameteri:
+			{
+				const GLenum target = r.get<GLenum>(), pname = r.get<GLenum>();
+				const GLint param = r.get<GLint>();
+				if (run) glTexParameteri(target, pname, param);
+			} break;
+			case Op::ActiveTexture: { const GLenum unit = r.get<GLenum>(); if (run) glActiveTexture(unit); } break;
+			case Op::TexBuffer:
+			{
+				const GLenum target = r.get<GLenum>(), internal_format = r.get<GLenum>();
+				const GLuint buffer = r.get<GLuint>();
+				if (run) glTexBuffer(target, internal_format, map_name(buffers, buffer));
+			} break;
+			case Op::TexStorage2D:
+			{
+				const GLenum target = r.get<GLenum>();
+				const GLsizei levels = r.get<GLsizei>();
+				const GLenum internal_format = r.get<GLenum>();
+				const GLsizei w = r.get<GLsizei>(), h = r.get<GLsizei>();
+				if (run) glTexStorage2D(target, levels, internal_format, w, h);
+			} break;
+			case Op::TexSubImage2D:
+			{
+				const GLenum target = r.get<GLenum>();
+				const GLint level = r.get<GLint>(), x = r.get<GLint>(), y = r.get<GLint>();
+				const GLsizei w = r.get<GLsizei>(), h = r.get<GLsizei>();
+				const GLenum format = r.get<GLenum>(), type = r.get<GLenum>();
+				const u8* pixels = r.get_pixels(&size);
+				if (run) glTexSubImage2D(target, level, x, y, w, h, format, type, pixels);
+			} break;
+			case Op::CompressedTexImage2D:
+			{
+				const GLenum target = r.get<GLenum>();
+				const GLint level = r.get<GLint>();
+				const GLenum internal_format = r.get<GLenum>();
+				const GLsizei w = r.get<GLsizei>(), h = r.get<GLsizei>();
+				const GLint border = r.get<GLint>();
+				const GLsizei image_size = r.get<GLsizei>();
+				const u8* data = r.get_pixels(&size);
+				if (run) glCompressedTexImage2D(target, level, internal_format, w, h, border, image_size, data);
+			} break;
+			case Op::CompressedTexSubImage2D:
+			{
+				const GLenum target = r.get<GLenum>();
+				const GLint level = r.get<GLint>(), x = r.get<GLint>(), y = r.get<GLint>();
+				const GLsizei w = r.get<GLsizei>(), h = r.get<GLsizei>();
+				const GLenum format = r.get<GLenum>();
+				const GLsizei image_size = r.get<GLsizei>();
+				const u8* data = r.get_pixels(&size);
+				if (run) glCompressedTexSubImage2D(target, level, x, y, w, h, format, image_size, data);
+			} break;
+
+			case Op::BindRenderbuffer:
+			{
+				const GLenum target = r.get<GLenum>();
+				const GLuint rb = r.get<GLuint>();
+				if (run) glBindRenderbuffer(target, map_name(renderbuffers, rb));
+			} break;
+			case Op::RenderbufferStorage:
+			{
+				const GLenum target = r.get<GLenum>(), internal_format = r.get<GLenum>();
+				const GLsizei w = r.get<GLsizei>(), h = r.get<GLsizei>();
+				if (run) glRenderbufferStorage(target, internal_format, w, h);
+			} break;
+
+			case Op::QueryCounter:
+			{
+				const GLuint id = r.get<GLuint>();
+				const GLenum target = r.get<GLenum>();
+				if (run) glQueryCounter(map_name(queries, id), target);
+			} break;
+			case Op::GetQueryObjectui64v:
+			{
+				// not replayed, reading back the app's own timers would sync every replayed frame with the GPU
+				r.get<GLuint>();
+				r.get<GLenum>();
+			} break;
+
+			default:
+				return false;
+			}
+			return true;
+		}
+	};
+}
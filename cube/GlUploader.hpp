@@ -0,0 +1,352 @@
+#pragma once
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <chrono>
+
+#include <glad/glad.h>
+
+#include "Utils.hpp"
+#include "my_math.h"
+#include "Metrics.hpp"
+#include "GlBackend.hpp"
+#include "Texture.hpp"
+
+//? Buffer and texture uploads off the render thread. An upload thread with its own context, shared with
+//? the render thread's, creates the object and fills it in slices, then fences it. The render thread polls
+//? the fences in begin_frame() and gets finished objects through a callback. An object changed by another
+//? context shows the changes once it is bound again, which every user of the callback does anyway.
+//? The upload thread gets frame_budget bytes per frame, so a big mesh goes in over several frames instead
+//? of competing with the frame for the driver and the bus all at once. Without a context (mock builds
+//? with no thread, --record) the same slices run inside begin_frame() under the same budget.
+//! Vertex arrays aren't shared between contexts, rebinding a new buffer into one is the callback's job.
+
+namespace lib
+{
+	struct UploadStats
+	{
+		u64 requests = 0;
+		u64 completed = 0;
+		u64 bytes = 0;
+		u64 slices = 0;
+		u64 limited_frames = 0; // frames that ran out of budget with work left
+		f64 latency_ms = 0.0;   // request to callback, summed over completed
+		f64 max_latency_ms = 0.0;
+		f64 max_slice_ms = 0.0; // longest single GL call, a driver stall shows up here
+	};
+
+	struct GlUploader
+	{
+		using Done = std::function<void(GLuint object)>;
+		using Context = std::function<void(b32 current)>; // true on the upload thread at start, false at exit
+
+		u64 frame_budget = 8ull << 20;
+		u64 slice_size = 1ull << 20;
+		b32 threaded = false;
+		UploadStats stats;
+
+		//? A null context keeps uploads on the render thread, inside begin_frame()
+		void init(u64 bytes_per_frame, Context context)
+		{
+			frame_budget = bytes_per_frame ? bytes_per_frame : 1;
+			budget_left = (s64)frame_budget;
+			quit = false;
+			threaded = context != nullptr;
+			if (threaded)
+			{
+				worker = std::thread([this, context]
+					{
+						glbackend::counting = false; // lib::metrics is the render thread's, begin_frame() adds our bytes
+						context(true);
+						thread_loop();
+						context(false);
+					});
+			}
+		}
+
+		//? Drops uploads that haven't finished, their callbacks never run
+		void destroy()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				quit = true;
+			}
+			wake.notify_all();
+			if (worker.joinable())
+				worker.join();
+			for (Fenced& f : fenced)
+				glDeleteSync(f.fence);
+			fenced.clear();
+			jobs.clear();
+		}
+
+		//! data must stay valid until done runs
+		void upload_buffer(const void* data, u64 size, Done done)
+		{
+			Job job{};
+			job.data = (const u8*)data;
+			job.size = size;
+			job.done = static_cast<Done&&>(done);
+			push(static_cast<Job&&>(job));
+		}
+
+		//? Into an existing buffer at byte offset, a range of a GpuHeap; done gets buffer
+		//! data must stay valid until done runs, and nothing else may write the range meanwhile
+		void upload_buffer_range(GLuint buffer, u64 offset, const void* data, u64 size, Done done)
+		{
+			Job job{};
+			job.data = (const u8*)data;
+			job.size = size;
+			job.object = buffer;
+			job.base = offset;
+			job.done = static_cast<Done&&>(done);
+			push(static_cast<Job&&>(job));
+		}
+
+		//? sRGB RGBA8 with every level of chain, sampling as upload_texture() sets it
+		//! chain must stay valid until done runs
+		void upload_texture(const MipChain& chain, Done done)
+		{
+			Job job{};
+			job.chain = &chain;
+			for (const MipLevel& l : chain.levels)
+				job.size += (u64)l.width * l.height * 4;
+			job.done = static_cast<Done&&>(done);
+			push(static_cast<Job&&>(job));
+		}
+
+		//? Render thread, once per frame: refills the budget and runs callbacks of uploads that are done
+		void begin_frame()
+		{
+			u64 uploaded_bytes;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!jobs.empty() && budget_left <= 0)
+					++stats.limited_frames;
+				budget_left = (s64)frame_budget;
+				uploaded_bytes = uploaded;
+				uploaded = 0;
+			}
+			if (threaded)
+			{
+				metrics.current.bytes_uploaded += uploaded_bytes; // the hooks don't count that thread
+				wake.notify_one();
+			}
+			else
+			{
+				while (run_slice()) {}
+			}
+
+			// in order, the first that isn't signalled holds back the rest
+			std::vector<Fenced> ready;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				u32 count = 0;
+				while (count < (u32)fenced.size())
+				{
+					const GLenum state = glClientWaitSync(fenced[count].fence, 0, 0);
+					if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+						break;
+					++count;
+				}
+				ready.assign(fenced.begin(), fenced.begin() + count);
+				fenced.erase(fenced.begin(), fenced.begin() + count);
+			}
+			const auto now = std::chrono::steady_clock::now();
+			for (Fenced& f : ready)
+			{
+				glDeleteSync(f.fence);
+				const f64 ms = std::chrono::duration<f64, std::milli>(now - f.start).count();
+				++stats.completed;
+				stats.latency_ms += ms;
+				stats.max_latency_ms = ms > stats.max_latency_ms ? ms : stats.max_latency_ms;
+				f.done(f.object); // may queue more uploads, no lock held
+			}
+		}
+
+		b32 idle()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return jobs.empty() && fenced.empty();
+		}
+
+		void print_summary() const
+		{
+			if (!stats.requests)
+				return;
+			printf("uploads (%s): %llu requests, %llu done, %.1f MiB in %llu slices, %.1f MiB per frame budget, %llu frames at the budget, "
+				"latency avg %.2f ms, max %.2f ms, longest call %.3f ms\n",
+				threaded ? "upload thread" : "render thread", (unsigned long long)stats.requests, (unsigned long long)stats.completed,
+				stats.bytes / (1024.0 * 1024.0), (unsigned long long)stats.slices, frame_budget / (1024.0 * 1024.0),
+				(unsigned long long)stats.limited_frames, stats.completed ? stats.latency_ms / stats.completed : 0.0, stats.max_latency_ms,
+				stats.max_slice_ms);
+		}
+
+	private:
+		struct Job
+		{
+			const u8* data;
+			const MipChain* chain; // texture when set
+			u64 size;
+			Done done;
+			GLuint object;
+			u64 base;              // buffers: where in object the data goes
+			u64 offset;            // buffers: bytes written
+			u32 level;             // textures: next rows to write
+			s32 row;
+			std::chrono::steady_clock::time_point start;
+		};
+
+		struct Fenced
+		{
+			GLsync fence;
+			GLuint object;
+			Done done;
+			std::chrono::steady_clock::time_point start;
+		};
+
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::deque<Job> jobs;        // front is in progress, only the one running slices pops it
+		std::vector<Fenced> fenced;
+		std::thread worker;
+		s64 budget_left = 0;
+		u64 uploaded = 0;            // since the last begin_frame()
+		b32 quit = false;
+
+		void push(Job&& job)
+		{
+			job.start = std::chrono::steady_clock::now();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				jobs.push_back(static_cast<Job&&>(job));
+				++stats.requests;
+			}
+			wake.notify_one();
+		}
+
+		void thread_loop()
+		{
+			for (;;)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					wake.wait(lock, [this] { return quit || (!jobs.empty() && budget_left > 0); });
+					if (quit)
+						return;
+				}
+				run_slice();
+			}
+		}
+
+		//? One GL call worth of the front job, false when there is nothing to do or no budget left
+		b32 run_slice()
+		{
+			Job* job;
+			u64 bytes;
+			s32 rows = 0;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (jobs.empty() || budget_left <= 0)
+					return false;
+				job = &jobs.front(); // deque references survive push_back
+				bytes = min<u64>(min<u64>(slice_size, (u64)budget_left), job->size - job->offset);
+				if (job->chain)
+				{
+					// whole rows of the current level, at least one even when that goes over the budget
+					const MipLevel& l = job->chain->levels[job->level];
+					const u64 row_bytes = (u64)l.width * 4;
+					rows = (s32)min<u64>(max<u64>(bytes / row_bytes, 1), (u64)(l.height - job->row));
+					bytes = rows * row_bytes;
+				}
+				budget_left -= (s64)bytes;
+			}
+
+			const auto start = std::chrono::steady_clock::now();
+			if (job->chain)
+				texture_slice(*job, rows);
+			else
+				buffer_slice(*job, bytes);
+			job->offset += bytes;
+			const f64 ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			GLsync fence = nullptr;
+			if (job->offset >= job->size)
+			{
+				// the render thread waits on this from its own context, it has to reach the driver first
+				fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				glFlush();
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			uploaded += bytes;
+			stats.bytes += bytes;
+			++stats.slices;
+			stats.max_slice_ms = ms > stats.max_slice_ms ? ms : stats.max_slice_ms;
+			if (fence)
+			{
+				fenced.push_back({ fence, job->object, static_cast<Done&&>(job->done), job->start });
+				jobs.pop_front();
+			}
+			return true;
+		}
+
+		void buffer_slice(Job& job, u64 bytes)
+		{
+			// a target no vertex array state hangs off
+			if (!job.object)
+			{
+				glGenBuffers(1, &job.object);
+				glBindBuffer(GL_COPY_WRITE_BUFFER, job.object);
+				glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)job.size, nullptr, GL_STATIC_DRAW);
+			}
+			else
+			{
+				glBindBuffer(GL_COPY_WRITE_BUFFER, job.object);
+			}
+			if (bytes)
+				glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)(job.base + job.offset), (GLsizeiptr)bytes, job.data + job.offset);
+		}
+
+		void texture_slice(Job& job, s32 rows)
+		{
+			const MipChain& chain = *job.chain;
+			const GLsizei levels = (GLsizei)chain.levels.size();
+			if (!job.object)
+			{
+				glGenTextures(1, &job.object);
+				glBindTexture(GL_TEXTURE_2D, job.object);
+				if (GLAD_GL_VERSION_4_2)
+				{
+					glTexStorage2D(GL_TEXTURE_2D, levels, GL_SRGB8_ALPHA8, chain.width, chain.height);
+				}
+				else
+				{
+					for (GLsizei level = 0; level < levels; ++level)
+						glTexImage2D(GL_TEXTURE_2D, level, GL_SRGB8_ALPHA8, chain.levels[level].width, chain.levels[level].height, 0,
+							GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+				}
+				set_texture_sampling();
+			}
+			else
+			{
+				glBindTexture(GL_TEXTURE_2D, job.object);
+			}
+
+			// rows of one level are contiguous, no unpack row length needed
+			const MipLevel& l = chain.levels[job.level];
+			glTexSubImage2D(GL_TEXTURE_2D, (GLint)job.level, 0, job.row, l.width, rows, GL_RGBA, GL_UNSIGNED_BYTE,
+				chain.level_pixels(job.level) + (size_t)job.row * l.width * 4);
+			job.row += rows;
+			if (job.row == l.height)
+			{
+				job.row = 0;
+				++job.level;
+			}
+		}
+	};
+}
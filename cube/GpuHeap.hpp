@@ -0,0 +1,566 @@
+#pragma once
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <bit>
+
+#include <glad/glad.h>
+
+#include "Utils.hpp"
+#include "my_math.h"
+#include "GpuMemory.hpp"
+
+//? Geometry sub-allocated from a few big buffers instead of a buffer per mesh. Sizes and offsets are in
+//? elements of one size (a vertex, an index), so an offset is directly a base vertex or a first index.
+//? Each page is a GL buffer with a TLSF allocator (two-level segregated fit: size classes by power of two,
+//? each split 16 ways, bitmaps to find a big enough free block in O(1), neighbours merged on free).
+//? defragment() copies ranges down into holes with glCopyBufferSubData, a budget at a time, and frees
+//? pages that end up empty. Allocations are handles, so users look up where a range is when they draw.
+
+namespace lib
+{
+	struct TlsfAllocator
+	{
+		static constexpr u32 sl_bits = 4;
+		static constexpr u32 sl_count = 1u << sl_bits;
+		static constexpr u32 fl_count = 32 - sl_bits + 1;
+		static constexpr u32 none = ~0u;
+
+		struct Block
+		{
+			u32 offset;
+			u32 size;
+			u32 prev_phys;
+			u32 next_phys;
+			u32 prev_free;
+			u32 next_free;
+			b32 free;
+		};
+
+		u32 capacity = 0;
+		u32 used = 0;
+		u32 free_count = 0;              // free blocks
+		std::vector<Block> blocks;       // records, unused ones chained through next_free
+		u32 unused = none;
+		u32 fl_map = 0;
+		u32 sl_map[fl_count] = {};
+		u32 heads[fl_count][sl_count];
+
+		void init(u32 size)
+		{
+			capacity = size;
+			used = 0;
+			free_count = 0;
+			blocks.clear();
+			unused = none;
+			fl_map = 0;
+			for (u32 fl = 0; fl < fl_count; ++fl)
+			{
+				sl_map[fl] = 0;
+				for (u32& head : heads[fl])
+					head = none;
+			}
+			// block 0 always starts at offset 0, merges keep the lower block
+			const u32 first = new_block();
+			blocks[first] = { 0, size, none, none, none, none, true };
+			insert_free(first);
+		}
+
+		//? Good fit, none when no free block is big enough
+		u32 alloc(u32 size)
+		{
+			if (size == 0 || size > capacity - used)
+				return none;
+			// round up to the next class boundary, every block in that class is big enough
+			u32 search = size;
+			if (size >= sl_count)
+				search += (1u << (msb(size) - sl_bits)) - 1;
+			if (search < size)
+				return alloc_in_class(size);
+			u32 fl, sl;
+			mapping(search, fl, sl);
+			u32 sl_bits_set = fl < fl_count ? sl_map[fl] & (~0u << sl) : 0;
+			if (!sl_bits_set)
+			{
+				const u32 fl_bits_set = fl + 1 < fl_count ? fl_map & (~0u << (fl + 1)) : 0;
+				if (!fl_bits_set)
+					return alloc_in_class(size);
+				fl = lsb(fl_bits_set);
+				sl_bits_set = sl_map[fl];
+			}
+			sl = lsb(sl_bits_set);
+			const u32 block = heads[fl][sl];
+			remove_free(block);
+			return take(block, size);
+		}
+
+		//? Blocks of size's own class may fit too, the rounded search skips them; only when nothing bigger is free
+		u32 alloc_in_class(u32 size)
+		{
+			u32 fl, sl;
+			mapping(size, fl, sl);
+			for (u32 b = heads[fl][sl]; b != none; b = blocks[b].next_free)
+			{
+				if (blocks[b].size >= size)
+				{
+					remove_free(b);
+					return take(b, size);
+				}
+			}
+			return none;
+		}
+
+		//? Lowest free block that fits and ends at or below limit, for compaction; walks every block
+		u32 alloc_low(u32 size, u32 limit)
+		{
+			for (u32 b = 0; b != none && blocks[b].offset + size <= limit; b = blocks[b].next_phys)
+			{
+				if (blocks[b].free && blocks[b].size >= size)
+				{
+					remove_free(b);
+					return take(b, size);
+				}
+			}
+			return none;
+		}
+
+		void free(u32 block)
+		{
+			Block& b = blocks[block];
+			used -= b.size;
+			b.free = true;
+			u32 merged = block;
+			const u32 next = b.next_phys;
+			if (next != none && blocks[next].free)
+			{
+				remove_free(next);
+				absorb_next(merged);
+			}
+			const u32 prev = blocks[merged].prev_phys;
+			if (prev != none && blocks[prev].free)
+			{
+				remove_free(prev);
+				absorb_next(prev);
+				merged = prev;
+			}
+			insert_free(merged);
+		}
+
+		u32 offset(u32 block) const
+		{
+			return blocks[block].offset;
+		}
+
+		//? Largest free block, scans one list of the highest non-empty class
+		u32 largest_free() const
+		{
+			if (!fl_map)
+				return 0;
+			const u32 fl = msb(fl_map);
+			const u32 sl = msb(sl_map[fl]);
+			u32 largest = 0;
+			for (u32 b = heads[fl][sl]; b != none; b = blocks[b].next_free)
+				largest = max(largest, blocks[b].size);
+			return largest;
+		}
+
+	private:
+		static u32 msb(u32 v)
+		{
+			return 31 - (u32)std::countl_zero(v);
+		}
+
+		static u32 lsb(u32 v)
+		{
+			return (u32)std::countr_zero(v);
+		}
+
+		//? Class of a size: exact below sl_count, then 16 steps per power of two
+		static void mapping(u32 size, u32& fl, u32& sl)
+		{
+			if (size < sl_count)
+			{
+				fl = 0;
+				sl = size;
+				return;
+			}
+			const u32 m = msb(size);
+			fl = m - sl_bits + 1;
+			sl = (size >> (m - sl_bits)) ^ sl_count;
+		}
+
+		u32 new_block()
+		{
+			if (unused != none)
+			{
+				const u32 b = unused;
+				unused = blocks[b].next_free;
+				return b;
+			}
+			blocks.push_back({});
+			return (u32)blocks.size() - 1;
+		}
+
+		void insert_free(u32 block)
+		{
+			Block& b = blocks[block];
+			u32 fl, sl;
+			mapping(b.size, fl, sl);
+			b.free = true;
+			b.prev_free = none;
+			b.next_free = heads[fl][sl];
+			if (b.next_free != none)
+				blocks[b.next_free].prev_free = block;
+			heads[fl][sl] = block;
+			fl_map |= 1u << fl;
+			sl_map[fl] |= 1u << sl;
+			++free_count;
+		}
+
+		void remove_free(u32 block)
+		{
+			Block& b = blocks[block];
+			u32 fl, sl;
+			mapping(b.size, fl, sl);
+			if (b.prev_free != none)
+				blocks[b.prev_free].next_free = b.next_free;
+			else
+				heads[fl][sl] = b.next_free;
+			if (b.next_free != none)
+				blocks[b.next_free].prev_free = b.prev_free;
+			if (heads[fl][sl] == none)
+			{
+				sl_map[fl] &= ~(1u << sl);
+				if (!sl_map[fl])
+					fl_map &= ~(1u << fl);
+			}
+			--free_count;
+		}
+
+		//? Marks a free block (already off its list) used, the rest of it goes back as a new free block
+		u32 take(u32 block, u32 size)
+		{
+			if (blocks[block].size > size)
+			{
+				const u32 rest = new_block(); // may reallocate blocks
+				Block& b = blocks[block];
+				blocks[rest] = { b.offset + size, b.size - size, block, b.next_phys, none, none, true };
+				if (b.next_phys != none)
+					blocks[b.next_phys].prev_phys = rest;
+				b.next_phys = rest;
+				b.size = size;
+				insert_free(rest);
+			}
+			blocks[block].free = false;
+			used += size;
+			return block;
+		}
+
+		void absorb_next(u32 block)
+		{
+			Block& b = blocks[block];
+			const u32 next = b.next_phys;
+			b.size += blocks[next].size;
+			b.next_phys = blocks[next].next_phys;
+			if (b.next_phys != none)
+				blocks[b.next_phys].prev_phys = block;
+			blocks[next].next_free = unused;
+			unused = next;
+		}
+	};
+
+	struct GpuHeapStats
+	{
+		u64 allocs = 0;
+		u64 frees = 0;
+		u64 failed = 0;
+		u64 moves = 0;
+		u64 moved_bytes = 0;
+		u32 pages_created = 0;
+		u32 pages_released = 0;
+		f64 defrag_ms = 0.0;
+	};
+
+	struct GpuHeap
+	{
+		static constexpr u32 none = ~0u;
+
+		struct Page
+		{
+			GLuint buffer; // 0 for a released slot
+			TlsfAllocator tlsf;
+		};
+
+		struct Allocation
+		{
+			u32 page;  // none for a free handle
+			u32 block;
+			u32 size;
+		};
+
+		const char* name = "heap";
+		u32 element_size = 1;
+		u32 page_elements = 0;
+		std::vector<Page> pages;
+		std::vector<Allocation> allocations; // indexed by handle
+		std::vector<u32> free_handles;
+		GpuHeapStats stats;
+		b32 settled = false; // the last defragment() moved all it could, nothing changed since
+
+		void init(const char* heap_name, u32 element_bytes, u32 elements_per_page)
+		{
+			name = heap_name;
+			element_size = element_bytes;
+			page_elements = elements_per_page;
+		}
+
+		void destroy()
+		{
+			for (Page& p : pages)
+			{
+				if (p.buffer)
+					glDeleteBuffers(1, &p.buffer);
+			}
+			pages.clear();
+			allocations.clear();
+			free_handles.clear();
+		}
+
+		//? Handle of a new range, none when a page for it can't be made. Creates pages on the calling
+		//? thread, which needs a context.
+		u32 alloc(u32 elements)
+		{
+			u32 page = none, block = none;
+			for (u32 p = 0; p < (u32)pages.size() && block == none; ++p)
+			{
+				if (pages[p].buffer)
+				{
+					block = pages[p].tlsf.alloc(elements);
+					page = p;
+				}
+			}
+			if (block == none)
+			{
+				page = new_page(max(elements, page_elements));
+				block = page != none ? pages[page].tlsf.alloc(elements) : none;
+			}
+			if (block == none)
+			{
+				++stats.failed;
+				return none;
+			}
+
+			u32 handle;
+			if (!free_handles.empty())
+			{
+				handle = free_handles.back();
+				free_handles.pop_back();
+			}
+			else
+			{
+				handle = (u32)allocations.size();
+				allocations.push_back({});
+			}
+			allocations[handle] = { page, block, elements };
+			settled = false;
+			++stats.allocs;
+			return handle;
+		}
+
+		void free(u32 handle)
+		{
+			Allocation& a = allocations[handle];
+			pages[a.page].tlsf.free(a.block);
+			a.page = none;
+			free_handles.push_back(handle);
+			settled = false;
+			++stats.frees;
+		}
+
+		GLuint buffer(u32 handle) const
+		{
+			return pages[allocations[handle].page].buffer;
+		}
+
+		//? In elements from the start of buffer(handle)
+		u32 offset(u32 handle) const
+		{
+			const Allocation& a = allocations[handle];
+			return pages[a.page].tlsf.offset(a.block);
+		}
+
+		u64 byte_offset(u32 handle) const
+		{
+			return (u64)offset(handle) * element_size;
+		}
+
+		//? glBufferSubData into the range, on a thread with a context
+		void upload(u32 handle, const void* data, u32 elements)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer(handle));
+			glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)byte_offset(handle), (GLsizeiptr)elements * element_size, data);
+		}
+
+		//? Moves ranges down, into holes of earlier pages or lower in their own page, until about max_bytes
+		//? were copied, then releases pages (but the first) that are empty. Returns bytes copied.
+		//! Nothing may be writing to the heap from another context meanwhile, and draws must look ranges up
+		//! again afterwards
+		u64 defragment(u64 max_bytes)
+		{
+			if (settled || (fragmentation() == 0.0 && !sparse_pages()))
+				return 0;
+			const auto start = std::chrono::steady_clock::now();
+
+			// last ranges first, they are what blocks a page from ending in one free tail
+			struct Position
+			{
+				u64 key; // page, offset
+				u32 handle;
+			};
+			std::vector<Position> order;
+			order.reserve(allocations.size() - free_handles.size());
+			for (u32 h = 0; h < (u32)allocations.size(); ++h)
+			{
+				if (allocations[h].page != none)
+					order.push_back({ ((u64)allocations[h].page << 32) | offset(h), h });
+			}
+			std::sort(order.begin(), order.end(), [](const Position& a, const Position& b) { return a.key > b.key; });
+
+			u64 moved = 0;
+			for (const Position& position : order)
+			{
+				if (moved >= max_bytes)
+					break;
+				const u32 h = position.handle;
+				Allocation& a = allocations[h];
+				const u32 from = offset(h);
+				u32 page = none, block = none;
+				// anywhere in an earlier page is good enough, in its own page it has to go down
+				for (u32 p = 0; p <= a.page && block == none; ++p)
+				{
+					if (pages[p].buffer)
+					{
+						block = p < a.page ? pages[p].tlsf.alloc(a.size) : pages[p].tlsf.alloc_low(a.size, from);
+						page = p;
+					}
+				}
+				if (block == none)
+					continue;
+
+				// source and destination never overlap, the destination was free
+				glBindBuffer(GL_COPY_READ_BUFFER, pages[a.page].buffer);
+				glBindBuffer(GL_COPY_WRITE_BUFFER, pages[page].buffer);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)from * element_size,
+					(GLintptr)pages[page].tlsf.offset(block) * element_size, (GLsizeiptr)a.size * element_size);
+				pages[a.page].tlsf.free(a.block);
+				a.page = page;
+				a.block = block;
+				moved += (u64)a.size * element_size;
+				++stats.moves;
+			}
+			stats.moved_bytes += moved;
+			settled = moved < max_bytes; // went through every range
+
+			for (u32 p = 1; p < (u32)pages.size(); ++p)
+			{
+				if (pages[p].buffer && pages[p].tlsf.used == 0)
+				{
+					glDeleteBuffers(1, &pages[p].buffer);
+					pages[p].buffer = 0;
+					++stats.pages_released;
+				}
+			}
+			stats.defrag_ms += std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+			return moved;
+		}
+
+		u32 buffer_count() const
+		{
+			u32 count = 0;
+			for (const Page& p : pages)
+				count += p.buffer ? 1 : 0;
+			return count;
+		}
+
+		u64 used_bytes() const
+		{
+			u64 used = 0;
+			for (const Page& p : pages)
+				used += p.buffer ? (u64)p.tlsf.used * element_size : 0;
+			return used;
+		}
+
+		u64 capacity_bytes() const
+		{
+			u64 capacity = 0;
+			for (const Page& p : pages)
+				capacity += p.buffer ? (u64)p.tlsf.capacity * element_size : 0;
+			return capacity;
+		}
+
+		f64 utilization() const
+		{
+			const u64 capacity = capacity_bytes();
+			return capacity ? (f64)used_bytes() / (f64)capacity : 0.0;
+		}
+
+		//? 1 - largest free block / free space, per page weighted by free space; 0 when every page's free
+		//? space is one block
+		f64 fragmentation() const
+		{
+			u64 free = 0, largest = 0;
+			for (const Page& p : pages)
+			{
+				if (!p.buffer)
+					continue;
+				free += p.tlsf.capacity - p.tlsf.used;
+				largest += p.tlsf.largest_free();
+			}
+			return free ? 1.0 - (f64)largest / (f64)free : 0.0;
+		}
+
+		void print_summary() const
+		{
+			printf("%s heap: %u buffers, %.2f of %.2f MiB used (%.1f%%), %.1f%% fragmented, %llu allocs, %llu frees, %llu failed, "
+				"%llu moves (%.2f MiB, %.2f ms), %u pages released\n",
+				name, buffer_count(), used_bytes() / (1024.0 * 1024.0), capacity_bytes() / (1024.0 * 1024.0), utilization() * 100.0,
+				fragmentation() * 100.0, (unsigned long long)stats.allocs, (unsigned long long)stats.frees, (unsigned long long)stats.failed,
+				(unsigned long long)stats.moves, stats.moved_bytes / (1024.0 * 1024.0), stats.defrag_ms, stats.pages_released);
+		}
+
+	private:
+		u32 new_page(u32 elements)
+		{
+			u32 slot = 0;
+			while (slot < (u32)pages.size() && pages[slot].buffer)
+				++slot;
+			if (slot == pages.size())
+				pages.emplace_back();
+			Page& p = pages[slot];
+			GpuCategoryScope scope(GpuCategory::vertex);
+			glGenBuffers(1, &p.buffer);
+			// a target no vertex array state hangs off
+			glBindBuffer(GL_COPY_WRITE_BUFFER, p.buffer);
+			glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)elements * element_size, nullptr, GL_STATIC_DRAW);
+			p.tlsf.init(elements);
+			++stats.pages_created;
+			return slot;
+		}
+
+		//? A page past the first that could be emptied into the others
+		b32 sparse_pages() const
+		{
+			u64 free_before = 0;
+			for (u32 p = 0; p < (u32)pages.size(); ++p)
+			{
+				if (!pages[p].buffer)
+					continue;
+				if (p > 0 && pages[p].tlsf.used <= free_before)
+					return true;
+				free_before += pages[p].tlsf.capacity - pages[p].tlsf.used;
+			}
+			return false;
+		}
+	};
+}
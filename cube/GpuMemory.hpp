@@ -0,0 +1,299 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include <mutex>
+#include <unordered_map>
+
+#include <glad/glad.h>
+
+#include "Utils.hpp"
+#include "my_math.h"
+
+//? GPU memory held by the app, by category. GlBackend's hooks report every buffer, texture level and
+//? renderbuffer allocation and delete, on any thread, so the sizes are what was asked for: the driver's
+//? padding, alignment and its own copies aren't in them. Where the driver reports memory itself
+//? (GL_NVX_gpu_memory_info, GL_ATI_meminfo) it is sampled every sample_interval frames alongside.
+//? A category comes from the target an object was allocated through unless a GpuCategoryScope names it.
+//? Budgets are per category and in total, crossing one is counted and reported once; over_budget() is
+//? for code that can give memory back (streaming, caches) to check.
+
+#ifndef GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX
+#define GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX 0x9047
+#define GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX 0x9048
+#define GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#define GL_GPU_MEMORY_INFO_EVICTION_COUNT_NVX 0x904A
+#define GL_GPU_MEMORY_INFO_EVICTED_MEMORY_NVX 0x904B
+#endif
+#ifndef GL_VBO_FREE_MEMORY_ATI
+#define GL_VBO_FREE_MEMORY_ATI 0x87FB
+#define GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+#define GL_RENDERBUFFER_FREE_MEMORY_ATI 0x87FD
+#endif
+
+namespace lib
+{
+	enum class GpuCategory : u32
+	{
+		vertex,        // vertex, index and instance data
+		uniform,
+		texture,
+		render_target,
+		staging,       // pixel pack and unpack buffers
+		other,         // texture buffers, copy targets
+		count,
+	};
+
+	inline const char* gpu_category_names[] = { "vertex", "uniform", "texture", "render target", "staging", "other" };
+
+	inline thread_local s32 gpu_category_override = -1;
+
+	//? Allocations on this thread get category while it lives
+	struct GpuCategoryScope
+	{
+		s32 previous;
+
+		explicit GpuCategoryScope(GpuCategory category) : previous(gpu_category_override)
+		{
+			gpu_category_override = (s32)category;
+		}
+
+		~GpuCategoryScope()
+		{
+			gpu_category_override = previous;
+		}
+	};
+
+	inline GpuCategory gpu_buffer_category(GLenum target)
+	{
+		if (gpu_category_override >= 0)
+			return (GpuCategory)gpu_category_override;
+		switch (target)
+		{
+		case GL_ARRAY_BUFFER:
+		case GL_ELEMENT_ARRAY_BUFFER: return GpuCategory::vertex;
+		case GL_UNIFORM_BUFFER: return GpuCategory::uniform;
+		case GL_PIXEL_PACK_BUFFER:
+		case GL_PIXEL_UNPACK_BUFFER: return GpuCategory::staging;
+		default: return GpuCategory::other;
+		}
+	}
+
+	inline GpuCategory gpu_texture_category(GpuCategory fallback)
+	{
+		return gpu_category_override >= 0 ? (GpuCategory)gpu_category_override : fallback;
+	}
+
+	//? Bytes of one level, uncompressed sizes assume 3 component formats are padded to 4
+	inline u64 gpu_texture_bytes(GLenum format, s32 width, s32 height)
+	{
+		const u64 w = (u64)max(width, 0), h = (u64)max(height, 0);
+		const u64 blocks = ((w + 3) / 4) * ((h + 3) / 4);
+		switch (format)
+		{
+		case 0x83F0: case 0x83F1: case 0x8C4C: case 0x8C4D: return blocks * 8;  // BC1
+		case 0x83F2: case 0x83F3: case 0x8C4E: case 0x8C4F:                     // BC2, BC3
+		case GL_COMPRESSED_RGBA_BPTC_UNORM: case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM: return blocks * 16;
+		case GL_R8: return w * h;
+		case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16: return w * h * 2;
+		case GL_RGBA16F: case GL_RG32F: return w * h * 8;
+		case GL_RGBA32F: return w * h * 16;
+		default: return w * h * 4;
+		}
+	}
+
+	struct GpuMemoryTracker
+	{
+		enum class Kind : u32
+		{
+			buffer,
+			texture,
+			renderbuffer,
+		};
+
+		static constexpr u32 category_count = (u32)GpuCategory::count;
+		static constexpr u32 max_levels = 16;
+		static constexpr u32 sample_interval = 60; // frames between driver queries
+
+		u64 bytes[category_count] = {};
+		u64 peak[category_count] = {};
+		u32 objects[category_count] = {};
+		u64 total = 0;
+		u64 peak_total = 0;
+		u64 budget[category_count] = {}; // 0 for none
+		u64 total_budget = 0;
+		u32 over_budget_events = 0;
+
+		// driver view in KiB, -1 when it doesn't say
+		b32 nvx = false;
+		b32 ati = false;
+		s64 dedicated_kib = -1;
+		s64 available_kib = -1;
+		s64 min_available_kib = -1;
+		s64 evicted_kib = -1;
+		s64 evictions = -1;
+
+		//? Render thread with a context: finds the driver extensions
+		void init()
+		{
+			GLint count = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+			for (GLint i = 0; i < count; ++i)
+			{
+				const char* name = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+				if (!name)
+					continue;
+				nvx |= strcmp(name, "GL_NVX_gpu_memory_info") == 0;
+				ati |= strcmp(name, "GL_ATI_meminfo") == 0;
+			}
+			sample_driver();
+		}
+
+		//? Size of a buffer or renderbuffer, replacing what it had
+		void set(Kind kind, GLuint name, GpuCategory category, u64 size)
+		{
+			if (!name)
+				return;
+			std::lock_guard<std::mutex> lock(mutex);
+			Object& o = object(kind, name, category);
+			change(o, (s64)size - (s64)o.bytes);
+		}
+
+		//? Size of one texture level, 0 releases it
+		void set_level(GLuint texture, u32 level, GpuCategory category, u64 size)
+		{
+			if (!texture || level >= max_levels)
+				return;
+			std::lock_guard<std::mutex> lock(mutex);
+			Object& o = object(Kind::texture, texture, category);
+			change(o, (s64)size - (s64)o.levels[level]);
+			o.levels[level] = size;
+		}
+
+		void release(Kind kind, GLuint name)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = tracked.find(key(kind, name));
+			if (it == tracked.end())
+				return;
+			change(it->second, -(s64)it->second.bytes);
+			--objects[(u32)it->second.category];
+			tracked.erase(it);
+		}
+
+		b32 over_budget(GpuCategory category) const
+		{
+			const u32 c = (u32)category;
+			return budget[c] && bytes[c] > budget[c];
+		}
+
+		b32 over_budget() const
+		{
+			return total_budget && total > total_budget;
+		}
+
+		//? Render thread, once per frame
+		void end_frame()
+		{
+			if (++frame % sample_interval == 0)
+				sample_driver();
+		}
+
+		void print_summary() const
+		{
+			const f64 mib = 1024.0 * 1024.0;
+			printf("gpu memory: %.2f MiB (peak %.2f)", total / mib, peak_total / mib);
+			if (total_budget)
+				printf(", budget %.0f MiB", total_budget / mib);
+			for (u32 c = 0; c < category_count; ++c)
+			{
+				if (peak[c])
+					printf(", %s %.2f (peak %.2f, %u objects)", gpu_category_names[c], bytes[c] / mib, peak[c] / mib, objects[c]);
+			}
+			printf(", %u over budget\n", over_budget_events);
+			if (available_kib >= 0)
+				printf("gpu memory (driver, %s): %.0f MiB available, lowest %.0f MiB, %.0f MiB dedicated, %lld evictions (%.0f MiB)\n",
+					nvx ? "NVX" : "ATI", available_kib / 1024.0, min_available_kib / 1024.0, dedicated_kib / 1024.0,
+					(long long)evictions, evicted_kib / 1024.0);
+		}
+
+	private:
+		struct Object
+		{
+			GpuCategory category;
+			u64 bytes;
+			u64 levels[max_levels]; // textures
+		};
+
+		std::mutex mutex;                         // allocations are made on upload threads too
+		std::unordered_map<u64, Object> tracked;  // key(kind, name)
+		u32 frame = 0;
+		u32 warned = 0;                           // bit per category, bit category_count for the total
+
+		static u64 key(Kind kind, GLuint name)
+		{
+			return ((u64)kind << 32) | name;
+		}
+
+		Object& object(Kind kind, GLuint name, GpuCategory category)
+		{
+			auto [it, inserted] = tracked.try_emplace(key(kind, name));
+			if (inserted)
+			{
+				it->second.category = category;
+				++objects[(u32)category];
+			}
+			return it->second;
+		}
+
+		void change(Object& o, s64 delta)
+		{
+			const u32 c = (u32)o.category;
+			o.bytes = (u64)((s64)o.bytes + delta);
+			bytes[c] = (u64)((s64)bytes[c] + delta);
+			total = (u64)((s64)total + delta);
+			peak[c] = max(peak[c], bytes[c]);
+			peak_total = max(peak_total, total);
+			if (delta > 0)
+			{
+				check_budget(c, bytes[c], budget[c], gpu_category_names[c]);
+				check_budget(category_count, total, total_budget, "total");
+			}
+		}
+
+		void check_budget(u32 bit, u64 used, u64 limit, const char* name)
+		{
+			if (!limit || used <= limit || (warned & (1u << bit)))
+				return;
+			warned |= 1u << bit;
+			++over_budget_events;
+			fprintf(stderr, "gpu memory: %s %.2f MiB over its %.2f MiB budget\n", name, used / (1024.0 * 1024.0), limit / (1024.0 * 1024.0));
+		}
+
+		void sample_driver()
+		{
+			if (nvx)
+			{
+				GLint dedicated = 0, available = 0, count = 0, evicted = 0;
+				glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &dedicated);
+				glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available);
+				glGetIntegerv(GL_GPU_MEMORY_INFO_EVICTION_COUNT_NVX, &count);
+				glGetIntegerv(GL_GPU_MEMORY_INFO_EVICTED_MEMORY_NVX, &evicted);
+				dedicated_kib = dedicated;
+				available_kib = available;
+				evictions = count;
+				evicted_kib = evicted;
+			}
+			else if (ati)
+			{
+				// free memory in KiB, largest free block, free auxiliary memory, largest auxiliary block
+				GLint texture[4] = {};
+				glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, texture);
+				available_kib = texture[0];
+			}
+			if (available_kib >= 0)
+				min_available_kib = min_available_kib < 0 ? available_kib : min(min_available_kib, available_kib);
+		}
+	};
+
+	inline GpuMemoryTracker gpu_memory;
+}
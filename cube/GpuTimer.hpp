@@ -0,0 +1,72 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "Utils.hpp"
+
+namespace lib
+{
+	//? GPU time measured with GL_TIMESTAMP query pairs instead of GL_TIME_ELAPSED, so timers can be nested
+	//? or overlap (frame timer around pass timers). Results are read back `latency` frames later, that way
+	//? glGetQueryObject never has to wait for the GPU. Until the ring fills up last_ms stays at 0.
+	struct GpuTimer
+	{
+		static constexpr u32 latency = 4;
+
+		GLuint queries[latency][2];
+		b32 pending[latency];
+		u32 frame;
+		f32 last_ms;
+
+		void init()
+		{
+			glGenQueries(latency * 2, &queries[0][0]);
+			for (u32 i = 0; i < latency; ++i)
+				pending[i] = false;
+			frame = 0;
+			last_ms = 0.0f;
+		}
+
+		void destroy()
+		{
+			glDeleteQueries(latency * 2, &queries[0][0]);
+		}
+
+		void begin()
+		{
+			const u32 slot = frame % latency;
+			if (pending[slot])
+				resolve(slot);
+
+			glQueryCounter(queries[slot][0], GL_TIMESTAMP);
+		}
+
+		void end()
+		{
+			const u32 slot = frame % latency;
+			glQueryCounter(queries[slot][1], GL_TIMESTAMP);
+			pending[slot] = true;
+			++frame;
+		}
+
+		//? Blocking read of every query still in flight, used at shutdown and by benchmarks
+		void flush()
+		{
+			for (u32 i = 1; i <= latency; ++i)
+			{
+				const u32 slot = (frame + i) % latency;
+				if (pending[slot])
+					resolve(slot);
+			}
+		}
+
+	private:
+		void resolve(u32 slot)
+		{
+			GLuint64 start = 0, stop = 0;
+			glGetQueryObjectui64v(queries[slot][0], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(queries[slot][1], GL_QUERY_RESULT, &stop);
+			last_ms = (f32)((f64)(stop - start) * 1e-6);
+			pending[slot] = false;
+		}
+	};
+}
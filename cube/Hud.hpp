@@ -0,0 +1,356 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include <glad/glad.h>
+
+#include "Utils.hpp"
+#include "my_math.h"
+#include "Metrics.hpp"
+#include "GpuMemory.hpp"
+
+//? Performance overlay over the finished frame: a frame time graph with p99 and max over its history, and
+//? the last frame's counters from lib::metrics and lib::gpu_memory. Text uses a built-in 5x7 font in a
+//? 96x48 glyph atlas; the graph and the background are quads on the atlas' solid cell, so the overlay is
+//? one vertex buffer refilled once per frame and one draw. Frame times are recorded while it is hidden too.
+
+namespace lib
+{
+	//? ASCII 32..127, rows top down, bit 4 is the leftmost pixel
+	inline constexpr u8 hud_font[96][7] =
+	{
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // space
+		{ 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 }, // !
+		{ 0x0a, 0x0a, 0x0a, 0x00, 0x00, 0x00, 0x00 }, // "
+		{ 0x0a, 0x0a, 0x1f, 0x0a, 0x1f, 0x0a, 0x0a }, // #
+		{ 0x04, 0x0f, 0x14, 0x0e, 0x05, 0x1e, 0x04 }, // $
+		{ 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 }, // %
+		{ 0x0c, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0d }, // &
+		{ 0x0c, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00 }, // '
+		{ 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 }, // (
+		{ 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 }, // )
+		{ 0x00, 0x04, 0x15, 0x0e, 0x15, 0x04, 0x00 }, // *
+		{ 0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00 }, // +
+		{ 0x00, 0x00, 0x00, 0x00, 0x0c, 0x04, 0x08 }, // ,
+		{ 0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00 }, // -
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c }, // .
+		{ 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 }, // /
+		{ 0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e }, // 0
+		{ 0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e }, // 1
+		{ 0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f }, // 2
+		{ 0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e }, // 3
+		{ 0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02 }, // 4
+		{ 0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e }, // 5
+		{ 0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e }, // 6
+		{ 0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 }, // 7
+		{ 0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e }, // 8
+		{ 0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c }, // 9
+		{ 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00 }, // :
+		{ 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x04, 0x08 }, // ;
+		{ 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 }, // <
+		{ 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00 }, // =
+		{ 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 }, // >
+		{ 0x0e, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, // ?
+		{ 0x0e, 0x11, 0x01, 0x0d, 0x15, 0x15, 0x0e }, // @
+		{ 0x0e, 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11 }, // A
+		{ 0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e }, // B
+		{ 0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e }, // C
+		{ 0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c }, // D
+		{ 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f }, // E
+		{ 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10 }, // F
+		{ 0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f }, // G
+		{ 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 }, // H
+		{ 0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e }, // I
+		{ 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c }, // J
+		{ 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, // K
+		{ 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f }, // L
+		{ 0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11 }, // M
+		{ 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, // N
+		{ 0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e }, // O
+		{ 0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10 }, // P
+		{ 0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d }, // Q
+		{ 0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11 }, // R
+		{ 0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e }, // S
+		{ 0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // T
+		{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e }, // U
+		{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04 }, // V
+		{ 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a }, // W
+		{ 0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11 }, // X
+		{ 0x11, 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04 }, // Y
+		{ 0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f }, // Z
+		{ 0x0e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0e }, // [
+		{ 0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00 }, // backslash
+		{ 0x0e, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0e }, // ]
+		{ 0x04, 0x0a, 0x11, 0x00, 0x00, 0x00, 0x00 }, // ^
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f }, // _
+		{ 0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00 }, // `
+		{ 0x00, 0x00, 0x0e, 0x01, 0x0f, 0x11, 0x0f }, // a
+		{ 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1e }, // b
+		{ 0x00, 0x00, 0x0e, 0x10, 0x10, 0x11, 0x0e }, // c
+		{ 0x01, 0x01, 0x0d, 0x13, 0x11, 0x11, 0x0f }, // d
+		{ 0x00, 0x00, 0x0e, 0x11, 0x1f, 0x10, 0x0e }, // e
+		{ 0x06, 0x09, 0x08, 0x1c, 0x08, 0x08, 0x08 }, // f
+		{ 0x00, 0x0f, 0x11, 0x11, 0x0f, 0x01, 0x0e }, // g
+		{ 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11 }, // h
+		{ 0x04, 0x00, 0x0c, 0x04, 0x04, 0x04, 0x0e }, // i
+		{ 0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0c }, // j
+		{ 0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12 }, // k
+		{ 0x0c, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e }, // l
+		{ 0x00, 0x00, 0x1a, 0x15, 0x15, 0x11, 0x11 }, // m
+		{ 0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11 }, // n
+		{ 0x00, 0x00, 0x0e, 0x11, 0x11, 0x11, 0x0e }, // o
+		{ 0x00, 0x00, 0x1e, 0x11, 0x1e, 0x10, 0x10 }, // p
+		{ 0x00, 0x00, 0x0d, 0x13, 0x0f, 0x01, 0x01 }, // q
+		{ 0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10 }, // r
+		{ 0x00, 0x00, 0x0e, 0x10, 0x0e, 0x01, 0x1e }, // s
+		{ 0x08, 0x08, 0x1c, 0x08, 0x08, 0x09, 0x06 }, // t
+		{ 0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0d }, // u
+		{ 0x00, 0x00, 0x11, 0x11, 0x11, 0x0a, 0x04 }, // v
+		{ 0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0a }, // w
+		{ 0x00, 0x00, 0x11, 0x0a, 0x04, 0x0a, 0x11 }, // x
+		{ 0x00, 0x00, 0x11, 0x11, 0x0f, 0x01, 0x0e }, // y
+		{ 0x00, 0x00, 0x1f, 0x02, 0x04, 0x08, 0x1f }, // z
+		{ 0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02 }, // {
+		{ 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // |
+		{ 0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08 }, // }
+		{ 0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00 }, // ~
+		{ 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f }, // solid, for quads
+	};
+
+	struct HudVertex
+	{
+		f32 x, y;  // pixels from the top left
+		f32 u, v;
+		u32 color; // RGBA8, linear
+	};
+
+	struct Hud
+	{
+		static constexpr u32 history_size = 240;
+		static constexpr s32 cell_width = 6;  // glyph and a pixel of spacing
+		static constexpr s32 cell_height = 8;
+		static constexpr s32 atlas_width = 16 * cell_width;
+		static constexpr s32 atlas_height = 6 * cell_height;
+		static constexpr GLenum texture_unit = GL_TEXTURE5;
+
+		b32 visible = false;
+		b32 in_capture = false; // drawn before FrameCapture reads the frame, otherwise after
+		f32 scale = 2.0f;       // screen pixels per font pixel
+		f32 target_ms = 1000.0f / 60.0f;
+
+		f32 frame_ms[history_size] = {};
+		u64 frames = 0;
+		// own cost, CPU side of draw()
+		u64 drawn = 0;
+		f64 cpu_ms = 0.0;
+		f64 max_cpu_ms = 0.0;
+		f64 last_cpu_ms = 0.0;
+
+		//? program takes HudVertex at locations 0..2 and has uniforms Scale (vec4, pixels to NDC) and Glyphs
+		void init(GLuint hud_program)
+		{
+			program = hud_program;
+			scale_location = glGetUniformLocation(program, "Scale");
+			glUseProgram(program);
+			glUniform1i(glGetUniformLocation(program, "Glyphs"), (GLint)(texture_unit - GL_TEXTURE0));
+
+			u8 pixels[atlas_height][atlas_width] = {};
+			for (u32 glyph = 0; glyph < 96; ++glyph)
+			{
+				const u32 x0 = glyph % 16 * cell_width, y0 = glyph / 16 * cell_height;
+				for (u32 row = 0; row < 7; ++row)
+				{
+					for (u32 column = 0; column < 5; ++column)
+						pixels[y0 + row][x0 + column] = (hud_font[glyph][row] >> (4 - column)) & 1 ? 255 : 0;
+				}
+			}
+			glGenTextures(1, &atlas);
+			glActiveTexture(texture_unit);
+			glBindTexture(GL_TEXTURE_2D, atlas);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlas_width, atlas_height, 0, GL_RED, GL_UNSIGNED_BYTE, pixels);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+			glActiveTexture(GL_TEXTURE0);
+
+			glGenVertexArrays(1, &vertex_array);
+			glBindVertexArray(vertex_array);
+			glGenBuffers(1, &vertex_buffer);
+			glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void*)offsetof(HudVertex, x));
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void*)offsetof(HudVertex, u));
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(HudVertex), (void*)offsetof(HudVertex, color));
+			glBindVertexArray(0);
+			vertices.reserve(16384);
+		}
+
+		void destroy()
+		{
+			glDeleteBuffers(1, &vertex_buffer);
+			glDeleteVertexArrays(1, &vertex_array);
+			glDeleteTextures(1, &atlas);
+		}
+
+		//? Render thread, once per frame with the window's framebuffer bound; leaves depth test and culling on
+		//? and blending off, the way the scene expects them
+		void draw(s32 width, s32 height)
+		{
+			const auto now = std::chrono::steady_clock::now();
+			if (frames)
+				frame_ms[(frames - 1) % history_size] = std::chrono::duration<f32, std::milli>(now - last_frame).count();
+			last_frame = now;
+			++frames;
+			if (!visible || width <= 0 || height <= 0)
+				return;
+
+			build();
+			glViewport(0, 0, width, height);
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_CULL_FACE);
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glUseProgram(program);
+			const f32 to_ndc[4] = { 2.0f / (f32)width, -2.0f / (f32)height, 0.0f, 0.0f };
+			glUniform4fv(scale_location, 1, to_ndc);
+			glActiveTexture(texture_unit);
+			glBindTexture(GL_TEXTURE_2D, atlas);
+			glActiveTexture(GL_TEXTURE0);
+			glBindVertexArray(vertex_array);
+			glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+			glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(vertices.size() * sizeof(HudVertex)), vertices.data(), GL_STREAM_DRAW);
+			glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+			glDisable(GL_BLEND);
+			glEnable(GL_CULL_FACE);
+			glEnable(GL_DEPTH_TEST);
+
+			last_cpu_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - now).count();
+			cpu_ms += last_cpu_ms;
+			max_cpu_ms = max(max_cpu_ms, last_cpu_ms);
+			++drawn;
+		}
+
+		void print_summary() const
+		{
+			if (drawn)
+				printf("hud: %llu frames drawn, cpu %.4f ms avg, %.4f ms max\n", (unsigned long long)drawn, cpu_ms / drawn, max_cpu_ms);
+		}
+
+	private:
+		GLuint program = 0;
+		GLuint atlas = 0;
+		GLuint vertex_array = 0;
+		GLuint vertex_buffer = 0;
+		GLint scale_location = -1;
+		std::vector<HudVertex> vertices;
+		std::chrono::steady_clock::time_point last_frame;
+
+		static constexpr u32 rgba(u32 r, u32 g, u32 b, u32 a)
+		{
+			return r | (g << 8) | (b << 16) | (a << 24);
+		}
+
+		void rect(f32 x, f32 y, f32 w, f32 h, f32 u0, f32 v0, f32 u1, f32 v1, u32 color)
+		{
+			const HudVertex a = { x, y, u0, v0, color }, b = { x + w, y, u1, v0, color };
+			const HudVertex c = { x + w, y + h, u1, v1, color }, d = { x, y + h, u0, v1, color };
+			vertices.insert(vertices.end(), { a, d, c, a, c, b });
+		}
+
+		//? Solid quad, sampled from the middle of the solid cell
+		void quad(f32 x, f32 y, f32 w, f32 h, u32 color)
+		{
+			const f32 u = (15 * cell_width + 2.5f) / atlas_width, v = (5 * cell_height + 3.5f) / atlas_height;
+			rect(x, y, w, h, u, v, u, v, color);
+		}
+
+		void text(f32 x, f32 y, u32 color, const char* s)
+		{
+			for (; *s; ++s, x += cell_width * scale)
+			{
+				const u32 c = (u8)*s >= 32 && (u8)*s < 127 ? (u8)*s : '?';
+				if (c == ' ')
+					continue;
+				const u32 glyph = c - 32;
+				const f32 u0 = (f32)(glyph % 16 * cell_width) / atlas_width, v0 = (f32)(glyph / 16 * cell_height) / atlas_height;
+				rect(x, y, 5 * scale, 7 * scale, u0, v0, u0 + 5.0f / atlas_width, v0 + 7.0f / atlas_height, color);
+			}
+		}
+
+		void build()
+		{
+			vertices.clear();
+			const u32 count = (u32)min<u64>(frames - 1, history_size);
+			f32 sorted[history_size];
+			f32 max_ms = 0.0f, sum_ms = 0.0f;
+			for (u32 i = 0; i < count; ++i)
+			{
+				sorted[i] = frame_ms[i];
+				max_ms = max(max_ms, frame_ms[i]);
+				sum_ms += frame_ms[i];
+			}
+			f32 p99 = 0.0f;
+			if (count)
+			{
+				const u32 index = (u32)((count * 99 + 99) / 100) - 1;
+				std::nth_element(sorted, sorted + index, sorted + count);
+				p99 = sorted[index];
+			}
+			const f32 avg_ms = count ? sum_ms / count : 0.0f;
+
+			const FrameMetrics& m = metrics.last;
+			const GpuMemoryTracker& g = gpu_memory;
+			const f64 mib = 1024.0 * 1024.0;
+			char lines[7][160];
+			u32 line_count = 0;
+			snprintf(lines[line_count++], sizeof(lines[0]), "frame %.2f ms  %.0f fps  p99 %.2f ms  max %.2f ms", avg_ms,
+				avg_ms > 0.0f ? 1000.0f / avg_ms : 0.0f, p99, max_ms);
+			snprintf(lines[line_count++], sizeof(lines[0]), "cpu %.2f ms  gpu %.2f ms  hud %.3f ms", m.cpu_ms, m.gpu_ms, last_cpu_ms);
+			snprintf(lines[line_count++], sizeof(lines[0]), "draws %llu  tris %llu  state %llu  uniforms %llu", (unsigned long long)m.draw_calls,
+				(unsigned long long)m.triangles, (unsigned long long)m.state_changes, (unsigned long long)m.uniform_updates);
+			snprintf(lines[line_count++], sizeof(lines[0]), "uploaded %.1f KiB  read %.1f KiB  gl calls %llu", m.bytes_uploaded / 1024.0,
+				m.bytes_read / 1024.0, (unsigned long long)m.gl_calls);
+			s32 n = snprintf(lines[line_count], sizeof(lines[0]), "gpu memory %.1f MiB  peak %.1f MiB", g.total / mib, g.peak_total / mib);
+			if (g.total_budget)
+				n += snprintf(lines[line_count] + n, sizeof(lines[0]) - n, "  budget %.0f MiB", g.total_budget / mib);
+			if (g.available_kib >= 0)
+				snprintf(lines[line_count] + n, sizeof(lines[0]) - n, "  %.0f MiB free", g.available_kib / 1024.0);
+			++line_count;
+			n = 0;
+			lines[line_count][0] = 0;
+			for (u32 c = 0; c < GpuMemoryTracker::category_count && n < (s32)sizeof(lines[0]); ++c)
+			{
+				if (g.bytes[c])
+					n += snprintf(lines[line_count] + n, sizeof(lines[0]) - n, "%s%s %.1f", n ? "  " : "", gpu_category_names[c], g.bytes[c] / mib);
+			}
+			line_count += n ? 1 : 0;
+
+			const f32 pad = 4.0f * scale;
+			const f32 line_height = cell_height * scale;
+			const f32 graph_width = 2.0f * history_size, graph_height = 20.0f * scale;
+			f32 width = graph_width;
+			for (u32 i = 0; i < line_count; ++i)
+				width = max(width, (f32)strlen(lines[i]) * cell_width * scale);
+			quad(0.0f, 0.0f, width + 2 * pad, graph_height + line_count * line_height + 3 * pad, rgba(0, 0, 0, 160));
+
+			// newest frame on the right, bars scaled so twice the target fills the graph
+			const f32 bottom = pad + graph_height;
+			for (u32 i = 0; i < count; ++i)
+			{
+				const f32 ms = frame_ms[(frames - 1 - count + i) % history_size];
+				const f32 h = min(ms / (2.0f * target_ms), 1.0f) * graph_height;
+				const u32 color = ms <= target_ms ? rgba(40, 200, 60, 255) : ms <= 1.5f * target_ms ? rgba(230, 200, 40, 255) : rgba(230, 50, 40, 255);
+				quad(pad + graph_width - 2.0f * (count - i), bottom - h, 2.0f, h, color);
+			}
+			quad(pad, bottom - 0.5f * graph_height, graph_width, 1.0f, rgba(255, 255, 255, 120));
+
+			for (u32 i = 0; i < line_count; ++i)
+				text(pad, bottom + pad + i * line_height, rgba(230, 230, 230, 255), lines[i]);
+		}
+	};
+}
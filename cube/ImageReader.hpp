@@ -0,0 +1,502 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "Utils.hpp"
+
+// QOI spec: https://qoiformat.org/qoi-specification.pdf
+// PNG spec: https://www.w3.org/TR/png/ , deflate: RFC 1951, zlib: RFC 1950
+
+namespace lib
+{
+	//? RGBA8, top-down rows
+	struct Image
+	{
+		s32 width = 0;
+		s32 height = 0;
+		std::vector<u8> pixels;
+	};
+
+	inline u32 get_u32_be(const u8* p)
+	{
+		return (u32)p[0] << 24 | (u32)p[1] << 16 | (u32)p[2] << 8 | (u32)p[3];
+	}
+
+	inline b32 decode_qoi(const u8* data, size_t size, Image& image)
+	{
+		if (size < 14 + 8 || memcmp(data, "qoif", 4) != 0)
+			return false;
+
+		const u32 width = get_u32_be(data + 4);
+		const u32 height = get_u32_be(data + 8);
+		if (width == 0 || height == 0 || (u64)width * height > (1ull << 28))
+			return false;
+
+		image.width = (s32)width;
+		image.height = (s32)height;
+		image.pixels.resize((size_t)width * height * 4);
+
+		u8 index[64][4] = {};
+		u8 px[4] = { 0, 0, 0, 255 };
+		u32 run = 0;
+		size_t at = 14;
+		const size_t end = size - 8; // end marker
+		for (u8* out = image.pixels.data(), *last = out + image.pixels.size(); out < last; out += 4)
+		{
+			if (run > 0)
+			{
+				--run;
+			}
+			else if (at < end)
+			{
+				const u8 b = data[at++];
+				if (b == 0xfe && at + 3 <= end)
+				{
+					px[0] = data[at]; px[1] = data[at + 1]; px[2] = data[at + 2];
+					at += 3;
+				}
+				else if (b == 0xff && at + 4 <= end)
+				{
+					memcpy(px, data + at, 4);
+					at += 4;
+				}
+				else if ((b & 0xc0) == 0x00)
+				{
+					memcpy(px, index[b], 4);
+				}
+				else if ((b & 0xc0) == 0x40)
+				{
+					px[0] += ((b >> 4) & 3) - 2;
+					px[1] += ((b >> 2) & 3) - 2;
+					px[2] += (b & 3) - 2;
+				}
+				else if ((b & 0xc0) == 0x80 && at < end)
+				{
+					const u8 b2 = data[at++];
+					const s32 dg = (b & 0x3f) - 32;
+					px[0] += (u8)(dg - 8 + ((b2 >> 4) & 0x0f));
+					px[1] += (u8)dg;
+					px[2] += (u8)(dg - 8 + (b2 & 0x0f));
+				}
+				else if ((b & 0xc0) == 0xc0)
+				{
+					run = b & 0x3f;
+				}
+				const u32 hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+				memcpy(index[hash], px, 4);
+			}
+			memcpy(out, px, 4);
+		}
+		return true;
+	}
+
+	//? Binary PPM (P6, maxval 255)
+	inline b32 decode_ppm(const u8* data, size_t size, Image& image)
+	{
+		if (size < 2 || data[0] != 'P' || data[1] != '6')
+			return false;
+
+		size_t at = 2;
+		u32 values[3] = {};
+		for (u32& value : values)
+		{
+			for (;;)
+			{
+				while (at < size && (data[at] == ' ' || data[at] == '\n' || data[at] == '\r' || data[at] == '\t'))
+					++at;
+				if (at < size && data[at] == '#')
+				{
+					while (at < size && data[at] != '\n')
+						++at;
+					continue;
+				}
+				break;
+			}
+			if (at >= size || data[at] < '0' || data[at] > '9')
+				return false;
+			while (at < size && data[at] >= '0' && data[at] <= '9')
+				value = value * 10 + (data[at++] - '0');
+		}
+		++at; // single whitespace before the raster
+
+		const u32 width = values[0], height = values[1];
+		if (width == 0 || height == 0 || values[2] != 255 || at + (size_t)width * height * 3 > size)
+			return false;
+
+		image.width = (s32)width;
+		image.height = (s32)height;
+		image.pixels.resize((size_t)width * height * 4);
+		const u8* src = data + at;
+		for (size_t i = 0; i < (size_t)width * height; ++i)
+		{
+			image.pixels[i * 4 + 0] = src[i * 3 + 0];
+			image.pixels[i * 4 + 1] = src[i * 3 + 1];
+			image.pixels[i * 4 + 2] = src[i * 3 + 2];
+			image.pixels[i * 4 + 3] = 255;
+		}
+		return true;
+	}
+
+	//? Small inflate for asset import: canonical Huffman decoded a bit at a time (the puff approach).
+	//? Slower than a table driven decoder, but imports happen once and mip generation dominates anyway.
+	struct Inflater
+	{
+		struct Huffman
+		{
+			u16 counts[16];
+			u16 symbols[320];
+		};
+
+		const u8* p;
+		const u8* end;
+		std::vector<u8>* out;
+		u32 bit_buffer = 0;
+		u32 bit_count = 0;
+		b32 overrun = false;
+
+		u32 bits(u32 n)
+		{
+			while (bit_count < n)
+			{
+				u32 b = 0;
+				if (p < end)
+					b = *p++;
+				else
+					overrun = true;
+				bit_buffer |= b << bit_count;
+				bit_count += 8;
+			}
+			const u32 value = bit_buffer & ((1u << n) - 1);
+			bit_buffer >>= n;
+			bit_count -= n;
+			return value;
+		}
+
+		static void build(Huffman& h, const u8* lengths, u32 n)
+		{
+			memset(h.counts, 0, sizeof(h.counts));
+			for (u32 i = 0; i < n; ++i)
+				++h.counts[lengths[i]];
+			h.counts[0] = 0;
+
+			u16 offsets[16];
+			offsets[1] = 0;
+			for (u32 len = 1; len < 15; ++len)
+				offsets[len + 1] = offsets[len] + h.counts[len];
+			for (u32 i = 0; i < n; ++i)
+			{
+				if (lengths[i])
+					h.symbols[offsets[lengths[i]]++] = (u16)i;
+			}
+		}
+
+		s32 decode(const Huffman& h)
+		{
+			s32 code = 0, first = 0, index = 0;
+			for (u32 len = 1; len < 16; ++len)
+			{
+				code |= (s32)bits(1);
+				const s32 count = h.counts[len];
+				if (code - count < first)
+					return h.symbols[index + (code - first)];
+				index += count;
+				first = (first + count) << 1;
+				code <<= 1;
+			}
+			return -1;
+		}
+
+		b32 codes(const Huffman& lengths, const Huffman& distances)
+		{
+			static const u16 length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+			static const u8 length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+			static const u16 distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+			static const u8 distance_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+			for (;;)
+			{
+				const s32 symbol = decode(lengths);
+				if (symbol < 0 || overrun)
+					return false;
+				if (symbol < 256)
+				{
+					out->push_back((u8)symbol);
+					continue;
+				}
+				if (symbol == 256)
+					return true;
+
+				const s32 l = symbol - 257;
+				if (l >= 29)
+					return false;
+				const u32 length = length_base[l] + bits(length_extra[l]);
+				const s32 d = decode(distances);
+				if (d < 0 || d >= 30)
+					return false;
+				const size_t distance = distance_base[d] + bits(distance_extra[d]);
+				if (distance > out->size())
+					return false;
+				const size_t from = out->size() - distance;
+				for (u32 i = 0; i < length; ++i)
+					out->push_back((*out)[from + i]);
+			}
+		}
+
+		b32 stored()
+		{
+			bit_buffer = 0;
+			bit_count = 0;
+			if (end - p < 4)
+				return false;
+			const u32 length = p[0] | (u32)p[1] << 8;
+			const u32 check = p[2] | (u32)p[3] << 8;
+			p += 4;
+			if (length != (~check & 0xffff) || (size_t)(end - p) < length)
+				return false;
+			out->insert(out->end(), p, p + length);
+			p += length;
+			return true;
+		}
+
+		b32 fixed()
+		{
+			Huffman lengths, distances;
+			u8 l[288];
+			for (u32 i = 0; i < 288; ++i)
+				l[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+			build(lengths, l, 288);
+			for (u32 i = 0; i < 30; ++i)
+				l[i] = 5;
+			build(distances, l, 30);
+			return codes(lengths, distances);
+		}
+
+		b32 dynamic()
+		{
+			static const u8 order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+			const u32 literal_count = bits(5) + 257;
+			const u32 distance_count = bits(5) + 1;
+			const u32 code_count = bits(4) + 4;
+			if (literal_count > 286 || distance_count > 30)
+				return false;
+
+			u8 l[320] = {};
+			for (u32 i = 0; i < code_count; ++i)
+				l[order[i]] = (u8)bits(3);
+			Huffman lengths, distances;
+			build(lengths, l, 19);
+
+			u32 at = 0;
+			while (at < literal_count + distance_count)
+			{
+				s32 symbol = decode(lengths);
+				if (symbol < 0 || overrun)
+					return false;
+				if (symbol < 16)
+				{
+					l[at++] = (u8)symbol;
+					continue;
+				}
+
+				u8 value = 0;
+				u32 repeat = 0;
+				if (symbol == 16)
+				{
+					if (at == 0)
+						return false;
+					value = l[at - 1];
+					repeat = 3 + bits(2);
+				}
+				else if (symbol == 17)
+				{
+					repeat = 3 + bits(3);
+				}
+				else
+				{
+					repeat = 11 + bits(7);
+				}
+				if (at + repeat > literal_count + distance_count)
+					return false;
+				while (repeat--)
+					l[at++] = value;
+			}
+
+			build(lengths, l, literal_count);
+			build(distances, l + literal_count, distance_count);
+			return codes(lengths, distances);
+		}
+
+		b32 run()
+		{
+			for (;;)
+			{
+				const u32 last = bits(1);
+				const u32 type = bits(2);
+				const b32 ok = type == 0 ? stored() : type == 1 ? fixed() : type == 2 ? dynamic() : false;
+				if (!ok || overrun)
+					return false;
+				if (last)
+					return true;
+			}
+		}
+	};
+
+	//? Raw deflate stream (no zlib header), appends to out
+	inline b32 inflate(const u8* data, size_t size, std::vector<u8>& out)
+	{
+		Inflater inflater{ data, data + size, &out };
+		return inflater.run();
+	}
+
+	inline u8 png_paeth(u8 a, u8 b, u8 c)
+	{
+		const s32 p = (s32)a + b - c;
+		const s32 pa = p > a ? p - a : a - p;
+		const s32 pb = p > b ? p - b : b - p;
+		const s32 pc = p > c ? p - c : c - p;
+		return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+	}
+
+	//? 8 bit gray, gray+alpha, RGB, RGBA and palette images without interlacing
+	inline b32 decode_png(const u8* data, size_t size, Image& image)
+	{
+		static const u8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+		if (size < 8 + 25 || memcmp(data, signature, 8) != 0)
+			return false;
+
+		u32 width = 0, height = 0, color_type = 0;
+		std::vector<u8> compressed;
+		u8 palette[256][4] = {};
+		for (size_t at = 8; at + 12 <= size;)
+		{
+			const u32 length = get_u32_be(data + at);
+			const u8* type = data + at + 4;
+			const u8* chunk = data + at + 8;
+			if (at + 12 + (size_t)length > size)
+				return false;
+
+			if (memcmp(type, "IHDR", 4) == 0 && length >= 13)
+			{
+				width = get_u32_be(chunk);
+				height = get_u32_be(chunk + 4);
+				color_type = chunk[9];
+				const u32 depth = chunk[8], interlace = chunk[12];
+				if (depth != 8 || interlace != 0 || (color_type != 0 && color_type != 2 && color_type != 3 && color_type != 4 && color_type != 6))
+					return false;
+			}
+			else if (memcmp(type, "PLTE", 4) == 0)
+			{
+				for (u32 i = 0; i < length / 3 && i < 256; ++i)
+				{
+					palette[i][0] = chunk[i * 3 + 0];
+					palette[i][1] = chunk[i * 3 + 1];
+					palette[i][2] = chunk[i * 3 + 2];
+					palette[i][3] = 255;
+				}
+			}
+			else if (memcmp(type, "tRNS", 4) == 0 && color_type == 3)
+			{
+				for (u32 i = 0; i < length && i < 256; ++i)
+					palette[i][3] = chunk[i];
+			}
+			else if (memcmp(type, "IDAT", 4) == 0)
+			{
+				compressed.insert(compressed.end(), chunk, chunk + length);
+			}
+			else if (memcmp(type, "IEND", 4) == 0)
+			{
+				break;
+			}
+			at += 12 + (size_t)length;
+		}
+
+		if (width == 0 || height == 0 || (u64)width * height > (1ull << 28) || compressed.size() < 2)
+			return false;
+
+		const u32 channels = color_type == 0 ? 1 : color_type == 2 ? 3 : color_type == 3 ? 1 : color_type == 4 ? 2 : 4;
+		const size_t stride = (size_t)width * channels;
+		std::vector<u8> raw;
+		raw.reserve((stride + 1) * height);
+		if (!inflate(compressed.data() + 2, compressed.size() - 2, raw) || raw.size() < (stride + 1) * height)
+			return false;
+
+		// unfilter in place, each row is [filter][stride bytes]
+		for (u32 y = 0; y < height; ++y)
+		{
+			u8* row = raw.data() + y * (stride + 1);
+			const u8* above = y ? raw.data() + (y - 1) * (stride + 1) + 1 : nullptr;
+			const u8 filter = row[0];
+			++row;
+			for (size_t i = 0; i < stride; ++i)
+			{
+				const u8 a = i >= channels ? row[i - channels] : 0;
+				const u8 b = above ? above[i] : 0;
+				const u8 c = above && i >= channels ? above[i - channels] : 0;
+				switch (filter)
+				{
+				case 1: row[i] += a; break;
+				case 2: row[i] += b; break;
+				case 3: row[i] += (u8)(((u32)a + b) / 2); break;
+				case 4: row[i] += png_paeth(a, b, c); break;
+				}
+			}
+		}
+
+		image.width = (s32)width;
+		image.height = (s32)height;
+		image.pixels.resize((size_t)width * height * 4);
+		for (u32 y = 0; y < height; ++y)
+		{
+			const u8* src = raw.data() + y * (stride + 1) + 1;
+			u8* dst = image.pixels.data() + (size_t)y * width * 4;
+			for (u32 x = 0; x < width; ++x, src += channels, dst += 4)
+			{
+				switch (color_type)
+				{
+				case 0: dst[0] = dst[1] = dst[2] = src[0]; dst[3] = 255; break;
+				case 2: dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = 255; break;
+				case 3: memcpy(dst, palette[src[0]], 4); break;
+				case 4: dst[0] = dst[1] = dst[2] = src[0]; dst[3] = src[1]; break;
+				case 6: memcpy(dst, src, 4); break;
+				}
+			}
+		}
+		return true;
+	}
+
+	//? Picks the decoder from the file's magic
+	//? Picks the decoder from the first bytes: QOI, PNG or binary PPM
+	inline b32 decode_image(const u8* data, size_t size, Image& image)
+	{
+		if (size < 4)
+			return false;
+		if (memcmp(data, "qoif", 4) == 0)
+			return decode_qoi(data, size, image);
+		if (data[0] == 0x89 && memcmp(data + 1, "PNG", 3) == 0)
+			return decode_png(data, size, image);
+		if (data[0] == 'P' && data[1] == '6')
+			return decode_ppm(data, size, image);
+		return false;
+	}
+
+	inline b32 load_image(const char* path, Image& image)
+	{
+		FILE* file = fopen(path, "rb");
+		if (!file)
+			return false;
+
+		std::vector<u8> data;
+		fseek(file, 0, SEEK_END);
+		const long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		if (size > 0)
+		{
+			data.resize((size_t)size);
+			if (fread(data.data(), 1, data.size(), file) != data.size())
+				data.clear();
+		}
+		fclose(file);
+		return decode_image(data.data(), data.size(), image);
+	}
+}
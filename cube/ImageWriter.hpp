@@ -0,0 +1,611 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "Utils.hpp"
+#include "my_math.h"
+#include "JobSystem.hpp"
+
+// QOI spec: https://qoiformat.org/qoi-specification.pdf
+// PNG spec: https://www.w3.org/TR/png/ , deflate: RFC 1951, zlib: RFC 1950
+
+namespace lib
+{
+	enum class ImageFormat : u32
+	{
+		qoi,
+		png,
+	};
+
+	inline const char* image_format_ext(ImageFormat format)
+	{
+		return format == ImageFormat::qoi ? "qoi" : "png";
+	}
+
+	//? RGBA8 image view, flip_y for bottom-up rows straight from glReadPixels
+	struct ImageView
+	{
+		const u8* pixels;
+		s32 width;
+		s32 height;
+		b32 flip_y;
+
+		inline const u8* row(s32 y) const
+		{
+			const s32 src_y = flip_y ? height - 1 - y : y;
+			return pixels + (size_t)src_y * width * 4;
+		}
+	};
+
+	inline void put_u32_be(std::vector<u8>& out, u32 v)
+	{
+		out.push_back((u8)(v >> 24));
+		out.push_back((u8)(v >> 16));
+		out.push_back((u8)(v >> 8));
+		out.push_back((u8)v);
+	}
+
+	inline void encode_qoi(const ImageView& image, std::vector<u8>& out)
+	{
+		constexpr u8 op_index = 0x00;
+		constexpr u8 op_diff = 0x40;
+		constexpr u8 op_luma = 0x80;
+		constexpr u8 op_run = 0xc0;
+		constexpr u8 op_rgb = 0xfe;
+		constexpr u8 op_rgba = 0xff;
+
+		out.clear();
+		// worst case is 5 bytes per pixel, reserve something more reasonable and let it grow
+		out.reserve(14 + (size_t)image.width * image.height * 2 + 8);
+		out.insert(out.end(), { 'q', 'o', 'i', 'f' });
+		put_u32_be(out, (u32)image.width);
+		put_u32_be(out, (u32)image.height);
+		out.push_back(4); // channels
+		out.push_back(0); // sRGB with linear alpha
+
+		u32 index[64] = {};
+		u32 prev = 0xff000000; // r=0 g=0 b=0 a=255, little endian RGBA
+		u32 run = 0;
+
+		for (s32 y = 0; y < image.height; ++y)
+		{
+			const u8* row = image.row(y);
+			for (s32 x = 0; x < image.width; ++x)
+			{
+				u32 px;
+				memcpy(&px, row + x * 4, 4);
+
+				if (px == prev)
+				{
+					if (++run == 62)
+					{
+						out.push_back(op_run | (u8)(run - 1));
+						run = 0;
+					}
+					continue;
+				}
+
+				if (run)
+				{
+					out.push_back(op_run | (u8)(run - 1));
+					run = 0;
+				}
+
+				const u8 r = (u8)px, g = (u8)(px >> 8), b = (u8)(px >> 16), a = (u8)(px >> 24);
+				const u32 hash = (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+
+				if (index[hash] == px)
+				{
+					out.push_back(op_index | (u8)hash);
+				}
+				else
+				{
+					index[hash] = px;
+
+					if (a == (u8)(prev >> 24))
+					{
+						const s8 vr = (s8)(r - (u8)prev);
+						const s8 vg = (s8)(g - (u8)(prev >> 8));
+						const s8 vb = (s8)(b - (u8)(prev >> 16));
+						const s8 vg_r = (s8)(vr - vg);
+						const s8 vg_b = (s8)(vb - vg);
+
+						if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+						{
+							out.push_back(op_diff | (u8)((vr + 2) << 4 | (vg + 2) << 2 | (vb + 2)));
+						}
+						else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8)
+						{
+							out.push_back(op_luma | (u8)(vg + 32));
+							out.push_back((u8)((vg_r + 8) << 4 | (vg_b + 8)));
+						}
+						else
+						{
+							out.insert(out.end(), { op_rgb, r, g, b });
+						}
+					}
+					else
+					{
+						out.insert(out.end(), { op_rgba, r, g, b, a });
+					}
+				}
+
+				prev = px;
+			}
+		}
+
+		if (run)
+			out.push_back(op_run | (u8)(run - 1));
+
+		out.insert(out.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+	}
+
+	//? Bit writer for deflate, LSB first
+	struct BitWriter
+	{
+		std::vector<u8>* out;
+		u64 bits = 0;
+		u32 count = 0;
+
+		inline void put(u32 value, u32 bit_count)
+		{
+			bits |= (u64)value << count;
+			count += bit_count;
+			while (count >= 8)
+			{
+				out->push_back((u8)bits);
+				bits >>= 8;
+				count -= 8;
+			}
+		}
+
+		//? Huffman codes go out MSB first
+		inline void put_reversed(u32 code, u32 bit_count)
+		{
+			u32 rev = 0;
+			for (u32 i = 0; i < bit_count; ++i)
+				rev |= ((code >> i) & 1) << (bit_count - 1 - i);
+			put(rev, bit_count);
+		}
+
+		inline void align()
+		{
+			if (count)
+				put(0, 8 - count);
+		}
+	};
+
+	namespace deflate
+	{
+		constexpr u32 window = 32768;
+		constexpr u32 min_match = 3;
+		constexpr u32 max_match = 258;
+		constexpr u32 hash_bits = 15;
+		constexpr u32 max_chain = 16;
+
+		constexpr u16 length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+			35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		constexpr u8 length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+			3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		constexpr u16 dist_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+			257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		constexpr u8 dist_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+			7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		inline void put_literal(BitWriter& bw, u32 sym)
+		{
+			if (sym < 144)
+				bw.put_reversed(0x30 + sym, 8);
+			else if (sym < 256)
+				bw.put_reversed(0x190 + sym - 144, 9);
+			else if (sym < 280)
+				bw.put_reversed(sym - 256, 7);
+			else
+				bw.put_reversed(0xc0 + sym - 280, 8);
+		}
+
+		inline void put_match(BitWriter& bw, u32 length, u32 distance)
+		{
+			u32 l = 28;
+			while (length_base[l] > length)
+				--l;
+			put_literal(bw, 257 + l);
+			bw.put(length - length_base[l], length_extra[l]);
+
+			u32 d = 29;
+			while (dist_base[d] > distance)
+				--d;
+			bw.put_reversed(d, 5);
+			bw.put(distance - dist_base[d], dist_extra[d]);
+		}
+
+		inline u32 hash3(const u8* p)
+		{
+			const u32 v = (u32)p[0] | (u32)p[1] << 8 | (u32)p[2] << 16;
+			return (v * 2654435761u) >> (32 - hash_bits);
+		}
+
+		//? Compresses data[begin, end) as fixed-Huffman blocks ending with a sync flush (empty stored block),
+		//? so independently compressed bands can be concatenated on byte boundaries like pigz does.
+		//? Matches may reach back into data before begin, it's part of the deflate history.
+		inline void compress_band(const u8* data, size_t begin, size_t end, std::vector<u8>& out)
+		{
+			std::vector<s32> head(1u << hash_bits, -1);
+			std::vector<s32> prev(window, -1);
+			auto insert = [&](size_t pos)
+			{
+				const u32 h = hash3(data + pos);
+				prev[pos & (window - 1)] = head[h];
+				head[h] = (s32)pos;
+			};
+
+			const size_t history = begin > window ? begin - window : 0;
+			for (size_t pos = history; pos + min_match <= begin; ++pos)
+				insert(pos);
+
+			BitWriter bw{ &out };
+			bw.put(2, 3); // BFINAL=0, BTYPE=01 fixed
+
+			size_t pos = begin;
+			while (pos < end)
+			{
+				u32 best_len = 0, best_dist = 0;
+				if (pos + min_match <= end)
+				{
+					const u32 limit = (u32)(end - pos < max_match ? end - pos : max_match);
+					s32 candidate = head[hash3(data + pos)];
+					for (u32 chain = 0; candidate >= 0 && chain < max_chain; ++chain)
+					{
+						const size_t dist = pos - (size_t)candidate;
+						if (dist > window - 1 || dist == 0)
+							break;
+
+						const u8* a = data + candidate;
+						const u8* b = data + pos;
+						u32 len = 0;
+						while (len < limit && a[len] == b[len])
+							++len;
+						if (len > best_len)
+						{
+							best_len = len;
+							best_dist = (u32)dist;
+							if (len == limit)
+								break;
+						}
+						candidate = prev[candidate & (window - 1)];
+					}
+				}
+
+				if (best_len >= min_match)
+				{
+					put_match(bw, best_len, best_dist);
+					// like zlib's fast levels, don't bother hashing the inside of long matches
+					const size_t match_end = pos + best_len;
+					const size_t insert_end = best_len <= 16 ? match_end : pos + 1;
+					for (; pos < insert_end; ++pos)
+						if (pos + min_match <= end)
+							insert(pos);
+					pos = match_end;
+				}
+				else
+				{
+					put_literal(bw, data[pos]);
+					if (pos + min_match <= end)
+						insert(pos);
+					++pos;
+				}
+			}
+
+			put_literal(bw, 256);
+			bw.put(0, 3); // BFINAL=0, BTYPE=00 stored
+			bw.align();
+			out.insert(out.end(), { 0x00, 0x00, 0xff, 0xff });
+		}
+
+		inline u32 adler32(const u8* data, size_t size)
+		{
+			constexpr u32 base = 65521;
+			constexpr size_t nmax = 5552;
+			u32 a = 1, b = 0;
+			while (size)
+			{
+				const size_t n = size < nmax ? size : nmax;
+				for (size_t i = 0; i < n; ++i)
+				{
+					a += data[i];
+					b += a;
+				}
+				a %= base;
+				b %= base;
+				data += n;
+				size -= n;
+			}
+			return b << 16 | a;
+		}
+
+		//? From zlib's adler32_combine
+		inline u32 adler32_combine(u32 adler1, u32 adler2, size_t len2)
+		{
+			constexpr u64 base = 65521;
+			const u64 rem = len2 % base;
+			u64 sum1 = adler1 & 0xffff;
+			u64 sum2 = (rem * sum1) % base;
+			sum1 += (adler2 & 0xffff) + base - 1;
+			sum2 += ((adler1 >> 16) & 0xffff) + ((adler2 >> 16) & 0xffff) + base - rem;
+			if (sum1 >= base) sum1 -= base;
+			if (sum1 >= base) sum1 -= base;
+			if (sum2 >= (base << 1)) sum2 -= (base << 1);
+			if (sum2 >= base) sum2 -= base;
+			return (u32)(sum1 | (sum2 << 16));
+		}
+	}
+
+	inline u32 crc32_update(u32 crc, const u8* data, size_t size)
+	{
+		static const auto table = []
+		{
+			struct Table { u32 e[256]; } t{};
+			for (u32 i = 0; i < 256; ++i)
+			{
+				u32 c = i;
+				for (u32 k = 0; k < 8; ++k)
+					c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				t.e[i] = c;
+			}
+			return t;
+		}();
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i)
+			crc = table.e[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	inline u8 paeth(u8 a, u8 b, u8 c)
+	{
+		const s32 p = (s32)a + b - c;
+		const s32 pa = abs(p - (s32)a), pb = abs(p - (s32)b), pc = abs(p - (s32)c);
+		return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+	}
+
+	inline u8 png_predict(u32 filter, u8 left, u8 up, u8 up_left)
+	{
+		switch (filter)
+		{
+		case 1: return left;
+		case 2: return up;
+		case 3: return (u8)(((u32)left + up) >> 1);
+		case 4: return paeth(left, up, up_left);
+		default: return 0;
+		}
+	}
+
+	//? Picks the filter with the smallest sum of absolute (signed) residuals, the usual libpng heuristic
+	inline void png_filter_row(const u8* row, const u8* above, u32 stride, u8* out)
+	{
+		constexpr u32 bpp = 4;
+
+		u64 sums[5] = {};
+		for (u32 i = 0; i < stride; ++i)
+		{
+			const u8 left = i >= bpp ? row[i - bpp] : 0;
+			const u8 up = above ? above[i] : 0;
+			const u8 up_left = above && i >= bpp ? above[i - bpp] : 0;
+			const u8 x = row[i];
+			sums[0] += (u32)abs((s32)(s8)x);
+			sums[1] += (u32)abs((s32)(s8)(u8)(x - left));
+			sums[2] += (u32)abs((s32)(s8)(u8)(x - up));
+			sums[3] += (u32)abs((s32)(s8)(u8)(x - (u8)(((u32)left + up) >> 1)));
+			sums[4] += (u32)abs((s32)(s8)(u8)(x - paeth(left, up, up_left)));
+		}
+
+		u32 best = 0;
+		for (u32 f = 1; f < 5; ++f)
+			best = sums[f] < sums[best] ? f : best;
+
+		out[0] = (u8)best;
+		for (u32 i = 0; i < stride; ++i)
+		{
+			const u8 left = i >= bpp ? row[i - bpp] : 0;
+			const u8 up = above ? above[i] : 0;
+			const u8 up_left = above && i >= bpp ? above[i - bpp] : 0;
+			out[1 + i] = (u8)(row[i] - png_predict(best, left, up, up_left));
+		}
+	}
+
+	//? Row bands are filtered and deflated in parallel, each band ends on a byte boundary so the zlib stream is
+	//? just the concatenation. Costs a few bytes per band and the matches that would cross into the next band.
+	inline void encode_png(const ImageView& image, std::vector<u8>& out, JobSystem* jobs = nullptr, u32 band_rows = 64)
+	{
+		const u32 stride = (u32)image.width * 4;
+		const size_t filtered_stride = 1 + (size_t)stride;
+		std::vector<u8> filtered(filtered_stride * image.height);
+
+		const u32 band_count = ((u32)image.height + band_rows - 1) / band_rows;
+		std::vector<std::vector<u8>> compressed(band_count);
+		std::vector<u32> adlers(band_count);
+
+		auto filter_bands = [&](u32 first, u32 last)
+		{
+			for (u32 y = first * band_rows; y < last * band_rows && y < (u32)image.height; ++y)
+				png_filter_row(image.row(y), y ? image.row(y - 1) : nullptr, stride, filtered.data() + y * filtered_stride);
+		};
+
+		auto compress_bands = [&](u32 first, u32 last)
+		{
+			for (u32 band = first; band < last; ++band)
+			{
+				const size_t begin = (size_t)band * band_rows * filtered_stride;
+				const size_t end = min(begin + band_rows * filtered_stride, filtered.size());
+				compressed[band].reserve((end - begin) / 2);
+				deflate::compress_band(filtered.data(), begin, end, compressed[band]);
+				adlers[band] = deflate::adler32(filtered.data() + begin, end - begin);
+			}
+		};
+
+		// filtering has to finish before compression, bands look back into the previous band's data
+		if (jobs)
+		{
+			jobs->parallel_for(band_count, 1, filter_bands);
+			jobs->parallel_for(band_count, 1, compress_bands);
+		}
+		else
+		{
+			filter_bands(0, band_count);
+			compress_bands(0, band_count);
+		}
+
+		u32 adler = 1;
+		size_t zlib_size = 2 + 2 + 4;
+		for (u32 band = 0; band < band_count; ++band)
+		{
+			const size_t begin = (size_t)band * band_rows * filtered_stride;
+			const size_t end = min(begin + band_rows * filtered_stride, filtered.size());
+			adler = deflate::adler32_combine(adler, adlers[band], end - begin);
+			zlib_size += compressed[band].size();
+		}
+
+		out.clear();
+		out.reserve(8 + 25 + 12 + zlib_size + 12);
+		out.insert(out.end(), { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' });
+
+		auto chunk = [&out](const char* type, auto&& write_payload)
+		{
+			const size_t length_at = out.size();
+			put_u32_be(out, 0);
+			out.insert(out.end(), type, type + 4);
+			write_payload();
+			const u32 length = (u32)(out.size() - length_at - 8);
+			for (u32 i = 0; i < 4; ++i)
+				out[length_at + i] = (u8)(length >> (24 - i * 8));
+			put_u32_be(out, crc32_update(0, out.data() + length_at + 4, length + 4));
+		};
+
+		chunk("IHDR", [&]
+			{
+				put_u32_be(out, (u32)image.width);
+				put_u32_be(out, (u32)image.height);
+				out.insert(out.end(), { 8, 6, 0, 0, 0 }); // 8 bit, RGBA, deflate, adaptive filter, no interlace
+			});
+
+		chunk("IDAT", [&]
+			{
+				out.insert(out.end(), { 0x78, 0x01 });
+				for (const std::vector<u8>& band : compressed)
+					out.insert(out.end(), band.begin(), band.end());
+				out.insert(out.end(), { 0x03, 0x00 }); // final empty fixed block
+				put_u32_be(out, adler);
+			});
+
+		chunk("IEND", [] {});
+	}
+
+	struct ImageWriterStats
+	{
+		u64 frames = 0;
+		u64 bytes_in = 0;
+		u64 bytes_out = 0;
+		f64 encode_seconds = 0.0; // summed over workers
+	};
+
+	//? Encodes and writes frames on the job system. At most max_pending frames are held in memory,
+	//? write() blocks the producer past that so a slow disk or encoder can't eat all memory.
+	struct ImageWriter
+	{
+		JobSystem* jobs = nullptr;
+		ImageFormat format = ImageFormat::qoi;
+		u32 max_pending = 8;
+		u32 png_band_rows = 64;
+		b32 discard = false; // encode only, benchmarks don't want to measure the disk
+
+		std::mutex mutex;
+		std::condition_variable slot_freed;
+		u32 pending = 0;
+		ImageWriterStats stats;
+		JobCounter counter;
+
+		void init(JobSystem* job_system, ImageFormat image_format, u32 max_pending_frames = 8)
+		{
+			jobs = job_system;
+			format = image_format;
+			max_pending = max_pending_frames;
+		}
+
+		//? Copies pixels, returns once the frame is queued
+		void write(const char* path, const ImageView& image)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				slot_freed.wait(lock, [this] { return pending < max_pending; });
+				++pending;
+			}
+
+			const size_t size = (size_t)image.width * image.height * 4;
+			std::vector<u8> pixels(image.pixels, image.pixels + size);
+			std::string file_path = path;
+			ImageView view = image;
+
+			jobs->submit([this, pixels = static_cast<std::vector<u8>&&>(pixels), file_path = static_cast<std::string&&>(file_path), view]() mutable
+				{
+					ImageView local = view;
+					local.pixels = pixels.data();
+					encode_and_write(file_path.c_str(), local);
+				}, &counter);
+		}
+
+		void flush()
+		{
+			jobs->wait(counter);
+		}
+
+		void print_stats() const
+		{
+			if (!stats.frames)
+				return;
+
+			const f64 mb_in = (f64)stats.bytes_in / (1024.0 * 1024.0);
+			printf("image writer %s: %llu frames, %.1f MiB -> %.1f MiB (%.1f%%), per encode %.1f MB/s %.1f frames/s\n",
+				image_format_ext(format), (unsigned long long)stats.frames, mb_in, (f64)stats.bytes_out / (1024.0 * 1024.0),
+				100.0 * (f64)stats.bytes_out / (f64)stats.bytes_in, mb_in / stats.encode_seconds,
+				(f64)stats.frames / stats.encode_seconds);
+		}
+
+	private:
+		void encode_and_write(const char* path, const ImageView& image)
+		{
+			PROFILE_SCOPE("encode image");
+			const auto start = std::chrono::steady_clock::now();
+
+			std::vector<u8> encoded;
+			if (format == ImageFormat::qoi)
+				encode_qoi(image, encoded);
+			else
+				encode_png(image, encoded, jobs, png_band_rows);
+
+			const f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+			FILE* file = discard ? nullptr : fopen(path, "wb");
+			if (file)
+			{
+				fwrite(encoded.data(), 1, encoded.size(), file);
+				fclose(file);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				--pending;
+				++stats.frames;
+				stats.bytes_in += (u64)image.width * image.height * 4;
+				stats.bytes_out += encoded.size();
+				stats.encode_seconds += seconds;
+			}
+			slot_freed.notify_one();
+		}
+	};
+}
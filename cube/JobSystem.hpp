@@ -0,0 +1,151 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+#include "Utils.hpp"
+
+namespace lib
+{
+	//? Jobs submitted with a counter increment it, it's decremented once the job has run. Waiting on zero.
+	struct JobCounter
+	{
+		std::atomic<u32> pending{ 0 };
+	};
+
+	//? Plain shared-queue worker pool. Nothing fancy like work stealing, jobs here are coarse (frame encodes,
+	//? row bands, light bins) so one mutex is not what limits us. wait() runs queued jobs on the waiting thread
+	//? so jobs can wait on other jobs without deadlocking the pool.
+	struct JobSystem
+	{
+		struct Job
+		{
+			std::function<void()> work;
+			JobCounter* counter;
+		};
+
+		std::vector<std::thread> workers;
+		std::deque<Job> queue;
+		std::mutex mutex;
+		std::condition_variable wake;
+		b32 quit = false;
+
+		//? 0 picks hardware concurrency minus the calling thread
+		void init(u32 thread_count = 0)
+		{
+			if (thread_count == 0)
+			{
+				const u32 hw = std::thread::hardware_concurrency();
+				thread_count = hw > 1 ? hw - 1 : 1;
+			}
+
+			quit = false;
+			workers.reserve(thread_count);
+			for (u32 i = 0; i < thread_count; ++i)
+				workers.emplace_back([this] { worker_loop(); });
+		}
+
+		void destroy()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				quit = true;
+			}
+			wake.notify_all();
+			for (std::thread& worker : workers)
+				worker.join();
+			workers.clear();
+		}
+
+		u32 thread_count() const
+		{
+			return (u32)workers.size();
+		}
+
+		void submit(std::function<void()> work, JobCounter* counter = nullptr)
+		{
+			if (counter)
+				counter->pending.fetch_add(1, std::memory_order_relaxed);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				queue.push_back({ static_cast<std::function<void()>&&>(work), counter });
+			}
+			wake.notify_one();
+		}
+
+		void wait(JobCounter& counter)
+		{
+			while (counter.pending.load(std::memory_order_acquire) != 0)
+			{
+				if (!run_one())
+					std::this_thread::yield();
+			}
+		}
+
+		//? Calls f(begin, end) over [0, count) split into batches of batch_size, returns when all are done
+		template <typename F>
+		void parallel_for(u32 count, u32 batch_size, F&& f)
+		{
+			if (count == 0)
+				return;
+
+			batch_size = batch_size ? batch_size : 1;
+			JobCounter counter;
+			for (u32 begin = batch_size; begin < count; begin += batch_size)
+			{
+				const u32 end = begin + batch_size < count ? begin + batch_size : count;
+				submit([&f, begin, end] { f(begin, end); }, &counter);
+			}
+
+			// first batch runs right here, no point in sleeping while the pool wakes up
+			f(0, batch_size < count ? batch_size : count);
+			wait(counter);
+		}
+
+	private:
+		b32 run_one()
+		{
+			Job job;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (queue.empty())
+					return false;
+				job = static_cast<Job&&>(queue.front());
+				queue.pop_front();
+			}
+
+			execute(job);
+			return true;
+		}
+
+		static void execute(Job& job)
+		{
+			PROFILE_SCOPE("job");
+			job.work();
+			if (job.counter)
+				job.counter->pending.fetch_sub(1, std::memory_order_release);
+		}
+
+		void worker_loop()
+		{
+			for (;;)
+			{
+				Job job;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					wake.wait(lock, [this] { return quit || !queue.empty(); });
+					if (queue.empty())
+						return;
+					job = static_cast<Job&&>(queue.front());
+					queue.pop_front();
+				}
+
+				execute(job);
+			}
+		}
+	};
+}
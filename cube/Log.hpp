@@ -0,0 +1,377 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <type_traits>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include "Utils.hpp"
+
+//? LOG("format", args...) never formats or touches a FILE on the calling thread. It copies the call site
+//? pointer, the arguments and any strings into a fixed size record in a ring owned by the calling thread,
+//? and a background thread formats and writes the records. A full ring drops the record and counts it, the
+//? caller never waits. Formats are printf style without '*' widths; a newline is added to every record.
+//? Records from different threads are ordered by timestamp within each drained batch.
+
+namespace lib::log
+{
+	struct Site
+	{
+		const char* format;
+		const char* file;
+		u32 line;
+	};
+
+	enum class Arg : u8
+	{
+		s64,
+		u64,
+		f64,
+		str,
+		ptr,
+	};
+
+	struct Record
+	{
+		static constexpr u32 max_args = 6;
+		static constexpr u32 text_size = 432; // room for a GLFW error description or a path
+
+		const Site* site;
+		u64 tsc;
+		u8 arg_count;
+		u16 text_used;
+		Arg types[max_args];
+		union Value
+		{
+			s64 i;
+			u64 u;
+			f64 f;
+			const void* p;
+			u32 text_offset;
+		} args[max_args];
+		char text[text_size]; // copied strings, each NUL terminated and cut to what is left with "..." at the end
+	};
+	static_assert(sizeof(Record) == 512);
+
+	struct Ring
+	{
+		static constexpr u32 capacity = 1 << 10;
+
+		alignas(64) std::atomic<u64> head{ 0 }; // producer
+		alignas(64) std::atomic<u64> tail{ 0 }; // consumer
+		std::atomic<u64> dropped{ 0 };
+		u32 thread_id = 0;
+		Ring* next = nullptr;
+		Record records[capacity];
+	};
+
+	inline thread_local Ring* thread_ring = nullptr;
+
+	struct Logger
+	{
+		std::atomic<Ring*> rings{ nullptr };
+		std::atomic<u32> thread_count{ 0 };
+		std::atomic<bool> quit{ false };
+		std::thread thread;
+		FILE* out = stderr;
+		u32 poll_ms = 2;
+
+		// consumer thread only
+		u64 written = 0;
+		u64 dropped_reported = 0;
+
+		//? Records pushed before init() stay in the rings and come out once the thread runs
+		void init(FILE* file = stderr)
+		{
+			out = file;
+			quit.store(false, std::memory_order_relaxed);
+			thread = std::thread([this] { thread_loop(); });
+		}
+
+		//? Writes everything pushed so far, later records wait for the next init()
+		void destroy()
+		{
+			if (!thread.joinable())
+				return;
+			quit.store(true, std::memory_order_release);
+			thread.join();
+		}
+
+		template <typename... Args>
+		void write(const Site* site, const Args&... args)
+		{
+			static_assert(sizeof...(Args) <= Record::max_args, "too many log arguments");
+
+			Ring* ring = thread_ring ? thread_ring : register_thread();
+			const u64 head = ring->head.load(std::memory_order_relaxed);
+			if (head - ring->tail.load(std::memory_order_acquire) >= Ring::capacity)
+			{
+				ring->dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+
+			Record& record = ring->records[head & (Ring::capacity - 1)];
+			record.site = site;
+			record.tsc = __rdtsc();
+			record.arg_count = (u8)sizeof...(Args);
+			record.text_used = 0;
+			u32 index = 0;
+			(put(record, index++, args), ...);
+			ring->head.store(head + 1, std::memory_order_release);
+		}
+
+		//? Records pushed but not written yet, over all threads
+		u64 pending() const
+		{
+			u64 count = 0;
+			for (Ring* ring = rings.load(std::memory_order_acquire); ring; ring = ring->next)
+				count += ring->head.load(std::memory_order_acquire) - ring->tail.load(std::memory_order_acquire);
+			return count;
+		}
+
+		u64 dropped() const
+		{
+			u64 count = 0;
+			for (Ring* ring = rings.load(std::memory_order_acquire); ring; ring = ring->next)
+				count += ring->dropped.load(std::memory_order_relaxed);
+			return count;
+		}
+
+	private:
+		//? Rings live until exit, a thread that is gone still gets drained
+		Ring* register_thread()
+		{
+			Ring* ring = new Ring;
+			ring->thread_id = thread_count.fetch_add(1, std::memory_order_relaxed);
+			ring->next = rings.load(std::memory_order_relaxed);
+			while (!rings.compare_exchange_weak(ring->next, ring, std::memory_order_release, std::memory_order_relaxed))
+			{
+			}
+			thread_ring = ring;
+			return ring;
+		}
+
+		template <typename T>
+		static void put(Record& record, u32 index, const T& value)
+		{
+			using D = std::decay_t<T>;
+			Record::Value& v = record.args[index];
+			if constexpr (std::is_same_v<D, const char*> || std::is_same_v<D, char*>)
+			{
+				const char* text = (const char*)value;
+				if (!text)
+					text = "(null)";
+				const u32 room = Record::text_size - record.text_used;
+				u32 length = 0;
+				while (length + 1 < room && text[length])
+					++length;
+				if (room > 0)
+				{
+					v.text_offset = record.text_used;
+					memcpy(record.text + record.text_used, text, length);
+					if (text[length]) // cut, marked where it was cut so width padding stays after it
+					{
+						const u32 dots = std::min(length, 3u);
+						memset(record.text + record.text_used + length - dots, '.', dots);
+					}
+					record.text[record.text_used + length] = '\0';
+					record.text_used = (u16)(record.text_used + length + 1);
+				}
+				else
+				{
+					v.text_offset = Record::text_size - 1; // terminator of the string that filled the buffer
+				}
+				record.types[index] = Arg::str;
+			}
+			else if constexpr (std::is_floating_point_v<D>)
+			{
+				v.f = (f64)value;
+				record.types[index] = Arg::f64;
+			}
+			else if constexpr (std::is_enum_v<D>)
+			{
+				v.i = (s64)value;
+				record.types[index] = Arg::s64;
+			}
+			else if constexpr (std::is_integral_v<D> && std::is_signed_v<D>)
+			{
+				v.i = (s64)value;
+				record.types[index] = Arg::s64;
+			}
+			else if constexpr (std::is_integral_v<D>)
+			{
+				v.u = (u64)value;
+				record.types[index] = Arg::u64;
+			}
+			else if constexpr (std::is_pointer_v<D>)
+			{
+				v.p = (const void*)value;
+				record.types[index] = Arg::ptr;
+			}
+			else
+			{
+				static_assert(std::is_pointer_v<D>, "log arguments are numbers, enums, pointers or C strings");
+			}
+		}
+
+		void thread_loop()
+		{
+			std::vector<Record> batch;
+			for (;;)
+			{
+				const b32 quitting = quit.load(std::memory_order_acquire);
+				drain(batch);
+				if (quitting)
+					break;
+				std::this_thread::sleep_for(std::chrono::milliseconds(poll_ms));
+			}
+			fflush(out);
+		}
+
+		void drain(std::vector<Record>& batch)
+		{
+			batch.clear();
+			for (Ring* ring = rings.load(std::memory_order_acquire); ring; ring = ring->next)
+			{
+				const u64 head = ring->head.load(std::memory_order_acquire);
+				const u64 tail = ring->tail.load(std::memory_order_relaxed);
+				for (u64 i = tail; i < head; ++i)
+					batch.push_back(ring->records[i & (Ring::capacity - 1)]);
+				ring->tail.store(head, std::memory_order_release);
+			}
+
+			std::stable_sort(batch.begin(), batch.end(), [](const Record& a, const Record& b) { return a.tsc < b.tsc; });
+
+			char line[1024];
+			for (const Record& record : batch)
+			{
+				const u32 length = format(record, line, sizeof(line));
+				fwrite(line, 1, length, out);
+			}
+			written += batch.size();
+
+			const u64 total_dropped = dropped();
+			if (total_dropped != dropped_reported)
+			{
+				fprintf(out, "log: %llu records dropped\n", (unsigned long long)(total_dropped - dropped_reported));
+				dropped_reported = total_dropped;
+			}
+			if (!batch.empty())
+				fflush(out);
+		}
+
+		//? Each conversion is handed to snprintf on its own, with the length modifier swapped for the stored type
+		static u32 format(const Record& record, char* out, u32 size)
+		{
+			u32 used = 0;
+			u32 arg = 0;
+			auto append = [&](const char* text, u32 length)
+			{
+				length = std::min(length, size - 2 - used);
+				memcpy(out + used, text, length);
+				used += length;
+			};
+
+			for (const char* c = record.site->format; *c && used + 2 < size;)
+			{
+				if (*c != '%')
+				{
+					const char* next = strchr(c, '%');
+					const u32 length = next ? (u32)(next - c) : (u32)strlen(c);
+					append(c, length);
+					c += length;
+					continue;
+				}
+				if (c[1] == '%')
+				{
+					append("%", 1);
+					c += 2;
+					continue;
+				}
+
+				// %[flags][width][.precision][length]conversion
+				char spec[32] = "%";
+				u32 spec_length = 1;
+				++c;
+				while (*c && strchr("-+ #0123456789.", *c) && spec_length < 24)
+					spec[spec_length++] = *c++;
+				while (*c && strchr("hljztL", *c))
+					++c;
+				const char conversion = *c ? *c++ : 's';
+
+				char text[Record::text_size + 64];
+				s32 length = 0;
+				if (arg >= record.arg_count)
+				{
+					length = snprintf(text, sizeof(text), "<missing>");
+				}
+				else
+				{
+					const Record::Value& v = record.args[arg];
+					const Arg type = record.types[arg];
+					++arg;
+
+					const b32 integer = strchr("diouxXc", conversion) != nullptr;
+					const b32 floating = strchr("eEfFgGaA", conversion) != nullptr;
+					if (type == Arg::str)
+					{
+						memcpy(spec + spec_length, "s", 2);
+						length = snprintf(text, sizeof(text), spec, record.text + v.text_offset);
+					}
+					else if (type == Arg::ptr || conversion == 'p')
+					{
+						length = snprintf(text, sizeof(text), "%p", v.p);
+					}
+					else if (floating)
+					{
+						spec[spec_length] = conversion;
+						spec[spec_length + 1] = '\0';
+						length = snprintf(text, sizeof(text), spec, type == Arg::f64 ? v.f : type == Arg::s64 ? (f64)v.i : (f64)v.u);
+					}
+					else if (integer && conversion == 'c')
+					{
+						memcpy(spec + spec_length, "c", 2);
+						length = snprintf(text, sizeof(text), spec, type == Arg::f64 ? (int)v.f : (int)v.i);
+					}
+					else if (integer)
+					{
+						spec[spec_length] = 'l';
+						spec[spec_length + 1] = 'l';
+						spec[spec_length + 2] = conversion;
+						spec[spec_length + 3] = '\0';
+						const long long value = type == Arg::f64 ? (long long)v.f : (long long)v.i;
+						length = snprintf(text, sizeof(text), spec, value);
+					}
+					else
+					{
+						length = snprintf(text, sizeof(text), "<%%%c?>", conversion);
+					}
+				}
+				if (length > 0)
+					append(text, std::min((u32)length, (u32)sizeof(text) - 1));
+			}
+
+			out[used++] = '\n';
+			return used;
+		}
+	};
+
+	inline Logger logger;
+}
+
+#define LOG(format, ...) \
+	do \
+	{ \
+		static constexpr lib::log::Site log_site_{ format, __FILE__, __LINE__ }; \
+		lib::log::logger.write(&log_site_, ##__VA_ARGS__); \
+	} while (0)
@@ -0,0 +1,151 @@
+#pragma once
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <unordered_map>
+
+#include "Utils.hpp"
+#include "my_math.h"
+#include "Scene.hpp"
+
+//? Mesh files for --mesh: Wavefront OBJ positions and faces (polygons as fans, v, v/t, v//n and v/t/n,
+//? negative indices), texture coordinates and normals are ignored. Vertices are colored from their
+//? position the way the cube's corners are.
+
+namespace lib
+{
+	struct MeshData
+	{
+		std::vector<Vertex> vertices;
+		std::vector<u32> indices;
+	};
+
+	//? Parses text from memory (no terminator needed), one vertex per face corner; optimize_mesh merges them
+	inline b32 parse_obj(const u8* data, size_t size, MeshData& mesh)
+	{
+		std::vector<Vec3> positions;
+		mesh.vertices.clear();
+		mesh.indices.clear();
+
+		const char* p = (const char*)data;
+		const char* end = p + size;
+		char number[64];
+		auto skip_spaces = [&] { while (p < end && (*p == ' ' || *p == '\t')) ++p; };
+		auto next_token = [&](char* out) -> b32
+		{
+			skip_spaces();
+			u32 n = 0;
+			while (p < end && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r' && n + 1 < sizeof(number))
+				out[n++] = *p++;
+			out[n] = 0;
+			return n != 0;
+		};
+
+		while (p < end)
+		{
+			skip_spaces();
+			if (end - p >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+			{
+				p += 2;
+				Vec3 v{};
+				f32* out[3] = { &v.x, &v.y, &v.z };
+				for (f32* c : out)
+				{
+					if (!next_token(number))
+						return false;
+					*c = strtof(number, nullptr);
+				}
+				positions.push_back(v);
+			}
+			else if (end - p >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+			{
+				p += 2;
+				u32 corners = 0;
+				u32 first = 0;
+				while (next_token(number))
+				{
+					// the position is everything before the first slash
+					long index = strtol(number, nullptr, 10);
+					index = index < 0 ? (long)positions.size() + index : index - 1;
+					if (index < 0 || index >= (long)positions.size())
+						return false;
+
+					const u32 vertex = (u32)mesh.vertices.size();
+					mesh.vertices.push_back({ positions[index], {} });
+					if (corners == 0)
+						first = vertex;
+					if (corners >= 2)
+					{
+						mesh.indices.push_back(first);
+						mesh.indices.push_back(vertex - 1);
+						mesh.indices.push_back(vertex);
+					}
+					++corners;
+				}
+				if (corners < 3)
+					return false;
+			}
+			while (p < end && *p != '\n')
+				++p;
+			++p;
+		}
+		return !mesh.indices.empty();
+	}
+
+	struct MeshOptimizeStats
+	{
+		u32 vertices_in;
+		u32 vertices_out;
+	};
+
+	//? Merges equal vertices, renumbers them in order of first use (fetches walk the buffer forwards),
+	//? scales into the cube's [-1, 1] box and colors by position
+	inline MeshOptimizeStats optimize_mesh(MeshData& mesh)
+	{
+		MeshOptimizeStats stats{ (u32)mesh.vertices.size(), 0 };
+
+		struct Key
+		{
+			u32 x, y, z;
+			bool operator==(const Key& o) const { return x == o.x && y == o.y && z == o.z; }
+		};
+		struct KeyHash
+		{
+			size_t operator()(const Key& k) const { return (size_t)((k.x * 0x9E3779B1u) ^ (k.y * 0x85EBCA77u) ^ (k.z * 0xC2B2AE3Du)); }
+		};
+
+		std::unordered_map<Key, u32, KeyHash> unique;
+		unique.reserve(mesh.vertices.size());
+		std::vector<Vertex> vertices;
+		vertices.reserve(mesh.vertices.size());
+		for (u32& index : mesh.indices)
+		{
+			const Vec3 pos = mesh.vertices[index].pos;
+			Key key;
+			memcpy(&key.x, &pos.x, 4);
+			memcpy(&key.y, &pos.y, 4);
+			memcpy(&key.z, &pos.z, 4);
+			auto [it, inserted] = unique.try_emplace(key, (u32)vertices.size());
+			if (inserted)
+				vertices.push_back(mesh.vertices[index]);
+			index = it->second;
+		}
+		mesh.vertices.swap(vertices);
+		stats.vertices_out = (u32)mesh.vertices.size();
+
+		Vec3 lo = mesh.vertices[0].pos, hi = lo;
+		for (const Vertex& v : mesh.vertices)
+		{
+			lo = { min(lo.x, v.pos.x), min(lo.y, v.pos.y), min(lo.z, v.pos.z) };
+			hi = { max(hi.x, v.pos.x), max(hi.y, v.pos.y), max(hi.z, v.pos.z) };
+		}
+		const Vec3 center = (lo + hi) * 0.5f;
+		const f32 extent = max(max(hi.x - lo.x, hi.y - lo.y), max(hi.z - lo.z, 1e-6f)) * 0.5f;
+		for (Vertex& v : mesh.vertices)
+		{
+			v.pos = (v.pos - center) / extent;
+			v.col = v.pos * 0.5f + Vec3{ 0.5f, 0.5f, 0.5f };
+		}
+		return stats;
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <stdio.h>
+
+#include "Utils.hpp"
+#include "GpuMemory.hpp"
+
+namespace lib
+{
+	//? Per-frame renderer counters. GL counters are filled by the hooks in GlBackend.hpp, the same way
+	//? whether calls go to the driver or to the mock backend, timings are filled by the frame loop.
+	struct FrameMetrics
+	{
+		u64 gl_calls;
+		u64 draw_calls;
+		u64 triangles;
+		u64 state_changes;   // binds, enables, viewport, program and vertex layout changes
+		u64 uniform_updates;
+		u64 bytes_uploaded;  // buffer and texture data sent from client memory
+		u64 bytes_read;      // pixels read back
+		u64 gpu_bytes;       // GPU memory held at the end of the frame, from lib::gpu_memory
+		f32 cpu_ms;
+		f32 gpu_ms;
+	};
+
+	struct Metrics
+	{
+		FrameMetrics current{};
+		FrameMetrics last{};
+		FrameMetrics total{};
+		u64 frames = 0;
+		f32 max_cpu_ms = 0.0f; // worst frame, where upload and load hitches show
+		u64 max_gpu_bytes = 0;
+
+		//? Rolls current into last and totals, call once per frame after everything was submitted
+		void end_frame()
+		{
+			gpu_memory.end_frame();
+			current.gpu_bytes = gpu_memory.total;
+			last = current;
+			total.gl_calls += current.gl_calls;
+			total.draw_calls += current.draw_calls;
+			total.triangles += current.triangles;
+			total.state_changes += current.state_changes;
+			total.uniform_updates += current.uniform_updates;
+			total.bytes_uploaded += current.bytes_uploaded;
+			total.bytes_read += current.bytes_read;
+			total.gpu_bytes += current.gpu_bytes;
+			total.cpu_ms += current.cpu_ms;
+			total.gpu_ms += current.gpu_ms;
+			max_cpu_ms = current.cpu_ms > max_cpu_ms ? current.cpu_ms : max_cpu_ms;
+			max_gpu_bytes = current.gpu_bytes > max_gpu_bytes ? current.gpu_bytes : max_gpu_bytes;
+			++frames;
+			current = {};
+		}
+
+		void print_summary(const char* label) const
+		{
+			if (!frames)
+				return;
+
+			const f64 n = (f64)frames;
+			printf("%s: %llu frames, per frame avg: %.1f gl calls, %.1f draws, %.0f tris, %.1f state changes, "
+				"%.1f uniforms, %.1f KiB uploaded, %.1f KiB read, cpu %.3f ms (max %.3f), gpu %.3f ms, gpu memory %.2f MiB (max %.2f)\n",
+				label, (unsigned long long)frames, total.gl_calls / n, total.draw_calls / n, total.triangles / n,
+				total.state_changes / n, total.uniform_updates / n, total.bytes_uploaded / n / 1024.0,
+				total.bytes_read / n / 1024.0, total.cpu_ms / n, max_cpu_ms, total.gpu_ms / n,
+				total.gpu_bytes / n / (1024.0 * 1024.0), max_gpu_bytes / (1024.0 * 1024.0));
+		}
+	};
+
+	inline Metrics metrics;
+}
@@ -0,0 +1,227 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "Utils.hpp"
+
+//? Hardware counters through perf_event_open, for the calling thread and user space only (works with the
+//? default perf_event_paranoid). Every event is opened on its own, so a CPU or VM that lacks one still gives
+//? the others; values are scaled when the kernel multiplexes them. When nothing can be opened (other OS,
+//? no PMU in a VM, locked down kernel) available stays false, reads return empty samples and callers just
+//? print timings.
+
+namespace lib
+{
+	enum class PerfEvent : u32
+	{
+		cycles,
+		instructions,
+		cache_misses,
+		branch_misses,
+		l1d_loads,
+		llc_loads,
+		count
+	};
+
+	constexpr u32 perf_event_count = (u32)PerfEvent::count;
+	constexpr u32 perf_all_valid = (1u << perf_event_count) - 1;
+
+	inline const char* perf_event_name(PerfEvent event)
+	{
+		constexpr const char* names[] = { "cycles", "instructions", "cache_misses", "branch_misses", "l1d_loads", "llc_loads" };
+		return names[(u32)event];
+	}
+
+	struct PerfSample
+	{
+		f64 values[perf_event_count];
+		u32 valid_mask; // bit per PerfEvent
+
+		b32 has(PerfEvent event) const { return TestBitPos(valid_mask, (u32)event); }
+		f64 operator[](PerfEvent event) const { return values[(u32)event]; }
+
+		f64 ipc() const
+		{
+			return has(PerfEvent::cycles) && has(PerfEvent::instructions) && values[(u32)PerfEvent::cycles] > 0.0
+				? values[(u32)PerfEvent::instructions] / values[(u32)PerfEvent::cycles] : 0.0;
+		}
+
+		PerfSample operator-(const PerfSample& start) const
+		{
+			PerfSample out{};
+			out.valid_mask = valid_mask & start.valid_mask;
+			for (u32 i = 0; i < perf_event_count; ++i)
+				out.values[i] = values[i] - start.values[i];
+			return out;
+		}
+
+		//? A counter is valid in a sum only if it was in every sample, start sums from { {}, perf_all_valid }
+		PerfSample& operator+=(const PerfSample& other)
+		{
+			valid_mask &= other.valid_mask;
+			for (u32 i = 0; i < perf_event_count; ++i)
+				values[i] += other.values[i];
+			return *this;
+		}
+
+		//? "ipc 1.92, 0.013 cache_misses/op, ..." with every counter divided by `per`
+		void format(char* out, size_t size, f64 per, const char* unit) const
+		{
+			size_t at = has(PerfEvent::cycles) && has(PerfEvent::instructions) ? (size_t)snprintf(out, size, "ipc %.2f", ipc()) : 0;
+			out[at] = 0;
+			for (u32 i = (u32)PerfEvent::cache_misses; i < perf_event_count && at < size; ++i)
+			{
+				if (TestBitPos(valid_mask, i))
+					at += (size_t)snprintf(out + at, size - at, "%s%.3f %s/%s", at ? ", " : "", values[i] / per, perf_event_name((PerfEvent)i), unit);
+			}
+		}
+	};
+
+	struct PerfCounters
+	{
+		s32 fds[perf_event_count];
+		b32 available = false;
+
+		b32 init()
+		{
+			for (s32& fd : fds)
+				fd = -1;
+
+#if defined(__linux__)
+			struct Config { u32 type; u64 config; };
+			const Config configs[perf_event_count] = {
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+				{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16) },
+				{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16) },
+			};
+
+			s32 error = 0;
+			for (u32 i = 0; i < perf_event_count; ++i)
+			{
+				perf_event_attr attr{};
+				attr.size = sizeof(attr);
+				attr.type = configs[i].type;
+				attr.config = configs[i].config;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+				fds[i] = (s32)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+				if (fds[i] < 0)
+					error = errno;
+				else
+					available = true;
+			}
+
+			if (!available)
+				printf("perf counters unavailable: %s\n", strerror(error));
+			else if (error)
+				printf("perf counters: some events unavailable (%s)\n", strerror(error));
+#else
+			printf("perf counters unavailable on this platform\n");
+#endif
+			return available;
+		}
+
+		void destroy()
+		{
+#if defined(__linux__)
+			for (s32& fd : fds)
+			{
+				if (fd >= 0)
+					close(fd);
+				fd = -1;
+			}
+#endif
+			available = false;
+		}
+
+		//? Running totals since init, subtract two reads for a range
+		PerfSample read() const
+		{
+			PerfSample out{};
+#if defined(__linux__)
+			for (u32 i = 0; i < perf_event_count; ++i)
+			{
+				u64 data[3]; // value, time enabled, time running
+				if (fds[i] < 0 || ::read(fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0)
+					continue;
+
+				out.values[i] = data[2] < data[1] ? (f64)data[0] * (f64)data[1] / (f64)data[2] : (f64)data[0];
+				out.valid_mask |= 1u << i;
+			}
+#endif
+			return out;
+		}
+	};
+
+	//? Counter totals for named phases of a frame, begin/end pairs on the same thread
+	struct PerfPhases
+	{
+		static constexpr u32 max_phases = 8;
+
+		PerfCounters* counters = nullptr;
+		const char* names[max_phases];
+		PerfSample totals[max_phases];
+		PerfSample started;
+		u32 phase_count = 0;
+
+		//? Index of the phase, max_phases once the table is full (that phase is not counted)
+		u32 phase(const char* name)
+		{
+			for (u32 i = 0; i < phase_count; ++i)
+			{
+				if (names[i] == name || strcmp(names[i], name) == 0)
+					return i;
+			}
+			if (phase_count == max_phases)
+				return max_phases;
+			names[phase_count] = name;
+			totals[phase_count] = { {}, perf_all_valid };
+			return phase_count++;
+		}
+
+		void begin()
+		{
+			if (counters && counters->available)
+				started = counters->read();
+		}
+
+		void end(const char* name)
+		{
+			if (!counters || !counters->available)
+				return;
+			const u32 i = phase(name);
+			if (i < max_phases)
+				totals[i] += counters->read() - started;
+		}
+
+		void print_summary(u64 frames, u64 elements, const char* element_unit) const
+		{
+			if (!counters || !counters->available || !frames)
+				return;
+
+			for (u32 i = 0; i < phase_count; ++i)
+			{
+				PerfSample per_frame = totals[i];
+				for (f64& v : per_frame.values)
+					v /= (f64)frames;
+
+				char line[512];
+				per_frame.format(line, sizeof(line), elements ? (f64)elements : 1.0, elements ? element_unit : "frame");
+				printf("perf %-8s %.0f cycles/frame, %.0f instructions/frame, %s\n", names[i],
+					per_frame[PerfEvent::cycles], per_frame[PerfEvent::instructions], line);
+			}
+		}
+	};
+}
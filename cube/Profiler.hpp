@@ -0,0 +1,158 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <unordered_map>
+#include <chrono>
+
+#include "Utils.hpp"
+
+//? Collector for the PROFILE_SCOPE rings in Utils.hpp. collect() drains every thread's ring into one list,
+//? call it often enough that no ring wraps (once a frame is plenty). write_chrome_trace() emits the Chrome
+//? trace event format, which chrome://tracing, Perfetto and Tracy (through its import-chrome tool) all open.
+//? Without CUBE_PROFILE everything here is a no-op.
+
+namespace lib::profiler
+{
+	struct CollectedEvent
+	{
+		u64 start;
+		u64 end;
+		const void* zone; // ProfileZoneInfo
+		u32 thread_id;
+	};
+
+	struct Collector
+	{
+		std::vector<CollectedEvent> events;
+		u64 max_events = 1u << 22;
+		u64 lost = 0;
+
+		// tsc <-> time, from the two ends of the capture
+		u64 tsc_origin = 0;
+		std::chrono::steady_clock::time_point time_origin;
+
+		void init()
+		{
+			time_origin = std::chrono::steady_clock::now();
+#if CUBE_PROFILE
+			tsc_origin = __rdtsc();
+#endif
+		}
+
+		void collect()
+		{
+#if CUBE_PROFILE
+			for (ProfileRing* ring = profile_rings.load(std::memory_order_acquire); ring; ring = ring->next)
+			{
+				const u64 head = ring->head.load(std::memory_order_acquire);
+				u64 tail = ring->tail;
+				if (head - tail > ProfileRing::capacity)
+				{
+					lost += head - tail - ProfileRing::capacity;
+					tail = head - ProfileRing::capacity;
+				}
+
+				const size_t first = events.size();
+				u64 copied = 0;
+				for (u64 i = tail; i < head && events.size() < max_events; ++i, ++copied)
+				{
+					const ProfileEvent& e = ring->events[i & (ProfileRing::capacity - 1)];
+					events.push_back({ e.start, e.end, e.zone, ring->thread_id });
+				}
+				lost += (head - tail) - copied; // over max_events
+
+				// the producer may have lapped us while copying, anything it could have overwritten is dropped
+				const u64 head_after = ring->head.load(std::memory_order_acquire);
+				if (head_after - tail > ProfileRing::capacity)
+				{
+					const u64 overwritten = std::min<u64>(head_after - tail - ProfileRing::capacity, copied);
+					events.erase(events.begin() + first, events.begin() + first + overwritten);
+					lost += overwritten;
+				}
+
+				ring->tail = head;
+			}
+#endif
+		}
+
+		f64 tsc_per_us() const
+		{
+#if CUBE_PROFILE
+			const f64 us = std::chrono::duration<f64, std::micro>(std::chrono::steady_clock::now() - time_origin).count();
+			return us > 0.0 ? (f64)(__rdtsc() - tsc_origin) / us : 1.0;
+#else
+			return 1.0;
+#endif
+		}
+
+		b32 write_chrome_trace(const char* path) const
+		{
+			FILE* file = fopen(path, "wb");
+			if (!file)
+				return false;
+
+#if CUBE_PROFILE
+			const f64 rate = tsc_per_us();
+#endif
+			fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+			for (size_t i = 0; i < events.size(); ++i)
+			{
+#if CUBE_PROFILE
+				const CollectedEvent& e = events[i];
+				const ProfileZoneInfo* zone = (const ProfileZoneInfo*)e.zone;
+				const f64 ts = e.start >= tsc_origin ? (f64)(e.start - tsc_origin) / rate : 0.0;
+				fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"file\":\"%s\",\"line\":%u}},\n",
+					escape(zone->name).c_str(), e.thread_id, ts, (f64)(e.end - e.start) / rate, escape(zone->file).c_str(), zone->line);
+#endif
+			}
+			// metadata record last so the list doesn't need trailing comma handling
+			fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"cube\"}}\n]}\n");
+			fclose(file);
+			return true;
+		}
+
+		//? Per zone count, total and average, sorted by total time
+		void print_summary() const
+		{
+#if CUBE_PROFILE
+			struct Total { const ProfileZoneInfo* zone; u64 count; u64 ticks; };
+			std::unordered_map<const void*, Total> totals;
+			for (const CollectedEvent& e : events)
+			{
+				Total& t = totals[e.zone];
+				t.zone = (const ProfileZoneInfo*)e.zone;
+				++t.count;
+				t.ticks += e.end - e.start;
+			}
+
+			std::vector<Total> sorted;
+			for (const auto& [zone, total] : totals)
+				sorted.push_back(total);
+			std::sort(sorted.begin(), sorted.end(), [](const Total& a, const Total& b) { return a.ticks > b.ticks; });
+
+			const f64 rate = tsc_per_us();
+			printf("profile: %zu events, %llu lost\n", events.size(), (unsigned long long)lost);
+			for (const Total& t : sorted)
+				printf("  %-24s %8llu calls %10.3f ms total %10.3f us avg\n", t.zone->name, (unsigned long long)t.count,
+					(f64)t.ticks / rate / 1000.0, (f64)t.ticks / rate / (f64)t.count);
+#endif
+		}
+
+	private:
+		static std::string escape(const char* text)
+		{
+			std::string out;
+			for (const char* c = text; *c; ++c)
+			{
+				if (*c == '"' || *c == '\\')
+					out += '\\';
+				out += *c;
+			}
+			return out;
+		}
+	};
+}
@@ -0,0 +1,329 @@
+#pragma once
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+#include "Utils.hpp"
+#include "my_math.h"
+#include "JobSystem.hpp"
+
+//? Deterministic stress scenes. Everything is derived from the cube below and a seed, so the same
+//? preset gives the same objects, meshes and motion on every machine and in every benchmark mode.
+
+namespace lib
+{
+	struct Vertex
+	{
+		Vec3 pos;
+		Vec3 col;
+	};
+
+	inline const Vertex cube_vertices[] = {
+
+	 { {-1.f, -1.f, -1.f},  {0.f, 0.f, 0.f} }, // 0
+	 { {-1.f, 1.f, -1.f},   {0.f, 1.f, 0.f} }, // 1
+	 { {1.f, 1.f, -1.f},    {1.f, 1.f, 0.f} }, // 2
+	 { {1.f, -1.f, -1.f},   {1.f, 0.f, 0.f} }, // 3
+	 { {-1.f, -1.f, 1.f},   {0.f, 0.f, 1.f} }, // 4
+	 { {-1.f, 1.f, 1.f},    {0.f, 1.f, 1.f} }, // 5
+	 { { 1.f, 1.f, 1.f},    {1.f, 1.f, 1.f} }, // 6
+	 { { 1.f, -1.f, 1.f},   {1.f, 0.f, 1.f} }  // 7
+	};
+
+	inline const GLuint cube_indices[] = {
+							  0, 1, 2, 0, 2, 3,
+							  4, 6, 5, 4, 7, 6,
+							  4, 5, 1, 4, 1, 0,
+							  3, 2, 6, 3, 6, 7,
+							  1, 5, 6, 1, 6, 2,
+							  4, 0, 3, 4, 3, 7
+	};
+
+	constexpr u32 cube_vertex_count = sizeof(cube_vertices) / sizeof(cube_vertices[0]);
+	constexpr u32 cube_index_count = sizeof(cube_indices) / sizeof(cube_indices[0]);
+
+	enum class Motion : u32
+	{
+		still,
+		rotating, // spins around its own axis
+		orbiting, // circles its parent (or the origin for roots)
+	};
+
+	struct SceneDesc
+	{
+		const char* name;
+		u64 seed;
+		u32 object_count;
+		u32 mesh_count;
+		u32 material_count;
+		u32 hierarchy_depth; // levels, 1 means every object is a root
+		f32 rotating;        // fraction of objects that rotate
+		f32 orbiting;        // fraction of objects that orbit, the rest stays still
+		b32 instanced;       // draw each mesh/material batch with one instanced call
+	};
+
+	//? A single object reproduces the original scene (the spinning cube next to the origin)
+	inline const SceneDesc scene_presets[] = {
+		{ "cube",              1, 1,       1,     1,  1, 1.0f,  0.0f, false },
+		{ "100k-static",       1, 100000,  1,     8,  1, 0.0f,  0.0f, false },
+		{ "1m-instanced",      1, 1000000, 1,     4,  1, 0.5f,  0.0f, true },
+		{ "10k-unique-meshes", 1, 10000,   10000, 16, 1, 0.25f, 0.0f, false },
+		{ "hierarchy",         1, 20000,   16,    8,  4, 0.3f,  0.5f, false },
+		{ "overdraw",          1, 250000,  1,     8,  1, 0.0f,  0.0f, true },  // dense block, tens of layers per pixel
+	};
+
+	constexpr u32 scene_preset_count = sizeof(scene_presets) / sizeof(scene_presets[0]);
+
+	inline const SceneDesc* find_scene_preset(const char* name)
+	{
+		for (const SceneDesc& desc : scene_presets)
+		{
+			if (strcmp(desc.name, name) == 0)
+				return &desc;
+		}
+		return nullptr;
+	}
+
+	//? splitmix64, small and the same everywhere, which is the point
+	struct SceneRng
+	{
+		u64 state;
+
+		u32 next()
+		{
+			u64 z = (state += 0x9e3779b97f4a7c15ull);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+			return (u32)((z ^ (z >> 31)) >> 32);
+		}
+
+		f32 uniform(f32 lo, f32 hi)
+		{
+			return lo + (hi - lo) * (f32)(next() >> 8) * (1.0f / 16777216.0f);
+		}
+
+		u32 below(u32 n)
+		{
+			return (u32)(((u64)next() * n) >> 32);
+		}
+
+		Vec3 unit_vector()
+		{
+			for (;;)
+			{
+				const Vec3 v = { uniform(-1.0f, 1.0f), uniform(-1.0f, 1.0f), uniform(-1.0f, 1.0f) };
+				const f32 len2 = length_squared_vec(v);
+				if (len2 > 0.01f && len2 <= 1.0f)
+					return v / sqrt(len2);
+			}
+		}
+	};
+
+	struct SceneObject
+	{
+		u32 parent; // ~0u for roots, parents always come before their children
+		u32 mesh;
+		u32 material;
+		Motion motion;
+		Vec3 offset; // from the parent, or from the origin for roots
+		Vec3 axis;
+		f32 speed;   // radians per second
+		f32 phase;
+		f32 scale;
+	};
+
+	struct SceneMesh
+	{
+		u32 base_vertex;
+		u32 first_index;
+		u32 index_count;
+		Vec3 bounds_min; // local space
+		Vec3 bounds_max;
+	};
+
+	inline void grow_bounds(Vec3& bounds_min, Vec3& bounds_max, Vec3 p)
+	{
+		bounds_min = { min(bounds_min.x, p.x), min(bounds_min.y, p.y), min(bounds_min.z, p.z) };
+		bounds_max = { max(bounds_max.x, p.x), max(bounds_max.y, p.y), max(bounds_max.z, p.z) };
+	}
+
+	//? Run of consecutive objects sharing mesh and material, one instanced draw or one state change
+	struct SceneBatch
+	{
+		u32 first_object;
+		u32 object_count;
+		u32 mesh;
+		u32 material;
+	};
+
+	struct Scene
+	{
+		SceneDesc desc{};
+		std::vector<Vertex> vertices;
+		std::vector<GLuint> indices;
+		std::vector<SceneMesh> meshes;
+		std::vector<Vec4> materials;
+		std::vector<SceneObject> objects;   // sorted by level, then mesh and material
+		std::vector<u32> level_begin;       // level L is [level_begin[L], level_begin[L + 1])
+		std::vector<SceneBatch> batches;
+		std::vector<Mat4> world;            // same order as objects, ready to upload as instance data
+		Vec3 camera_pos{};
+		f32 radius = 0.0f;
+		b32 dynamic = false;
+		b32 updated = false;
+
+		void generate(const SceneDesc& scene_desc)
+		{
+			desc = scene_desc;
+			SceneRng rng{ desc.seed };
+
+			const u32 object_count = max(desc.object_count, 1u);
+			const u32 mesh_count = max(desc.mesh_count, 1u);
+			const u32 material_count = max(desc.material_count, 1u);
+			const u32 depth = clamp(desc.hierarchy_depth, 1u, object_count);
+
+			// every mesh is the cube with its corners pushed around and recolored, mesh 0 is the cube itself;
+			// they share the index pattern so only vertices are per mesh
+			vertices.clear();
+			vertices.reserve((size_t)mesh_count * cube_vertex_count);
+			meshes.resize(mesh_count);
+			indices.assign(cube_indices, cube_indices + cube_index_count);
+			for (u32 m = 0; m < mesh_count; ++m)
+			{
+				meshes[m] = { (u32)vertices.size(), 0, cube_index_count, cube_vertices[0].pos, cube_vertices[0].pos };
+				for (const Vertex& v : cube_vertices)
+				{
+					Vertex out = v;
+					if (m != 0)
+					{
+						out.pos += Vec3{ rng.uniform(-0.35f, 0.35f), rng.uniform(-0.35f, 0.35f), rng.uniform(-0.35f, 0.35f) };
+						out.col = 0.5f * v.col + 0.5f * Vec3{ rng.uniform(0.0f, 1.0f), rng.uniform(0.0f, 1.0f), rng.uniform(0.0f, 1.0f) };
+					}
+					vertices.push_back(out);
+					grow_bounds(meshes[m].bounds_min, meshes[m].bounds_max, out.pos);
+				}
+			}
+
+			materials.resize(material_count);
+			materials[0] = { 1.0f, 1.0f, 1.0f, 1.0f };
+			for (u32 m = 1; m < material_count; ++m)
+				materials[m] = { rng.uniform(0.3f, 1.0f), rng.uniform(0.3f, 1.0f), rng.uniform(0.3f, 1.0f), 1.0f };
+
+			// roots fill a cube of side ~4 units per object, deeper levels hang off random parents one level up
+			const f32 extent = 2.0f * cbrtf((f32)object_count / (f32)depth);
+			objects.resize(object_count);
+			level_begin.resize(depth + 1);
+			const u32 per_level = object_count / depth;
+			u32 at = 0;
+			for (u32 level = 0; level < depth; ++level)
+			{
+				level_begin[level] = at;
+				const u32 count = level == 0 ? object_count - per_level * (depth - 1) : per_level;
+				for (u32 i = 0; i < count; ++i, ++at)
+				{
+					SceneObject& o = objects[at];
+					o.parent = level == 0 ? ~0u : level_begin[level - 1] + rng.below(level_begin[level] - level_begin[level - 1]);
+					o.mesh = rng.below(mesh_count);
+					o.material = rng.below(material_count);
+
+					const f32 pick = rng.uniform(0.0f, 1.0f);
+					o.motion = pick < desc.rotating ? Motion::rotating : pick < desc.rotating + desc.orbiting ? Motion::orbiting : Motion::still;
+					if (level == 0)
+					{
+						o.offset = { rng.uniform(-extent, extent), rng.uniform(-extent, extent), rng.uniform(-extent, extent) };
+					}
+					else
+					{
+						const Vec3 direction = rng.unit_vector();
+						o.offset = direction * rng.uniform(2.0f, 3.0f);
+					}
+					o.axis = rng.unit_vector();
+					o.speed = rng.uniform(0.25f, 2.0f);
+					o.phase = rng.uniform(0.0f, 2.0f * PI32);
+					o.scale = level == 0 ? rng.uniform(0.5f, 1.0f) : 0.5f;
+				}
+
+				// parents of this level are final already, so sorting it doesn't break any links
+				std::stable_sort(objects.begin() + level_begin[level], objects.begin() + at,
+					[](const SceneObject& a, const SceneObject& b) { return a.mesh != b.mesh ? a.mesh < b.mesh : a.material < b.material; });
+			}
+			level_begin[depth] = at;
+
+			if (object_count == 1)
+			{
+				SceneObject& o = objects[0];
+				o = { ~0u, 0, 0, Motion::rotating, { -0.33f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, 1.0f, 0.0f, 1.0f };
+			}
+
+			batches.clear();
+			for (u32 level = 0; level < depth; ++level)
+			{
+				for (u32 i = level_begin[level]; i < level_begin[level + 1]; ++i)
+				{
+					const SceneObject& o = objects[i];
+					if (i == level_begin[level] || batches.back().mesh != o.mesh || batches.back().material != o.material)
+						batches.push_back({ i, 0, o.mesh, o.material });
+					++batches.back().object_count;
+				}
+			}
+
+			dynamic = false;
+			for (const SceneObject& o : objects)
+				dynamic |= o.motion != Motion::still;
+
+			radius = object_count == 1 ? 1.0f : extent + 3.0f * (f32)(depth - 1) + 1.0f;
+			camera_pos = object_count == 1 ? Vec3{ 3.0f, 0.0f, 3.0f } : Vec3{ radius * 1.3f, radius * 0.6f, radius * 1.3f };
+
+			world.resize(object_count);
+			updated = false;
+		}
+
+		//? Far plane that keeps the whole scene in view from camera_pos
+		f32 far_plane() const
+		{
+			return length_vec(camera_pos) + radius * 2.0f;
+		}
+
+		//? World matrices for the given time, one level at a time so parents are done before children.
+		//? Static scenes are computed once.
+		void update(f32 time, JobSystem& jobs)
+		{
+			if (updated && !dynamic)
+				return;
+
+			PROFILE_SCOPE("scene update");
+			for (size_t level = 0; level + 1 < level_begin.size(); ++level)
+			{
+				const u32 begin = level_begin[level];
+				jobs.parallel_for(level_begin[level + 1] - begin, 4096, [this, begin, time](u32 first, u32 last)
+					{
+						for (u32 i = begin + first; i < begin + last; ++i)
+							world[i] = compute_world(objects[i], time);
+					});
+			}
+			updated = true;
+		}
+
+	private:
+		Mat4 compute_world(const SceneObject& o, f32 time) const
+		{
+			const f32 angle = o.phase + o.speed * time;
+			Mat4 local;
+			switch (o.motion)
+			{
+			case Motion::rotating: local = create_translate(o.offset) * create_rotation(o.axis, angle); break;
+			case Motion::orbiting: local = create_rotation(o.axis, angle) * create_translate(o.offset); break;
+			default: local = create_translate(o.offset); break;
+			}
+
+			local[0] *= o.scale;
+			local[1] *= o.scale;
+			local[2] *= o.scale;
+
+			return o.parent == ~0u ? local : world[o.parent] * local;
+		}
+	};
+}
@@ -0,0 +1,413 @@
+#pragma once
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <atomic>
+#include <thread>
+
+#include "Utils.hpp"
+#include "my_math.h"
+#include "JobSystem.hpp"
+#include "Clipper.hpp"
+
+//? Tiled CPU rasterizer for the bins ClipStage fills, with 1x, 4x and 8x multisampling. Triangles are set
+//? up once, binned to 64x64 tiles in submission order, and tiles are rasterized on the job system, each
+//? start to finish on one thread: clear, every triangle touching it, resolve into the image. Sample
+//? colors and depths only exist for the tiles in flight, one tile's worth per thread; the image is all
+//? that is kept at full size. Edges are integer, vertices snapped to 1/16 pixel, with the top-left rule,
+//? so triangles sharing an edge cover every sample exactly once. A step tests four pixels of a row per
+//? edge with SSE, once per sample, giving each pixel's coverage mask; each covered sample is depth tested
+//? at its own depth, and pixels with a sample left are shaded once at their center, the color going to
+//? every one of their samples that passed. With per_sample_shading every visible sample is shaded at its
+//? own position instead, which is supersampling with the same sample pattern and memory, to compare with.
+//! Image rows go bottom up, RGBA8; the resolve is a box filter on the stored (not linear) values.
+//! Triangles up to 16384 pixels across; the clipper's guard band keeps them well under it.
+
+namespace lib
+{
+	struct SoftRasterStats
+	{
+		u64 triangles = 0;      // set up with area left after snapping
+		u64 tile_triangles = 0; // triangle and tile pairs binned
+		u64 shaded = 0;         // shader runs: pixels with a visible sample, or visible samples with per_sample_shading
+		u64 samples = 0;        // samples passing the depth test
+
+		void add(const SoftRasterStats& o)
+		{
+			triangles += o.triangles;
+			tile_triangles += o.tile_triangles;
+			shaded += o.shaded;
+			samples += o.samples;
+		}
+	};
+
+	struct SoftRaster
+	{
+		static constexpr u32 tile_size = 64;
+		static constexpr u32 tile_pixels = tile_size * tile_size;
+		static constexpr u32 max_samples = 8;
+
+		u32 width = 0;
+		u32 height = 0;
+		u32 samples = 1;                  // 1, 4 or 8
+		b32 per_sample_shading = false;
+		u32 clear_color = 0xff000000;
+		std::vector<u32> image;           // width * height, resolved
+		SoftRasterStats stats;            // last render()
+
+		void init(u32 image_width, u32 image_height, u32 sample_count, b32 shade_samples = false)
+		{
+			SoftAssert(sample_count == 1 || sample_count == 4 || sample_count == 8);
+			width = image_width;
+			height = image_height;
+			samples = sample_count;
+			per_sample_shading = shade_samples;
+			tiles_x = (width + tile_size - 1) / tile_size;
+			tiles_y = (height + tile_size - 1) / tile_size;
+			image.assign((size_t)width * height, clear_color);
+			tile_lists.resize((size_t)tiles_x * tiles_y);
+			for (std::vector<u32>& list : tile_lists)
+				list.clear();
+
+			// D3D standard patterns, 1/16 pixel from the center
+			static const s32 pattern_4[4][2] = { { -2, -6 }, { 6, -2 }, { -6, 2 }, { 2, 6 } };
+			static const s32 pattern_8[8][2] = { { 1, -3 }, { -1, 3 }, { 5, 1 }, { -3, -5 }, { -5, 5 }, { -7, -1 }, { 3, 7 }, { 7, -7 } };
+			for (u32 s = 0; s < samples; ++s)
+			{
+				sample_x[s] = samples == 4 ? pattern_4[s][0] : samples == 8 ? pattern_8[s][0] : 0;
+				sample_y[s] = samples == 4 ? pattern_4[s][1] : samples == 8 ? pattern_8[s][1] : 0;
+			}
+		}
+
+		void destroy()
+		{
+			image = {};
+			triangles = {};
+			tile_lists = {};
+			scratch = {};
+		}
+
+		//? Rasterizes the triangles of bins in order into image, which it clears first
+		void render(JobSystem& jobs, const ClipBin* bins, u32 bin_count)
+		{
+			// setup, a range of triangles per bin so the order stays
+			bin_first.resize(bin_count + 1);
+			bin_first[0] = 0;
+			for (u32 b = 0; b < bin_count; ++b)
+				bin_first[b + 1] = bin_first[b] + (u32)(bins[b].vertices.size() / 3);
+			triangles.resize(bin_first[bin_count]);
+			jobs.parallel_for(bin_count, 1, [&](u32 first, u32 last)
+				{
+					for (u32 b = first; b < last; ++b)
+					{
+						const RasterVertex* v = bins[b].vertices.data();
+						for (u32 t = bin_first[b]; t < bin_first[b + 1]; ++t, v += 3)
+							setup(v, triangles[t]);
+					}
+				});
+
+			stats = {};
+			for (std::vector<u32>& list : tile_lists)
+				list.clear();
+			for (u32 t = 0; t < (u32)triangles.size(); ++t)
+			{
+				const Triangle& tri = triangles[t];
+				if (tri.min_x > tri.max_x)
+					continue;
+				++stats.triangles;
+				for (u32 ty = (u32)tri.min_y / tile_size; ty <= (u32)tri.max_y / tile_size; ++ty)
+				{
+					for (u32 tx = (u32)tri.min_x / tile_size; tx <= (u32)tri.max_x / tile_size; ++tx)
+						tile_lists[ty * tiles_x + tx].push_back(t);
+				}
+			}
+
+			// a job per thread pulling tiles, the job's index picks its scratch
+			const u32 slots = (u32)jobs.workers.size() + 1;
+			if (scratch.size() < slots)
+				scratch.resize(slots);
+			for (Scratch& s : scratch)
+			{
+				s.color.resize((size_t)tile_pixels * samples);
+				s.depth.resize((size_t)tile_pixels * samples);
+				s.stats = {};
+			}
+			next_tile = 0;
+			jobs.parallel_for(slots, 1, [&](u32 first, u32 last)
+				{
+					for (u32 slot = first; slot < last; ++slot)
+					{
+						for (u32 tile = next_tile++; tile < tiles_x * tiles_y; tile = next_tile++)
+							render_tile(tile, scratch[slot]);
+					}
+				});
+			for (const Scratch& s : scratch)
+				stats.add(s.stats);
+		}
+
+		//? Bytes held: the image, triangle setups, tile lists and every thread's tile of samples
+		u64 memory_bytes() const
+		{
+			u64 bytes = image.capacity() * sizeof(u32) + triangles.capacity() * sizeof(Triangle) + bin_first.capacity() * sizeof(u32);
+			for (const std::vector<u32>& list : tile_lists)
+				bytes += list.capacity() * sizeof(u32);
+			for (const Scratch& s : scratch)
+				bytes += s.color.capacity() * sizeof(u32) + s.depth.capacity() * sizeof(f32);
+			return bytes;
+		}
+
+	private:
+		struct Triangle
+		{
+			s32 min_x, min_y, max_x, max_y; // pixels, inclusive, in the image; min_x > max_x when nothing to draw
+			s64 c[3];                       // edge functions at pixel (0, 0)'s center, top-left bias in
+			s32 a[3], b[3];                 // their steps per pixel in x and y
+			s32 dx[3], dy[3];               // edges in 1/16 pixels, for sample offsets
+			f32 plane[6][3];                // z, 1/w, r, g, b, a: value at (0, 0), per pixel in x, in y
+		};
+
+		struct Scratch
+		{
+			std::vector<u32> color; // samples planes of tile_pixels
+			std::vector<f32> depth;
+			SoftRasterStats stats;
+		};
+
+		u32 tiles_x = 0;
+		u32 tiles_y = 0;
+		s32 sample_x[max_samples] = {};
+		s32 sample_y[max_samples] = {};
+		std::vector<Triangle> triangles;
+		std::vector<u32> bin_first;
+		std::vector<std::vector<u32>> tile_lists; // triangle indices per tile, in order
+		std::vector<Scratch> scratch;             // per job of render()
+		std::atomic<u32> next_tile = 0;
+
+		void setup(const RasterVertex* v, Triangle& t) const
+		{
+			s32 x[3], y[3];
+			for (u32 k = 0; k < 3; ++k)
+			{
+				x[k] = (s32)lrintf(v[k].x * 16.0f);
+				y[k] = (s32)lrintf(v[k].y * 16.0f);
+			}
+			const s64 area = (s64)(x[1] - x[0]) * (y[2] - y[0]) - (s64)(x[2] - x[0]) * (y[1] - y[0]);
+
+			// samples are within half a pixel of the center, so a pixel can be hit from anywhere in it
+			t.min_x = max(min(min(x[0], x[1]), x[2]) >> 4, 0);
+			t.min_y = max(min(min(y[0], y[1]), y[2]) >> 4, 0);
+			t.max_x = min(max(max(x[0], x[1]), x[2]) >> 4, (s32)width - 1);
+			t.max_y = min(max(max(y[0], y[1]), y[2]) >> 4, (s32)height - 1);
+			if (area <= 0 || t.min_x > t.max_x || t.min_y > t.max_y)
+			{
+				// lost its area or turned around snapping
+				t.min_x = 1;
+				t.max_x = 0;
+				return;
+			}
+
+			for (u32 k = 0; k < 3; ++k)
+			{
+				const u32 j = k == 2 ? 0 : k + 1;
+				const s32 dx = x[j] - x[k], dy = y[j] - y[k];
+				// counter-clockwise with y up: the inside is on the left, a left edge goes down, a top edge left
+				const b32 top_left = dy < 0 || (dy == 0 && dx < 0);
+				t.dx[k] = dx;
+				t.dy[k] = dy;
+				t.a[k] = -dy * 16;
+				t.b[k] = dx * 16;
+				t.c[k] = (s64)dx * (8 - y[k]) - (s64)dy * (8 - x[k]) - (top_left ? 0 : 1);
+			}
+
+			const f32 e1x = v[1].x - v[0].x, e1y = v[1].y - v[0].y;
+			const f32 e2x = v[2].x - v[0].x, e2y = v[2].y - v[0].y;
+			const f32 inv_det = 1.0f / (e1x * e2y - e2x * e1y);
+			for (u32 i = 0; i < 6; ++i)
+			{
+				const f32 f0 = (&v[0].z)[i], d1 = (&v[1].z)[i] - f0, d2 = (&v[2].z)[i] - f0;
+				const f32 ddx = (d1 * e2y - d2 * e1y) * inv_det;
+				const f32 ddy = (d2 * e1x - d1 * e2x) * inv_det;
+				t.plane[i][0] = f0 - ddx * v[0].x - ddy * v[0].y;
+				t.plane[i][1] = ddx;
+				t.plane[i][2] = ddy;
+			}
+		}
+
+		//? Color at four positions, perspective correct, packed RGBA8
+		static __m128i shade(const Triangle& t, __m128 x, __m128 y)
+		{
+			auto plane = [&](u32 i)
+			{
+				return _mm_add_ps(_mm_set1_ps(t.plane[i][0]), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.plane[i][1]), x),
+					_mm_mul_ps(_mm_set1_ps(t.plane[i][2]), y)));
+			};
+			const __m128 w = _mm_div_ps(_mm_set1_ps(1.0f), plane(1));
+			__m128i packed = _mm_setzero_si128();
+			for (u32 i = 0; i < 4; ++i)
+			{
+				const __m128 c = _mm_min_ps(_mm_max_ps(_mm_mul_ps(plane(2 + i), w), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+				const __m128i channel = _mm_cvtps_epi32(_mm_mul_ps(c, _mm_set1_ps(255.0f)));
+				packed = _mm_or_si128(packed, _mm_sll_epi32(channel, _mm_cvtsi32_si128((s32)i * 8)));
+			}
+			return packed;
+		}
+
+		void render_tile(u32 tile, Scratch& s)
+		{
+			const s32 tile_x = (s32)(tile % tiles_x * tile_size);
+			const s32 tile_y = (s32)(tile / tiles_x * tile_size);
+			const std::vector<u32>& list = tile_lists[tile];
+			u32* color = s.color.data();
+			f32* depth = s.depth.data();
+
+			const __m128i clear = _mm_set1_epi32((s32)clear_color);
+			const __m128 far_depth = _mm_set1_ps(1.0f);
+			for (u32 i = 0; i < tile_pixels * samples; i += 4)
+			{
+				_mm_store_si128((__m128i*)(color + i), clear);
+				_mm_store_ps(depth + i, far_depth);
+			}
+
+			const __m128 lane_x = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+			const __m128i minus_one = _mm_set1_epi32(-1);
+			for (u32 index : list)
+			{
+				const Triangle& t = triangles[index];
+				++s.stats.tile_triangles;
+				// tiles and rows start on a multiple of 4, so steps never leave the tile
+				const s32 x0 = max(t.min_x, tile_x) & ~3;
+				const s32 x1 = min(t.max_x, tile_x + (s32)tile_size - 1);
+				const s32 y0 = max(t.min_y, tile_y);
+				const s32 y1 = min(t.max_y, tile_y + (s32)tile_size - 1);
+
+				// edge functions at (x0, y0) fit in 32 bits once clamped: whatever is left of them within a
+				// tile stays under 2^29, so a clamped value keeps its sign all over it
+				s32 row[3];
+				__m128i lanes[3], step[3], offset[3][max_samples];
+				for (u32 k = 0; k < 3; ++k)
+				{
+					const s64 e = t.c[k] + (s64)x0 * t.a[k] + (s64)y0 * t.b[k];
+					row[k] = (s32)(e < -(1ll << 30) ? -(1ll << 30) : e > (1ll << 30) ? (1ll << 30) : e);
+					lanes[k] = _mm_setr_epi32(0, t.a[k], t.a[k] * 2, t.a[k] * 3);
+					step[k] = _mm_set1_epi32(t.a[k] * 4);
+					for (u32 i = 0; i < samples; ++i)
+						offset[k][i] = _mm_set1_epi32(t.dx[k] * sample_y[i] - t.dy[k] * sample_x[i]);
+				}
+				f32 z_offset[max_samples];
+				for (u32 i = 0; i < samples; ++i)
+					z_offset[i] = (t.plane[0][1] * (f32)sample_x[i] + t.plane[0][2] * (f32)sample_y[i]) * (1.0f / 16.0f);
+
+				for (s32 y = y0; y <= y1; ++y)
+				{
+					__m128i e0 = _mm_add_epi32(_mm_set1_epi32(row[0]), lanes[0]);
+					__m128i e1 = _mm_add_epi32(_mm_set1_epi32(row[1]), lanes[1]);
+					__m128i e2 = _mm_add_epi32(_mm_set1_epi32(row[2]), lanes[2]);
+					const __m128 fy = _mm_set1_ps((f32)y + 0.5f);
+					for (s32 x = x0; x <= x1; x += 4)
+					{
+						// inside all three edges is a clear sign bit in all three
+						__m128i covered[max_samples];
+						u32 any = 0;
+						for (u32 i = 0; i < samples; ++i)
+						{
+							const __m128i e = _mm_or_si128(_mm_or_si128(_mm_add_epi32(e0, offset[0][i]), _mm_add_epi32(e1, offset[1][i])),
+								_mm_add_epi32(e2, offset[2][i]));
+							covered[i] = _mm_cmpgt_epi32(e, minus_one);
+							any |= (u32)_mm_movemask_ps(_mm_castsi128_ps(covered[i]));
+						}
+						e0 = _mm_add_epi32(e0, step[0]);
+						e1 = _mm_add_epi32(e1, step[1]);
+						e2 = _mm_add_epi32(e2, step[2]);
+						if (!any)
+							continue;
+
+						const u32 pixel = (u32)(y - tile_y) * tile_size + (u32)(x - tile_x);
+						const __m128 fx = _mm_add_ps(_mm_set1_ps((f32)x), lane_x);
+						const __m128 z = _mm_add_ps(_mm_set1_ps(t.plane[0][0]), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.plane[0][1]), fx),
+							_mm_mul_ps(_mm_set1_ps(t.plane[0][2]), fy)));
+						// depth first, a pixel is only shaded if some sample of it is visible
+						__m128 pass[max_samples], zs[max_samples];
+						u32 visible = 0;
+						for (u32 i = 0; i < samples; ++i)
+						{
+							zs[i] = _mm_add_ps(z, _mm_set1_ps(z_offset[i]));
+							pass[i] = _mm_and_ps(_mm_castsi128_ps(covered[i]), _mm_cmplt_ps(zs[i], _mm_load_ps(depth + i * tile_pixels + pixel)));
+							visible |= (u32)_mm_movemask_ps(pass[i]);
+						}
+						if (!visible)
+							continue;
+						__m128i shaded = _mm_setzero_si128();
+						if (!per_sample_shading)
+						{
+							shaded = shade(t, fx, fy);
+							s.stats.shaded += clip_lane_count[visible];
+						}
+						for (u32 i = 0; i < samples; ++i)
+						{
+							const u32 passed = (u32)_mm_movemask_ps(pass[i]);
+							if (!passed)
+								continue;
+							if (per_sample_shading)
+							{
+								const f32 sx = (f32)sample_x[i] * (1.0f / 16.0f), sy = (f32)sample_y[i] * (1.0f / 16.0f);
+								shaded = shade(t, _mm_add_ps(fx, _mm_set1_ps(sx)), _mm_add_ps(fy, _mm_set1_ps(sy)));
+								s.stats.shaded += clip_lane_count[passed];
+							}
+							s.stats.samples += clip_lane_count[passed];
+							const u32 at = i * tile_pixels + pixel;
+							_mm_store_ps(depth + at, _mm_blendv_ps(_mm_load_ps(depth + at), zs[i], pass[i]));
+							const __m128i old_color = _mm_load_si128((const __m128i*)(color + at));
+							_mm_store_si128((__m128i*)(color + at), _mm_blendv_epi8(old_color, shaded, _mm_castps_si128(pass[i])));
+						}
+					}
+					row[0] += t.b[0];
+					row[1] += t.b[1];
+					row[2] += t.b[2];
+				}
+			}
+
+			resolve(tile_x, tile_y, color);
+		}
+
+		//? Averages the samples of a tile into the image, four pixels at a time
+		void resolve(s32 tile_x, s32 tile_y, const u32* color)
+		{
+			const u32 columns = min(tile_size, width - (u32)tile_x);
+			const u32 rows = min(tile_size, height - (u32)tile_y);
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i shift = _mm_cvtsi32_si128(samples == 8 ? 3 : samples == 4 ? 2 : 0);
+			const __m128i round = _mm_set1_epi16((s16)(samples / 2));
+			for (u32 y = 0; y < rows; ++y)
+			{
+				u32* dst = image.data() + (size_t)(tile_y + y) * width + tile_x;
+				const u32* src = color + y * tile_size;
+				if (samples == 1)
+				{
+					memcpy(dst, src, columns * sizeof(u32));
+					continue;
+				}
+				for (u32 x = 0; x < columns; x += 4)
+				{
+					__m128i lo = round, hi = round;
+					for (u32 i = 0; i < samples; ++i)
+					{
+						const __m128i c = _mm_load_si128((const __m128i*)(src + i * tile_pixels + x));
+						lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(c, zero));
+						hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(c, zero));
+					}
+					const __m128i resolved = _mm_packus_epi16(_mm_srl_epi16(lo, shift), _mm_srl_epi16(hi, shift));
+					if (x + 4 <= columns)
+					{
+						_mm_storeu_si128((__m128i*)(dst + x), resolved);
+					}
+					else
+					{
+						alignas(16) u32 last[4];
+						_mm_store_si128((__m128i*)last, resolved);
+						memcpy(dst + x, last, (columns - x) * sizeof(u32));
+					}
+				}
+			}
+		}
+	};
+}
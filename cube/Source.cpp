@@ -1,9 +1,17 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <vector>
 #include <string>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <chrono>
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
@@ -14,33 +22,29 @@
 #include <GLFW/glfw3.h>
 
 #include "my_math.h"
-
-struct Vertex
-{
-  lib::Vec3 pos;
-  lib::Vec3 col;
-};
-
-static const Vertex vertices[] = {
-
- { {-1.f, -1.f, -1.f},  {0.f, 0.f, 0.f} }, // 0
- { {-1.f, 1.f, -1.f},   {0.f, 1.f, 0.f} }, // 1
- { {1.f, 1.f, -1.f},    {1.f, 1.f, 0.f} }, // 2
- { {1.f, -1.f, -1.f},   {1.f, 0.f, 0.f} }, // 3
- { {-1.f, -1.f, 1.f},   {0.f, 0.f, 1.f} }, // 4
- { {-1.f, 1.f, 1.f},    {0.f, 1.f, 1.f} }, // 5
- { { 1.f, 1.f, 1.f},    {1.f, 1.f, 1.f} }, // 6
- { { 1.f, -1.f, 1.f},   {1.f, 0.f, 1.f} }  // 7
-};
-
-static const GLuint indices[] = {
-                          0, 1, 2, 0, 2, 3,
-                          4, 6, 5, 4, 7, 6,
-                          4, 5, 1, 4, 1, 0,
-                          3, 2, 6, 3, 6, 7,
-                          1, 5, 6, 1, 6, 2,
-                          4, 0, 3, 4, 3, 7
-};
+#include "DynamicResolution.hpp"
+#include "FrameCapture.hpp"
+#include "JobSystem.hpp"
+#include "ImageWriter.hpp"
+#include "GlRecorder.hpp"
+#include "Metrics.hpp"
+#include "GlBackend.hpp"
+#include "Scene.hpp"
+#include "PerfCounters.hpp"
+#include "Profiler.hpp"
+#include "Log.hpp"
+#include "ClusteredLights.hpp"
+#include "Texture.hpp"
+#include "BlockCompress.hpp"
+#include "Atlas.hpp"
+#include "TextureStreamer.hpp"
+#include "AssetIO.hpp"
+#include "Task.hpp"
+#include "Mesh.hpp"
+#include "GlUploader.hpp"
+#include "GpuHeap.hpp"
+#include "Hud.hpp"
+#include "DebugDraw.hpp"
 
 static const char* vertex_shader_text =
 "#version 410 core\n"
@@ -51,155 +55,1542 @@ static const char* vertex_shader_text =
 "    mat4 View;\n"
 "};\n"
 "uniform float time;\n"
+"uniform vec4 Tint;\n"
+"uniform float MaterialIndex;\n"
+"uniform float Textured;\n"
+"uniform samplerBuffer MaterialTable;\n"
 "layout(location = 0) in vec3 vPos;\n"
 "layout(location = 1) in vec3 vCol;\n"
 "out vec3 color;\n"
+"out vec3 view_pos;\n"
+"out vec3 object_pos;\n"
+"flat out int material;\n"
+"invariant gl_Position;\n" // the depth pre-pass computes it the same way, GL_EQUAL needs the same bits
 "void main()\n"
 "{\n"
-"    gl_Position = Proj * View * Model *  vec4(vPos, 1.0);\n"
-"    color = vCol;\n"
+"    vec4 view = View * Model * vec4(vPos, 1.0);\n"
+"    gl_Position = Proj * view;\n"
+"    view_pos = view.xyz;\n"
+"    object_pos = vPos;\n"
+"    material = int(MaterialIndex);\n"
+"    color = vCol * (Textured > 1.5 ? texelFetch(MaterialTable, material * 7).rgb : Tint.rgb);\n"
+"}\n";
+
+// same as above with the model matrix coming from a per-instance attribute, and with --atlas the material too
+static const char* instanced_vertex_shader_text =
+"#version 410 core\n"
+"layout (std140) uniform Matrices\n"
+"{\n"
+"    mat4 Proj;\n"
+"    mat4 View;\n"
+"};\n"
+"uniform vec4 Tint;\n"
+"uniform float Textured;\n"
+"uniform samplerBuffer MaterialTable;\n"
+"layout(location = 0) in vec3 vPos;\n"
+"layout(location = 1) in vec3 vCol;\n"
+"layout(location = 2) in mat4 iModel;\n"
+"layout(location = 6) in float iMaterial;\n"
+"out vec3 color;\n"
+"out vec3 view_pos;\n"
+"out vec3 object_pos;\n"
+"flat out int material;\n"
+"invariant gl_Position;\n" // the depth pre-pass computes it the same way, GL_EQUAL needs the same bits
+"void main()\n"
+"{\n"
+"    vec4 view = View * iModel * vec4(vPos, 1.0);\n"
+"    gl_Position = Proj * view;\n"
+"    view_pos = view.xyz;\n"
+"    object_pos = vPos;\n"
+"    material = int(iMaterial);\n"
+"    color = vCol * (Textured > 1.5 ? texelFetch(MaterialTable, material * 7).rgb : Tint.rgb);\n"
+"}\n";
+
+// Depth pre-pass, positions only; the transform is the color pass' expression for an identical gl_Position
+static const char* depth_vertex_shader_text =
+"#version 410 core\n"
+"uniform mat4 Model;\n"
+"layout (std140) uniform Matrices\n"
+"{\n"
+"    mat4 Proj;\n"
+"    mat4 View;\n"
+"};\n"
+"layout(location = 0) in vec3 vPos;\n"
+"invariant gl_Position;\n"
+"void main()\n"
+"{\n"
+"    vec4 view = View * Model * vec4(vPos, 1.0);\n"
+"    gl_Position = Proj * view;\n"
+"}\n";
+
+static const char* depth_instanced_vertex_shader_text =
+"#version 410 core\n"
+"layout (std140) uniform Matrices\n"
+"{\n"
+"    mat4 Proj;\n"
+"    mat4 View;\n"
+"};\n"
+"layout(location = 0) in vec3 vPos;\n"
+"layout(location = 2) in mat4 iModel;\n"
+"invariant gl_Position;\n"
+"void main()\n"
+"{\n"
+"    vec4 view = View * iModel * vec4(vPos, 1.0);\n"
+"    gl_Position = Proj * view;\n"
 "}\n";
 
+static const char* depth_fragment_shader_text =
+"#version 410 core\n"
+"void main()\n"
+"{\n"
+"}\n";
+
+// Clustered point lights, layout is described in ClusteredLights.hpp. Cubes have no normals, the face normal
+// comes from screen space derivatives of the view position. Ambient.a is 0 when there are no lights.
+// With --texture the albedo is sampled with object space coordinates projected along the face's major axis.
+// With --atlas (Textured 2) every material has a tint and six face tiles in MaterialTable, 7 texels each,
+// and the face coordinates wrap inside the tile; gradients come from the unwrapped ones so fract() doesn't
+// pick the smallest mip along the seam.
 static const char* fragment_shader_text =
 "#version 410\n"
+"uniform samplerBuffer Lights;\n"
+"uniform usamplerBuffer Clusters;\n"
+"uniform usamplerBuffer LightIndices;\n"
+"uniform vec4 ClusterGrid;\n"   // grid x, y, z
+"uniform vec4 ClusterParams;\n" // tiles per pixel x, y, slice scale, slice bias
+"uniform vec4 Ambient;\n"
+"uniform sampler2D Albedo;\n"
+"uniform float Textured;\n"
+"uniform samplerBuffer MaterialTable;\n"
 "in vec3 color;\n"
+"in vec3 view_pos;\n"
+"in vec3 object_pos;\n"
+"flat in int material;\n"
+"out vec4 fragment;\n"
+"void main()\n"
+"{\n"
+"    vec3 albedo = color;\n"
+"    if (Textured > 0.0)\n"
+"    {\n"
+"        vec3 f = abs(cross(dFdx(object_pos), dFdy(object_pos)));\n"
+"        int axis = f.x > f.y && f.x > f.z ? 0 : (f.y > f.z ? 1 : 2);\n"
+"        vec2 uv = axis == 0 ? object_pos.zy : (axis == 1 ? object_pos.xz : object_pos.xy);\n"
+"        if (Textured > 1.5)\n"
+"        {\n"
+"            int face = axis * 2 + (object_pos[axis] < 0.0 ? 1 : 0);\n"
+"            vec4 rect = texelFetch(MaterialTable, material * 7 + 1 + face);\n"
+"            vec2 local = uv * 0.5 + 0.5;\n"
+"            albedo *= textureGrad(Albedo, rect.xy + fract(local) * rect.zw, dFdx(local) * rect.zw, dFdy(local) * rect.zw).rgb;\n"
+"        }\n"
+"        else\n"
+"        {\n"
+"            albedo *= texture(Albedo, uv + 0.5).rgb;\n"
+"        }\n"
+"    }\n"
+"    vec3 lit = Ambient.rgb;\n"
+"    if (Ambient.a > 0.0)\n"
+"    {\n"
+"        vec3 n = normalize(cross(dFdx(view_pos), dFdy(view_pos)));\n"
+"        ivec3 grid = ivec3(ClusterGrid.xyz);\n"
+"        ivec2 tile = min(ivec2(gl_FragCoord.xy * ClusterParams.xy), grid.xy - 1);\n"
+"        int slice = int(clamp(log(-view_pos.z) * ClusterParams.z + ClusterParams.w, 0.0, ClusterGrid.z - 1.0));\n"
+"        uvec2 range = texelFetch(Clusters, (slice * grid.y + tile.y) * grid.x + tile.x).xy;\n"
+"        for (uint i = 0u; i < range.y; ++i)\n"
+"        {\n"
+"            int index = int(texelFetch(LightIndices, int(range.x + i)).x);\n"
+"            vec4 light = texelFetch(Lights, index * 2);\n"
+"            vec3 l = light.xyz - view_pos;\n"
+"            float d = length(l);\n"
+"            float falloff = clamp(1.0 - d / light.w, 0.0, 1.0);\n"
+"            lit += texelFetch(Lights, index * 2 + 1).rgb * max(dot(n, l / d), 0.0) * falloff * falloff;\n"
+"        }\n"
+"    }\n"
+"    fragment = vec4(albedo * lit, 1.0);\n"
+"}\n";
+
+// HUD quads in pixels from the top left, text samples glyph coverage from the font atlas
+static const char* hud_vertex_shader_text =
+"#version 410\n"
+"uniform vec4 Scale;\n" // pixels to NDC x, y
+"layout(location = 0) in vec2 vPos;\n"
+"layout(location = 1) in vec2 vUv;\n"
+"layout(location = 2) in vec4 vCol;\n"
+"out vec2 uv;\n"
+"out vec4 color;\n"
+"void main()\n"
+"{\n"
+"    gl_Position = vec4(vPos * Scale.xy + vec2(-1.0, 1.0), 0.0, 1.0);\n"
+"    uv = vUv;\n"
+"    color = vCol;\n"
+"}\n";
+
+static const char* hud_fragment_shader_text =
+"#version 410\n"
+"uniform sampler2D Glyphs;\n"
+"in vec2 uv;\n"
+"in vec4 color;\n"
 "out vec4 fragment;\n"
 "void main()\n"
 "{\n"
-"    fragment = vec4(color, 1.0);\n"
+"    fragment = vec4(color.rgb, color.a * texture(Glyphs, uv).r);\n"
 "}\n";
 
+static const char* debug_vertex_shader_text =
+"#version 410\n"
+"uniform mat4 ViewProj;\n"
+"uniform float PointSize;\n"
+"layout(location = 0) in vec3 vPos;\n"
+"layout(location = 1) in vec4 vCol;\n"
+"out vec4 color;\n"
+"void main()\n"
+"{\n"
+"    gl_Position = ViewProj * vec4(vPos, 1.0);\n"
+"    gl_PointSize = PointSize;\n"
+"    color = vCol;\n"
+"}\n";
+
+static const char* debug_fragment_shader_text =
+"#version 410\n"
+"in vec4 color;\n"
+"out vec4 fragment;\n"
+"void main()\n"
+"{\n"
+"    fragment = color;\n"
+"}\n";
+
+global_variable lib::DynamicResolution dynres;
+global_variable lib::FrameCapture capture;
+global_variable lib::JobSystem jobs;
+global_variable lib::ImageWriter image_writer;
+global_variable lib::Scene scene;
+global_variable lib::PerfCounters perf_counters;
+global_variable lib::PerfPhases perf_phases;
+global_variable lib::profiler::Collector profile_collector;
+global_variable lib::ClusteredLights clustered_lights;
+global_variable lib::AssetIO asset_io;
+global_variable lib::FrameQueue render_frames; // coroutines waiting for the render thread, run at frame start
+global_variable lib::JobCounter mesh_loads;
+global_variable const char* mesh_path = NULL;
+global_variable lib::GlUploader uploader;
+global_variable b32 use_upload_thread = true; // --no-upload-thread uploads on the render thread, same budget
+global_variable const u64 upload_frame_budget = 8ull << 20; // bytes per frame
+global_variable const u64 defrag_frame_budget = 1ull << 20; // bytes copied per idle frame
+global_variable const char* trace_path = NULL;
+global_variable const char* texture_path = NULL;
+global_variable const char* texture_format = NULL; // bc1/bc3/bc7 compresses at load, NULL keeps RGBA8
+global_variable b32 use_atlas = false;
+global_variable lib::TextureStreamer texture_streamer;
+global_variable u32 stream_budget_mib = 0; // --stream, 0 keeps every texture resident
+global_variable const u64 stream_upload_budget = 4ull << 20; // bytes per frame
+global_variable u32 gpu_budget_mib = 0; // --gpu-budget, reported when crossed
+global_variable const char* prepass_materials = NULL; // --prepass, "all" or material indices like 0,3,5
+global_variable b32 depth_prepass = false; // on with --prepass, P toggles it
+global_variable lib::Hud hud; // --hud shows it from the start, H toggles it
+global_variable lib::DebugDraw debug_draw; // --debug-draw turns it on from the start, B toggles it
+
+// GLFW calls this on whatever thread hit the error, usually the render thread mid-frame
 static void error_callback(int error, const char* description)
 {
-  fprintf(stderr, "Error: %s\n", description);
+  LOG("Error 0x%x: %s", error, description);
 }
 
 static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
   if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
     glfwSetWindowShouldClose(window, GLFW_TRUE);
-}
 
-int main(void)
-{
-  glfwSetErrorCallback(error_callback);
+  if (key == GLFW_KEY_R && action == GLFW_PRESS)
+  {
+    dynres.enabled = !dynres.enabled;
+    printf("dynamic resolution %s\n", dynres.enabled ? "on" : "off");
+  }
 
-  if (!glfwInit())
-    exit(EXIT_FAILURE);
+  if (key == GLFW_KEY_F12 && action == GLFW_PRESS)
+    capture.cycle_mode();
 
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  if (key == GLFW_KEY_B && action == GLFW_PRESS)
+    debug_draw.enabled = !debug_draw.enabled;
 
-  GLFWwindow* window = glfwCreateWindow(1200, 1200, "OpenGL Cube", NULL, NULL);
-  if (!window)
+  if (key == GLFW_KEY_P && action == GLFW_PRESS && prepass_materials)
   {
-    glfwTerminate();
-    exit(EXIT_FAILURE);
+    depth_prepass = !depth_prepass;
+    printf("depth pre-pass %s\n", depth_prepass ? "on" : "off");
   }
 
-  glfwSetKeyCallback(window, key_callback);
-
-  glfwMakeContextCurrent(window);
-  gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
-  glfwSwapInterval(1);
+  // Shift+H picks whether captures include the HUD
+  if (key == GLFW_KEY_H && action == GLFW_PRESS)
+  {
+    if (mods & GLFW_MOD_SHIFT)
+    {
+      hud.in_capture = !hud.in_capture;
+      printf("hud %s captures\n", hud.in_capture ? "in" : "hidden from");
+    }
+    else
+    {
+      hud.visible = !hud.visible;
+    }
+  }
+}
 
-  // NOTE: OpenGL error checks have been omitted for brevity
+struct Renderer
+{
+  GLuint program;
+  GLuint instanced_program;
+  GLuint instance_buffer;
+  GLuint vertex_array;
 
+  // mesh geometry is sub-allocated from a few big buffers; ranges can move between frames, so draws look
+  // them up and rebind when a mesh lives in another buffer than the previous one
+  lib::GpuHeap vertex_heap;
+  lib::GpuHeap index_heap;
+  lib::GpuHeap position_heap;          // the vertices' positions again, packed for the depth pre-pass
+  struct MeshRanges { u32 vertices, indices, first_index, positions; };
+  std::vector<MeshRanges> mesh_ranges; // per scene mesh
+  u32 shared_indices;                  // the cube's meshes all use the same indices
+  GLuint bound_vertex_buffer;          // in the vertex array, 0 forces a rebind
+  GLuint bound_index_buffer;
 
+  // depth pre-pass, its own vertex array reads positions and the same instance data
+  GLuint depth_program;
+  GLuint depth_instanced_program;
+  GLuint depth_vertex_array;
+  GLint depth_model_location;
+  GLuint depth_bound_position_buffer;
+  GLuint depth_bound_index_buffer;
+  std::vector<u8> prepass_material; // per scene material, 1 when it is in the pre-pass
+  u32 prepass_count;
+  GLuint uboMatrices;
+  GLint mvp_location;
+  GLint tint_location;
+  GLint instanced_tint_location;
+  b32 instances_valid;
 
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_FRAMEBUFFER_SRGB); // linear color input and then gamma corrected framebuffer
-  glEnable(GL_CULL_FACE);
-  glFrontFace(GL_CCW);
-  glCullFace(GL_BACK);
+  // clustered lighting, uniforms are looked up in both programs
+  GLuint light_buffers[3];  // lights, cluster ranges, light indices
+  GLuint light_textures[3];
+  struct LightUniforms { GLint grid, params, ambient; } light_uniforms[2];
 
-  GLuint vertex_buffer;
-  glGenBuffers(1, &vertex_buffer);
-  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+  GLuint albedo_texture; // 0 without --texture
+  b32 streaming;         // --stream: one streamed texture per material, bound per batch
 
-  GLuint EBO;
-  glGenBuffers(1, &EBO);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+  // --atlas: per-material tint and face tiles, per-instance material ids, batches merged across materials
+  GLuint material_table_buffer;
+  GLuint material_table_texture;
+  GLuint material_buffer;
+  GLint material_location;
+  std::vector<lib::SceneBatch> atlas_batches;
+  lib::Mat4 view_proj; // of the last render_scene()
+};
 
+static GLuint create_program(const char* vs_text, const char* fs_text)
+{
   const GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertex_shader, 1, &vertex_shader_text, NULL);
+  glShaderSource(vertex_shader, 1, &vs_text, NULL);
   glCompileShader(vertex_shader);
 
   const GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragment_shader, 1, &fragment_shader_text, NULL);
+  glShaderSource(fragment_shader, 1, &fs_text, NULL);
   glCompileShader(fragment_shader);
 
   const GLuint program = glCreateProgram();
   glAttachShader(program, vertex_shader);
   glAttachShader(program, fragment_shader);
   glLinkProgram(program);
+  return program;
+}
 
-  const GLint mvp_location = glGetUniformLocation(program, "Model");
-  const GLint vpos_location = glGetAttribLocation(program, "vPos");
-  const GLint vcol_location = glGetAttribLocation(program, "vCol");
+//? Reads --texture through asset_io, decodes it, filters the mips on the job system and uploads them as
+//? sRGB, block compressed with --texture-format. .ctex files from bench/texture_compress are uploaded as they are.
+static GLuint load_albedo(const char* path)
+{
+  PROFILE_SCOPE("load texture");
+  const size_t length = strlen(path);
+  const b32 ctex = length > 5 && strcmp(path + length - 5, ".ctex") == 0;
+  lib::IoArena arena;
+  arena.init(0); // one block the size of the file
+  const lib::IoResult file = asset_io.read(path, arena, lib::IoPriority::high).get();
+  lib::CompressedTexture compressed;
+  lib::Image image;
+  const b32 decoded = file.status == lib::IoStatus::done &&
+    (ctex ? lib::parse_ctex(file.data, file.size, compressed) : lib::decode_image(file.data, file.size, image));
+  arena.destroy();
+  if (!decoded)
+  {
+    fprintf(stderr, ctex ? "can't load texture %s\n" : "can't load texture %s (png, qoi or ppm)\n", path);
+    return 0;
+  }
 
-  GLuint vertex_array;
-  glGenVertexArrays(1, &vertex_array);
-  glBindVertexArray(vertex_array);
+  if (ctex)
+  {
+    printf("texture %s: %dx%d %s, %zu levels, %.1f KiB%s\n", path, compressed.width, compressed.height, lib::bc_format_name(compressed.format),
+      compressed.levels.size(), compressed.blocks.size() / 1024.0, lib::bc_format_supported(compressed.format) ? "" : ", decompressed for this driver");
+    return lib::upload_compressed(compressed);
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  lib::MipChain chain;
+  lib::build_mips(image, chain, lib::MipFilter::kaiser, &jobs);
+  const f64 mip_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  lib::BcFormat format;
+  if (texture_format && lib::parse_bc_format(texture_format, format))
+  {
+    const auto compress_start = std::chrono::steady_clock::now();
+    lib::compress(chain, format, compressed, &jobs);
+    const f64 compress_ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - compress_start).count();
+    printf("texture %s: %dx%d %s, %zu levels, %.1f KiB, mips %.2f ms, compress %.2f ms%s\n", path, chain.width, chain.height, texture_format,
+      chain.levels.size(), compressed.blocks.size() / 1024.0, mip_ms, compress_ms,
+      lib::bc_format_supported(format) ? "" : ", decompressed for this driver");
+    return lib::upload_compressed(compressed);
+  }
+
+  const GLuint texture = lib::upload_texture(chain);
+  printf("texture %s: %dx%d, %zu levels, %.1f KiB, mips %.2f ms\n", path, chain.width, chain.height, chain.levels.size(),
+    chain.pixels.size() / 1024.0, mip_ms);
+  return texture;
+}
+
+//? Gray checkers, stripes or rings over the image's size, picked by rng, bands of 4..15 texels times scale
+static void fill_pattern(lib::Image& image, lib::SceneRng& rng, s32 scale = 1)
+{
+  image.pixels.resize((size_t)image.width * image.height * 4);
+  const u32 pattern = rng.below(3);
+  const s32 period = (4 + (s32)rng.below(12)) * scale;
+  const u8 dark = (u8)(60 + rng.below(80)), light = (u8)(180 + rng.below(76));
+  for (s32 y = 0; y < image.height; ++y)
+  {
+    for (s32 x = 0; x < image.width; ++x)
+    {
+      const s32 dx = x - image.width / 2, dy = y - image.height / 2;
+      const s32 band = pattern == 0 ? (x / period) ^ (y / period) : pattern == 1 ? (x + y) / period : (s32)sqrtf((f32)(dx * dx + dy * dy)) / period;
+      u8* p = &image.pixels[((size_t)y * image.width + x) * 4];
+      p[0] = p[1] = p[2] = (band & 1) ? light : dark;
+      p[3] = 255;
+    }
+  }
+}
+
+//? Stand-in face textures for --atlas, six per material in a few sizes, the material color tints them
+//? in the shader
+static void make_face_textures(const lib::Scene& scene, std::vector<lib::Image>& images)
+{
+  static const s32 sizes[5] = { 32, 48, 64, 96, 128 };
+  lib::SceneRng rng{ scene.desc.seed ^ 0x61746c6173ull };
+  images.resize(scene.materials.size() * 6);
+  for (lib::Image& image : images)
+  {
+    image.width = sizes[rng.below(5)];
+    image.height = sizes[rng.below(5)];
+    fill_pattern(image, rng);
+  }
+}
+
+//? --stream: one texture per material, --texture for all of them (read through asset_io at low priority)
+//? or a generated 1024x1024 pattern, decoded on the streamer's threads when a material first shows up
+static void init_streaming(Renderer& r, const lib::Scene& scene)
+{
+  texture_streamer.init((u64)stream_budget_mib << 20, stream_upload_budget);
+  for (u32 m = 0; m < (u32)scene.materials.size(); ++m)
+  {
+    const u64 seed = scene.desc.seed ^ 0x73747265616dull ^ ((u64)m << 32);
+    texture_streamer.add([seed](lib::Image& image)
+      {
+        if (texture_path)
+        {
+          lib::IoArena arena;
+          arena.init(0);
+          const lib::IoResult file = asset_io.read(texture_path, arena, lib::IoPriority::low).get();
+          const b32 decoded = file.status == lib::IoStatus::done && lib::decode_image(file.data, file.size, image);
+          arena.destroy();
+          return decoded;
+        }
+        lib::SceneRng rng{ seed };
+        image.width = 1024;
+        image.height = 1024;
+        fill_pattern(image, rng, 8);
+        return (b32)true;
+      });
+  }
+  r.streaming = true;
+  printf("streaming: %zu textures, %u MiB budget, %.1f MiB uploads per frame\n", scene.materials.size(), stream_budget_mib,
+    stream_upload_budget / (1024.0 * 1024.0));
+}
+
+//? Screen size of every material's texture from the nearest object in front of the camera using it: a
+//? face spans 2 * scale world units. Then the streamer uploads and evicts for this frame.
+static void stream_textures(const lib::Scene& scene, const lib::Mat4& view, f32 fov)
+{
+  PROFILE_SCOPE("texture residency");
+  const u32 material_count = (u32)scene.materials.size();
+  const u32 batch = 16384;
+  const u32 chunks = ((u32)scene.objects.size() + batch - 1) / batch;
+  const f32 focal = 0.5f * (f32)dynres.render_height / tanf(0.5f * fov);
+  std::vector<f32> pixels((size_t)chunks * material_count, 0.0f);
+  jobs.parallel_for((u32)scene.objects.size(), batch, [&](u32 first, u32 last)
+    {
+      f32* out = &pixels[(size_t)(first / batch) * material_count];
+      for (u32 i = first; i < last; ++i)
+      {
+        const lib::Mat4& world = scene.world[i];
+        const lib::Vec4 p = view * world[3];
+        const f32 scale = lib::length_vec(world[0].xyz);
+        const f32 distance = lib::max(-p.z - scale, 0.1f);
+        if (-p.z + scale <= 0.1f)
+          continue;
+        f32& best = out[scene.objects[i].material];
+        best = lib::max(best, 2.0f * scale * focal / distance);
+      }
+    });
+
+  for (u32 m = 0; m < material_count; ++m)
+  {
+    f32 best = 0.0f;
+    for (u32 c = 0; c < chunks; ++c)
+      best = lib::max(best, pixels[(size_t)c * material_count + m]);
+    if (best > 0.0f)
+      texture_streamer.request(m, best);
+  }
+  texture_streamer.update();
+}
+
+//? --atlas: packs every material's face textures into one page on unit 3 and puts tint and tile rects in
+//? a texture buffer on unit 4. Instanced scenes also get a per-instance material id, so batches that
+//? only differ by material draw as one.
+static void init_atlas(Renderer& r, const lib::Scene& scene)
+{
+  PROFILE_SCOPE("init atlas");
+  std::vector<lib::Image> images;
+  make_face_textures(scene, images);
+  lib::Atlas atlas;
+  if (!atlas.build(images, 5, &jobs))
+  {
+    fprintf(stderr, "%zu face textures don't fit a 16k atlas\n", images.size());
+    return;
+  }
+  r.albedo_texture = lib::upload_texture(atlas.chain);
+  atlas.print_summary();
+
+  // tint, then the tiles of +x, -x, +y, -y, +z, -z
+  std::vector<lib::Vec4> table(scene.materials.size() * 7);
+  for (u32 m = 0; m < (u32)scene.materials.size(); ++m)
+  {
+    table[m * 7] = scene.materials[m];
+    for (u32 face = 0; face < 6; ++face)
+      table[m * 7 + 1 + face] = atlas.uv_rect(m * 6 + face);
+  }
+  glGenBuffers(1, &r.material_table_buffer);
+  glBindBuffer(GL_TEXTURE_BUFFER, r.material_table_buffer);
+  glBufferData(GL_TEXTURE_BUFFER, table.size() * sizeof(lib::Vec4), table.data(), GL_STATIC_DRAW);
+  glGenTextures(1, &r.material_table_texture);
+  glActiveTexture(GL_TEXTURE4);
+  glBindTexture(GL_TEXTURE_BUFFER, r.material_table_texture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, r.material_table_buffer);
+  glActiveTexture(GL_TEXTURE0);
+
+  // without the atlas every face texture is its own draw, and binds change per face of every batch
+  size_t draws_before = 0, draws_after = 0;
+  if (scene.desc.instanced)
+  {
+    std::vector<f32> materials(scene.objects.size());
+    for (u32 i = 0; i < (u32)scene.objects.size(); ++i)
+      materials[i] = (f32)scene.objects[i].material;
+    glGenBuffers(1, &r.material_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, r.material_buffer);
+    glBufferData(GL_ARRAY_BUFFER, materials.size() * sizeof(f32), materials.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(6);
+    glVertexAttribDivisor(6, 1);
+
+    for (const lib::SceneBatch& batch : scene.batches)
+    {
+      lib::SceneBatch* last = r.atlas_batches.empty() ? nullptr : &r.atlas_batches.back();
+      if (last && last->mesh == batch.mesh && last->first_object + last->object_count == batch.first_object &&
+      r.prepass_material[last->material] == r.prepass_material[batch.material])
+        last->object_count += batch.object_count;
+      else
+        r.atlas_batches.push_back(batch);
+    }
+    draws_before = scene.batches.size() * 6;
+    draws_after = r.atlas_batches.size();
+  }
+  else
+  {
+    draws_before = scene.objects.size() * 6;
+    draws_after = scene.objects.size();
+  }
+  printf("atlas: %zu draws and 1 texture bind per frame instead of %zu draws and %zu binds\n", draws_after, draws_before, scene.batches.size() * 6);
+}
+
+static std::vector<lib::Vec3> positions_of(const lib::Vertex* vertices, u32 count)
+{
+  std::vector<lib::Vec3> positions(count);
+  for (u32 i = 0; i < count; ++i)
+    positions[i] = vertices[i].pos;
+  return positions;
+}
+
+//? --mesh: read on the I/O thread, parsed and optimized on the job system, ranges for it taken from the
+//? heaps on the render thread and filled by the upload thread, then swapped in for mesh 0 on the render
+//? thread at the start of a frame. Objects refer to meshes by index, so all of the cube's pick it up.
+static lib::Task<void> load_mesh(Renderer& r, std::string path)
+{
+  const auto start = std::chrono::steady_clock::now();
+  auto since = [&start] { return std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count(); };
+
+  lib::IoArena arena;
+  arena.init(0);
+  const lib::IoResult file = co_await lib::read_file(asset_io, path.c_str(), arena, lib::IoPriority::normal, &jobs);
+  const f64 read_ms = since();
+  lib::MeshData mesh;
+  const b32 parsed = file.status == lib::IoStatus::done && lib::parse_obj(file.data, file.size, mesh);
+  arena.destroy();
+  if (!parsed)
+  {
+    fprintf(stderr, "can't load mesh %s (obj)\n", path.c_str());
+    co_return;
+  }
+  const f64 parse_ms = since();
+  const lib::MeshOptimizeStats optimized = lib::optimize_mesh(mesh);
+  const f64 optimize_ms = since();
+
+  // a new page is a GL buffer, so ranges come from the render thread; the heaps aren't defragmented while a
+  // load is pending, the ranges stay put until the upload thread has filled them
+  co_await render_frames.next_frame();
+  const u32 vertex_range = r.vertex_heap.alloc((u32)mesh.vertices.size());
+  const u32 index_range = r.index_heap.alloc((u32)mesh.indices.size());
+  const u32 position_range = r.position_heap.alloc((u32)mesh.vertices.size());
+  if (vertex_range == lib::GpuHeap::none || index_range == lib::GpuHeap::none || position_range == lib::GpuHeap::none)
+  {
+    if (vertex_range != lib::GpuHeap::none)
+      r.vertex_heap.free(vertex_range);
+    if (index_range != lib::GpuHeap::none)
+      r.index_heap.free(index_range);
+    if (position_range != lib::GpuHeap::none)
+      r.position_heap.free(position_range);
+    fprintf(stderr, "no room for mesh %s\n", path.c_str());
+    co_return;
+  }
+
+  // upload callbacks run on the render thread
+  co_await lib::await_callback<GLuint>([&](lib::GlUploader::Done done)
+    {
+      uploader.upload_buffer_range(r.vertex_heap.buffer(vertex_range), r.vertex_heap.byte_offset(vertex_range), mesh.vertices.data(),
+        mesh.vertices.size() * sizeof(lib::Vertex), static_cast<lib::GlUploader::Done&&>(done));
+    });
+  co_await lib::await_callback<GLuint>([&](lib::GlUploader::Done done)
+    {
+      uploader.upload_buffer_range(r.index_heap.buffer(index_range), r.index_heap.byte_offset(index_range), mesh.indices.data(),
+        mesh.indices.size() * sizeof(GLuint), static_cast<lib::GlUploader::Done&&>(done));
+    });
+  const std::vector<lib::Vec3> positions = positions_of(mesh.vertices.data(), (u32)mesh.vertices.size());
+  co_await lib::await_callback<GLuint>([&](lib::GlUploader::Done done)
+    {
+      uploader.upload_buffer_range(r.position_heap.buffer(position_range), r.position_heap.byte_offset(position_range), positions.data(),
+        positions.size() * sizeof(lib::Vec3), static_cast<lib::GlUploader::Done&&>(done));
+    });
+  const f64 upload_ms = since();
+  {
+    PROFILE_SCOPE("swap mesh ranges");
+    Renderer::MeshRanges& ranges = r.mesh_ranges[0];
+    r.vertex_heap.free(ranges.vertices);
+    r.position_heap.free(ranges.positions);
+    if (ranges.indices != r.shared_indices)
+      r.index_heap.free(ranges.indices);
+    ranges = { vertex_range, index_range, 0, position_range };
+    scene.meshes[0] = { 0, 0, (u32)mesh.indices.size(), mesh.vertices[0].pos, mesh.vertices[0].pos }; // where it is only the renderer knows
+    for (const lib::Vertex& v : mesh.vertices)
+      lib::grow_bounds(scene.meshes[0].bounds_min, scene.meshes[0].bounds_max, v.pos);
+  }
+  printf("mesh %s: %zu triangles, %u -> %u vertices; read %.2f ms, parse %.2f ms, optimize %.2f ms, upload %.2f ms, swap %.2f ms\n",
+    path.c_str(), mesh.indices.size() / 3, optimized.vertices_in, optimized.vertices_out, read_ms, parse_ms - read_ms,
+    optimize_ms - parse_ms, upload_ms - optimize_ms, since() - upload_ms);
+}
+
+static void init_renderer(Renderer& r, const lib::Scene& scene)
+{
+  // NOTE: OpenGL error checks have been omitted for brevity
+
+  glEnable(GL_DEPTH_TEST);
+  glEnable(GL_FRAMEBUFFER_SRGB); // linear color input and then gamma corrected framebuffer
+  glEnable(GL_CULL_FACE);
+  glFrontFace(GL_CCW);
+  glCullFace(GL_BACK);
+
+  // 6 MiB of vertices, 3 MiB of positions and 4 MiB of indices per page, a range bigger than that gets a
+  // page of its own
+  r.vertex_heap.init("vertex", sizeof(lib::Vertex), 1u << 18);
+  r.position_heap.init("position", sizeof(lib::Vec3), 1u << 18);
+  r.index_heap.init("index", sizeof(GLuint), 1u << 20);
+  const std::vector<lib::Vec3> positions = positions_of(scene.vertices.data(), (u32)scene.vertices.size());
+  r.shared_indices = r.index_heap.alloc((u32)scene.indices.size());
+  r.index_heap.upload(r.shared_indices, scene.indices.data(), (u32)scene.indices.size());
+  r.mesh_ranges.resize(scene.meshes.size());
+  for (u32 m = 0; m < (u32)scene.meshes.size(); ++m)
+  {
+    const lib::SceneMesh& mesh = scene.meshes[m];
+    const u32 end = m + 1 < (u32)scene.meshes.size() ? scene.meshes[m + 1].base_vertex : (u32)scene.vertices.size();
+    const u32 range = r.vertex_heap.alloc(end - mesh.base_vertex);
+    r.vertex_heap.upload(range, scene.vertices.data() + mesh.base_vertex, end - mesh.base_vertex);
+    const u32 position_range = r.position_heap.alloc(end - mesh.base_vertex);
+    r.position_heap.upload(position_range, positions.data() + mesh.base_vertex, end - mesh.base_vertex);
+    r.mesh_ranges[m] = { range, r.shared_indices, mesh.first_index, position_range };
+  }
+  r.bound_vertex_buffer = 0;
+  r.bound_index_buffer = 0;
+
+  r.program = create_program(vertex_shader_text, fragment_shader_text);
+  r.mvp_location = glGetUniformLocation(r.program, "Model");
+  r.tint_location = glGetUniformLocation(r.program, "Tint");
+  r.material_location = glGetUniformLocation(r.program, "MaterialIndex");
+  const GLint vpos_location = glGetAttribLocation(r.program, "vPos");
+  const GLint vcol_location = glGetAttribLocation(r.program, "vCol");
+
+  glGenVertexArrays(1, &r.vertex_array);
+  glBindVertexArray(r.vertex_array);
+  // pointers are set by bind_mesh() with the vertex heap page bound
   glEnableVertexAttribArray(vpos_location);
-  glVertexAttribPointer(vpos_location, 3, GL_FLOAT, GL_FALSE,
-    sizeof(Vertex), (void*)offsetof(Vertex, pos));
   glEnableVertexAttribArray(vcol_location);
-  glVertexAttribPointer(vcol_location, 3, GL_FLOAT, GL_FALSE,
-    sizeof(Vertex), (void*)offsetof(Vertex, col));
+
+  // model matrix columns at locations 2..5, pointers are set per batch when drawing
+  r.instance_buffer = 0;
+  r.instanced_program = 0;
+  r.instances_valid = false;
+  if (scene.desc.instanced)
+  {
+    r.instanced_program = create_program(instanced_vertex_shader_text, fragment_shader_text);
+    r.instanced_tint_location = glGetUniformLocation(r.instanced_program, "Tint");
+    glUniformBlockBinding(r.instanced_program, glGetUniformBlockIndex(r.instanced_program, "Matrices"), 0);
+
+    glGenBuffers(1, &r.instance_buffer);
+    for (GLuint column = 0; column < 4; ++column)
+    {
+      glEnableVertexAttribArray(2 + column);
+      glVertexAttribDivisor(2 + column, 1);
+    }
+  }
 
   // obtain location of the uniform block
   GLuint Matrices_binding = 0;
-  GLint matricesIndex = glGetUniformBlockIndex(program, "Matrices");
+  GLint matricesIndex = glGetUniformBlockIndex(r.program, "Matrices");
   // Bind the uniform block to the binding point
-  glUniformBlockBinding(program, matricesIndex, Matrices_binding);
+  glUniformBlockBinding(r.program, matricesIndex, Matrices_binding);
   // Create uniform buffer object for matrices
-  GLuint uboMatrices;
-  glGenBuffers(1, &uboMatrices);
-  glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
+  glGenBuffers(1, &r.uboMatrices);
+  glBindBuffer(GL_UNIFORM_BUFFER, r.uboMatrices);
   glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(lib::Mat4), NULL, GL_STATIC_DRAW);
-  glBindBufferBase(GL_UNIFORM_BUFFER, Matrices_binding, uboMatrices);
+  glBindBufferBase(GL_UNIFORM_BUFFER, Matrices_binding, r.uboMatrices);
+
+  // light data lives in texture buffers on units 0..2, refilled every frame; the samplers differ in type
+  // so they need distinct units even when there are no lights
+  const GLenum light_formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+  glGenBuffers(3, r.light_buffers);
+  glGenTextures(3, r.light_textures);
+  for (u32 i = 0; i < 3; ++i)
+  {
+    glBindBuffer(GL_TEXTURE_BUFFER, r.light_buffers[i]);
+    glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, r.light_textures[i]);
+    glTexBuffer(GL_TEXTURE_BUFFER, light_formats[i], r.light_buffers[i]);
+  }
+
+  const GLuint programs[2] = { r.program, r.instanced_program };
+  for (u32 p = 0; p < 2; ++p)
+  {
+    r.light_uniforms[p] = { -1, -1, -1 };
+    if (!programs[p])
+      continue;
+    glUseProgram(programs[p]);
+    glUniform1i(glGetUniformLocation(programs[p], "Lights"), 0);
+    glUniform1i(glGetUniformLocation(programs[p], "Clusters"), 1);
+    glUniform1i(glGetUniformLocation(programs[p], "LightIndices"), 2);
+    glUniform1i(glGetUniformLocation(programs[p], "Albedo"), 3);
+    glUniform1i(glGetUniformLocation(programs[p], "MaterialTable"), 4);
+    r.light_uniforms[p] = { glGetUniformLocation(programs[p], "ClusterGrid"), glGetUniformLocation(programs[p], "ClusterParams"),
+      glGetUniformLocation(programs[p], "Ambient") };
+  }
+
+  r.prepass_material.assign(scene.materials.size(), 0);
+  if (prepass_materials && strcmp(prepass_materials, "all") == 0)
+  {
+    r.prepass_material.assign(scene.materials.size(), 1);
+  }
+  else if (prepass_materials)
+  {
+    for (const char* s = prepass_materials; *s; s += *s == ',')
+    {
+      char* end;
+      const unsigned long m = strtoul(s, &end, 10);
+      if (end == s)
+        break;
+      if (m < r.prepass_material.size())
+        r.prepass_material[m] = 1;
+      s = end;
+    }
+  }
+  r.prepass_count = 0;
+  for (u8 in_prepass : r.prepass_material)
+    r.prepass_count += in_prepass;
+  if (prepass_materials)
+    printf("depth pre-pass: %u of %zu materials\n", r.prepass_count, r.prepass_material.size());
+
+  // albedo or the atlas stays bound on unit 3 for the whole run
+  r.albedo_texture = 0;
+  r.streaming = false;
+  r.material_table_buffer = 0;
+  r.material_table_texture = 0;
+  r.material_buffer = 0;
+  if (use_atlas)
+    init_atlas(r, scene);
+  else if (stream_budget_mib)
+    init_streaming(r, scene);
+  else if (texture_path)
+    r.albedo_texture = load_albedo(texture_path);
+  glActiveTexture(GL_TEXTURE3);
+  glBindTexture(GL_TEXTURE_2D, r.albedo_texture);
+  glActiveTexture(GL_TEXTURE0);
+  for (u32 p = 0; p < 2; ++p)
+  {
+    if (!programs[p])
+      continue;
+    glUseProgram(programs[p]);
+    glUniform1f(glGetUniformLocation(programs[p], "Textured"), r.material_table_texture ? 2.0f : r.albedo_texture || r.streaming ? 1.0f : 0.0f);
+  }
+
+  // position at location 0, instance matrix columns at 2..5 like the color pass, pointers set when drawing
+  r.depth_program = create_program(depth_vertex_shader_text, depth_fragment_shader_text);
+  r.depth_model_location = glGetUniformLocation(r.depth_program, "Model");
+  glUniformBlockBinding(r.depth_program, glGetUniformBlockIndex(r.depth_program, "Matrices"), 0);
+  r.depth_instanced_program = 0;
+  glGenVertexArrays(1, &r.depth_vertex_array);
+  glBindVertexArray(r.depth_vertex_array);
+  glEnableVertexAttribArray(0);
+  if (scene.desc.instanced)
+  {
+    r.depth_instanced_program = create_program(depth_instanced_vertex_shader_text, depth_fragment_shader_text);
+    glUniformBlockBinding(r.depth_instanced_program, glGetUniformBlockIndex(r.depth_instanced_program, "Matrices"), 0);
+    for (GLuint column = 0; column < 4; ++column)
+    {
+      glEnableVertexAttribArray(2 + column);
+      glVertexAttribDivisor(2 + column, 1);
+    }
+  }
+  glBindVertexArray(r.vertex_array);
+}
+
+//? Bins the lights for this frame's view and projection and uploads the result
+static void upload_lights(Renderer& r, const lib::Mat4& view, float time, int width, int height, float fov, float far_plane)
+{
+  lib::ClusteredLights& cl = clustered_lights;
+  cl.set_projection(fov, (f32)width / height, 0.1f, far_plane);
+  cl.bin(view, time, jobs);
+
+  const void* data[3] = { cl.gpu_lights.data(), cl.cluster_ranges.data(), cl.light_indices.data() };
+  const size_t sizes[3] = { cl.gpu_lights.size() * sizeof(lib::GpuLight), cl.cluster_ranges.size() * sizeof(u32),
+    cl.light_indices.size() * sizeof(u16) };
+  for (u32 i = 0; i < 3; ++i)
+  {
+    glBindBuffer(GL_TEXTURE_BUFFER, r.light_buffers[i]);
+    glBufferData(GL_TEXTURE_BUFFER, sizes[i], data[i], GL_STREAM_DRAW);
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_BUFFER, r.light_textures[i]);
+  }
+  glActiveTexture(GL_TEXTURE0);
+}
+
+static void set_light_uniforms(const Renderer::LightUniforms& u)
+{
+  const lib::ClusteredLights& cl = clustered_lights;
+  const b32 lit = !cl.lights.empty();
+  const lib::Vec4 grid = { (f32)cl.grid_x, (f32)cl.grid_y, (f32)cl.grid_z, 0.0f };
+  // tiles cover what is rendered this frame, which is smaller than the window with dynamic resolution
+  const lib::Vec4 params = { (f32)cl.grid_x / (f32)dynres.render_width, (f32)cl.grid_y / (f32)dynres.render_height,
+    lit ? cl.z_scale() : 0.0f, lit ? cl.z_bias() : 0.0f };
+  const lib::Vec4 ambient = lit ? lib::Vec4{ 0.08f, 0.08f, 0.08f, 1.0f } : lib::Vec4{ 1.0f, 1.0f, 1.0f, 0.0f };
+  glUniform4fv(u.grid, 1, (const GLfloat*)&grid);
+  glUniform4fv(u.params, 1, (const GLfloat*)&params);
+  glUniform4fv(u.ambient, 1, (const GLfloat*)&ambient);
+}
+
+//? Compacts the heaps on frames with nothing loading or uploading, a range the upload thread is filling
+//? must not move
+static void defragment_heaps(Renderer& r)
+{
+  if (mesh_loads.pending.load(std::memory_order_acquire) || !uploader.idle())
+    return;
+  PROFILE_SCOPE("defragment heaps");
+  r.vertex_heap.defragment(defrag_frame_budget);
+  r.position_heap.defragment(defrag_frame_budget);
+  r.index_heap.defragment(defrag_frame_budget);
+}
+
+struct MeshDraw
+{
+  void* first_index; // byte offset into the bound index buffer
+  GLint base_vertex;
+  b32 rebound;       // GL_ARRAY_BUFFER now holds the vertex page
+};
+
+//? Points the vertex array at the heap pages holding mesh when they aren't bound yet
+static MeshDraw bind_mesh(Renderer& r, u32 mesh)
+{
+  const Renderer::MeshRanges& ranges = r.mesh_ranges[mesh];
+  const GLuint vertices = r.vertex_heap.buffer(ranges.vertices);
+  const GLuint indices = r.index_heap.buffer(ranges.indices);
+  const b32 rebound = vertices != r.bound_vertex_buffer;
+  if (rebound)
+  {
+    // vPos and vCol are locations 0 and 1 in both programs
+    glBindBuffer(GL_ARRAY_BUFFER, vertices);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(lib::Vertex), (void*)offsetof(lib::Vertex, pos));
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(lib::Vertex), (void*)offsetof(lib::Vertex, col));
+    r.bound_vertex_buffer = vertices;
+  }
+  if (indices != r.bound_index_buffer)
+  {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices);
+    r.bound_index_buffer = indices;
+  }
+  const size_t first = (size_t)r.index_heap.offset(ranges.indices) + ranges.first_index;
+  return { (void*)(first * sizeof(GLuint)), (GLint)r.vertex_heap.offset(ranges.vertices), rebound };
+}
+
+//? Positions of mesh in the pre-pass' vertex array, as bind_mesh() does for the color pass
+static MeshDraw bind_positions(Renderer& r, u32 mesh)
+{
+  const Renderer::MeshRanges& ranges = r.mesh_ranges[mesh];
+  const GLuint positions = r.position_heap.buffer(ranges.positions);
+  const GLuint indices = r.index_heap.buffer(ranges.indices);
+  const b32 rebound = positions != r.depth_bound_position_buffer;
+  if (rebound)
+  {
+    glBindBuffer(GL_ARRAY_BUFFER, positions);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(lib::Vec3), (void*)0);
+    r.depth_bound_position_buffer = positions;
+  }
+  if (indices != r.depth_bound_index_buffer)
+  {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices);
+    r.depth_bound_index_buffer = indices;
+  }
+  const size_t first = (size_t)r.index_heap.offset(ranges.indices) + ranges.first_index;
+  return { (void*)(first * sizeof(GLuint)), (GLint)r.position_heap.offset(ranges.positions), rebound };
+}
+
+//? Depth of the batches whose material is in the pre-pass, positions only and no color writes. The color
+//? pass then shades those with GL_EQUAL, once per pixel, and what it draws after them is rejected early
+//? against the finished depth. Instance data must be uploaded already. False when there is no pre-pass.
+static b32 render_depth_prepass(Renderer& r, const lib::Scene& scene, const std::vector<lib::SceneBatch>& batches)
+{
+  if (!depth_prepass || !r.prepass_count)
+    return false;
+
+  PROFILE_SCOPE("depth prepass");
+  glBindVertexArray(r.depth_vertex_array);
+  r.depth_bound_position_buffer = 0;
+  r.depth_bound_index_buffer = 0;
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  glUseProgram(scene.desc.instanced ? r.depth_instanced_program : r.depth_program);
+  for (const lib::SceneBatch& batch : batches)
+  {
+    if (!r.prepass_material[batch.material])
+      continue;
+    const lib::SceneMesh& mesh = scene.meshes[batch.mesh];
+    const MeshDraw draw = bind_positions(r, batch.mesh);
+    if (scene.desc.instanced)
+    {
+      if (draw.rebound)
+        glBindBuffer(GL_ARRAY_BUFFER, r.instance_buffer);
+      const size_t first = (size_t)batch.first_object * sizeof(lib::Mat4);
+      for (GLuint column = 0; column < 4; ++column)
+        glVertexAttribPointer(2 + column, 4, GL_FLOAT, GL_FALSE, sizeof(lib::Mat4), (void*)(first + column * sizeof(lib::Vec4)));
+      glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.index_count, GL_UNSIGNED_INT,
+        draw.first_index, batch.object_count, draw.base_vertex);
+      continue;
+    }
+    for (u32 i = batch.first_object; i < batch.first_object + batch.object_count; ++i)
+    {
+      glUniformMatrix4fv(r.depth_model_location, 1, GL_FALSE, (const GLfloat*)&scene.world[i]);
+      glDrawElementsBaseVertex(GL_TRIANGLES, mesh.index_count, GL_UNSIGNED_INT, draw.first_index, draw.base_vertex);
+    }
+  }
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  glBindVertexArray(r.vertex_array);
+  return true;
+}
+
+//? With a pre-pass the color pass runs twice: pass 0 shades the pre-pass materials on their finished depth,
+//? pass 1 the rest with the usual test. Without one only pass 1 runs and takes everything.
+static b32 skip_batch(const Renderer& r, const lib::SceneBatch& batch, b32 prepass, u32 pass)
+{
+  return prepass && (r.prepass_material[batch.material] != 0) != (pass == 0);
+}
+
+static void set_pass_depth(b32 prepass, u32 pass)
+{
+  if (!prepass)
+    return;
+  glDepthFunc(pass == 0 ? GL_EQUAL : GL_LESS);
+  glDepthMask(pass == 0 ? GL_FALSE : GL_TRUE);
+}
+
+static void render_scene(Renderer& r, const lib::Scene& scene, float time, int width, int height)
+{
+  PROFILE_SCOPE("render scene");
+
+  lib::Vec3 camera_target = { 0.0f, 0.0f, 0.0f, };
+  lib::Mat4 view = lib::create_look_at(scene.camera_pos, camera_target, { 0.0f, 1.0f, 0.0f });
+  lib::Mat4 projection = lib::create_perspective(lib::deg_to_rad(50.0f), (f32)width / height, 0.1f, scene.far_plane());
+  r.view_proj = projection * view;
+  if (!clustered_lights.lights.empty())
+    upload_lights(r, view, time, width, height, lib::deg_to_rad(50.0f), scene.far_plane());
+  if (r.streaming)
+    stream_textures(scene, view, lib::deg_to_rad(50.0f));
+
+  glBindBuffer(GL_UNIFORM_BUFFER, r.uboMatrices);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(lib::Mat4), &projection);
+  glBufferSubData(GL_UNIFORM_BUFFER, sizeof(lib::Mat4), sizeof(lib::Mat4), &view);
+
+  glBindVertexArray(r.vertex_array);
+  // defragmenting between frames can move ranges and free pages
+  r.bound_vertex_buffer = 0;
+  r.bound_index_buffer = 0;
+
+  if (scene.desc.instanced)
+  {
+    // static scenes upload once, moving ones orphan and refill the whole buffer every frame
+    glBindBuffer(GL_ARRAY_BUFFER, r.instance_buffer);
+    if (!r.instances_valid || scene.dynamic)
+    {
+      glBufferData(GL_ARRAY_BUFFER, scene.world.size() * sizeof(lib::Mat4), scene.world.data(), GL_STREAM_DRAW);
+      r.instances_valid = true;
+    }
+
+    const std::vector<lib::SceneBatch>& batches = r.material_buffer ? r.atlas_batches : scene.batches;
+    const b32 prepass = render_depth_prepass(r, scene, batches);
+    glUseProgram(r.instanced_program);
+    set_light_uniforms(r.light_uniforms[1]);
+    if (r.streaming)
+      glActiveTexture(GL_TEXTURE3);
+    for (u32 pass = prepass ? 0 : 1; pass < 2; ++pass)
+    {
+      set_pass_depth(prepass, pass);
+      for (const lib::SceneBatch& batch : batches)
+      {
+        if (skip_batch(r, batch, prepass, pass))
+          continue;
+        const lib::SceneMesh& mesh = scene.meshes[batch.mesh];
+        const MeshDraw draw = bind_mesh(r, batch.mesh);
+        if (draw.rebound)
+          glBindBuffer(GL_ARRAY_BUFFER, r.instance_buffer);
+        const size_t first = (size_t)batch.first_object * sizeof(lib::Mat4);
+        for (GLuint column = 0; column < 4; ++column)
+          glVertexAttribPointer(2 + column, 4, GL_FLOAT, GL_FALSE, sizeof(lib::Mat4), (void*)(first + column * sizeof(lib::Vec4)));
+        if (r.material_buffer)
+        {
+          glBindBuffer(GL_ARRAY_BUFFER, r.material_buffer);
+          glVertexAttribPointer(6, 1, GL_FLOAT, GL_FALSE, sizeof(f32), (void*)((size_t)batch.first_object * sizeof(f32)));
+          glBindBuffer(GL_ARRAY_BUFFER, r.instance_buffer);
+        }
 
-  while (!glfwWindowShouldClose(window))
+        glUniform4fv(r.instanced_tint_location, 1, (const GLfloat*)&scene.materials[batch.material]);
+        if (r.streaming)
+          glBindTexture(GL_TEXTURE_2D, texture_streamer.texture(batch.material));
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.index_count, GL_UNSIGNED_INT,
+          draw.first_index, batch.object_count, draw.base_vertex);
+      }
+    }
+    if (r.streaming)
+      glActiveTexture(GL_TEXTURE0);
+    return;
+  }
+
+  const b32 prepass = render_depth_prepass(r, scene, scene.batches);
+  glUseProgram(r.program);
+  glUniform1f(glGetUniformLocation(r.program, "time"), time);
+  set_light_uniforms(r.light_uniforms[0]);
+  if (r.streaming)
+    glActiveTexture(GL_TEXTURE3);
+  for (u32 pass = prepass ? 0 : 1; pass < 2; ++pass)
+  {
+    set_pass_depth(prepass, pass);
+    for (const lib::SceneBatch& batch : scene.batches)
+    {
+      if (skip_batch(r, batch, prepass, pass))
+        continue;
+      const lib::SceneMesh& mesh = scene.meshes[batch.mesh];
+      const MeshDraw draw = bind_mesh(r, batch.mesh);
+      glUniform4fv(r.tint_location, 1, (const GLfloat*)&scene.materials[batch.material]);
+      glUniform1f(r.material_location, (f32)batch.material);
+      if (r.streaming)
+        glBindTexture(GL_TEXTURE_2D, texture_streamer.texture(batch.material));
+      for (u32 i = batch.first_object; i < batch.first_object + batch.object_count; ++i)
+      {
+        glUniformMatrix4fv(r.mvp_location, 1, GL_FALSE, (const GLfloat*)&scene.world[i]);
+        glDrawElementsBaseVertex(GL_TRIANGLES, mesh.index_count, GL_UNSIGNED_INT, draw.first_index, draw.base_vertex);
+      }
+    }
+  }
+  if (r.streaming)
+    glActiveTexture(GL_TEXTURE0);
+}
+
+//? Object bounds, light ranges and the world axes. Bounds come from the job system, each worker appends to
+//? its own arena.
+static void draw_debug(const lib::Scene& scene, float time)
+{
+  PROFILE_SCOPE("debug draw");
+  jobs.parallel_for((u32)scene.objects.size(), 4096, [&scene](u32 first, u32 last)
+    {
+      for (u32 i = first; i < last; ++i)
+      {
+        const lib::SceneObject& o = scene.objects[i];
+        const lib::SceneMesh& mesh = scene.meshes[o.mesh];
+        debug_draw.obb(scene.world[i], mesh.bounds_min, mesh.bounds_max, lib::debug_color(scene.materials[o.material].rgb));
+      }
+    });
+  for (const lib::PointLight& light : clustered_lights.lights)
+  {
+    const lib::Vec3 pos = lib::ClusteredLights::world_pos(light, time);
+    debug_draw.sphere(pos, light.radius, lib::debug_color(light.color, 0.5f));
+    debug_draw.point(pos, lib::debug_color(light.color), lib::DebugDepth::overlay);
+  }
+  debug_draw.axes(lib::create_diagonal_matrix(), scene.radius * 0.25f);
+}
+
+//? Frame time and GPU memory in the window title twice a second, while the HUD is off
+static void update_title(GLFWwindow* window, f64 time)
+{
+  static f64 next_update = 0.0;
+  if (time < next_update)
+    return;
+  next_update = time + 0.5;
+  const lib::GpuMemoryTracker& m = lib::gpu_memory;
+  const f64 mib = 1024.0 * 1024.0;
+  char title[256];
+  s32 n = snprintf(title, sizeof(title), "OpenGL Cube - %.2f ms - gpu %.1f MiB (peak %.1f)", lib::metrics.last.cpu_ms, m.total / mib, m.peak_total / mib);
+  if (m.total_budget)
+    n += snprintf(title + n, sizeof(title) - n, " of %.0f", m.total_budget / mib);
+  if (m.available_kib >= 0)
+    n += snprintf(title + n, sizeof(title) - n, ", %.0f MiB free", m.available_kib / 1024.0);
+  for (u32 c = 0; c < lib::GpuMemoryTracker::category_count && n < (s32)sizeof(title); ++c)
+  {
+    if (m.bytes[c])
+      n += snprintf(title + n, sizeof(title) - n, " | %s %.1f", lib::gpu_category_names[c], m.bytes[c] / mib);
+  }
+  glfwSetWindowTitle(window, title);
+}
+
+static void print_scene(const lib::Scene& scene)
+{
+  printf("scene %s (seed %llu): %zu objects, %zu meshes, %zu materials, %zu levels, %zu batches, %s%s\n",
+    scene.desc.name, (unsigned long long)scene.desc.seed, scene.objects.size(), scene.meshes.size(), scene.materials.size(),
+    scene.level_begin.size() - 1, scene.batches.size(), scene.dynamic ? "dynamic" : "static", scene.desc.instanced ? ", instanced" : "");
+}
+
+static void write_trace()
+{
+  if (!trace_path)
+    return;
+
+  profile_collector.collect();
+  profile_collector.print_summary();
+  if (!profile_collector.write_chrome_trace(trace_path))
+    fprintf(stderr, "can't write trace %s\n", trace_path);
+}
+
+#if defined(CUBE_MOCK_GL)
+// Mock build: no window and no context, GL calls only hit counters. Runs a fixed number of frames
+// at a fixed resolution and reports CPU cost of the render loop plus what it would have sent to GL.
+static int run_mock(u32 frame_count)
+{
+  lib::glbackend::install_mock();
+  lib::gpu_memory.init();
+
+  jobs.init();
+  asset_io.init();
+  // no context to make current, the mock functions work from any thread
+  uploader.init(upload_frame_budget, use_upload_thread ? lib::GlUploader::Context([](b32) {}) : nullptr);
+  print_scene(scene);
+
+  Renderer renderer;
+  init_renderer(renderer, scene);
+  if (mesh_path)
+    lib::spawn(load_mesh(renderer, mesh_path), &mesh_loads);
+  dynres.init();
+  hud.init(create_program(hud_vertex_shader_text, hud_fragment_shader_text));
+  debug_draw.init(create_program(debug_vertex_shader_text, debug_fragment_shader_text));
+  lib::metrics.end_frame(); // setup isn't a frame
+  lib::metrics = {};
+
+  const int width = 1200, height = 1200;
+  const auto start = std::chrono::steady_clock::now();
+  for (u32 frame = 0; frame < frame_count; ++frame)
+  {
+    PROFILE_SCOPE("frame");
+    const auto frame_start = std::chrono::steady_clock::now();
+    uploader.begin_frame();
+    render_frames.run();
+    defragment_heaps(renderer);
+
+    perf_phases.begin();
+    scene.update((float)frame / 60.0f, jobs);
+    perf_phases.end("update");
+
+    perf_phases.begin();
+    dynres.begin_frame(width, height);
+    dynres.clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    render_scene(renderer, scene, (float)frame / 60.0f, width, height);
+    if (debug_draw.enabled)
+    {
+      draw_debug(scene, (float)frame / 60.0f);
+      debug_draw.flush(renderer.view_proj);
+    }
+    dynres.end_frame(width, height);
+    hud.draw(width, height);
+    perf_phases.end("submit");
+
+    lib::metrics.current.cpu_ms = std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - frame_start).count();
+    lib::metrics.end_frame();
+    if (trace_path)
+      profile_collector.collect();
+  }
+  const f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+  // a mesh still loading needs this thread for its last steps, and the job system for the ones before
+  while (mesh_loads.pending.load(std::memory_order_acquire))
+  {
+    uploader.begin_frame();
+    render_frames.run();
+    std::this_thread::yield();
+  }
+
+  dynres.destroy();
+  jobs.destroy();
+  lib::metrics.print_summary("mock gl");
+  hud.print_summary();
+  hud.destroy();
+  debug_draw.print_summary();
+  debug_draw.destroy();
+  printf("mock gl: %.1f frames/s, %.2f us per frame\n", frame_count / seconds, seconds * 1e6 / frame_count);
+  lib::gpu_memory.print_summary();
+  clustered_lights.print_summary();
+  texture_streamer.print_summary();
+  if (renderer.streaming)
+    texture_streamer.destroy();
+  uploader.print_summary();
+  uploader.destroy();
+  renderer.vertex_heap.print_summary();
+  renderer.position_heap.print_summary();
+  renderer.index_heap.print_summary();
+  renderer.vertex_heap.destroy();
+  renderer.position_heap.destroy();
+  renderer.index_heap.destroy();
+  asset_io.print_summary();
+  lib::TaskFramePool::print_summary();
+  asset_io.destroy();
+  perf_phases.print_summary(frame_count, scene.objects.size(), "object");
+  perf_counters.destroy();
+  write_trace();
+  return EXIT_SUCCESS;
+}
+#endif
+
+// usage: cube [--scene <preset>] [--seed <n>] [--lights <count>] [--texture <path>] [--texture-format bc1|bc3|bc7] [--atlas] [--stream <vram MiB>] [--mesh <obj>] [--no-upload-thread] [--gpu-budget <MiB>] [--prepass all|<material,...>] [--hud] [--debug-draw] [--record <path> [frame]] [--frames <count>] [--perf] [--trace <path>]
+int main(int argc, char** argv)
+{
+  lib::SceneDesc scene_desc = lib::scene_presets[0];
+  const char* record_path = NULL;
+  u32 record_frame = 60;
+  u32 frame_count = 0; // --frames, 0 runs the window until it is closed and the mock build for 10000
+  u32 light_count = 0;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+    {
+      record_path = argv[++i];
+      if (i + 1 < argc && argv[i + 1][0] != '-')
+        record_frame = (u32)atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+    {
+      frame_count = (u32)atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+    {
+      const lib::SceneDesc* preset = lib::find_scene_preset(argv[++i]);
+      if (!preset)
+      {
+        fprintf(stderr, "unknown scene %s, presets:", argv[i]);
+        for (const lib::SceneDesc& desc : lib::scene_presets)
+          fprintf(stderr, " %s", desc.name);
+        fprintf(stderr, "\n");
+        exit(EXIT_FAILURE);
+      }
+      const u64 seed = scene_desc.seed;
+      scene_desc = *preset;
+      scene_desc.seed = seed;
+    }
+    else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+    {
+      scene_desc.seed = strtoull(argv[++i], NULL, 10);
+    }
+    else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc)
+    {
+      light_count = (u32)atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--texture") == 0 && i + 1 < argc)
+    {
+      texture_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--atlas") == 0)
+    {
+      use_atlas = true;
+    }
+    else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc)
+    {
+      stream_budget_mib = (u32)atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc)
+    {
+      mesh_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--no-upload-thread") == 0)
+    {
+      use_upload_thread = false;
+    }
+    else if (strcmp(argv[i], "--gpu-budget") == 0 && i + 1 < argc)
+    {
+      gpu_budget_mib = (u32)atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--prepass") == 0 && i + 1 < argc)
+    {
+      prepass_materials = argv[++i];
+      depth_prepass = true;
+    }
+    else if (strcmp(argv[i], "--hud") == 0)
+    {
+      hud.visible = true;
+    }
+    else if (strcmp(argv[i], "--debug-draw") == 0)
+    {
+      debug_draw.enabled = true;
+    }
+    else if (strcmp(argv[i], "--texture-format") == 0 && i + 1 < argc)
+    {
+      lib::BcFormat format;
+      texture_format = argv[++i];
+      if (!lib::parse_bc_format(texture_format, format))
+      {
+        fprintf(stderr, "unknown texture format %s, bc1, bc3 or bc7\n", texture_format);
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+    {
+      // zones only exist in builds with CUBE_PROFILE, the trace is empty otherwise
+      trace_path = argv[++i];
+      profile_collector.init();
+    }
+    else if (strcmp(argv[i], "--perf") == 0)
+    {
+      // counters are per thread, phases measure the render thread only
+      if (perf_counters.init())
+        perf_phases.counters = &perf_counters;
+    }
+  }
+
+  scene.generate(scene_desc);
+  lib::gpu_memory.total_budget = (u64)gpu_budget_mib << 20;
+  clustered_lights.generate(light_count, scene.radius, scene_desc.seed);
+
+#if defined(CUBE_MOCK_GL)
+  return run_mock(frame_count ? frame_count : 10000);
+#endif
+
+  lib::log::logger.init();
+  glfwSetErrorCallback(error_callback);
+
+  if (!glfwInit())
+  {
+    lib::log::logger.destroy();
+    exit(EXIT_FAILURE);
+  }
+
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+  GLFWwindow* window = glfwCreateWindow(1200, 1200, "OpenGL Cube", NULL, NULL);
+  if (!window)
   {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glfwTerminate();
+    lib::log::logger.destroy();
+    exit(EXIT_FAILURE);
+  }
+
+  glfwSetKeyCallback(window, key_callback);
+
+  glfwMakeContextCurrent(window);
+  gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+  glfwSwapInterval(1);
+
+  lib::glbackend::install_counters();
+  lib::gpu_memory.init();
+
+  if (record_path)
+  {
+    int fb_width, fb_height;
+    glfwGetFramebufferSize(window, &fb_width, &fb_height);
+    lib::glrec::install(record_path, record_frame, fb_width, fb_height);
+  }
+
+  print_scene(scene);
+
+  jobs.init(); // texture mips are filtered on it during init_renderer
+  asset_io.init();
+
+  // hidden 1x1 window for a context sharing objects with the main one, current on the upload thread only;
+  // the recorder captures one thread's calls, so recording keeps uploads on this one
+  GLFWwindow* upload_window = NULL;
+  if (use_upload_thread && !record_path)
+  {
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    upload_window = glfwCreateWindow(1, 1, "upload", NULL, window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+  }
+  uploader.init(upload_frame_budget, upload_window ? lib::GlUploader::Context([upload_window](b32 current)
+    {
+      glfwMakeContextCurrent(current ? upload_window : NULL);
+    }) : nullptr);
+
+  Renderer renderer;
+  init_renderer(renderer, scene);
+  if (mesh_path)
+    lib::spawn(load_mesh(renderer, mesh_path), &mesh_loads);
+
+  // budget for dynamic resolution is one vblank of the monitor we start on
+  const GLFWvidmode* video_mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+  if (video_mode && video_mode->refreshRate > 0)
+    dynres.target_ms = 1000.0f / (float)video_mode->refreshRate;
+  dynres.init();
+  hud.init(create_program(hud_vertex_shader_text, hud_fragment_shader_text));
+  hud.target_ms = dynres.target_ms;
+  debug_draw.init(create_program(debug_vertex_shader_text, debug_fragment_shader_text));
+
+  image_writer.init(&jobs, lib::ImageFormat::qoi);
+
+  // capture worker only copies the frame into the writer's queue, encoding happens on the job system
+  capture.init([](const lib::CapturedFrame& frame)
+    {
+      char path[64];
+      snprintf(path, sizeof(path), "capture_%05u.%s", frame.index, lib::image_format_ext(image_writer.format));
+      image_writer.write(path, { frame.pixels, frame.width, frame.height, true });
+    });
+
+  lib::metrics = {};
+
+  while (!glfwWindowShouldClose(window) && (!frame_count || lib::metrics.frames < frame_count))
+  {
+    PROFILE_SCOPE("frame");
+    const auto frame_start = std::chrono::steady_clock::now();
     float time = (float)glfwGetTime();
     int width, height;
     glfwGetFramebufferSize(window, &width, &height);
-    const float ratio = (float)width / (float)height;
+    uploader.begin_frame();
+    render_frames.run();
+    defragment_heaps(renderer);
 
-    glViewport(0, 0, width, height);
-    glClear(GL_COLOR_BUFFER_BIT);
+    perf_phases.begin();
+    scene.update(time, jobs);
+    perf_phases.end("update");
 
-    lib::Vec3 camera_pos = { 3.0f, 0.0f, 3.0f };
-    lib::Vec3 camera_target = { 0.0f, 0.0f, 0.0f, };
-    lib::Mat4 view = lib::create_look_at(camera_pos, camera_target, { 0.0f, 1.0f, 0.0f });
-    lib::Mat4 translate = lib::create_translate({ -0.33f, 0.0f, 0.0f });
-    lib::Mat4 rotation = lib::create_rotation_z((f32)time);
-    lib::Mat4 projection = lib::create_perspective(lib::deg_to_rad(50.0f), (f32)width / height, 0.1f, 100.0f);
-    lib::Mat4 model = translate * rotation;
+    perf_phases.begin();
+    lib::glrec::begin_frame();
+    dynres.begin_frame(width, height);
+    dynres.clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glUseProgram(program);
+    render_scene(renderer, scene, time, width, height);
+    // into the scene's depth, before it is resolved
+    if (debug_draw.enabled)
+    {
+      draw_debug(scene, time);
+      debug_draw.flush(renderer.view_proj);
+    }
 
-    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(lib::Mat4), &projection);
-    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(lib::Mat4), sizeof(lib::Mat4), &view);
+    dynres.end_frame(width, height);
+    lib::glrec::end_frame();
+    perf_phases.end("submit");
 
-    glUniformMatrix4fv(mvp_location, 1, GL_FALSE, (const GLfloat*)&model);
-    glUniform1f(glGetUniformLocation(program, "time"), time);
-    glBindVertexArray(vertex_array);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO); // Bind the EBO
-    glDrawElements(GL_TRIANGLES, sizeof(indices) / sizeof(indices[0]), GL_UNSIGNED_INT, 0);
+    // after the recorder's frame, a replay shows the scene only
+    perf_phases.begin();
+    if (hud.in_capture)
+      hud.draw(width, height);
+    capture.capture(width, height);
+    if (!hud.in_capture)
+      hud.draw(width, height);
+    perf_phases.end("capture");
 
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    lib::metrics.current.cpu_ms = std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - frame_start).count();
+    lib::metrics.current.gpu_ms = dynres.timer.last_ms;
+
+    perf_phases.begin();
+    {
+      PROFILE_SCOPE("present");
+      glfwSwapBuffers(window);
+      glfwPollEvents();
+    }
+    perf_phases.end("present");
+
+    lib::metrics.end_frame();
+    if (!hud.visible)
+      update_title(window, time);
+    if (trace_path)
+      profile_collector.collect();
   }
+  // a mesh still loading needs this thread for its last steps, and the job system for the ones before
+  while (mesh_loads.pending.load(std::memory_order_acquire))
+  {
+    uploader.begin_frame();
+    render_frames.run();
+    std::this_thread::yield();
+  }
+
+  lib::metrics.print_summary("gl");
+  hud.print_summary();
+  hud.destroy();
+  debug_draw.print_summary();
+  debug_draw.destroy();
+  lib::gpu_memory.print_summary();
+  clustered_lights.print_summary();
+  texture_streamer.print_summary();
+  if (renderer.streaming)
+    texture_streamer.destroy();
+  uploader.print_summary();
+  uploader.destroy();
+  renderer.vertex_heap.print_summary();
+  renderer.position_heap.print_summary();
+  renderer.index_heap.print_summary();
+  renderer.vertex_heap.destroy();
+  renderer.position_heap.destroy();
+  renderer.index_heap.destroy();
+  asset_io.print_summary();
+  lib::TaskFramePool::print_summary();
+  asset_io.destroy();
+  perf_phases.print_summary(lib::metrics.frames, scene.objects.size(), "object");
+  perf_counters.destroy();
+  dynres.print_summary();
+  dynres.write_log("dynres_log.csv");
+  dynres.destroy();
+  capture.destroy();
+  capture.print_stats();
+  image_writer.flush();
+  image_writer.print_stats();
+  jobs.destroy();
+  write_trace();
 
+  if (upload_window)
+    glfwDestroyWindow(upload_window);
   glfwDestroyWindow(window);
 
   glfwTerminate();
+  lib::log::logger.destroy();
   exit(EXIT_SUCCESS);
 }
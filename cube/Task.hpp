@@ -0,0 +1,508 @@
+#pragma once
+#include <stdlib.h>
+#include <stdio.h>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <exception>
+#include <coroutine>
+
+#include "Utils.hpp"
+#include "JobSystem.hpp"
+#include "AssetIO.hpp"
+
+//? Coroutines for load chains that hop between threads: read on the I/O thread, decode on the job system,
+//? upload on the render thread. Task<T> is lazy and single owner; co_await starts it and the awaiting
+//? coroutine continues when it returns (symmetric transfer; optimized builds turn it into a tail call, so
+//? long chains of tasks that finish synchronously don't grow the stack, unoptimized ones may). Where
+//? a coroutine runs is whatever resumed it last, so each hop is explicit:
+//?   co_await schedule(jobs);                      next line runs on a job system worker
+//?   co_await read_file(io, path, arena, p, &jobs); the file is in the arena, running on a worker
+//?   co_await frames.next_frame();                 running on the render thread, at the start of a frame
+//? Frames come from a per-thread freelist by size class, so chains that load thousands of assets don't hit
+//? malloc per step. Exceptions aren't used in this codebase, one escaping a coroutine terminates.
+
+namespace lib
+{
+	//? Size classes of 64 << i bytes; bigger frames go straight to malloc. Freed frames go on the freeing
+	//? thread's list, which is fine for a cache of equally sized blocks.
+	struct TaskFramePool
+	{
+		static constexpr u32 class_count = 7; // up to 4 KiB
+		static constexpr size_t header = 16;  // class index, keeps the frame 16 byte aligned
+
+		struct Node
+		{
+			Node* next;
+		};
+
+		// plain thread_locals have no init guard, the hot path is a TLS load; Cleanup is only touched when
+		// a list runs empty, it frees the lists and folds the counts in when the thread exits
+		static inline thread_local Node* lists[class_count] = {};
+		static inline thread_local u64 local_allocations = 0;
+		static inline thread_local u64 local_reused = 0;
+		static inline std::atomic<u64> exited_allocations{ 0 };
+		static inline std::atomic<u64> exited_reused{ 0 };
+
+		struct Cleanup
+		{
+			~Cleanup()
+			{
+				for (Node*& list : lists)
+				{
+					while (list)
+					{
+						Node* next = list->next;
+						::free(list);
+						list = next;
+					}
+				}
+				exited_allocations.fetch_add(local_allocations, std::memory_order_relaxed);
+				exited_reused.fetch_add(local_reused, std::memory_order_relaxed);
+			}
+		};
+		static inline thread_local Cleanup cleanup; // one per thread, see own_lists()
+
+		//? Registers the thread's Cleanup, needed before its lists hold anything
+		static void own_lists()
+		{
+			(void)&cleanup;
+		}
+
+		static void* alloc(size_t size)
+		{
+			u32 index = 0;
+			while (index < class_count && ((size_t)64 << index) < size + header)
+				++index;
+			++local_allocations;
+
+			u8* block = nullptr;
+			if (index < class_count && lists[index])
+			{
+				block = (u8*)lists[index];
+				lists[index] = lists[index]->next;
+				++local_reused;
+			}
+			else
+			{
+				own_lists();
+				block = (u8*)::malloc(index < class_count ? (size_t)64 << index : size + header);
+				if (!block)
+					std::terminate();
+			}
+			*(u32*)block = index;
+			return block + header;
+		}
+
+		static void free(void* p)
+		{
+			u8* block = (u8*)p - header;
+			const u32 index = *(u32*)block;
+			if (index >= class_count)
+			{
+				::free(block);
+				return;
+			}
+			if (!lists[index])
+				own_lists(); // threads that only free frames own a list too
+			Node* node = (Node*)block;
+			node->next = lists[index];
+			lists[index] = node;
+		}
+
+		//? Counts this thread and threads that have exited
+		static void print_summary()
+		{
+			const u64 count = exited_allocations.load(std::memory_order_relaxed) + local_allocations;
+			if (count)
+				printf("task frames: %llu allocated, %.1f%% from the pool\n", (unsigned long long)count,
+					(exited_reused.load(std::memory_order_relaxed) + local_reused) * 100.0 / count);
+		}
+	};
+
+	template <typename T>
+	struct Task;
+
+	struct TaskPromiseBase
+	{
+		std::coroutine_handle<> continuation;
+
+		static void* operator new(size_t size)
+		{
+			return TaskFramePool::alloc(size);
+		}
+
+		static void operator delete(void* p)
+		{
+			TaskFramePool::free(p);
+		}
+
+		std::suspend_always initial_suspend() noexcept
+		{
+			return {};
+		}
+
+		struct FinalAwaiter
+		{
+			bool await_ready() noexcept
+			{
+				return false;
+			}
+
+			template <typename P>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+			{
+				const std::coroutine_handle<> next = h.promise().continuation;
+				return next ? next : std::noop_coroutine();
+			}
+
+			void await_resume() noexcept
+			{
+			}
+		};
+
+		FinalAwaiter final_suspend() noexcept
+		{
+			return {};
+		}
+
+		void unhandled_exception() noexcept
+		{
+			std::terminate();
+		}
+	};
+
+	template <typename T>
+	struct TaskPromise : TaskPromiseBase
+	{
+		std::optional<T> value;
+
+		Task<T> get_return_object();
+
+		void return_value(T v)
+		{
+			value.emplace(static_cast<T&&>(v));
+		}
+
+		T result()
+		{
+			return static_cast<T&&>(*value);
+		}
+	};
+
+	template <>
+	struct TaskPromise<void> : TaskPromiseBase
+	{
+		Task<void> get_return_object();
+
+		void return_void()
+		{
+		}
+
+		void result()
+		{
+		}
+	};
+
+	template <typename T = void>
+	struct Task
+	{
+		using promise_type = TaskPromise<T>;
+
+		std::coroutine_handle<promise_type> handle;
+
+		Task() = default;
+
+		explicit Task(std::coroutine_handle<promise_type> h) : handle(h)
+		{
+		}
+
+		Task(Task&& other) noexcept : handle(other.handle)
+		{
+			other.handle = nullptr;
+		}
+
+		Task& operator=(Task&& other) noexcept
+		{
+			if (this != &other)
+			{
+				if (handle)
+					handle.destroy();
+				handle = other.handle;
+				other.handle = nullptr;
+			}
+			return *this;
+		}
+
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+
+		~Task()
+		{
+			if (handle)
+				handle.destroy();
+		}
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		//? Starts the task right away, this coroutine continues where the task returns
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+		{
+			handle.promise().continuation = awaiting;
+			return handle;
+		}
+
+		T await_resume()
+		{
+			return handle.promise().result();
+		}
+	};
+
+	template <typename T>
+	inline Task<T> TaskPromise<T>::get_return_object()
+	{
+		return Task<T>{ std::coroutine_handle<TaskPromise<T>>::from_promise(*this) };
+	}
+
+	inline Task<void> TaskPromise<void>::get_return_object()
+	{
+		return Task<void>{ std::coroutine_handle<TaskPromise<void>>::from_promise(*this) };
+	}
+
+	//? Owns itself: starts immediately and frees its frame when it ends
+	struct DetachedTask
+	{
+		struct promise_type
+		{
+			static void* operator new(size_t size)
+			{
+				return TaskFramePool::alloc(size);
+			}
+
+			static void operator delete(void* p)
+			{
+				TaskFramePool::free(p);
+			}
+
+			DetachedTask get_return_object() noexcept
+			{
+				return {};
+			}
+
+			std::suspend_never initial_suspend() noexcept
+			{
+				return {};
+			}
+
+			std::suspend_never final_suspend() noexcept
+			{
+				return {};
+			}
+
+			void return_void() noexcept
+			{
+			}
+
+			void unhandled_exception() noexcept
+			{
+				std::terminate();
+			}
+		};
+	};
+
+	inline DetachedTask run_detached(Task<void> task, JobCounter* counter)
+	{
+		co_await task;
+		if (counter)
+			counter->pending.fetch_sub(1, std::memory_order_release);
+	}
+
+	//? Runs task on this thread until its first hop, then it goes on by itself. counter drops once it has
+	//? finished, to wait on it (JobSystem::wait, or a loop that also runs a FrameQueue).
+	inline void spawn(Task<void> task, JobCounter* counter = nullptr)
+	{
+		if (counter)
+			counter->pending.fetch_add(1, std::memory_order_relaxed);
+		run_detached(static_cast<Task<void>&&>(task), counter);
+	}
+
+	template <typename T>
+	inline Task<void> store_result(Task<T> task, std::optional<T>& out)
+	{
+		out.emplace(co_await task);
+	}
+
+	//? Blocks until task is done, running queued jobs meanwhile. Deadlocks if the task waits for a frame.
+	template <typename T>
+	inline T sync_wait(Task<T> task, JobSystem& jobs)
+	{
+		JobCounter counter;
+		if constexpr (std::is_void_v<T>)
+		{
+			spawn(static_cast<Task<T>&&>(task), &counter);
+			jobs.wait(counter);
+		}
+		else
+		{
+			std::optional<T> result;
+			spawn(store_result(static_cast<Task<T>&&>(task), result), &counter);
+			jobs.wait(counter);
+			return static_cast<T&&>(*result);
+		}
+	}
+
+	struct JobAwaiter
+	{
+		JobSystem& jobs;
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> h)
+		{
+			jobs.submit([h] { h.resume(); });
+		}
+
+		void await_resume() const noexcept
+		{
+		}
+	};
+
+	//? Continues on a job system worker (or a thread inside JobSystem::wait)
+	inline JobAwaiter schedule(JobSystem& jobs)
+	{
+		return { jobs };
+	}
+
+	struct ReadAwaiter
+	{
+		AssetIO& io;
+		const char* path;
+		IoArena& arena;
+		IoPriority priority;
+		JobSystem* jobs;
+		IoResult result{};
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> h)
+		{
+			// nothing here may touch this awaiter after read(), the coroutine can be running already
+			io.read(path, arena, priority, [this, h](const IoResult& r)
+				{
+					result = r;
+					if (jobs)
+						jobs->submit([h] { h.resume(); });
+					else
+						h.resume();
+				});
+		}
+
+		IoResult await_resume() const noexcept
+		{
+			return result;
+		}
+	};
+
+	//? Reads the whole file into arena and continues on jobs, or on the I/O thread when jobs is null
+	//? (which stalls every other read until the coroutine's next hop)
+	inline ReadAwaiter read_file(AssetIO& io, const char* path, IoArena& arena, IoPriority priority, JobSystem* jobs)
+	{
+		return { io, path, arena, priority, jobs };
+	}
+
+	template <typename T, typename Start>
+	struct CallbackAwaiter
+	{
+		Start start;
+		std::optional<T> value;
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> h)
+		{
+			start([this, h](T v)
+				{
+					value.emplace(static_cast<T&&>(v));
+					h.resume();
+				});
+		}
+
+		T await_resume()
+		{
+			return static_cast<T&&>(*value);
+		}
+	};
+
+	//? For APIs that finish through a callback: start(done) starts the operation, done(value) continues the
+	//? coroutine on whichever thread calls it
+	template <typename T, typename Start>
+	inline CallbackAwaiter<T, Start> await_callback(Start start)
+	{
+		return { static_cast<Start&&>(start), std::nullopt };
+	}
+
+	//? Coroutines parked until the owning thread's next run(), normally once per frame on the render thread,
+	//? where GL calls are allowed
+	struct FrameQueue
+	{
+		struct Awaiter
+		{
+			FrameQueue& queue;
+
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+
+			void await_suspend(std::coroutine_handle<> h)
+			{
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				queue.waiting.push_back(h);
+			}
+
+			void await_resume() const noexcept
+			{
+			}
+		};
+
+		std::mutex mutex;
+		std::vector<std::coroutine_handle<>> waiting;
+		std::vector<std::coroutine_handle<>> running; // run() only
+		u64 resumed = 0;
+
+		Awaiter next_frame()
+		{
+			return { *this };
+		}
+
+		//? Resumes what was waiting when called; whatever those park again waits for the next call
+		u32 run()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (waiting.empty())
+					return 0;
+				running.swap(waiting);
+			}
+			for (std::coroutine_handle<> h : running)
+				h.resume();
+			const u32 count = (u32)running.size();
+			resumed += count;
+			running.clear();
+			return count;
+		}
+	};
+}
@@ -0,0 +1,413 @@
+#pragma once
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Utils.hpp"
+#include "my_math.h"
+#include "JobSystem.hpp"
+#include "ImageReader.hpp"
+
+//? Texture import: decode (ImageReader.hpp), sRGB to linear through a table, build the mip chain in linear
+//? float RGBA and encode every level back to sRGB8. Filtering in sRGB space darkens every level, that is
+//? what glGenerateMipmap does on many drivers for sRGB formats and why we don't use it. Each pixel is one
+//? __m128, so the SIMD path filters all four channels at once; the scalar path is the reference.
+//? Box is the usual 2x2 average, Kaiser is a separable 8 tap windowed sinc that keeps detail sharper.
+
+namespace lib
+{
+	enum class MipFilter : u32
+	{
+		box,
+		kaiser,
+	};
+
+	struct MipLevel
+	{
+		s32 width;
+		s32 height;
+		size_t offset; // into MipChain::pixels
+	};
+
+	//? All levels, sRGB8 RGBA with linear alpha, packed one after another
+	struct MipChain
+	{
+		s32 width = 0;
+		s32 height = 0;
+		std::vector<MipLevel> levels;
+		std::vector<u8> pixels;
+
+		const u8* level_pixels(u32 level) const
+		{
+			return pixels.data() + levels[level].offset;
+		}
+	};
+
+	struct SrgbTables
+	{
+		f32 to_linear[256];
+		u8 to_srgb[4096]; // indexed by linear * 4095
+	};
+
+	inline const SrgbTables& srgb_tables()
+	{
+		static const SrgbTables tables = []
+			{
+				SrgbTables t;
+				for (u32 i = 0; i < 256; ++i)
+				{
+					const f64 c = i / 255.0;
+					t.to_linear[i] = (f32)(c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4));
+				}
+				for (u32 i = 0; i < 4096; ++i)
+				{
+					const f64 l = i / 4095.0;
+					const f64 c = l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+					t.to_srgb[i] = (u8)(c * 255.0 + 0.5);
+				}
+				return t;
+			}();
+		return tables;
+	}
+
+	//? Kaiser windowed sinc for a 2:1 reduction, taps at -3.5 .. 3.5 source pixels from the output center
+	struct KaiserKernel
+	{
+		static constexpr u32 taps = 8;
+		f32 weights[taps];
+	};
+
+	inline const KaiserKernel& kaiser_kernel()
+	{
+		static const KaiserKernel kernel = []
+			{
+				auto bessel_i0 = [](f64 x)
+					{
+						f64 sum = 1.0, term = 1.0;
+						for (u32 k = 1; k < 32; ++k)
+						{
+							term *= (x / (2.0 * k)) * (x / (2.0 * k));
+							sum += term;
+						}
+						return sum;
+					};
+
+				constexpr f64 alpha = 4.0;
+				constexpr f64 half_width = 4.0;
+				KaiserKernel k;
+				f64 total = 0.0;
+				f64 w[KaiserKernel::taps];
+				for (u32 i = 0; i < KaiserKernel::taps; ++i)
+				{
+					const f64 t = (f64)i - 3.5;
+					const f64 x = t * 0.5; // sinc at half the source rate
+					const f64 sinc = x == 0.0 ? 1.0 : sin(PI64 * x) / (PI64 * x);
+					const f64 r = t / half_width;
+					w[i] = sinc * bessel_i0(alpha * ::sqrt(1.0 - r * r)) / bessel_i0(alpha);
+					total += w[i];
+				}
+				for (u32 i = 0; i < KaiserKernel::taps; ++i)
+					k.weights[i] = (f32)(w[i] / total);
+				return k;
+			}();
+		return kernel;
+	}
+
+	inline u32 mip_count(s32 width, s32 height)
+	{
+		u32 count = 1;
+		while (width > 1 || height > 1)
+		{
+			width = max(1, width / 2);
+			height = max(1, height / 2);
+			++count;
+		}
+		return count;
+	}
+
+	namespace mip
+	{
+		//? Runs f(begin, end) over rows, on the job system when there is one and the level is big enough
+		template <typename F>
+		inline void for_rows(JobSystem* jobs, s32 rows, s32 width, F&& f)
+		{
+			if (jobs && (s64)rows * width >= 64 * 1024)
+				jobs->parallel_for((u32)rows, max(1u, (u32)(16384 / max(width, 1))), [&f](u32 begin, u32 end) { f((s32)begin, (s32)end); });
+			else
+				f(0, rows);
+		}
+
+		inline void to_linear(const u8* src, f32* dst, size_t count)
+		{
+			const SrgbTables& t = srgb_tables();
+			for (size_t i = 0; i < count; ++i)
+			{
+				dst[i * 4 + 0] = t.to_linear[src[i * 4 + 0]];
+				dst[i * 4 + 1] = t.to_linear[src[i * 4 + 1]];
+				dst[i * 4 + 2] = t.to_linear[src[i * 4 + 2]];
+				dst[i * 4 + 3] = src[i * 4 + 3] * (1.0f / 255.0f);
+			}
+		}
+
+		inline void to_srgb(const f32* src, u8* dst, size_t count)
+		{
+			const SrgbTables& t = srgb_tables();
+			const __m128 scale = _mm_setr_ps(4095.0f, 4095.0f, 4095.0f, 255.0f);
+			const __m128 zero = _mm_setzero_ps();
+			for (size_t i = 0; i < count; ++i)
+			{
+				const __m128 v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i * 4), scale), zero), scale);
+				alignas(16) s32 q[4];
+				_mm_store_si128((__m128i*)q, _mm_cvtps_epi32(v));
+				dst[i * 4 + 0] = t.to_srgb[q[0]];
+				dst[i * 4 + 1] = t.to_srgb[q[1]];
+				dst[i * 4 + 2] = t.to_srgb[q[2]];
+				dst[i * 4 + 3] = (u8)q[3];
+			}
+		}
+
+		//? Source rows for the SIMD filters: linear floats from the previous level, or level 0 read straight
+		//? from sRGB8 through the table so the full size image never exists as floats
+		struct LinearRows
+		{
+			const f32* pixels;
+			s32 width;
+
+			const f32* row(s32 y) const { return pixels + (size_t)y * width * 4; }
+			static __m128 load(const f32* row, s32 x) { return _mm_loadu_ps(row + x * 4); }
+		};
+
+		struct SrgbRows
+		{
+			const u8* pixels;
+			s32 width;
+			const f32* to_linear;
+
+			const u8* row(s32 y) const { return pixels + (size_t)y * width * 4; }
+			__m128 load(const u8* row, s32 x) const
+			{
+				const u8* p = row + x * 4;
+				return _mm_setr_ps(to_linear[p[0]], to_linear[p[1]], to_linear[p[2]], p[3] * (1.0f / 255.0f));
+			}
+		};
+
+		template <typename Rows>
+		inline void box_simd(const Rows& src, s32 sw, s32 sh, f32* dst, s32 dw, s32 dh, JobSystem* jobs)
+		{
+			for_rows(jobs, dh, dw, [=](s32 begin, s32 end)
+				{
+					const __m128 quarter = _mm_set1_ps(0.25f);
+					for (s32 y = begin; y < end; ++y)
+					{
+						const auto* r0 = src.row(min(y * 2, sh - 1));
+						const auto* r1 = src.row(min(y * 2 + 1, sh - 1));
+						f32* out = dst + (size_t)y * dw * 4;
+						for (s32 x = 0; x < dw; ++x)
+						{
+							const s32 x0 = min(x * 2, sw - 1), x1 = min(x * 2 + 1, sw - 1);
+							const __m128 sum = _mm_add_ps(_mm_add_ps(src.load(r0, x0), src.load(r0, x1)),
+								_mm_add_ps(src.load(r1, x0), src.load(r1, x1)));
+							_mm_storeu_ps(out + x * 4, _mm_mul_ps(sum, quarter));
+						}
+					}
+				});
+		}
+
+		inline void box_scalar(const f32* src, s32 sw, s32 sh, f32* dst, s32 dw, s32 dh)
+		{
+			for (s32 y = 0; y < dh; ++y)
+			{
+				const f32* r0 = src + (size_t)min(y * 2, sh - 1) * sw * 4;
+				const f32* r1 = src + (size_t)min(y * 2 + 1, sh - 1) * sw * 4;
+				f32* out = dst + (size_t)y * dw * 4;
+				for (s32 x = 0; x < dw; ++x)
+				{
+					const s32 x0 = min(x * 2, sw - 1) * 4, x1 = min(x * 2 + 1, sw - 1) * 4;
+					for (s32 c = 0; c < 4; ++c)
+						out[x * 4 + c] = ((r0[x0 + c] + r0[x1 + c]) + (r1[x0 + c] + r1[x1 + c])) * 0.25f;
+				}
+			}
+		}
+
+		//? Horizontal pass into tmp (dw x sh), then vertical into dst (dw x dh), edges clamp
+		template <typename Rows>
+		inline void kaiser_simd(const Rows& src, s32 sw, s32 sh, f32* tmp, f32* dst, s32 dw, s32 dh, JobSystem* jobs)
+		{
+			const KaiserKernel& k = kaiser_kernel();
+			for_rows(jobs, sh, dw, [=, &k](s32 begin, s32 end)
+				{
+					for (s32 y = begin; y < end; ++y)
+					{
+						const auto* row = src.row(y);
+						f32* out = tmp + (size_t)y * dw * 4;
+						for (s32 x = 0; x < dw; ++x)
+						{
+							__m128 sum = _mm_setzero_ps();
+							for (s32 i = 0; i < (s32)KaiserKernel::taps; ++i)
+							{
+								const s32 sx = clamp(x * 2 - 3 + i, 0, sw - 1);
+								sum = _mm_add_ps(sum, _mm_mul_ps(src.load(row, sx), _mm_set1_ps(k.weights[i])));
+							}
+							_mm_storeu_ps(out + x * 4, sum);
+						}
+					}
+				});
+
+			for_rows(jobs, dh, dw, [=, &k](s32 begin, s32 end)
+				{
+					for (s32 y = begin; y < end; ++y)
+					{
+						const f32* rows[KaiserKernel::taps];
+						for (s32 i = 0; i < (s32)KaiserKernel::taps; ++i)
+							rows[i] = tmp + (size_t)clamp(y * 2 - 3 + i, 0, sh - 1) * dw * 4;
+						f32* out = dst + (size_t)y * dw * 4;
+						for (s32 x = 0; x < dw; ++x)
+						{
+							__m128 sum = _mm_setzero_ps();
+							for (s32 i = 0; i < (s32)KaiserKernel::taps; ++i)
+								sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[i] + x * 4), _mm_set1_ps(k.weights[i])));
+							// negative lobes can overshoot, keep colors and alpha in range
+							_mm_storeu_ps(out + x * 4, _mm_min_ps(_mm_max_ps(sum, _mm_setzero_ps()), _mm_set1_ps(1.0f)));
+						}
+					}
+				});
+		}
+
+		inline void kaiser_scalar(const f32* src, s32 sw, s32 sh, f32* tmp, f32* dst, s32 dw, s32 dh)
+		{
+			const KaiserKernel& k = kaiser_kernel();
+			for (s32 y = 0; y < sh; ++y)
+			{
+				for (s32 x = 0; x < dw; ++x)
+				{
+					for (s32 c = 0; c < 4; ++c)
+					{
+						f32 sum = 0.0f;
+						for (s32 i = 0; i < (s32)KaiserKernel::taps; ++i)
+							sum += src[((size_t)y * sw + clamp(x * 2 - 3 + i, 0, sw - 1)) * 4 + c] * k.weights[i];
+						tmp[((size_t)y * dw + x) * 4 + c] = sum;
+					}
+				}
+			}
+			for (s32 y = 0; y < dh; ++y)
+			{
+				for (s32 x = 0; x < dw; ++x)
+				{
+					for (s32 c = 0; c < 4; ++c)
+					{
+						f32 sum = 0.0f;
+						for (s32 i = 0; i < (s32)KaiserKernel::taps; ++i)
+							sum += tmp[((size_t)clamp(y * 2 - 3 + i, 0, sh - 1) * dw + x) * 4 + c] * k.weights[i];
+						dst[((size_t)y * dw + x) * 4 + c] = clamp(sum, 0.0f, 1.0f);
+					}
+				}
+			}
+		}
+	}
+
+	//? Level 0 is the image as is, every further level is filtered from the previous one in linear space.
+	//? simd = false runs the scalar reference, single threaded.
+	inline void build_mips(const Image& image, MipChain& chain, MipFilter filter = MipFilter::box, JobSystem* jobs = nullptr, b32 simd = true)
+	{
+		PROFILE_SCOPE("build mips");
+		const u32 count = mip_count(image.width, image.height);
+		chain.width = image.width;
+		chain.height = image.height;
+		chain.levels.resize(count);
+
+		size_t total = 0;
+		s32 w = image.width, h = image.height;
+		for (u32 level = 0; level < count; ++level)
+		{
+			chain.levels[level] = { w, h, total };
+			total += (size_t)w * h * 4;
+			w = max(1, w / 2);
+			h = max(1, h / 2);
+		}
+		chain.pixels.resize(total);
+		memcpy(chain.pixels.data(), image.pixels.data(), (size_t)image.width * image.height * 4);
+
+		// the SIMD path reads level 0 as sRGB8, only the scalar reference converts it up front
+		const size_t level1_floats = (size_t)max(1, image.width / 2) * max(1, image.height / 2) * 4;
+		std::vector<f32> current(simd ? level1_floats : (size_t)image.width * image.height * 4);
+		std::vector<f32> next(level1_floats);
+		std::vector<f32> tmp(filter == MipFilter::kaiser ? (size_t)max(1, image.width / 2) * image.height * 4 : 0);
+		if (!simd)
+			mip::to_linear(image.pixels.data(), current.data(), (size_t)image.width * image.height);
+
+		const mip::SrgbRows level0 = { image.pixels.data(), image.width, srgb_tables().to_linear };
+		for (u32 level = 1; level < count; ++level)
+		{
+			const MipLevel& src = chain.levels[level - 1];
+			const MipLevel& dst = chain.levels[level];
+			const mip::LinearRows previous = { current.data(), src.width };
+			if (filter == MipFilter::kaiser)
+			{
+				if (!simd)
+					mip::kaiser_scalar(current.data(), src.width, src.height, tmp.data(), next.data(), dst.width, dst.height);
+				else if (level == 1)
+					mip::kaiser_simd(level0, src.width, src.height, tmp.data(), next.data(), dst.width, dst.height, jobs);
+				else
+					mip::kaiser_simd(previous, src.width, src.height, tmp.data(), next.data(), dst.width, dst.height, jobs);
+			}
+			else
+			{
+				if (!simd)
+					mip::box_scalar(current.data(), src.width, src.height, next.data(), dst.width, dst.height);
+				else if (level == 1)
+					mip::box_simd(level0, src.width, src.height, next.data(), dst.width, dst.height, jobs);
+				else
+					mip::box_simd(previous, src.width, src.height, next.data(), dst.width, dst.height, jobs);
+			}
+
+			f32* linear = next.data();
+			u8* out = chain.pixels.data() + dst.offset;
+			mip::for_rows(simd ? jobs : nullptr, dst.height, dst.width, [=](s32 begin, s32 end)
+				{
+					mip::to_srgb(linear + (size_t)begin * dst.width * 4, out + (size_t)begin * dst.width * 4, (size_t)(end - begin) * dst.width);
+				});
+			current.swap(next);
+		}
+	}
+
+	//? Trilinear and repeat, for whatever texture is bound to GL_TEXTURE_2D
+	inline void set_texture_sampling()
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	}
+
+	//? Immutable storage when the driver has it (4.2+), otherwise the same levels through glTexImage2D.
+	//! Checks the version flag, not the pointer, the counting and recording layers install hooks over null slots
+	inline GLuint upload_texture(const MipChain& chain)
+	{
+		GLuint texture = 0;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		const GLsizei levels = (GLsizei)chain.levels.size();
+		if (GLAD_GL_VERSION_4_2)
+		{
+			glTexStorage2D(GL_TEXTURE_2D, levels, GL_SRGB8_ALPHA8, chain.width, chain.height);
+			for (GLsizei level = 0; level < levels; ++level)
+			{
+				const MipLevel& l = chain.levels[level];
+				glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, l.width, l.height, GL_RGBA, GL_UNSIGNED_BYTE, chain.level_pixels(level));
+			}
+		}
+		else
+		{
+			for (GLsizei level = 0; level < levels; ++level)
+			{
+				const MipLevel& l = chain.levels[level];
+				glTexImage2D(GL_TEXTURE_2D, level, GL_SRGB8_ALPHA8, l.width, l.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, chain.level_pixels(level));
+			}
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+		}
+		set_texture_sampling();
+		return texture;
+	}
+}
@@ -0,0 +1,402 @@
+#pragma once
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <algorithm>
+#include <chrono>
+
+#include <glad/glad.h>
+
+#include "Utils.hpp"
+#include "Texture.hpp"
+
+//? Texture streaming under a VRAM budget. Every frame the renderer reports how many pixels each texture
+//? covers on screen, which gives the finest mip worth having. Sources are decoded and filtered on I/O
+//? threads and kept in memory; only the levels the screen needs are uploaded, one level at a time from
+//? coarse to fine, through an orphaned pixel unpack buffer and within a per-frame byte budget. When an
+//? upload would go over the VRAM budget, the finest levels of the least recently used textures are
+//? dropped first. Textures are mutable (glTexImage2D per level) so a dropped level really is released;
+//? GL_TEXTURE_BASE_LEVEL keeps the texture complete from the finest resident level down.
+
+namespace lib
+{
+	struct StreamingStats
+	{
+		u64 frames = 0;
+		u64 loads = 0;
+		u64 load_failures = 0;
+		u64 uploads = 0;          // levels
+		u64 upload_bytes = 0;
+		u64 evictions = 0;        // levels
+		u64 evicted_bytes = 0;
+		u64 starved_frames = 0;   // frames where the VRAM budget stopped an upload
+		u64 peak_resident = 0;
+		f64 upload_ms = 0.0;      // render thread, copies into the PBO and glTexImage2D
+		std::vector<f32> pop_in_ms; // from needing a finer level to having it, load included
+	};
+
+	struct TextureStreamer
+	{
+		using Loader = std::function<b32(Image&)>; // runs on an I/O thread
+
+		enum class State : u32 { unloaded, queued, ready, failed };
+
+		struct Entry
+		{
+			Loader load;
+			std::atomic<State> state{ State::unloaded };
+			MipChain chain; // written by the I/O thread before state becomes ready
+
+			GLuint texture = 0;
+			u32 resident = 0;      // finest resident level, the level count when nothing is
+			u32 wanted = 0;        // finest level wanted this frame
+			f32 pixels = 0.0f;     // largest screen size this frame
+			u64 last_used = 0;     // frame
+			u64 resident_bytes = 0;
+			b32 waiting = false;   // wanted is finer than resident since wait_start
+			std::chrono::steady_clock::time_point wait_start;
+			std::chrono::steady_clock::time_point queued_at;
+		};
+
+		u64 vram_budget = 0;
+		u64 upload_budget = 0;  // bytes per frame, one level may go over it so large levels still move
+		u64 resident_bytes = 0;
+		u64 frame = 0;
+		StreamingStats stats;
+
+		std::deque<Entry> entries;
+		GLuint pbo = 0;
+		GLuint fallback = 0; // 1x1 gray until a texture has a level
+
+		void init(u64 vram_budget_bytes, u64 upload_budget_bytes, u32 io_thread_count = 2)
+		{
+			vram_budget = vram_budget_bytes;
+			upload_budget = upload_budget_bytes;
+			glGenBuffers(1, &pbo);
+
+			const u8 gray[4] = { 128, 128, 128, 255 };
+			glGenTextures(1, &fallback);
+			glBindTexture(GL_TEXTURE_2D, fallback);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, gray);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+			glBindTexture(GL_TEXTURE_2D, 0);
+
+			quit = false;
+			for (u32 i = 0; i < max(io_thread_count, 1u); ++i)
+				io_threads.emplace_back([this] { io_loop(); });
+		}
+
+		void destroy()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				quit = true;
+			}
+			wake.notify_all();
+			for (std::thread& thread : io_threads)
+				thread.join();
+			io_threads.clear();
+
+			for (Entry& e : entries)
+			{
+				if (e.texture)
+					glDeleteTextures(1, &e.texture);
+			}
+			entries.clear();
+			glDeleteTextures(1, &fallback);
+			glDeleteBuffers(1, &pbo);
+			resident_bytes = 0;
+		}
+
+		u32 add(Loader load)
+		{
+			entries.emplace_back();
+			entries.back().load = static_cast<Loader&&>(load);
+			return (u32)entries.size() - 1;
+		}
+
+		//? The texture covers this many pixels across on screen this frame, the largest report wins.
+		//? The first report queues the load.
+		void request(u32 id, f32 pixels)
+		{
+			Entry& e = entries[id];
+			e.pixels = max(e.pixels, pixels);
+			e.last_used = frame;
+			if (e.state.load(std::memory_order_relaxed) == State::unloaded)
+			{
+				e.state.store(State::queued, std::memory_order_relaxed);
+				e.queued_at = std::chrono::steady_clock::now();
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					queue.push_back(&e);
+				}
+				wake.notify_one();
+			}
+		}
+
+		//? Texture to bind for id, the fallback until its first level is resident
+		GLuint texture(u32 id) const
+		{
+			const Entry& e = entries[id];
+			return e.texture && e.resident < e.chain.levels.size() ? e.texture : fallback;
+		}
+
+		//? Once per frame after the requests: turns screen sizes into wanted levels, uploads what is
+		//? missing within the budgets and evicts to make room. Leaves GL_TEXTURE_2D unbound on the active unit.
+		void update()
+		{
+			PROFILE_SCOPE("stream textures");
+			const auto now = std::chrono::steady_clock::now();
+
+			// wanted levels, the most blurry texture goes first
+			std::vector<Entry*> pending;
+			for (Entry& e : entries)
+			{
+				if (e.state.load(std::memory_order_acquire) != State::ready)
+					continue;
+				if (!e.texture)
+					create(e);
+
+				const u32 levels = (u32)e.chain.levels.size();
+				if (e.last_used == frame)
+				{
+					const f32 ratio = (f32)max(e.chain.width, e.chain.height) / max(e.pixels, 1.0f);
+					e.wanted = ratio > 1.0f ? min((u32)log2f(ratio), levels - 1) : 0;
+				}
+				else
+				{
+					e.wanted = levels; // not drawn, every resident level is surplus
+				}
+
+				if (e.wanted < e.resident && !e.waiting)
+				{
+					e.waiting = true;
+					e.wait_start = now;
+				}
+				else if (e.wanted >= e.resident)
+				{
+					e.waiting = false; // it went back to needing less before it got more
+				}
+				if (e.wanted < e.resident)
+					pending.push_back(&e);
+			}
+			std::sort(pending.begin(), pending.end(), [](const Entry* a, const Entry* b) { return a->resident - a->wanted > b->resident - b->wanted; });
+
+			u64 uploaded = 0;
+			b32 starved = false;
+			const auto upload_start = std::chrono::steady_clock::now();
+			// one level per texture per pass, so many textures sharpen together instead of one at a time
+			for (b32 progress = true; progress && !starved;)
+			{
+				progress = false;
+				for (Entry* e : pending)
+				{
+					if (e->resident <= e->wanted)
+						continue;
+
+					const u32 level = e->resident - 1;
+					const u64 bytes = level_bytes(*e, level);
+					if (uploaded && uploaded + bytes > upload_budget)
+					{
+						progress = false;
+						break;
+					}
+					if (!make_room(bytes, e))
+					{
+						starved = true;
+						break;
+					}
+					upload(*e, level, uploaded);
+					uploaded += bytes;
+					progress = true;
+
+					if (e->resident <= e->wanted && e->waiting)
+					{
+						e->waiting = false;
+						stats.pop_in_ms.push_back(std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - e->wait_start).count());
+					}
+				}
+			}
+			if (bound)
+			{
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				glBindTexture(GL_TEXTURE_2D, 0);
+				bound = false;
+			}
+			if (uploaded)
+			{
+				stats.upload_ms += std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - upload_start).count();
+			}
+			stats.starved_frames += starved ? 1 : 0;
+			stats.load_failures = failed_loads.load(std::memory_order_relaxed);
+			stats.peak_resident = max(stats.peak_resident, resident_bytes);
+			++stats.frames;
+
+			for (Entry& e : entries)
+				e.pixels = 0.0f;
+			++frame;
+		}
+
+		void print_summary() const
+		{
+			if (!stats.frames)
+				return;
+
+			u32 loaded = 0, sharp = 0;
+			for (const Entry& e : entries)
+			{
+				if (e.state.load(std::memory_order_acquire) != State::ready)
+					continue;
+				++loaded;
+				sharp += e.resident <= e.wanted ? 1 : 0;
+			}
+			const f64 mib = 1024.0 * 1024.0;
+			printf("streaming: %u of %zu textures loaded, %u at their wanted level, resident %.1f MiB (peak %.1f) of %.1f MiB, "
+				"%llu levels uploaded (%.1f MiB, %.3f ms per frame avg), %llu evicted (%.1f MiB), %llu starved frames, %llu failed loads\n",
+				loaded, entries.size(), sharp, resident_bytes / mib, stats.peak_resident / mib, vram_budget / mib,
+				(unsigned long long)stats.uploads, stats.upload_bytes / mib, stats.upload_ms / (f64)stats.frames,
+				(unsigned long long)stats.evictions, stats.evicted_bytes / mib, (unsigned long long)stats.starved_frames,
+				(unsigned long long)stats.load_failures);
+
+			if (stats.pop_in_ms.empty())
+				return;
+			std::vector<f32> sorted = stats.pop_in_ms;
+			std::sort(sorted.begin(), sorted.end());
+			f64 sum = 0.0;
+			for (f32 ms : sorted)
+				sum += ms;
+			printf("streaming: pop-in %zu times, avg %.1f ms, p50 %.1f ms, p95 %.1f ms, max %.1f ms\n", sorted.size(), sum / sorted.size(),
+				sorted[sorted.size() / 2], sorted[min(sorted.size() - 1, sorted.size() * 95 / 100)], sorted.back());
+		}
+
+	private:
+		std::vector<std::thread> io_threads;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::deque<Entry*> queue;
+		b32 quit = false;
+		b32 bound = false; // something was bound for create, evict or upload this frame
+		std::atomic<u64> failed_loads{ 0 };
+
+		static u64 level_bytes(const Entry& e, u32 level)
+		{
+			const MipLevel& l = e.chain.levels[level];
+			return (u64)l.width * l.height * 4;
+		}
+
+		void create(Entry& e)
+		{
+			glGenTextures(1, &e.texture);
+			glBindTexture(GL_TEXTURE_2D, e.texture);
+			bound = true;
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)e.chain.levels.size() - 1);
+			set_texture_sampling();
+			e.resident = (u32)e.chain.levels.size();
+			// pop-in counts from the first request, so the load is part of it
+			e.waiting = true;
+			e.wait_start = e.queued_at;
+			++stats.loads;
+		}
+
+		//? Evicts until bytes fit: first levels finer than their texture wants, then the finest level of
+		//? textures not used this frame, least recently used first. Never touches what this frame needs.
+		b32 make_room(u64 bytes, const Entry* keep)
+		{
+			while (resident_bytes + bytes > vram_budget)
+			{
+				Entry* victim = nullptr;
+				for (Entry& e : entries)
+				{
+					if (&e == keep || !e.texture || e.resident >= e.chain.levels.size())
+						continue;
+					const b32 surplus = e.resident < e.wanted;
+					if (!surplus && e.last_used == frame)
+						continue;
+					if (!victim || surplus > (victim->resident < victim->wanted) ||
+						(surplus == (victim->resident < victim->wanted) && e.last_used < victim->last_used))
+					{
+						victim = &e;
+					}
+				}
+				if (!victim)
+					return false;
+				evict(*victim);
+			}
+			return true;
+		}
+
+		void evict(Entry& e)
+		{
+			const u32 level = e.resident;
+			const u64 bytes = level_bytes(e, level);
+			glBindTexture(GL_TEXTURE_2D, e.texture);
+			bound = true;
+			// redefining the level as empty releases it, the base level keeps the rest complete
+			glTexImage2D(GL_TEXTURE_2D, level, GL_SRGB8_ALPHA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			++e.resident;
+			if (e.resident < e.chain.levels.size())
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)e.resident);
+			e.resident_bytes -= bytes;
+			resident_bytes -= bytes;
+			++stats.evictions;
+			stats.evicted_bytes += bytes;
+		}
+
+		//? Copies the level into the unpack buffer at offset and defines it from there. The buffer is
+		//? orphaned at the first upload of a frame, so we never wait for last frame's copies.
+		void upload(Entry& e, u32 level, u64 offset)
+		{
+			const MipLevel& l = e.chain.levels[level];
+			const u64 bytes = level_bytes(e, level);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+			if (offset == 0)
+				glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)max(upload_budget, bytes), NULL, GL_STREAM_DRAW);
+			glBufferSubData(GL_PIXEL_UNPACK_BUFFER, (GLintptr)offset, (GLsizeiptr)bytes, e.chain.level_pixels(level));
+
+			glBindTexture(GL_TEXTURE_2D, e.texture);
+			bound = true;
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			glTexImage2D(GL_TEXTURE_2D, level, GL_SRGB8_ALPHA8, l.width, l.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)(uintptr_t)offset);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)level);
+			e.resident = level;
+			e.resident_bytes += bytes;
+			resident_bytes += bytes;
+			++stats.uploads;
+			stats.upload_bytes += bytes;
+		}
+
+		void io_loop()
+		{
+			for (;;)
+			{
+				Entry* e = nullptr;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					wake.wait(lock, [this] { return quit || !queue.empty(); });
+					if (quit)
+						return;
+					e = queue.front();
+					queue.pop_front();
+				}
+
+				PROFILE_SCOPE("load texture");
+				Image image;
+				if (!e->load(image) || image.width <= 0 || image.height <= 0)
+				{
+					e->state.store(State::failed, std::memory_order_release);
+					failed_loads.fetch_add(1, std::memory_order_relaxed);
+					continue;
+				}
+				build_mips(image, e->chain);
+				e->state.store(State::ready, std::memory_order_release);
+			}
+		}
+	};
+}
@@ -1,6 +1,24 @@
 #pragma once
 #include <cstdint>
 
+// Profiling zones are compiled in for debug builds, define CUBE_PROFILE 0/1 to override
+#if !defined(CUBE_PROFILE)
+#if defined(NDEBUG)
+#define CUBE_PROFILE 0
+#else
+#define CUBE_PROFILE 1
+#endif
+#endif
+
+#if CUBE_PROFILE
+#include <atomic>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
 // version: 0.0.1 19.02.2024
 
 #undef max
@@ -141,3 +159,76 @@ constexpr T clamp_v(T x, T low, T high)
 {
 	return min(max(low, x), high);
 }
+
+//? PROFILE_SCOPE("name") records when the enclosing scope started and ended (rdtsc) into a ring owned by the
+//? calling thread. The zone's static info is its id, names are never copied or hashed. One producer per ring,
+//? so a zone is two rdtsc, one store and one release increment; if the collector falls a whole ring behind,
+//? the oldest events are overwritten and counted as lost. Profiler.hpp drains the rings and exports them.
+#if CUBE_PROFILE
+struct ProfileZoneInfo
+{
+	const char* name;
+	const char* file;
+	u32 line;
+};
+
+struct ProfileEvent
+{
+	u64 start;
+	u64 end;
+	const ProfileZoneInfo* zone;
+};
+
+struct ProfileRing
+{
+	static constexpr u32 capacity = 1 << 16;
+
+	std::atomic<u64> head{ 0 }; // written by the owning thread only
+	u64 tail = 0;               // read position, collector only
+	u32 thread_id = 0;
+	ProfileRing* next = nullptr;
+	ProfileEvent events[capacity];
+};
+
+inline std::atomic<ProfileRing*> profile_rings{ nullptr };
+inline std::atomic<u32> profile_thread_count{ 0 };
+inline thread_local ProfileRing* profile_ring = nullptr;
+
+//? Rings live until exit, threads that are gone still get drained
+inline ProfileRing* profile_register_thread()
+{
+	ProfileRing* ring = new ProfileRing;
+	ring->thread_id = profile_thread_count.fetch_add(1, std::memory_order_relaxed);
+	ring->next = profile_rings.load(std::memory_order_relaxed);
+	while (!profile_rings.compare_exchange_weak(ring->next, ring, std::memory_order_release, std::memory_order_relaxed))
+	{
+	}
+	profile_ring = ring;
+	return ring;
+}
+
+struct ProfileZone
+{
+	const ProfileZoneInfo* zone;
+	u64 start;
+
+	ProfileZone(const ProfileZoneInfo* zone) : zone(zone), start(__rdtsc()) {}
+
+	~ProfileZone()
+	{
+		const u64 end = __rdtsc();
+		ProfileRing* ring = profile_ring ? profile_ring : profile_register_thread();
+		const u64 head = ring->head.load(std::memory_order_relaxed);
+		ring->events[head & (ProfileRing::capacity - 1)] = { start, end, zone };
+		ring->head.store(head + 1, std::memory_order_release);
+	}
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) \
+	static constexpr ProfileZoneInfo PROFILE_CONCAT(profile_zone_info_, __LINE__){ name, __FILE__, __LINE__ }; \
+	ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(&PROFILE_CONCAT(profile_zone_info_, __LINE__))
+#else
+#define PROFILE_SCOPE(name) do {} while (0)
+#endif
@@ -0,0 +1,225 @@
+#pragma once
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include "../Utils.hpp"
+#include "../PerfCounters.hpp"
+
+//? Shared harness for the microbenchmarks in this directory. A benchmark is a body that runs `reps` passes
+//? of a fixed number of ops; the runner scales reps until one sample takes min_ms, keeps the best of
+//? `samples` and reports ns/op and cycles/op. Cycles come from rdtsc, so they are reference cycles at the
+//? nominal TSC rate, not core clocks: with turbo they undercount, with power saving they overcount.
+//? With counters on (init(true)) the timed samples also count hardware events, reported per op; the
+//? `cycles` event there is real core cycles, which is also what IPC is computed from.
+
+namespace lib::bench
+{
+	inline u64 read_tsc()
+	{
+		return __rdtsc();
+	}
+
+	//! Only keeps the value alive, doesn't stop the compiler from hoisting its computation out of a loop
+#if defined(_MSC_VER)
+	inline const volatile void* keep_sink;
+	template <typename T>
+	inline void keep(const T& value)
+	{
+		keep_sink = &value;
+		_ReadWriteBarrier();
+	}
+#else
+	template <typename T>
+	inline void keep(const T& value)
+	{
+		asm volatile("" : : "g"(&value) : "memory");
+	}
+#endif
+
+	//? TSC ticks per nanosecond, measured against steady_clock over ~50 ms
+	inline f64 calibrate_tsc()
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const u64 tsc_start = read_tsc();
+		while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(50))
+		{
+		}
+		const u64 tsc_end = read_tsc();
+		const f64 ns = std::chrono::duration<f64, std::nano>(std::chrono::steady_clock::now() - start).count();
+		return (f64)(tsc_end - tsc_start) / ns;
+	}
+
+	struct Result
+	{
+		std::string name;
+		std::string variant;
+		std::string mode;
+		u64 ops;            // ops in the best sample
+		f64 ns_per_op;
+		f64 cycles_per_op;
+		PerfSample perf;    // per op, valid_mask 0 without counters
+	};
+
+	struct Runner
+	{
+		std::vector<Result> results;
+		f64 tsc_per_ns = 1.0;
+		f64 min_ms = 20.0;
+		u32 samples = 5;
+		const char* filter = nullptr;
+		PerfCounters counters{};
+
+		void init(b32 with_counters = false)
+		{
+			tsc_per_ns = calibrate_tsc();
+			if (with_counters)
+				counters.init();
+		}
+
+		void destroy()
+		{
+			counters.destroy();
+		}
+
+		b32 selected(const char* name) const
+		{
+			return !filter || strstr(name, filter);
+		}
+
+		//? body(reps) must run reps * ops_per_rep ops
+		template <typename F>
+		void run(const char* name, const char* variant, const char* mode, u64 ops_per_rep, F&& body)
+		{
+			if (!selected(name))
+				return;
+
+			body(1); // warm caches and branch predictors
+
+			u64 reps = 1;
+			for (;;)
+			{
+				const u64 start = read_tsc();
+				body(reps);
+				const f64 ms = (f64)(read_tsc() - start) / tsc_per_ns / 1e6;
+				if (ms >= min_ms || reps >= (1ull << 40))
+					break;
+				reps = ms > 0.01 ? (u64)((f64)reps * min_ms / ms * 1.1) + 1 : reps * 16;
+			}
+
+			// counters cover all samples (time is the best one), reading them is a few syscalls per sample
+			u64 best = ~0ull;
+			PerfSample perf{ {}, perf_all_valid };
+			for (u32 s = 0; s < samples; ++s)
+			{
+				const PerfSample perf_start = counters.read();
+				const u64 start = read_tsc();
+				body(reps);
+				best = std::min(best, read_tsc() - start);
+				perf += counters.read() - perf_start;
+			}
+
+			const u64 ops = reps * ops_per_rep;
+			for (f64& v : perf.values)
+				v /= (f64)ops * samples;
+
+			const f64 cycles = (f64)best / (f64)ops;
+			results.push_back({ name, variant, mode, ops, cycles / tsc_per_ns, cycles, perf });
+			printf("%-28s %-10s %-20s %10.3f ns %10.3f cyc", name, variant, mode, cycles / tsc_per_ns, cycles);
+			if (perf.valid_mask)
+			{
+				char line[512];
+				perf.format(line, sizeof(line), 1.0, "op");
+				printf("  %s", line);
+			}
+			printf("\n");
+		}
+
+		b32 write_json(const char* path) const
+		{
+			FILE* file = fopen(path, "wb");
+			if (!file)
+				return false;
+
+			fprintf(file, "{\n  \"tsc_ghz\": %.4f,\n  \"results\": [\n", tsc_per_ns);
+			for (size_t i = 0; i < results.size(); ++i)
+			{
+				const Result& r = results[i];
+				fprintf(file, "    {\"name\": \"%s\", \"variant\": \"%s\", \"mode\": \"%s\", \"ops\": %llu, \"ns_per_op\": %.6f, \"cycles_per_op\": %.6f",
+					r.name.c_str(), r.variant.c_str(), r.mode.c_str(), (unsigned long long)r.ops, r.ns_per_op, r.cycles_per_op);
+				if (r.perf.has(PerfEvent::cycles) && r.perf.has(PerfEvent::instructions))
+					fprintf(file, ", \"ipc\": %.4f", r.perf.ipc());
+				for (u32 e = 0; e < perf_event_count; ++e)
+				{
+					if (r.perf.has((PerfEvent)e))
+						fprintf(file, ", \"hw_%s_per_op\": %.6f", perf_event_name((PerfEvent)e), r.perf.values[e]);
+				}
+				fprintf(file, "}%s\n", i + 1 < results.size() ? "," : "");
+			}
+			fprintf(file, "  ]\n}\n");
+			fclose(file);
+			return true;
+		}
+	};
+
+	//? Reader for what write_json produces (one result per line), not a general JSON parser
+	inline b32 json_string(const char* line, const char* key, std::string& out)
+	{
+		char pattern[64];
+		snprintf(pattern, sizeof(pattern), "\"%s\": \"", key);
+		const char* at = strstr(line, pattern);
+		if (!at)
+			return false;
+		at += strlen(pattern);
+		const char* end = strchr(at, '"');
+		if (!end)
+			return false;
+		out.assign(at, end);
+		return true;
+	}
+
+	inline b32 json_number(const char* line, const char* key, f64& out)
+	{
+		char pattern[64];
+		snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+		const char* at = strstr(line, pattern);
+		if (!at)
+			return false;
+		out = strtod(at + strlen(pattern), nullptr);
+		return true;
+	}
+
+	inline b32 read_json(const char* path, std::vector<Result>& results)
+	{
+		FILE* file = fopen(path, "rb");
+		if (!file)
+			return false;
+
+		char line[1024];
+		while (fgets(line, sizeof(line), file))
+		{
+			Result r{};
+			f64 ops = 0.0;
+			if (!json_string(line, "name", r.name) || !json_string(line, "variant", r.variant) || !json_string(line, "mode", r.mode))
+				continue;
+			json_number(line, "ops", ops);
+			json_number(line, "ns_per_op", r.ns_per_op);
+			json_number(line, "cycles_per_op", r.cycles_per_op);
+			r.ops = (u64)ops;
+			results.push_back(r);
+		}
+		fclose(file);
+		return true;
+	}
+}
@@ -0,0 +1,217 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "../AssetIO.hpp"
+#include "Bench.hpp"
+
+// usage: asset_io_bench <dir> [total MiB=2048] [files=512]
+// Loads a generated asset set (files of 1/8 to 2x the mean size) three ways: the old blocking fread loop
+// on the calling thread, AssetIO on its thread fallback and AssetIO on io_uring. Each runs cold (the
+// files are dropped from the page cache first, Linux only) and then warm. Reads go in batches into a
+// 256 MiB arena that is reset in between, like a level load streaming through a staging area.
+
+static f64 ms_since(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool write_file(const std::string& path, u64 size, u64 seed)
+{
+  FILE* f = fopen(path.c_str(), "rb");
+  if (f)
+  {
+    fseek(f, 0, SEEK_END);
+    const bool same = (u64)ftell(f) == size;
+    fclose(f);
+    if (same)
+      return true;
+  }
+  f = fopen(path.c_str(), "wb");
+  if (!f)
+    return false;
+  std::vector<u64> block(1 << 17);
+  u64 x = seed * 0x9E3779B97F4A7C15ull + 1;
+  for (u64 left = size; left;)
+  {
+    for (u64& v : block)
+    {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      v = x;
+    }
+    const size_t n = (size_t)std::min<u64>(left, block.size() * sizeof(u64));
+    fwrite(block.data(), 1, n, f);
+    left -= n;
+  }
+  fflush(f);
+#if defined(__linux__)
+  fsync(fileno(f)); // clean pages, so dropping them below works
+#endif
+  fclose(f);
+  return true;
+}
+
+static void drop_cache(const std::vector<std::string>& paths)
+{
+#if defined(__linux__)
+  for (const std::string& path : paths)
+  {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+      posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+      close(fd);
+    }
+  }
+#else
+  (void)paths;
+#endif
+}
+
+static const u64 batch_bytes = 256ull << 20;
+
+static f64 load_blocking(const std::vector<std::string>& paths, const std::vector<u64>& sizes, lib::IoArena& arena)
+{
+  const auto start = std::chrono::steady_clock::now();
+  u64 batch = 0, sum = 0;
+  for (u32 i = 0; i < (u32)paths.size(); ++i)
+  {
+    if (batch + sizes[i] > batch_bytes)
+    {
+      arena.reset();
+      batch = 0;
+    }
+    FILE* f = fopen(paths[i].c_str(), "rb");
+    if (!f)
+      continue;
+    u8* data = arena.alloc(sizes[i]);
+    const size_t got = fread(data, 1, sizes[i], f);
+    fclose(f);
+    sum += got ? data[got - 1] : 0;
+    batch += sizes[i];
+  }
+  lib::bench::keep(sum);
+  arena.reset();
+  return ms_since(start);
+}
+
+static f64 load_async(lib::AssetIO& io, const std::vector<std::string>& paths, const std::vector<u64>& sizes, lib::IoArena& arena)
+{
+  std::atomic<u64> sum{ 0 };
+  const auto start = std::chrono::steady_clock::now();
+  u64 batch = 0;
+  for (u32 i = 0; i < (u32)paths.size(); ++i)
+  {
+    if (batch + sizes[i] > batch_bytes)
+    {
+      io.wait_idle();
+      arena.reset();
+      batch = 0;
+    }
+    io.read(paths[i].c_str(), arena, lib::IoPriority::normal, [&sum](const lib::IoResult& r)
+      {
+        if (r.status == lib::IoStatus::done && r.size)
+          sum.fetch_add(r.data[r.size - 1], std::memory_order_relaxed);
+      });
+    batch += sizes[i];
+  }
+  io.wait_idle();
+  lib::bench::keep(sum.load());
+  arena.reset();
+  return ms_since(start);
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: asset_io_bench <dir> [total MiB=2048] [files=512]\n");
+    return EXIT_FAILURE;
+  }
+  const std::string dir = argv[1];
+  const u64 total = (argc > 2 ? strtoull(argv[2], nullptr, 10) : 2048ull) << 20;
+  const u32 file_count = argc > 3 ? (u32)atoi(argv[3]) : 512u;
+  if (!total || !file_count)
+  {
+    fprintf(stderr, "nothing to load\n");
+    return EXIT_FAILURE;
+  }
+
+  // sizes from 1/8 to 2x the mean, scaled so they add up to total
+  std::vector<u64> sizes(file_count);
+  std::vector<std::string> paths(file_count);
+  u64 x = 12345, weights = 0;
+  for (u64& s : sizes)
+  {
+    x = x * 6364136223846793005ull + 1442695040888963407ull;
+    s = 128 + (x >> 33) % 1920;
+    weights += s;
+  }
+  u64 bytes = 0;
+  for (u32 i = 0; i < file_count; ++i)
+  {
+    sizes[i] = std::max<u64>(1, std::min<u64>(batch_bytes, sizes[i] * total / weights));
+    bytes += sizes[i];
+    paths[i] = dir + "/asset_" + std::to_string(i) + ".bin";
+  }
+
+  const auto gen_start = std::chrono::steady_clock::now();
+  for (u32 i = 0; i < file_count; ++i)
+  {
+    if (!write_file(paths[i], sizes[i], i))
+    {
+      fprintf(stderr, "can't write %s\n", paths[i].c_str());
+      return EXIT_FAILURE;
+    }
+  }
+  printf("%u files, %.1f MiB (set up in %.0f ms), batches of %llu MiB\n", file_count, bytes / (1024.0 * 1024.0), ms_since(gen_start),
+    (unsigned long long)(batch_bytes >> 20));
+#if !defined(__linux__)
+  printf("no page cache control on this platform, cold runs are warm\n");
+#endif
+
+  lib::IoArena arena;
+  arena.init(batch_bytes);
+  auto row = [&](const char* name, auto&& load)
+  {
+    drop_cache(paths);
+    const f64 cold = load();
+    const f64 warm = load();
+    printf("%-22s cold %9.1f ms %8.1f MB/s   warm %9.1f ms %8.1f MB/s\n", name, cold, bytes / (cold * 1e3), warm, bytes / (warm * 1e3));
+  };
+
+  row("blocking fread", [&] { return load_blocking(paths, sizes, arena); });
+
+  lib::AssetIO threads;
+  threads.init(lib::IoBackend::threads, 4);
+  row("asset io threads x4", [&] { return load_async(threads, paths, sizes, arena); });
+  threads.print_summary();
+  threads.destroy();
+
+  lib::AssetIO uring;
+  uring.init(lib::IoBackend::uring);
+  if (uring.backend == lib::IoBackend::uring)
+  {
+    row("asset io io_uring", [&] { return load_async(uring, paths, sizes, arena); });
+    uring.print_summary();
+  }
+  else
+  {
+    printf("io_uring not available\n");
+  }
+  uring.destroy();
+  arena.destroy();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "../Atlas.hpp"
+#include "Bench.hpp"
+
+// usage: atlas_bench [seed]
+// Atlas packing for growing tile counts and kept mip levels: page size, inner tiles and slots over the
+// page, and time to pack and to filter the mips. More levels mean coarser alignment and wider gutters,
+// which is where the space goes for small tiles. Tile sizes are a random mix of 16..256 texels per side.
+
+static void make_tiles(std::vector<lib::Image>& images, u32 count, u32 seed)
+{
+  static const s32 sizes[6] = { 16, 32, 48, 64, 128, 256 };
+  u32 state = 0x9e3779b9u ^ seed;
+  auto next = [&] { state ^= state << 13; state ^= state >> 17; state ^= state << 5; return state; };
+  images.resize(count);
+  for (lib::Image& image : images)
+  {
+    // mostly small ones, like per-face material textures
+    image.width = sizes[std::min(next() % 6, next() % 6)];
+    image.height = sizes[std::min(next() % 6, next() % 6)];
+    image.pixels.assign((size_t)image.width * image.height * 4, (u8)(next() & 255));
+  }
+}
+
+int main(int argc, char** argv)
+{
+  const u32 seed = argc > 1 ? (u32)atoi(argv[1]) : 1;
+  const u32 hw = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+  lib::JobSystem jobs;
+  jobs.init(hw);
+
+  printf("%6s %6s %11s %6s %8s %8s %10s %10s\n", "tiles", "levels", "page", "align", "tiles%", "slots%", "pack ms", "mips ms");
+  std::vector<lib::Image> images;
+  for (u32 count : { 48u, 384u, 3072u })
+  {
+    make_tiles(images, count, seed);
+    for (u32 levels : { 1u, 3u, 5u })
+    {
+      lib::Atlas atlas;
+      if (!atlas.build(images, levels, &jobs))
+      {
+        printf("%6u %6u doesn't fit 16k\n", count, levels);
+        continue;
+      }
+      char page[32];
+      snprintf(page, sizeof(page), "%dx%d", atlas.chain.width, atlas.chain.height);
+      printf("%6u %6u %11s %6d %8.1f %8.1f %10.2f %10.2f\n", count, levels, page, atlas.align, atlas.efficiency() * 100.0,
+        atlas.slot_efficiency() * 100.0, atlas.stats.pack_ms, atlas.stats.mip_ms);
+      lib::bench::keep(atlas.chain.pixels.back());
+    }
+  }
+  jobs.destroy();
+  return 0;
+}
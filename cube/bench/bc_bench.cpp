@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "../BlockCompress.hpp"
+#include "Bench.hpp"
+
+// usage: bc_bench [image path | size] [reps]
+// Block compression of level 0 only: encode throughput in MB/s of RGBA8 input and PSNR of the decoded
+// result against the source, per format. fast is the runtime path (scalar index search, SSE on one
+// worker, SSE on every worker), best is the offline path and the reference the fast path is measured
+// against. Scalar and SSE must produce the same blocks, that's checked too. Best of reps.
+
+static void make_image(lib::Image& image, s32 size)
+{
+  // gradients, hard edges, noise and an alpha ramp with a cut out, so every block type gets exercised
+  image.width = size;
+  image.height = size;
+  image.pixels.resize((size_t)size * size * 4);
+  u32 state = 0x9e3779b9u;
+  for (s32 y = 0; y < size; ++y)
+  {
+    for (s32 x = 0; x < size; ++x)
+    {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      u8* p = &image.pixels[((size_t)y * size + x) * 4];
+      const b32 checker = ((x / 37) ^ (y / 37)) & 1;
+      p[0] = (u8)(x * 255 / size);
+      p[1] = (u8)(checker ? 200 + (state & 31) : 25);
+      p[2] = (u8)((y * 255 / size) ^ ((state >> 8) & 15));
+      p[3] = (u8)(((x + y) / 23) % 5 == 0 ? 0 : 128 + y * 127 / size);
+    }
+  }
+}
+
+//? Over RGB, and alpha when the format has more than one bit of it. BC1 punches out pixels under half
+//? alpha, their color is gone by design and they are skipped.
+static f64 psnr(const lib::Image& image, const lib::MipChain& decoded, u32 channels)
+{
+  f64 sum = 0.0;
+  u64 count = 0;
+  for (size_t i = 0; i < image.pixels.size(); i += 4)
+  {
+    if (channels == 3 && image.pixels[i + 3] < 128)
+      continue;
+    ++count;
+    for (u32 c = 0; c < channels; ++c)
+    {
+      const f64 d = (f64)image.pixels[i + c] - (f64)decoded.pixels[i + c];
+      sum += d * d;
+    }
+  }
+  const f64 mse = sum / ((f64)count * channels);
+  return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+template <typename F>
+static f64 best_ms(u32 reps, F&& f)
+{
+  f();
+  f64 best = 1e30;
+  for (u32 i = 0; i < reps; ++i)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    best = std::min(best, std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count());
+  }
+  return best;
+}
+
+int main(int argc, char** argv)
+{
+  lib::Image image;
+  if (argc > 1 && !(argv[1][0] >= '0' && argv[1][0] <= '9'))
+  {
+    if (!lib::load_image(argv[1], image))
+    {
+      fprintf(stderr, "can't load %s\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+  }
+  else
+  {
+    make_image(image, argc > 1 ? atoi(argv[1]) : 1024);
+  }
+  const u32 reps = argc > 2 ? (u32)atoi(argv[2]) : 5;
+  const f64 mb = (f64)image.pixels.size() / (1024.0 * 1024.0);
+  const u32 hw = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+
+  lib::MipChain chain;
+  chain.width = image.width;
+  chain.height = image.height;
+  chain.levels = { { image.width, image.height, 0 } };
+  chain.pixels = image.pixels;
+
+  lib::JobSystem jobs;
+  jobs.init(hw);
+
+  printf("%dx%d, %.1f MB, best of %u, %u workers\n", image.width, image.height, mb, reps, hw);
+  printf("%-6s %-6s %8s %8s %10s %10s %10s\n", "format", "mode", "variant", "workers", "ms", "MB/s", "PSNR dB");
+
+  for (lib::BcFormat format : { lib::BcFormat::bc1, lib::BcFormat::bc3, lib::BcFormat::bc7 })
+  {
+    const char* name = lib::bc_format_name(format);
+    const u32 channels = format == lib::BcFormat::bc1 ? 3 : 4;
+    lib::CompressedTexture scalar, simd, reference;
+    lib::MipChain decoded;
+
+    const f64 scalar_ms = best_ms(reps, [&] { lib::compress(chain, format, scalar, nullptr, lib::BcQuality::fast, false); });
+    const f64 simd_ms = best_ms(reps, [&] { lib::compress(chain, format, simd, nullptr, lib::BcQuality::fast); });
+    const f64 parallel_ms = hw > 1 ? best_ms(reps, [&] { lib::compress(chain, format, simd, &jobs, lib::BcQuality::fast); }) : 0.0;
+    lib::decompress(simd, decoded);
+    const f64 fast_psnr = psnr(image, decoded, channels);
+    const f64 reference_ms = best_ms(1, [&] { lib::compress(chain, format, reference, &jobs, lib::BcQuality::best); });
+    lib::decompress(reference, decoded);
+    const f64 reference_psnr = psnr(image, decoded, channels);
+
+    printf("%-6s %-6s %8s %8u %10.2f %10.1f %10.2f\n", name, "fast", "scalar", 1, scalar_ms, mb / (scalar_ms / 1000.0), fast_psnr);
+    printf("%-6s %-6s %8s %8u %10.2f %10.1f %10.2f\n", name, "fast", "sse", 1, simd_ms, mb / (simd_ms / 1000.0), fast_psnr);
+    if (hw > 1)
+      printf("%-6s %-6s %8s %8u %10.2f %10.1f %10.2f\n", name, "fast", "sse", hw, parallel_ms, mb / (parallel_ms / 1000.0), fast_psnr);
+    printf("%-6s %-6s %8s %8u %10.2f %10.1f %10.2f\n", name, "best", "sse", hw, reference_ms, mb / (reference_ms / 1000.0), reference_psnr);
+    if (scalar.blocks != simd.blocks)
+      printf("%-6s scalar and sse blocks differ\n", name);
+  }
+
+  jobs.destroy();
+  return 0;
+}
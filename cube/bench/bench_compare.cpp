@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+#include "Bench.hpp"
+
+// usage: bench_compare <baseline.json> <current.json> [threshold_percent]
+// Matches results of two runs by name/variant/mode and flags anything that got slower (ns/op) by more
+// than the threshold, 5% by default. Exits with 1 when something regressed, so it can gate a script.
+
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+  {
+    fprintf(stderr, "usage: bench_compare <baseline.json> <current.json> [threshold_percent]\n");
+    return EXIT_FAILURE;
+  }
+
+  const f64 threshold = argc > 3 ? atof(argv[3]) : 5.0;
+
+  std::vector<lib::bench::Result> baseline, current;
+  if (!lib::bench::read_json(argv[1], baseline) || !lib::bench::read_json(argv[2], current))
+  {
+    fprintf(stderr, "can't read %s or %s\n", argv[1], argv[2]);
+    return EXIT_FAILURE;
+  }
+
+  std::unordered_map<std::string, const lib::bench::Result*> by_key;
+  for (const lib::bench::Result& r : baseline)
+    by_key[r.name + "|" + r.variant + "|" + r.mode] = &r;
+
+  u32 regressions = 0, improvements = 0, missing = 0;
+  printf("%-28s %-10s %-20s %10s %10s %8s\n", "name", "variant", "mode", "base ns", "ns", "delta");
+  for (const lib::bench::Result& r : current)
+  {
+    auto it = by_key.find(r.name + "|" + r.variant + "|" + r.mode);
+    if (it == by_key.end())
+    {
+      printf("%-28s %-10s %-20s %10s %10.3f %8s\n", r.name.c_str(), r.variant.c_str(), r.mode.c_str(), "-", r.ns_per_op, "new");
+      continue;
+    }
+
+    const lib::bench::Result& base = *it->second;
+    const f64 delta = base.ns_per_op > 0.0 ? (r.ns_per_op - base.ns_per_op) / base.ns_per_op * 100.0 : 0.0;
+    const char* flag = delta > threshold ? "  REGRESSION" : delta < -threshold ? "  faster" : "";
+    regressions += delta > threshold;
+    improvements += delta < -threshold;
+    printf("%-28s %-10s %-20s %10.3f %10.3f %+7.1f%%%s\n", r.name.c_str(), r.variant.c_str(), r.mode.c_str(),
+      base.ns_per_op, r.ns_per_op, delta, flag);
+    by_key.erase(it);
+  }
+
+  missing = (u32)by_key.size();
+  printf("%u regressions, %u improvements over %.1f%%, %u results missing from the current run\n",
+    regressions, improvements, threshold, missing);
+
+  return regressions ? 1 : EXIT_SUCCESS;
+}
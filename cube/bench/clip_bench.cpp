@@ -0,0 +1,172 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "../Clipper.hpp"
+#include "Bench.hpp"
+
+// usage: clip_bench [filter] [grid]
+// Triangles per second through clipping and setup, the scalar path against four triangles per iteration,
+// for a grid^3 field of cubes (32 by default, 12 triangles each) already in clip space. "outside" looks at
+// the field from away, most triangles are accepted or rejected whole; "inside" stands in the field with a
+// near plane as wide as the gaps between cubes, most of the field is behind or beside it; "debris" is as
+// many triangles, up to 4 units across, scattered in the 8 units in front of the eye with a near plane at 1, so a
+// large share of what is in view crosses the near plane and goes through Sutherland-Hodgman. Then the
+// same with the ClipStage over the job system.
+
+static constexpr f32 spacing = 2.0f;
+
+struct Scene
+{
+  std::vector<lib::ClipVertex> vertices;
+  std::vector<u32> indices;
+};
+
+static Scene make_scene(u32 grid, const lib::Mat4& view_proj)
+{
+  static const u32 cube_indices[36] = {
+    0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, // -x, +x
+    0, 4, 5, 0, 5, 1, 2, 3, 7, 2, 7, 6, // -y, +y
+    0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3, // -z, +z
+  };
+  Scene scene;
+  scene.vertices.reserve((size_t)grid * grid * grid * 8);
+  scene.indices.reserve((size_t)grid * grid * grid * 36);
+  const f32 offset = (grid - 1) * spacing * 0.5f;
+  for (u32 i = 0; i < grid * grid * grid; ++i)
+  {
+    const lib::Vec3 center = { (i % grid) * spacing - offset, (i / grid % grid) * spacing - offset, (i / grid / grid) * spacing - offset };
+    const u32 base = (u32)scene.vertices.size();
+    for (u32 c = 0; c < 8; ++c)
+    {
+      const lib::Vec4 p = view_proj * lib::Vec4{ center.x + (c & 4 ? 0.5f : -0.5f), center.y + (c & 2 ? 0.5f : -0.5f),
+        center.z + (c & 1 ? 0.5f : -0.5f), 1.0f };
+      scene.vertices.push_back({ p.x, p.y, p.z, p.w, c & 4 ? 1.0f : 0.2f, c & 2 ? 1.0f : 0.2f, c & 1 ? 1.0f : 0.2f, 1.0f });
+    }
+    for (u32 k = 0; k < 36; ++k)
+      scene.indices.push_back(base + cube_indices[k]);
+  }
+  return scene;
+}
+
+//? Triangles up to a few units across, a few units in front of the eye: a large share
+//? of the ones in view cross the near plane or a side plane, the worst case for a clipper
+static Scene make_debris(u32 count, const lib::Mat4& view_proj)
+{
+  Scene scene;
+  scene.vertices.reserve((size_t)count * 3);
+  scene.indices.reserve((size_t)count * 3);
+  u32 state = 0x9e3779b9u;
+  auto random = [&](f32 range)
+    {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      return ((f32)(state >> 8) / (f32)(1u << 24) * 2.0f - 1.0f) * range;
+    };
+  for (u32 t = 0; t < count; ++t)
+  {
+    const lib::Vec3 center = { random(4.0f), random(3.0f), random(4.0f) - 4.0f };
+    for (u32 k = 0; k < 3; ++k)
+    {
+      const lib::Vec4 p = view_proj * lib::Vec4{ center.x + random(2.0f), center.y + random(2.0f), center.z + random(2.0f), 1.0f };
+      scene.indices.push_back((u32)scene.vertices.size());
+      scene.vertices.push_back({ p.x, p.y, p.z, p.w, k == 0 ? 1.0f : 0.2f, k == 1 ? 1.0f : 0.2f, k == 2 ? 1.0f : 0.2f, 1.0f });
+    }
+  }
+  return scene;
+}
+
+static void print_stats(const char* scene, const lib::ClipStats& s)
+{
+  const f64 n = (f64)s.triangles;
+  printf("%-8s %9llu triangles: %5.1f%% accepted, %5.1f%% rejected, %5.1f%% clipped, %5.1f%% culled after setup, %.2f out per in\n",
+    scene, (unsigned long long)s.triangles, s.accepted * 100.0 / n, s.rejected * 100.0 / n, s.clipped * 100.0 / n, s.culled * 100.0 / n,
+    s.emitted / n);
+}
+
+int main(int argc, char** argv)
+{
+  lib::bench::Runner runner;
+  runner.filter = argc > 1 && strcmp(argv[1], "-") != 0 ? argv[1] : nullptr;
+  const u32 grid = argc > 2 ? (u32)atoi(argv[2]) : 32;
+  runner.init();
+
+  const lib::ClipViewport viewport = { 1920.0f, 1080.0f, true };
+  const f32 aspect = viewport.width / viewport.height;
+  const f32 extent = grid * spacing;
+  struct Setup
+  {
+    const char* name;
+    lib::Mat4 view_proj;
+    b32 debris;
+  };
+  const Setup setups[] = {
+    { "outside", lib::create_perspective(1.0f, aspect, 0.1f, extent * 4.0f) *
+      lib::create_look_at({ extent * 0.9f, extent * 0.5f, extent * 1.1f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }), false },
+    { "inside", lib::create_perspective(1.4f, aspect, spacing * 0.75f, extent * 4.0f) *
+      lib::create_look_at({ 0.3f, 0.2f, 0.1f }, { extent, extent * 0.3f, extent * 0.6f }, { 0.0f, 1.0f, 0.0f }), false },
+    { "debris", lib::create_perspective(1.4f, aspect, 1.0f, 100.0f) *
+      lib::create_look_at({ 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 1.0f, 0.0f }), true },
+  };
+
+  for (const Setup& setup : setups)
+  {
+    if (!runner.selected(setup.name) && !runner.selected("clip"))
+      continue;
+    const Scene scene = setup.debris ? make_debris(grid * grid * grid * 12, setup.view_proj) : make_scene(grid, setup.view_proj);
+    const u32 triangle_count = (u32)(scene.indices.size() / 3);
+
+    lib::ClipBin reference, bin;
+    lib::clip_triangles_scalar(scene.vertices.data(), scene.indices.data(), 0, triangle_count, viewport, reference);
+    lib::clip_triangles(scene.vertices.data(), scene.indices.data(), 0, triangle_count, viewport, bin);
+    print_stats(setup.name, reference.stats);
+    if (memcmp(&reference.stats, &bin.stats, sizeof(lib::ClipStats)) != 0 || reference.vertices.size() != bin.vertices.size() ||
+      memcmp(reference.vertices.data(), bin.vertices.data(), bin.vertices.size() * sizeof(lib::RasterVertex)) != 0)
+      printf("%-8s simd and scalar disagree: %llu against %llu triangles out\n", setup.name, (unsigned long long)bin.stats.emitted,
+        (unsigned long long)reference.stats.emitted);
+
+    char name[32];
+    snprintf(name, sizeof(name), "clip %s", setup.name);
+    runner.run(name, "scalar", "1 thread", triangle_count, [&](u64 reps)
+      {
+        for (u64 i = 0; i < reps; ++i)
+        {
+          bin.clear();
+          lib::clip_triangles_scalar(scene.vertices.data(), scene.indices.data(), 0, triangle_count, viewport, bin);
+        }
+        lib::bench::keep(bin.stats.emitted);
+      });
+    runner.run(name, "simd", "1 thread", triangle_count, [&](u64 reps)
+      {
+        for (u64 i = 0; i < reps; ++i)
+        {
+          bin.clear();
+          lib::clip_triangles(scene.vertices.data(), scene.indices.data(), 0, triangle_count, viewport, bin);
+        }
+        lib::bench::keep(bin.stats.emitted);
+      });
+
+    lib::JobSystem jobs;
+    jobs.init();
+    lib::ClipStage stage;
+    for (b32 simd : { false, true })
+    {
+      stage.simd = simd;
+      runner.run(name, simd ? "simd" : "scalar", "job system", triangle_count, [&](u64 reps)
+        {
+          for (u64 i = 0; i < reps; ++i)
+            stage.run(jobs, scene.vertices.data(), scene.indices.data(), triangle_count, viewport);
+          lib::bench::keep(stage.bin_count);
+        });
+    }
+    jobs.destroy();
+  }
+
+  for (const lib::bench::Result& r : runner.results)
+    printf("%-14s %-7s %-11s %7.1f Mtri/s\n", r.name.c_str(), r.variant.c_str(), r.mode.c_str(), 1000.0 / r.ns_per_op);
+  runner.destroy();
+  return EXIT_SUCCESS;
+}
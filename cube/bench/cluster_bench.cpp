@@ -0,0 +1,142 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <vector>
+#include <chrono>
+#include <thread>
+
+#include "../ClusteredLights.hpp"
+#include "Bench.hpp"
+
+// usage: cluster_bench [scene preset] [frames]
+// Light binning time per frame for 256/1024/4096 lights with one worker and with the whole machine, then
+// shading cost on the CPU: the fragment shader's loop run for a grid of samples on the scene's bounding
+// sphere, with each sample's cluster list against looping over every light. Light evaluations per fragment
+// are what the GPU pays too, ns per fragment is only a CPU reference for how the two compare.
+
+struct Sample
+{
+  lib::Vec3 pos; // view space
+  lib::Vec3 normal;
+  u32 cluster;
+};
+
+//? Rays through a grid of pixels hitting the front of the scene's bounding sphere, normals from the sphere
+static std::vector<Sample> make_samples(const lib::ClusteredLights& cl, const lib::Mat4& view, lib::Vec3 center_world, f32 radius, u32 size)
+{
+  const lib::Vec4 c = view * lib::Vec4{ center_world.x, center_world.y, center_world.z, 1.0f };
+  const lib::Vec3 center = { c.x, c.y, c.z };
+  const f32 tan_y = tanf(cl.fov * 0.5f);
+  const f32 tan_x = tan_y * cl.aspect;
+
+  std::vector<Sample> samples;
+  for (u32 py = 0; py < size; ++py)
+  {
+    for (u32 px = 0; px < size; ++px)
+    {
+      const f32 nx = -1.0f + 2.0f * (px + 0.5f) / size;
+      const f32 ny = -1.0f + 2.0f * (py + 0.5f) / size;
+      const lib::Vec3 dir = lib::normalize(lib::Vec3{ nx * tan_x, ny * tan_y, -1.0f });
+      const f32 b = lib::dot(dir, center);
+      const f32 disc = b * b - lib::dot(center, center) + radius * radius;
+      if (disc < 0.0f)
+        continue;
+      const f32 t = b - sqrtf(disc);
+      if (t <= cl.near_plane)
+        continue;
+
+      Sample s;
+      s.pos = dir * t;
+      s.normal = lib::normalize(s.pos - center);
+      const u32 tx = lib::min((u32)((f32)px * cl.grid_x / size), cl.grid_x - 1);
+      const u32 ty = lib::min((u32)((f32)py * cl.grid_y / size), cl.grid_y - 1);
+      const f32 slice = lib::clamp(logf(-s.pos.z) * cl.z_scale() + cl.z_bias(), 0.0f, (f32)cl.grid_z - 1.0f);
+      s.cluster = ((u32)slice * cl.grid_y + ty) * cl.grid_x + tx;
+      samples.push_back(s);
+    }
+  }
+  return samples;
+}
+
+static f32 shade(const lib::GpuLight& light, const Sample& s)
+{
+  const lib::Vec3 l = light.pos - s.pos;
+  const f32 d = lib::length_vec(l);
+  const f32 falloff = lib::clamp(1.0f - d / light.radius, 0.0f, 1.0f);
+  return lib::max(lib::dot(s.normal, l / d), 0.0f) * falloff * falloff * light.color.x;
+}
+
+int main(int argc, char** argv)
+{
+  const lib::SceneDesc* preset = lib::find_scene_preset(argc > 1 ? argv[1] : "100k-static");
+  const u32 frames = argc > 2 ? (u32)atoi(argv[2]) : 200;
+  if (!preset)
+  {
+    fprintf(stderr, "unknown scene preset\n");
+    return EXIT_FAILURE;
+  }
+
+  lib::Scene scene;
+  scene.generate(*preset);
+  const lib::Mat4 view = lib::create_look_at(scene.camera_pos, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+  const u32 hw = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+
+  printf("scene %s, radius %.1f, %ux%ux%u clusters, %u frames\n", preset->name, scene.radius,
+    lib::ClusteredLights::grid_x, lib::ClusteredLights::grid_y, lib::ClusteredLights::grid_z, frames);
+  printf("%6s %8s %10s %10s %12s %10s %14s %14s %12s %12s\n", "lights", "workers", "bin ms", "max ms", "refs/cluster", "max/clus",
+    "evals/frag", "brute/frag", "ns/frag", "brute ns");
+
+  for (u32 count : { 256u, 1024u, 4096u })
+  {
+    for (u32 pass = 0; pass < (hw > 1 ? 2u : 1u); ++pass)
+    {
+      const u32 workers = pass ? hw : 1;
+      lib::JobSystem jobs;
+      jobs.init(workers);
+
+      lib::ClusteredLights cl;
+      cl.generate(count, scene.radius, preset->seed);
+      cl.set_projection(lib::deg_to_rad(50.0f), 1.0f, 0.1f, scene.far_plane());
+      cl.bin(view, 0.0f, jobs); // warm up, allocates
+      cl.stats = {};
+      for (u32 f = 0; f < frames; ++f)
+        cl.bin(view, (f32)f / 60.0f, jobs);
+      jobs.destroy();
+
+      const std::vector<Sample> samples = make_samples(cl, view, { 0.0f, 0.0f, 0.0f }, scene.radius, 256);
+
+      u64 evals = 0;
+      f32 sum = 0.0f;
+      auto start = std::chrono::steady_clock::now();
+      for (const Sample& s : samples)
+      {
+        const u32 offset = cl.cluster_ranges[s.cluster * 2 + 0];
+        const u32 n = cl.cluster_ranges[s.cluster * 2 + 1];
+        for (u32 i = 0; i < n; ++i)
+          sum += shade(cl.gpu_lights[cl.light_indices[offset + i]], s);
+        evals += n;
+      }
+      const f64 clustered_ns = std::chrono::duration<f64, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+      start = std::chrono::steady_clock::now();
+      for (const Sample& s : samples)
+      {
+        for (const lib::GpuLight& light : cl.gpu_lights)
+          sum += shade(light, s);
+      }
+      const f64 brute_ns = std::chrono::duration<f64, std::nano>(std::chrono::steady_clock::now() - start).count();
+      lib::bench::keep(sum);
+
+      const f64 n = (f64)cl.stats.frames;
+      const f64 fragments = (f64)samples.size();
+      printf("%6u %8u %10.3f %10.3f %12.2f %10u %14.2f %14u %12.1f %12.1f\n", count, workers, cl.stats.bin_ms / n, cl.stats.max_bin_ms,
+        cl.stats.references / n / lib::ClusteredLights::cluster_count, cl.stats.max_per_cluster, evals / fragments, count,
+        clustered_ns / fragments, brute_ns / fragments);
+      if (cl.stats.overflow)
+        printf("       %llu light/cluster pairs overflowed\n", (unsigned long long)cl.stats.overflow);
+    }
+  }
+
+  return 0;
+}
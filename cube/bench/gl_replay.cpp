@@ -0,0 +1,117 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <unordered_map>
+#include <chrono>
+
+#include <glad/glad.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include "../Utils.hpp"
+#include "../GpuTimer.hpp"
+#include "../GlRecorder.hpp"
+
+// usage: gl_replay <recording> [iterations]
+// Plays the setup section once, then the recorded frame N times and reports CPU submission time
+// (time spent issuing the calls) and GPU time of each replayed frame.
+
+static void error_callback(int error, const char* description)
+{
+  fprintf(stderr, "Error 0x%x: %s\n", error, description);
+}
+
+static f64 percentile(std::vector<f64>& values, f64 p)
+{
+  if (values.empty())
+    return 0.0;
+  std::sort(values.begin(), values.end());
+  return values[(size_t)(p * (values.size() - 1))];
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: gl_replay <recording> [iterations]\n");
+    return EXIT_FAILURE;
+  }
+
+  const u32 iterations = argc > 2 ? (u32)atoi(argv[2]) : 1000;
+
+  glfwSetErrorCallback(error_callback);
+  if (!glfwInit())
+    return EXIT_FAILURE;
+
+  lib::glrec::Replayer replayer;
+  if (!replayer.load(argv[1]))
+  {
+    fprintf(stderr, "can't load recording %s\n", argv[1]);
+    glfwTerminate();
+    return EXIT_FAILURE;
+  }
+
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+  GLFWwindow* window = glfwCreateWindow(replayer.header.width, replayer.header.height, "gl_replay", NULL, NULL);
+  if (!window)
+  {
+    glfwTerminate();
+    return EXIT_FAILURE;
+  }
+
+  glfwMakeContextCurrent(window);
+  gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+  glfwSwapInterval(0);
+
+  printf("%s: %dx%d, setup %.1f KiB, frame %.1f KiB, %s\n", argv[1], replayer.header.width, replayer.header.height,
+    replayer.setup_end / 1024.0, replayer.frame_bytes() / 1024.0, (const char*)glGetString(GL_RENDERER));
+
+  replayer.play_setup();
+  glFinish();
+
+  lib::GpuTimer timer;
+  timer.init();
+
+  std::vector<f64> cpu_us;
+  std::vector<f64> gpu_ms;
+  cpu_us.reserve(iterations);
+  gpu_ms.reserve(iterations);
+
+  for (u32 i = 0; i < iterations; ++i)
+  {
+    timer.begin();
+    const auto start = std::chrono::steady_clock::now();
+    replayer.play_frame();
+    const auto stop = std::chrono::steady_clock::now();
+    timer.end();
+
+    cpu_us.push_back(std::chrono::duration<f64, std::micro>(stop - start).count());
+    if (timer.last_ms > 0.0f)
+      gpu_ms.push_back(timer.last_ms);
+  }
+
+  timer.flush();
+  gpu_ms.push_back(timer.last_ms);
+  timer.destroy();
+
+  f64 cpu_sum = 0.0, gpu_sum = 0.0;
+  for (f64 v : cpu_us)
+    cpu_sum += v;
+  for (f64 v : gpu_ms)
+    gpu_sum += v;
+
+  printf("%u iterations\n", iterations);
+  printf("cpu submit: avg %.2f us, p50 %.2f us, p99 %.2f us\n", cpu_sum / cpu_us.size(), percentile(cpu_us, 0.5), percentile(cpu_us, 0.99));
+  printf("gpu frame:  avg %.3f ms, p50 %.3f ms, p99 %.3f ms\n", gpu_sum / gpu_ms.size(), percentile(gpu_ms, 0.5), percentile(gpu_ms, 0.99));
+
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+#include <chrono>
+
+#include <glad/glad.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include "../GlBackend.hpp"
+#include "../GpuHeap.hpp"
+#include "Bench.hpp"
+
+// usage: gpu_heap_bench [filter] [meshes]
+// Mesh buffers from a GpuHeap against a GL buffer per mesh. Latency of replacing one of 4096 live meshes
+// (24 B vertices, 64 to 32K of them, log uniform): the TLSF allocator alone, the heap with its page
+// buffers, and glGenBuffers + glBufferData + glDeleteBuffers. Then meshes (10000 by default) allocated,
+// churned and defragmented: buffer objects, utilization and fragmentation at each step. Without a GL
+// context the GL calls are the mock stubs, so the per-mesh buffer row is the call overhead only and the
+// driver's cost of an allocation, which is what the heap saves, isn't in it.
+
+static constexpr u32 live_count = 4096;
+static constexpr u32 size_count = 1 << 16;
+
+static void error_callback(int error, const char* description)
+{
+  fprintf(stderr, "Error 0x%x: %s\n", error, description);
+}
+
+static std::vector<u32> make_sizes(u32 count, u32 seed)
+{
+  std::vector<u32> sizes(count);
+  u32 state = seed;
+  for (u32& size : sizes)
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    size = 64u << (state % 9);          // 64 .. 32K
+    size += (state >> 8) % size;
+  }
+  return sizes;
+}
+
+static void print_heap(const char* step, const lib::GpuHeap& heap, u32 meshes)
+{
+  printf("%-22s %6u meshes %4u buffers (%u with a buffer per mesh), %7.1f MiB of %7.1f MiB (%.1f%%), %.1f%% fragmented\n",
+    step, meshes, heap.buffer_count(), meshes, heap.used_bytes() / (1024.0 * 1024.0), heap.capacity_bytes() / (1024.0 * 1024.0),
+    heap.utilization() * 100.0, heap.fragmentation() * 100.0);
+}
+
+int main(int argc, char** argv)
+{
+  lib::bench::Runner runner;
+  runner.filter = argc > 1 && strcmp(argv[1], "-") != 0 ? argv[1] : nullptr;
+  const u32 mesh_count = argc > 2 ? (u32)atoi(argv[2]) : 10000;
+  runner.init();
+
+  glfwSetErrorCallback(error_callback);
+  GLFWwindow* window = NULL;
+  if (glfwInit())
+  {
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    window = glfwCreateWindow(64, 64, "gpu_heap_bench", NULL, NULL);
+  }
+  if (window)
+  {
+    glfwMakeContextCurrent(window);
+    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    printf("%s\n", (const char*)glGetString(GL_RENDERER));
+  }
+  else
+  {
+    lib::glbackend::install_mock();
+    printf("no GL context, GL calls are mock stubs\n");
+  }
+
+  const std::vector<u32> sizes = make_sizes(size_count, 0x9e3779b9u);
+  const std::vector<u32> slots = make_sizes(size_count, 0x85ebca77u); // which live mesh gets replaced
+
+  {
+    lib::TlsfAllocator tlsf;
+    tlsf.init(1u << 30);
+    std::vector<u32> live(live_count);
+    for (u32 i = 0; i < live_count; ++i)
+      live[i] = tlsf.alloc(sizes[i]);
+    u32 next = 0;
+    runner.run("replace mesh", "tlsf", "allocator only", 1, [&](u64 reps)
+      {
+        for (u64 i = 0; i < reps; ++i, ++next)
+        {
+          u32& block = live[slots[next % size_count] % live_count];
+          tlsf.free(block);
+          block = tlsf.alloc(sizes[next % size_count]);
+        }
+        lib::bench::keep(live[0]);
+      });
+  }
+
+  {
+    lib::GpuHeap heap;
+    heap.init("bench", 24, 1u << 20);
+    std::vector<u32> live(live_count);
+    for (u32 i = 0; i < live_count; ++i)
+      live[i] = heap.alloc(sizes[i]);
+    u32 next = 0;
+    runner.run("replace mesh", "heap", "alloc + free", 1, [&](u64 reps)
+      {
+        for (u64 i = 0; i < reps; ++i, ++next)
+        {
+          u32& handle = live[slots[next % size_count] % live_count];
+          heap.free(handle);
+          handle = heap.alloc(sizes[next % size_count]);
+        }
+        lib::bench::keep(live[0]);
+      });
+    if (runner.selected("replace mesh"))
+      printf("heap after the run: %u buffers for %u meshes\n", heap.buffer_count(), live_count);
+    heap.destroy();
+  }
+
+  {
+    std::vector<GLuint> live(live_count);
+    glGenBuffers(live_count, live.data());
+    for (u32 i = 0; i < live_count; ++i)
+    {
+      glBindBuffer(GL_COPY_WRITE_BUFFER, live[i]);
+      glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)sizes[i] * 24, nullptr, GL_STATIC_DRAW);
+    }
+    u32 next = 0;
+    runner.run("replace mesh", "gl", window ? "buffer per mesh" : "buffer per mesh, mock", 1, [&](u64 reps)
+      {
+        for (u64 i = 0; i < reps; ++i, ++next)
+        {
+          GLuint& buffer = live[slots[next % size_count] % live_count];
+          glDeleteBuffers(1, &buffer);
+          glGenBuffers(1, &buffer);
+          glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+          glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)sizes[next % size_count] * 24, nullptr, GL_STATIC_DRAW);
+        }
+        if (window)
+          glFinish();
+        lib::bench::keep(live[0]);
+      });
+    glDeleteBuffers(live_count, live.data());
+  }
+
+  if (runner.selected("churn"))
+  {
+    // fill, drop every other mesh and refill with other sizes, then compact a MiB at a time as idle
+    // frames would
+    lib::GpuHeap heap;
+    heap.init("churn", 24, 1u << 20);
+    std::vector<u32> live(mesh_count);
+    for (u32 i = 0; i < mesh_count; ++i)
+      live[i] = heap.alloc(sizes[i % size_count]);
+    print_heap("filled", heap, mesh_count);
+    for (u32 i = 0; i < mesh_count; i += 2)
+      heap.free(live[i]);
+    print_heap("half freed", heap, mesh_count / 2);
+    for (u32 i = 0; i < mesh_count; i += 2)
+      live[i] = heap.alloc(slots[i % size_count] / 2 + 64);
+    print_heap("refilled", heap, mesh_count);
+    for (u32 i = 1; i < mesh_count; i += 4)
+      heap.free(live[i]);
+    print_heap("quarter freed", heap, mesh_count - (mesh_count + 2) / 4);
+
+    u32 passes = 0;
+    while (heap.defragment(1ull << 20))
+      ++passes;
+    if (window)
+      glFinish();
+    print_heap("defragmented", heap, mesh_count - (mesh_count + 2) / 4);
+    printf("defragment: %u passes of 1 MiB, %llu moves, %.1f MiB copied, %.2f ms CPU, %u pages released\n", passes,
+      (unsigned long long)heap.stats.moves, heap.stats.moved_bytes / (1024.0 * 1024.0), heap.stats.defrag_ms, heap.stats.pages_released);
+    heap.destroy();
+  }
+
+  if (window)
+    glfwDestroyWindow(window);
+  glfwTerminate();
+  runner.destroy();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <chrono>
+
+#include "../ImageWriter.hpp"
+
+// usage: image_bench [width height frames]
+// Encodes the same synthetic frames with every format and thread count, encode only (no disk).
+
+static void make_frame(std::vector<u8>& pixels, s32 width, s32 height, u32 seed)
+{
+  // something between a rendered frame and noise: gradients, flat areas and a bit of dither
+  u32 state = seed * 747796405u + 2891336453u;
+  for (s32 y = 0; y < height; ++y)
+  {
+    for (s32 x = 0; x < width; ++x)
+    {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+
+      u8* p = &pixels[((size_t)y * width + x) * 4];
+      const b32 inside = (x - width / 2) * (x - width / 2) + (y - height / 2) * (y - height / 2) < (height / 3) * (height / 3);
+      if (inside)
+      {
+        p[0] = (u8)(x * 255 / width + (state & 3));
+        p[1] = (u8)(y * 255 / height + ((state >> 2) & 3));
+        p[2] = (u8)((x + y + seed) & 0xff);
+      }
+      else
+      {
+        p[0] = p[1] = p[2] = 0;
+      }
+      p[3] = 255;
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  const s32 width = argc > 2 ? atoi(argv[1]) : 1200;
+  const s32 height = argc > 2 ? atoi(argv[2]) : 1200;
+  const u32 frames = argc > 3 ? (u32)atoi(argv[3]) : 64;
+
+  constexpr u32 unique_frames = 8;
+  std::vector<std::vector<u8>> source(unique_frames, std::vector<u8>((size_t)width * height * 4));
+  for (u32 i = 0; i < unique_frames; ++i)
+    make_frame(source[i], width, height, i);
+
+  const u32 hw = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+  const f64 frame_mb = (f64)width * height * 4 / 1e6;
+
+  printf("%dx%d, %u frames, %.2f MB per frame\n", width, height, frames, frame_mb);
+  printf("%-6s %8s %10s %10s %10s\n", "format", "threads", "MB/s", "frames/s", "ratio");
+
+  for (lib::ImageFormat format : { lib::ImageFormat::qoi, lib::ImageFormat::png })
+  {
+    for (u32 threads = 1; threads <= hw; threads *= 2)
+    {
+      lib::JobSystem jobs;
+      jobs.init(threads);
+
+      lib::ImageWriter writer;
+      writer.init(&jobs, format, threads * 2);
+      writer.discard = true;
+
+      const auto start = std::chrono::steady_clock::now();
+      for (u32 i = 0; i < frames; ++i)
+      {
+        const lib::ImageView view{ source[i % unique_frames].data(), width, height, true };
+        writer.write("", view);
+      }
+      writer.flush();
+      const f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+      printf("%-6s %8u %10.1f %10.2f %9.1f%%\n", lib::image_format_ext(format), threads,
+        frame_mb * frames / seconds, frames / seconds, 100.0 * (f64)writer.stats.bytes_out / (f64)writer.stats.bytes_in);
+
+      jobs.destroy();
+
+      if (threads < hw && threads * 2 > hw)
+        threads = hw / 2; // always finish with all hardware threads
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,88 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "../Log.hpp"
+#include "Bench.hpp"
+
+// usage: log_bench [bursts]
+// Latency of one log call on the calling thread: LOG against fprintf to an unbuffered FILE (how stderr
+// behaves) and a buffered one. Everything goes to the null device so the disk isn't what is measured.
+// Calls come in bursts smaller than a log ring and the logger is given time to drain between bursts,
+// so LOG is measured on its normal path, not the drop path. Every call is timed on its own with rdtsc.
+
+#if defined(_WIN32)
+static const char* null_path = "NUL";
+#else
+static const char* null_path = "/dev/null";
+#endif
+
+static const char* messages[] = { "GLX: Failed to create context", "Invalid window size", "The requested format is not available" };
+
+template <typename F>
+static void measure(const char* name, u32 bursts, f64 tsc_per_ns, F&& call)
+{
+  constexpr u32 burst = 256;
+  std::vector<u64> ticks;
+  ticks.reserve((size_t)bursts * burst);
+
+  for (u32 b = 0; b < bursts; ++b)
+  {
+    while (lib::log::logger.pending() != 0)
+      std::this_thread::yield();
+
+    for (u32 i = 0; i < burst; ++i)
+    {
+      const u64 start = __rdtsc();
+      call(i);
+      ticks.push_back(__rdtsc() - start);
+    }
+  }
+
+  std::sort(ticks.begin(), ticks.end());
+  f64 sum = 0.0;
+  for (u64 t : ticks)
+    sum += (f64)t;
+  auto ns = [&](f64 t) { return t / tsc_per_ns; };
+  printf("%-18s avg %9.1f ns  p50 %9.1f ns  p99 %9.1f ns  max %10.1f ns\n", name, ns(sum / ticks.size()),
+    ns((f64)ticks[ticks.size() / 2]), ns((f64)ticks[ticks.size() * 99 / 100]), ns((f64)ticks.back()));
+}
+
+int main(int argc, char** argv)
+{
+  const u32 bursts = argc > 1 ? (u32)atoi(argv[1]) : 400;
+  const f64 tsc_per_ns = lib::bench::calibrate_tsc();
+
+  FILE* unbuffered = fopen(null_path, "wb");
+  FILE* buffered = fopen(null_path, "wb");
+  FILE* log_out = fopen(null_path, "wb");
+  if (!unbuffered || !buffered || !log_out)
+  {
+    fprintf(stderr, "can't open %s\n", null_path);
+    return 1;
+  }
+  setvbuf(unbuffered, NULL, _IONBF, 0);
+  lib::log::logger.init(log_out);
+
+  printf("%u bursts of 256 calls, \"Error %%d: %%s\" with a ~30 char string, timer overhead included\n", bursts);
+
+  measure("timer only", bursts, tsc_per_ns, [](u32 i) { lib::bench::keep(i); });
+  measure("fprintf unbuffered", bursts, tsc_per_ns, [&](u32 i) { fprintf(unbuffered, "Error %d: %s\n", 0x10000 + i, messages[i % 3]); });
+  measure("fprintf buffered", bursts, tsc_per_ns, [&](u32 i) { fprintf(buffered, "Error %d: %s\n", 0x10000 + i, messages[i % 3]); });
+  measure("LOG", bursts, tsc_per_ns, [](u32 i) { LOG("Error %d: %s", 0x10000 + i, messages[i % 3]); });
+  measure("LOG no args", bursts, tsc_per_ns, [](u32) { LOG("frame done"); });
+
+  lib::log::logger.destroy();
+  printf("logger wrote %llu records, %llu dropped\n", (unsigned long long)lib::log::logger.written, (unsigned long long)lib::log::logger.dropped());
+
+  fclose(unbuffered);
+  fclose(buffered);
+  fclose(log_out);
+  return 0;
+}
@@ -0,0 +1,469 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <type_traits>
+#include <algorithm>
+#include <chrono>
+
+#include "../my_math.h"
+#include "Bench.hpp"
+
+// usage: math_bench [--json <path>] [--filter <substring>] [--min-ms <ms>] [--perf]
+// Every Vec/Mat operation in my_math.h in three modes:
+//   latency              each result feeds the next call, chains of 64 so values stay finite
+//   throughput           independent calls over arrays of 256 inputs, inlined in the loop
+//   throughput_unaligned same, inputs loaded from a buffer offset by 4 bytes
+// refract_fast is skipped, it is a WIP stub that breaks into the debugger.
+// Where my_math.h made a scalar/SIMD choice the other option runs next to it as variant "scalar" or "simd".
+// Ops with a different result type than their input feed back as first_lane(result) * 0 written into a
+// lane, so their latency includes a mul+add and a lane insert (often a store forward); compare those rows
+// with each other, not with ops that chain directly. "baseline" rows are the bare loop.
+
+constexpr u32 element_count = 256;
+constexpr u32 chain_length = 64;
+
+struct Rng
+{
+  u32 state = 0x2545f491u;
+
+  f32 next(f32 lo, f32 hi)
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return lo + (hi - lo) * (f32)(state >> 8) * (1.0f / 16777216.0f);
+  }
+
+  f32 signed_next()
+  {
+    const f32 v = next(0.5f, 1.5f);
+    return (state & 1) ? v : -v;
+  }
+};
+
+static f32 make_value(Rng& rng, f32*) { return rng.next(0.5f, 2.0f); }
+static lib::Vec2 make_value(Rng& rng, lib::Vec2*) { return { rng.signed_next(), rng.signed_next() }; }
+static lib::Vec3 make_value(Rng& rng, lib::Vec3*) { return { rng.signed_next(), rng.signed_next(), rng.signed_next() }; }
+
+// w = 0, Vec4 is a direction in homogeneous space for most of my_math.h
+static lib::Vec4 make_value(Rng& rng, lib::Vec4*) { return { rng.signed_next(), rng.signed_next(), rng.signed_next(), 0.0f }; }
+
+static lib::Mat4 make_value(Rng& rng, lib::Mat4*)
+{
+  const lib::Vec3 axis = { rng.signed_next(), rng.signed_next(), rng.signed_next() };
+  const lib::Vec3 offset = { rng.signed_next(), rng.signed_next(), rng.signed_next() };
+  return lib::create_translate(offset) * lib::create_rotation(axis, rng.next(0.0f, 6.0f));
+}
+
+static f32& lane(f32& v) { return v; }
+static f32& lane(lib::Vec2& v) { return v.e[0]; }
+static f32& lane(lib::Vec3& v) { return v.e[0]; }
+static f32& lane(lib::Vec4& v) { return v.e[0]; }
+static f32& lane(lib::Mat4& v) { return v.e[0][0]; }
+
+static f32 first_lane(f32 v) { return v; }
+static f32 first_lane(s32 v) { return (f32)v; }
+static f32 first_lane(const lib::Mat4& v) { return v.e[0][0]; }
+
+// next input of a latency chain, the result itself when types match
+template <typename A, typename R>
+static A feed(A x, const R& result)
+{
+  if constexpr (std::is_same_v<A, R>)
+  {
+    return result;
+  }
+  else
+  {
+    lane(x) += first_lane(result) * 0.0f;
+    return x;
+  }
+}
+
+template <typename T>
+struct Inputs
+{
+  std::vector<T> aligned;
+  std::vector<f32> raw; // same values starting 4 bytes into the buffer
+
+  void init(Rng& rng)
+  {
+    aligned.resize(element_count);
+    raw.assign(element_count * sizeof(T) / sizeof(f32) + 4, 0.0f);
+    for (u32 i = 0; i < element_count; ++i)
+    {
+      aligned[i] = make_value(rng, (T*)nullptr);
+      memcpy(unaligned(i), &aligned[i], sizeof(T));
+    }
+  }
+
+  u8* unaligned(u32 i)
+  {
+    return (u8*)(raw.data() + 1) + (size_t)i * sizeof(T);
+  }
+
+  T load_unaligned(u32 i)
+  {
+    T value;
+    memcpy(&value, unaligned(i), sizeof(T));
+    return value;
+  }
+};
+
+template <typename A, typename F>
+static void bench_unary(lib::bench::Runner& runner, const char* name, const char* variant, F f)
+{
+  using R = decltype(f(std::declval<A>()));
+  if (!runner.selected(name))
+    return;
+
+  Rng rng;
+  Inputs<A> a;
+  a.init(rng);
+  std::vector<R> out(element_count);
+
+  runner.run(name, variant, "latency", element_count, [&](u64 reps)
+    {
+      for (u64 r = 0; r < reps; ++r)
+      {
+        for (u32 i = 0; i < element_count; i += chain_length)
+        {
+          A x = a.aligned[i];
+          for (u32 j = 0; j < chain_length; ++j)
+            x = feed(x, f(x));
+          lib::bench::keep(x);
+        }
+      }
+    });
+
+  runner.run(name, variant, "throughput", element_count, [&](u64 reps)
+    {
+      for (u64 r = 0; r < reps; ++r)
+      {
+        for (u32 i = 0; i < element_count; ++i)
+          out[i] = f(a.aligned[i]);
+        lib::bench::keep(out[0]);
+      }
+    });
+
+  runner.run(name, variant, "throughput_unaligned", element_count, [&](u64 reps)
+    {
+      for (u64 r = 0; r < reps; ++r)
+      {
+        for (u32 i = 0; i < element_count; ++i)
+          out[i] = f(a.load_unaligned(i));
+        lib::bench::keep(out[0]);
+      }
+    });
+}
+
+// latency chains go through the argument with the result's type, the first one otherwise
+template <typename A, typename B, typename F>
+static void bench_binary(lib::bench::Runner& runner, const char* name, const char* variant, F f)
+{
+  using R = decltype(f(std::declval<A>(), std::declval<B>()));
+  constexpr b32 chain_b = std::is_same_v<R, B> && !std::is_same_v<R, A>;
+  if (!runner.selected(name))
+    return;
+
+  Rng rng;
+  Inputs<A> a;
+  Inputs<B> b;
+  a.init(rng);
+  b.init(rng);
+  std::vector<R> out(element_count);
+
+  runner.run(name, variant, "latency", element_count, [&](u64 reps)
+    {
+      for (u64 r = 0; r < reps; ++r)
+      {
+        for (u32 i = 0; i < element_count; i += chain_length)
+        {
+          if constexpr (chain_b)
+          {
+            B x = b.aligned[i];
+            for (u32 j = 0; j < chain_length; ++j)
+              x = feed(x, f(a.aligned[i + j], x));
+            lib::bench::keep(x);
+          }
+          else
+          {
+            A x = a.aligned[i];
+            for (u32 j = 0; j < chain_length; ++j)
+              x = feed(x, f(x, b.aligned[i + j]));
+            lib::bench::keep(x);
+          }
+        }
+      }
+    });
+
+  runner.run(name, variant, "throughput", element_count, [&](u64 reps)
+    {
+      for (u64 r = 0; r < reps; ++r)
+      {
+        for (u32 i = 0; i < element_count; ++i)
+          out[i] = f(a.aligned[i], b.aligned[i]);
+        lib::bench::keep(out[0]);
+      }
+    });
+
+  runner.run(name, variant, "throughput_unaligned", element_count, [&](u64 reps)
+    {
+      for (u64 r = 0; r < reps; ++r)
+      {
+        for (u32 i = 0; i < element_count; ++i)
+          out[i] = f(a.load_unaligned(i), b.load_unaligned(i));
+        lib::bench::keep(out[0]);
+      }
+    });
+}
+
+// the other side of choices my_math.h made
+namespace alt
+{
+  static lib::Vec4 add_scalar(lib::Vec4 a, lib::Vec4 b)
+  {
+    return { a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w };
+  }
+
+  static f32 dot_dp(lib::Vec4 a, lib::Vec4 b)
+  {
+    return _mm_cvtss_f32(_mm_dp_ps(a.simd, b.simd, 0xF1));
+  }
+
+  static lib::Vec4 cross_scalar(lib::Vec4 a, lib::Vec4 b)
+  {
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x, 0.0f };
+  }
+
+  static lib::Vec4 mat_vec_scalar(const lib::Mat4& m, lib::Vec4 v)
+  {
+    lib::Vec4 out;
+    for (s32 row = 0; row < 4; ++row)
+      out.e[row] = m.e[0][row] * v.e[0] + m.e[1][row] * v.e[1] + m.e[2][row] * v.e[2] + m.e[3][row] * v.e[3];
+    return out;
+  }
+
+  static lib::Mat4 mat_mul_scalar(const lib::Mat4& a, const lib::Mat4& b)
+  {
+    lib::Mat4 out;
+    for (s32 column = 0; column < 4; ++column)
+      for (s32 row = 0; row < 4; ++row)
+        out.e[column][row] = a.e[0][row] * b.e[column][0] + a.e[1][row] * b.e[column][1] + a.e[2][row] * b.e[column][2] + a.e[3][row] * b.e[column][3];
+    return out;
+  }
+
+  static lib::Mat4 transpose_scalar(const lib::Mat4& a)
+  {
+    lib::Mat4 out;
+    for (s32 column = 0; column < 4; ++column)
+      for (s32 row = 0; row < 4; ++row)
+        out.e[column][row] = a.e[row][column];
+    return out;
+  }
+
+  // the "more dot products at once" case from the comment on dot(): 4 dots per call in SoA form
+  static void dot4_soa(const lib::Vec4* a, const lib::Vec4* b, f32* out)
+  {
+    __m128 ax = _mm_load_ps(a[0].e), ay = _mm_load_ps(a[1].e), az = _mm_load_ps(a[2].e), aw = _mm_load_ps(a[3].e);
+    __m128 bx = _mm_load_ps(b[0].e), by = _mm_load_ps(b[1].e), bz = _mm_load_ps(b[2].e), bw = _mm_load_ps(b[3].e);
+    _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+    _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+    const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+    _mm_storeu_ps(out, sum);
+  }
+}
+
+#define UNARY(T, name, expr) bench_unary<T>(runner, name, "repo", [](T a) { return expr; })
+#define BINARY(A, B, name, expr) bench_binary<A, B>(runner, name, "repo", [](A a, B b) { return expr; })
+
+// wrapped in lambdas, passed as plain function pointers they don't get inlined
+#define ALT_UNARY(T, name, variant, fn) bench_unary<T>(runner, name, variant, [](T a) { return fn(a); })
+#define ALT_BINARY(A, B, name, variant, fn) bench_binary<A, B>(runner, name, variant, [](A a, B b) { return fn(a, b); })
+
+static void bench_scalars(lib::bench::Runner& runner)
+{
+  UNARY(f32, "f32/baseline", a);
+  UNARY(f32, "f32/sqrt", lib::sqrt(a));
+  bench_unary<f32>(runner, "f32/sqrt", "std", [](f32 a) { return std::sqrt(a); });
+  UNARY(f32, "f32/rsqrt", lib::rsqrt(a));
+  bench_unary<f32>(runner, "f32/rsqrt", "std", [](f32 a) { return 1.0f / std::sqrt(a); });
+  UNARY(f32, "f32/ceil", lib::ceil(a));
+  UNARY(f32, "f32/floor", lib::floor(a));
+  UNARY(f32, "f32/round", lib::round(a));
+  UNARY(f32, "f32/trunc", lib::trunc(a));
+  bench_unary<f32>(runner, "f32/floor", "std", [](f32 a) { return (s32)std::floor(a); });
+  UNARY(f32, "f32/mod_pi", lib::mod_pi(a * 10.0f));
+  BINARY(f32, f32, "f32/lerp", lib::lerp(a, b, 0.25f));
+  BINARY(f32, f32, "f32/clamp", lib::clamp(a, 0.75f, b));
+  BINARY(f32, f32, "f32/min", lib::min(a, b));
+  UNARY(f32, "f32/abs", lib::abs(a));
+}
+
+static void bench_vec2(lib::bench::Runner& runner)
+{
+  using lib::Vec2;
+  UNARY(Vec2, "vec2/baseline", a);
+  BINARY(Vec2, Vec2, "vec2/add", a + b);
+  BINARY(Vec2, Vec2, "vec2/sub", a - b);
+  BINARY(Vec2, Vec2, "vec2/mul", a * b);
+  BINARY(Vec2, f32, "vec2/mul_f32", a * b);
+  BINARY(Vec2, f32, "vec2/div_f32", a / b);
+  BINARY(Vec2, Vec2, "vec2/dot", lib::dot(a, b));
+  UNARY(Vec2, "vec2/length", lib::length_vec(a));
+  UNARY(Vec2, "vec2/length_squared", lib::length_squared_vec(a));
+  UNARY(Vec2, "vec2/normalize", lib::normalize(a));
+  UNARY(Vec2, "vec2/normalize_fast", lib::normalize_fast(a));
+  UNARY(Vec2, "vec2/perp", lib::perp(a));
+  BINARY(Vec2, Vec2, "vec2/perp_dot", lib::perp_dot(a, b));
+  BINARY(Vec2, Vec2, "vec2/reflect", lib::reflect(a, lib::normalize(b)));
+  BINARY(Vec2, Vec2, "vec2/refract", lib::refract(a, lib::normalize(b), 0.75f));
+  BINARY(Vec2, Vec2, "vec2/project", lib::project(a, b));
+  BINARY(Vec2, Vec2, "vec2/project_length", lib::project_length(a, b));
+  BINARY(Vec2, Vec2, "vec2/reject", lib::reject(a, b));
+  BINARY(Vec2, Vec2, "vec2/reject_length", lib::reject_length(a, b));
+}
+
+static void bench_vec3(lib::bench::Runner& runner)
+{
+  using lib::Vec3;
+  UNARY(Vec3, "vec3/baseline", a);
+  BINARY(Vec3, Vec3, "vec3/add", a + b);
+  BINARY(Vec3, Vec3, "vec3/sub", a - b);
+  BINARY(Vec3, Vec3, "vec3/mul", a * b);
+  BINARY(Vec3, f32, "vec3/mul_f32", a * b);
+  BINARY(Vec3, f32, "vec3/div_f32", a / b);
+  BINARY(Vec3, Vec3, "vec3/dot", lib::dot(a, b));
+  UNARY(Vec3, "vec3/length", lib::length_vec(a));
+  UNARY(Vec3, "vec3/length_squared", lib::length_squared_vec(a));
+  UNARY(Vec3, "vec3/normalize", lib::normalize(a));
+  UNARY(Vec3, "vec3/normalize_fast", lib::normalize_fast(a));
+  BINARY(Vec3, Vec3, "vec3/cross", lib::cross(a, b));
+  BINARY(Vec3, Vec3, "vec3/reflect", lib::reflect(a, lib::normalize(b)));
+  BINARY(Vec3, Vec3, "vec3/refract", lib::refract(a, lib::normalize(b), 0.75f));
+  BINARY(Vec3, Vec3, "vec3/project", lib::project(a, b));
+  BINARY(Vec3, Vec3, "vec3/project_length", lib::project_length(a, b));
+  BINARY(Vec3, Vec3, "vec3/reject", lib::reject(a, b));
+  BINARY(Vec3, Vec3, "vec3/reject_length", lib::reject_length(a, b));
+}
+
+static void bench_vec4(lib::bench::Runner& runner)
+{
+  using lib::Vec4;
+  UNARY(Vec4, "vec4/baseline", a);
+  BINARY(Vec4, Vec4, "vec4/add", a + b);
+  ALT_BINARY(Vec4, Vec4, "vec4/add", "scalar", alt::add_scalar);
+  BINARY(Vec4, Vec4, "vec4/sub", a - b);
+  BINARY(Vec4, Vec4, "vec4/mul", a * b);
+  BINARY(Vec4, Vec4, "vec4/div", a / b);
+  BINARY(Vec4, f32, "vec4/mul_f32", a * b);
+  BINARY(Vec4, f32, "vec4/div_f32", a / b);
+  BINARY(Vec4, Vec4, "vec4/dot", lib::dot(a, b));
+  ALT_BINARY(Vec4, Vec4, "vec4/dot", "simd", alt::dot_dp);
+  UNARY(Vec4, "vec4/length", lib::length_vec(a));
+  UNARY(Vec4, "vec4/normalize", lib::normalize(a));
+  UNARY(Vec4, "vec4/normalize_fast", lib::normalize_fast(a));
+  BINARY(Vec4, Vec4, "vec4/cross", lib::cross(a, b));
+  ALT_BINARY(Vec4, Vec4, "vec4/cross", "scalar", alt::cross_scalar);
+  BINARY(Vec4, Vec4, "vec4/reflect", lib::reflect(a, lib::normalize(b)));
+  BINARY(Vec4, Vec4, "vec4/refract", lib::refract(a, lib::normalize(b), 0.75f));
+  BINARY(Vec4, Vec4, "vec4/project", lib::project(a, b));
+  BINARY(Vec4, Vec4, "vec4/project_length", lib::project_length(a, b));
+  BINARY(Vec4, Vec4, "vec4/reject", lib::reject(a, b));
+  BINARY(Vec4, Vec4, "vec4/reject_length", lib::reject_length(a, b));
+
+  // 4 dots per call, throughput only, there's no chain to speak of
+  if (runner.selected("vec4/dot"))
+  {
+    Rng rng;
+    Inputs<Vec4> a, b;
+    a.init(rng);
+    b.init(rng);
+    std::vector<f32> out(element_count);
+    runner.run("vec4/dot", "simd_soa4", "throughput", element_count, [&](u64 reps)
+      {
+        for (u64 r = 0; r < reps; ++r)
+        {
+          for (u32 i = 0; i < element_count; i += 4)
+            alt::dot4_soa(&a.aligned[i], &b.aligned[i], &out[i]);
+          lib::bench::keep(out[0]);
+        }
+      });
+  }
+}
+
+static void bench_mat4(lib::bench::Runner& runner)
+{
+  using lib::Mat4;
+  using lib::Vec3;
+  using lib::Vec4;
+  UNARY(Mat4, "mat4/baseline", a);
+  UNARY(Mat4, "mat4/negate", -a);
+  BINARY(Mat4, Mat4, "mat4/add", a + b);
+  BINARY(Mat4, Mat4, "mat4/sub", a - b);
+  BINARY(Mat4, Mat4, "mat4/mul_mat4", a * b);
+  ALT_BINARY(Mat4, Mat4, "mat4/mul_mat4", "scalar", alt::mat_mul_scalar);
+  BINARY(Mat4, Vec4, "mat4/mul_vec4", a * b);
+  ALT_BINARY(Mat4, Vec4, "mat4/mul_vec4", "scalar", alt::mat_vec_scalar);
+  BINARY(Mat4, f32, "mat4/mul_f32", a * b);
+  BINARY(Mat4, f32, "mat4/div_f32", a / b);
+  UNARY(Mat4, "mat4/transpose", lib::transpose(a));
+  ALT_UNARY(Mat4, "mat4/transpose", "scalar", alt::transpose_scalar);
+  UNARY(Mat4, "mat4/det", lib::det(a));
+  UNARY(Mat4, "mat4/inverse", lib::inverse(a));
+  UNARY(Mat4, "mat4/inverse_trans", lib::inverse_trans(a));
+  UNARY(Mat4, "mat4/adjugate_trans", lib::adjugate_trans(a));
+  BINARY(Mat4, Mat4, "mat4/mul_trans", lib::mul_trans(a, b));
+  BINARY(Mat4, Vec3, "mat4/mul_trans_vec", lib::mul_trans_vec(a, b));
+  BINARY(Mat4, Vec3, "mat4/mul_trans_point", lib::mul_trans_point(a, b));
+  UNARY(Mat4, "mat4/get_scale", lib::get_scale(a));
+  UNARY(Mat4, "mat4/get_translation", lib::get_translation(a));
+
+  UNARY(Vec3, "mat4/create_translate", lib::create_translate(a));
+  BINARY(Vec3, f32, "mat4/create_rotation", lib::create_rotation(a, b));
+  UNARY(f32, "mat4/create_rotation_x", lib::create_rotation_x(a));
+  UNARY(f32, "mat4/create_rotation_y", lib::create_rotation_y(a));
+  UNARY(f32, "mat4/create_rotation_z", lib::create_rotation_z(a));
+  BINARY(Vec3, Vec3, "mat4/create_look_at", lib::create_look_at(a, b, { 0.0f, 1.0f, 0.0f }));
+  UNARY(f32, "mat4/create_perspective", lib::create_perspective(a, 1.5f, 0.1f, 100.0f));
+}
+
+int main(int argc, char** argv)
+{
+  lib::bench::Runner runner;
+  const char* json_path = NULL;
+  b32 use_counters = false;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+      json_path = argv[++i];
+    else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+      runner.filter = argv[++i];
+    else if (strcmp(argv[i], "--min-ms") == 0 && i + 1 < argc)
+      runner.min_ms = atof(argv[++i]);
+    else if (strcmp(argv[i], "--perf") == 0)
+      use_counters = true;
+  }
+
+  runner.init(use_counters);
+  printf("tsc %.3f GHz, %u elements, chains of %u\n", runner.tsc_per_ns, element_count, chain_length);
+
+  bench_scalars(runner);
+  bench_vec2(runner);
+  bench_vec3(runner);
+  bench_vec4(runner);
+  bench_mat4(runner);
+
+  if (json_path && !runner.write_json(json_path))
+  {
+    fprintf(stderr, "can't write %s\n", json_path);
+    return EXIT_FAILURE;
+  }
+
+  runner.destroy();
+  return EXIT_SUCCESS;
+}
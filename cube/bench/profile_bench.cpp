@@ -0,0 +1,130 @@
+#define CUBE_PROFILE 1
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <unordered_map>
+#include <chrono>
+#include <thread>
+
+#include "../Utils.hpp"
+#include "../Profiler.hpp"
+#include "Bench.hpp"
+
+// usage: profile_bench [trace.json]
+// Cost of one PROFILE_SCOPE (zone enter + exit) against the same loop without it, single thread and with
+// every hardware thread recording at once, plus how fast the collector drains. Target is < 20 ns per zone.
+
+static u32 work(u32 x)
+{
+  // a few dependent ops so the loop body isn't empty
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+int main(int argc, char** argv)
+{
+  lib::bench::Runner runner;
+  runner.init();
+
+  lib::profiler::Collector collector;
+  collector.init();
+
+  constexpr u32 zones_per_rep = 1024;
+  u32 state = 1;
+
+  runner.run("loop", "bare", "throughput", zones_per_rep, [&](u64 reps)
+    {
+      for (u64 r = 0; r < reps * zones_per_rep; ++r)
+      {
+        state = work(state);
+        lib::bench::keep(state);
+      }
+    });
+
+  // floor for a zone, two of these are unavoidable
+  runner.run("rdtsc", "bare", "throughput", zones_per_rep, [&](u64 reps)
+    {
+      for (u64 r = 0; r < reps * zones_per_rep; ++r)
+        lib::bench::keep(__rdtsc());
+    });
+
+  runner.run("loop", "zone", "throughput", zones_per_rep, [&](u64 reps)
+    {
+      for (u64 r = 0; r < reps; ++r)
+      {
+        for (u32 i = 0; i < zones_per_rep; ++i)
+        {
+          PROFILE_SCOPE("bench zone");
+          state = work(state);
+          lib::bench::keep(state);
+        }
+      }
+    });
+
+  runner.run("loop", "nested", "throughput", zones_per_rep, [&](u64 reps)
+    {
+      for (u64 r = 0; r < reps; ++r)
+      {
+        for (u32 i = 0; i < zones_per_rep / 4; ++i)
+        {
+          PROFILE_SCOPE("outer");
+          for (u32 j = 0; j < 4; ++j)
+          {
+            PROFILE_SCOPE("inner");
+            state = work(state);
+            lib::bench::keep(state);
+          }
+        }
+      }
+    });
+
+  const f64 bare = runner.results[0].ns_per_op;
+  const f64 zone = runner.results[2].ns_per_op - bare;
+  printf("zone overhead: %.2f ns (%.1f tsc cycles), %.2f ns of it is the two rdtsc\n", zone, zone * runner.tsc_per_ns,
+    2.0 * runner.results[1].ns_per_op);
+
+  // the loops above lapped the ring on purpose (the collector isn't what they measure), skip what they left
+  const u32 threads = std::max(1u, std::thread::hardware_concurrency());
+  collector.collect();
+  collector.events.clear();
+  collector.lost = 0;
+  {
+    std::vector<std::thread> workers;
+    const auto start = std::chrono::steady_clock::now();
+    for (u32 t = 0; t < threads; ++t)
+    {
+      workers.emplace_back([]
+        {
+          u32 s = 1;
+          for (u32 i = 0; i < ProfileRing::capacity; ++i)
+          {
+            PROFILE_SCOPE("thread zone");
+            s = work(s);
+            lib::bench::keep(s);
+          }
+        });
+    }
+    for (std::thread& w : workers)
+      w.join();
+    const f64 record_ns = std::chrono::duration<f64, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    const auto collect_start = std::chrono::steady_clock::now();
+    collector.collect();
+    const f64 collect_ns = std::chrono::duration<f64, std::nano>(std::chrono::steady_clock::now() - collect_start).count();
+    printf("%u threads x %u zones: %.2f ns per zone wall, collect %.2f ns per event, %zu events, %llu lost\n",
+      threads, ProfileRing::capacity, record_ns / ((f64)threads * ProfileRing::capacity), collect_ns / (f64)collector.events.size(),
+      collector.events.size(), (unsigned long long)collector.lost);
+  }
+
+  if (argc > 1)
+    collector.write_chrome_trace(argv[1]);
+
+  return 0;
+}
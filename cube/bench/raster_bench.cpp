@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "../SoftRaster.hpp"
+#include "Bench.hpp"
+
+// usage: raster_bench [filter] [width] [height] [grid]
+// The CPU rasterizer at 1x, 4x and 8x: multisampled (shaded once per pixel) against supersampled
+// (shaded once per sample, same samples), for a grid^3 field of cubes (16 by default) clipped once up
+// front, at 1280x720 by default. Time per frame is setup, binning, rasterizing and the resolve, on the
+// job system. Memory is what the rasterizer holds, next to what full size sample buffers (color and
+// depth per sample, plus the resolved image) would take without tiles.
+
+static constexpr f32 spacing = 2.0f;
+
+static void make_scene(u32 grid, const lib::Mat4& view_proj, std::vector<lib::ClipVertex>& vertices, std::vector<u32>& indices)
+{
+  static const u32 cube_indices[36] = {
+    0, 1, 3, 0, 3, 2, 4, 6, 7, 4, 7, 5, // -x, +x
+    0, 4, 5, 0, 5, 1, 2, 3, 7, 2, 7, 6, // -y, +y
+    0, 2, 6, 0, 6, 4, 1, 5, 7, 1, 7, 3, // -z, +z
+  };
+  const f32 offset = (grid - 1) * spacing * 0.5f;
+  for (u32 i = 0; i < grid * grid * grid; ++i)
+  {
+    const lib::Vec3 center = { (i % grid) * spacing - offset, (i / grid % grid) * spacing - offset, (i / grid / grid) * spacing - offset };
+    const u32 base = (u32)vertices.size();
+    for (u32 c = 0; c < 8; ++c)
+    {
+      const lib::Vec4 p = view_proj * lib::Vec4{ center.x + (c & 4 ? 0.5f : -0.5f), center.y + (c & 2 ? 0.5f : -0.5f),
+        center.z + (c & 1 ? 0.5f : -0.5f), 1.0f };
+      vertices.push_back({ p.x, p.y, p.z, p.w, c & 4 ? 1.0f : 0.2f, c & 2 ? 1.0f : 0.2f, c & 1 ? 1.0f : 0.2f, 1.0f });
+    }
+    for (u32 k = 0; k < 36; ++k)
+      indices.push_back(base + cube_indices[k]);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  lib::bench::Runner runner;
+  runner.filter = argc > 1 && strcmp(argv[1], "-") != 0 ? argv[1] : nullptr;
+  const u32 width = argc > 2 ? (u32)atoi(argv[2]) : 1280;
+  const u32 height = argc > 3 ? (u32)atoi(argv[3]) : 720;
+  const u32 grid = argc > 4 ? (u32)atoi(argv[4]) : 16;
+  runner.init();
+
+  lib::JobSystem jobs;
+  jobs.init();
+
+  const f32 extent = grid * spacing;
+  const lib::Mat4 view_proj = lib::create_perspective(0.9f, (f32)width / (f32)height, 0.1f, extent * 4.0f) *
+    lib::create_look_at({ extent * 0.6f, extent * 0.35f, extent * 0.8f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+  std::vector<lib::ClipVertex> vertices;
+  std::vector<u32> indices;
+  make_scene(grid, view_proj, vertices, indices);
+  lib::ClipStage clip;
+  clip.run(jobs, vertices.data(), indices.data(), (u32)(indices.size() / 3), { (f32)width, (f32)height, true });
+  const lib::ClipStats clipped = clip.stats();
+  printf("%ux%u, %llu triangles, %llu after clipping and culling, %zu threads\n", width, height, (unsigned long long)clipped.triangles,
+    (unsigned long long)clipped.emitted, jobs.workers.size() + 1);
+
+  struct Mode
+  {
+    const char* name;
+    u32 samples;
+    b32 per_sample_shading;
+  };
+  const Mode modes[] = {
+    { "1x", 1, false },
+    { "4x msaa", 4, false },
+    { "4x ssaa", 4, true },
+    { "8x msaa", 8, false },
+    { "8x ssaa", 8, true },
+  };
+  struct Row
+  {
+    const char* name;
+    f64 ms;
+    lib::SoftRasterStats stats;
+    u64 memory;
+    u64 untiled;
+  };
+  std::vector<Row> rows;
+  const u64 pixels = (u64)width * height;
+  for (const Mode& mode : modes)
+  {
+    if (!runner.selected(mode.name))
+      continue;
+    lib::SoftRaster raster;
+    raster.init(width, height, mode.samples, mode.per_sample_shading);
+    runner.run(mode.name, "raster", "job system", pixels, [&](u64 reps)
+      {
+        for (u64 i = 0; i < reps; ++i)
+          raster.render(jobs, clip.bins.data(), clip.bin_count);
+        lib::bench::keep(raster.image[0]);
+      });
+    const u64 untiled = pixels * sizeof(u32) + (mode.samples > 1 ? pixels * mode.samples * (sizeof(u32) + sizeof(f32)) : pixels * sizeof(f32));
+    rows.push_back({ mode.name, runner.results.back().ns_per_op * pixels / 1e6, raster.stats, raster.memory_bytes(), untiled });
+    raster.destroy();
+  }
+
+  const f64 mib = 1024.0 * 1024.0;
+  printf("%-8s %9s %10s %12s %12s %12s %14s\n", "mode", "ms/frame", "Mpix/s", "shaded/pix", "samples/pix", "memory MiB", "untiled MiB");
+  for (const Row& r : rows)
+    printf("%-8s %9.2f %10.1f %12.2f %12.2f %12.2f %14.2f\n", r.name, r.ms, pixels / r.ms / 1e3, (f64)r.stats.shaded / pixels,
+      (f64)r.stats.samples / pixels, r.memory / mib, r.untiled / mib);
+
+  jobs.destroy();
+  runner.destroy();
+  return EXIT_SUCCESS;
+}
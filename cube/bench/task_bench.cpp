@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+#include <thread>
+
+#include "../Task.hpp"
+#include "Bench.hpp"
+
+// usage: task_bench [filter]
+// What a hop costs in the coroutine layer. Frame allocation from the pool against malloc, a co_await of a
+// task that finishes right away against a plain call, and the three thread switches a load chain makes:
+// to the job system, to the I/O layer and back, and to the render thread's frame queue. Job hops are
+// compared with submitting a std::function and waiting on a counter, which is the same queue.
+
+__attribute__((noinline)) static int plain_leaf(int x)
+{
+  return x + 1;
+}
+
+static lib::Task<int> leaf(int x)
+{
+  co_return x + 1;
+}
+
+static lib::Task<int> chain(u64 count)
+{
+  int x = 0;
+  for (u64 i = 0; i < count; ++i)
+    x = co_await leaf(x);
+  co_return x;
+}
+
+static lib::Task<void> job_hops(lib::JobSystem& jobs, u64 count)
+{
+  for (u64 i = 0; i < count; ++i)
+    co_await lib::schedule(jobs);
+}
+
+static lib::Task<void> frame_hops(lib::FrameQueue& frames, u64 count)
+{
+  for (u64 i = 0; i < count; ++i)
+    co_await frames.next_frame();
+}
+
+static lib::Task<u64> io_reads(lib::AssetIO& io, lib::JobSystem& jobs, const char* path, u64 count)
+{
+  lib::IoArena arena;
+  arena.init(1 << 20);
+  u64 bytes = 0;
+  for (u64 i = 0; i < count; ++i)
+  {
+    const lib::IoResult r = co_await lib::read_file(io, path, arena, lib::IoPriority::normal, &jobs);
+    bytes += r.size;
+    arena.reset();
+  }
+  arena.destroy();
+  co_return bytes;
+}
+
+int main(int argc, char** argv)
+{
+  lib::bench::Runner runner;
+  runner.filter = argc > 1 ? argv[1] : nullptr;
+  runner.init();
+
+  runner.run("frame alloc 256 B", "pool", "", 1, [](u64 reps)
+    {
+      for (u64 i = 0; i < reps; ++i)
+      {
+        void* p = lib::TaskFramePool::alloc(256);
+        lib::bench::keep(p);
+        lib::TaskFramePool::free(p);
+      }
+    });
+  runner.run("frame alloc 256 B", "malloc", "", 1, [](u64 reps)
+    {
+      for (u64 i = 0; i < reps; ++i)
+      {
+        void* p = malloc(256);
+        lib::bench::keep(p);
+        free(p);
+      }
+    });
+
+  runner.run("call", "plain", "", 1, [](u64 reps)
+    {
+      int x = 0;
+      for (u64 i = 0; i < reps; ++i)
+        x = plain_leaf(x);
+      lib::bench::keep(x);
+    });
+
+  lib::JobSystem jobs;
+  jobs.init(1);
+  runner.run("call", "co_await", "ready task", 1, [&](u64 reps) { lib::bench::keep(lib::sync_wait(chain(reps), jobs)); });
+
+  runner.run("hop to job system", "function", "submit + wait", 1, [&](u64 reps)
+    {
+      for (u64 i = 0; i < reps; ++i)
+      {
+        lib::JobCounter counter;
+        jobs.submit([] {}, &counter);
+        jobs.wait(counter);
+      }
+    });
+  runner.run("hop to job system", "co_await", "schedule", 1, [&](u64 reps) { lib::sync_wait(job_hops(jobs, reps), jobs); });
+
+  lib::FrameQueue frames;
+  runner.run("hop to frame queue", "co_await", "next_frame + run", 1, [&](u64 reps)
+    {
+      lib::JobCounter counter;
+      lib::spawn(frame_hops(frames, reps), &counter);
+      while (counter.pending.load(std::memory_order_acquire))
+        frames.run();
+    });
+
+  char path[] = "/tmp/task_bench_XXXXXX";
+  const int fd = mkstemp(path);
+  if (fd >= 0)
+  {
+    std::vector<u8> data(4096, 7);
+    const bool written = write(fd, data.data(), data.size()) == (ssize_t)data.size();
+    close(fd);
+    if (written)
+    {
+      lib::AssetIO io;
+      io.init();
+      lib::IoArena arena;
+      arena.init(1 << 20);
+      runner.run("read 4 KiB (warm)", io_backend_name(io.backend), "future get", 1, [&](u64 reps)
+        {
+          for (u64 i = 0; i < reps; ++i)
+          {
+            lib::bench::keep(io.read(path, arena).get().size);
+            arena.reset();
+          }
+        });
+      runner.run("read 4 KiB (warm)", io_backend_name(io.backend), "co_await read_file", 1, [&](u64 reps)
+        {
+          lib::bench::keep(lib::sync_wait(io_reads(io, jobs, path, reps), jobs));
+        });
+      arena.destroy();
+      io.destroy();
+    }
+    unlink(path);
+  }
+
+  jobs.destroy();
+  lib::TaskFramePool::print_summary();
+  runner.destroy();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <glad/glad.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include "../Texture.hpp"
+#include "Bench.hpp"
+
+// usage: texture_bench [image path | size] [reps]
+// Mip chain generation throughput in MB/s of level 0 RGBA8 input: the scalar reference, the SSE path on one
+// worker and on the whole machine, for both filters, each including the sRGB decode/encode. Then the
+// same level 0 uploaded as GL_SRGB8_ALPHA8 and glGenerateMipmap timed with glFinish, GPU and driver
+// together. Without a GL context the last rows are skipped. Best of reps, the first run is a warm up.
+
+static void error_callback(int error, const char* description)
+{
+  fprintf(stderr, "Error 0x%x: %s\n", error, description);
+}
+
+static void make_image(lib::Image& image, s32 size)
+{
+  // photo-ish: smooth gradients, hard edges and some noise so no filter gets a free ride
+  image.width = size;
+  image.height = size;
+  image.pixels.resize((size_t)size * size * 4);
+  u32 state = 0x9e3779b9u;
+  for (s32 y = 0; y < size; ++y)
+  {
+    for (s32 x = 0; x < size; ++x)
+    {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      u8* p = &image.pixels[((size_t)y * size + x) * 4];
+      const b32 checker = ((x / 37) ^ (y / 37)) & 1;
+      p[0] = (u8)(x * 255 / size);
+      p[1] = (u8)(checker ? 230 : 25);
+      p[2] = (u8)((y * 255 / size) ^ (state & 15));
+      p[3] = 255;
+    }
+  }
+}
+
+template <typename F>
+static f64 best_ms(u32 reps, F&& f)
+{
+  f(); // warm up, allocates
+  f64 best = 1e30;
+  for (u32 i = 0; i < reps; ++i)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    best = std::min(best, std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count());
+  }
+  return best;
+}
+
+static void report(const char* name, const char* filter, u32 workers, f64 ms, f64 mb)
+{
+  printf("%-18s %8s %8u %10.3f %10.1f\n", name, filter, workers, ms, mb / (ms / 1000.0));
+}
+
+int main(int argc, char** argv)
+{
+  lib::Image image;
+  if (argc > 1 && !(argv[1][0] >= '0' && argv[1][0] <= '9'))
+  {
+    if (!lib::load_image(argv[1], image))
+    {
+      fprintf(stderr, "can't load %s\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+  }
+  else
+  {
+    make_image(image, argc > 1 ? atoi(argv[1]) : 2048);
+  }
+  const u32 reps = argc > 2 ? (u32)atoi(argv[2]) : 10;
+  const f64 mb = (f64)image.pixels.size() / (1024.0 * 1024.0);
+  const u32 hw = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+
+  printf("%dx%d, %u levels, %.1f MB level 0, best of %u\n", image.width, image.height, lib::mip_count(image.width, image.height), mb, reps);
+  printf("%-18s %8s %8s %10s %10s\n", "variant", "filter", "workers", "ms", "MB/s");
+
+  lib::MipChain chain;
+  for (lib::MipFilter filter : { lib::MipFilter::box, lib::MipFilter::kaiser })
+  {
+    const char* filter_name = filter == lib::MipFilter::box ? "box" : "kaiser";
+    report("scalar", filter_name, 1, best_ms(reps, [&] { lib::build_mips(image, chain, filter, nullptr, false); }), mb);
+    report("sse", filter_name, 1, best_ms(reps, [&] { lib::build_mips(image, chain, filter, nullptr); }), mb);
+    if (hw > 1)
+    {
+      lib::JobSystem jobs;
+      jobs.init(hw);
+      report("sse", filter_name, hw, best_ms(reps, [&] { lib::build_mips(image, chain, filter, &jobs); }), mb);
+      jobs.destroy();
+    }
+  }
+  lib::bench::keep(chain.pixels.back());
+
+  glfwSetErrorCallback(error_callback);
+  GLFWwindow* window = NULL;
+  if (glfwInit())
+  {
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    window = glfwCreateWindow(64, 64, "texture_bench", NULL, NULL);
+  }
+  if (!window)
+  {
+    printf("no GL context, glGenerateMipmap skipped\n");
+    glfwTerminate();
+    return 0;
+  }
+
+  glfwMakeContextCurrent(window);
+  gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  const GLsizei levels = (GLsizei)lib::mip_count(image.width, image.height);
+  s32 w = image.width, h = image.height;
+  for (GLsizei level = 0; level < levels; ++level)
+  {
+    glTexImage2D(GL_TEXTURE_2D, level, GL_SRGB8_ALPHA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, level ? NULL : image.pixels.data());
+    w = lib::max(1, w / 2);
+    h = lib::max(1, h / 2);
+  }
+  glFinish();
+
+  report("glGenerateMipmap", "driver", 1, best_ms(reps, [] { glGenerateMipmap(GL_TEXTURE_2D); glFinish(); }), mb);
+  printf("%s\n", (const char*)glGetString(GL_RENDERER));
+
+  glDeleteTextures(1, &texture);
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return 0;
+}
@@ -0,0 +1,64 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+#include <chrono>
+#include <thread>
+
+#include "../BlockCompress.hpp"
+
+// usage: texture_compress <image> <out.ctex> [bc1|bc3|bc7] [--fast] [--box]
+// Offline side of the texture path: decode, Kaiser mips in linear space, best quality block compression
+// on every core, written as .ctex for cube --texture. bc7 by default.
+
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+  {
+    fprintf(stderr, "usage: texture_compress <image> <out.ctex> [bc1|bc3|bc7] [--fast] [--box]\n");
+    return EXIT_FAILURE;
+  }
+
+  lib::BcFormat format = lib::BcFormat::bc7;
+  lib::BcQuality quality = lib::BcQuality::best;
+  lib::MipFilter filter = lib::MipFilter::kaiser;
+  for (int i = 3; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--fast") == 0)
+      quality = lib::BcQuality::fast;
+    else if (strcmp(argv[i], "--box") == 0)
+      filter = lib::MipFilter::box;
+    else if (!lib::parse_bc_format(argv[i], format))
+    {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  lib::Image image;
+  if (!lib::load_image(argv[1], image))
+  {
+    fprintf(stderr, "can't load %s (png, qoi or ppm)\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  lib::JobSystem jobs;
+  jobs.init();
+  const auto start = std::chrono::steady_clock::now();
+  lib::MipChain chain;
+  lib::build_mips(image, chain, filter, &jobs);
+  lib::CompressedTexture texture;
+  lib::compress(chain, format, texture, &jobs, quality);
+  const f64 ms = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+  jobs.destroy();
+
+  if (!lib::write_ctex(argv[2], texture))
+  {
+    fprintf(stderr, "can't write %s\n", argv[2]);
+    return EXIT_FAILURE;
+  }
+  printf("%s: %dx%d, %zu levels, %s, %.1f KiB -> %.1f KiB in %.1f ms\n", argv[2], texture.width, texture.height, texture.levels.size(),
+    lib::bc_format_name(format), chain.pixels.size() / 1024.0, texture.blocks.size() / 1024.0, ms);
+  return 0;
+}